@@ -1,36 +1,39 @@
 ## Example of a python plugin for tcpflow.
-## This sample contains three functions.
+## This sample contains four functions.
 
-## The first function takes a string and returns a sample message.
-## The input string contains the application data from tcpflow's buffer.
+## Each function is called with the application data of a flow, as a
+## read-only memoryview, and a dict describing the flow (src, dst, sport,
+## dport, proto, family, start, end, packets, len, path and content).
+## The memoryview is only valid during the call; use bytes(data) to keep it.
 
-def sampleFunction(appData):
+## The first function returns a sample message.
+
+def sampleFunction(appData, meta):
     return "This message appears in the XML tag 'tcpflow:result' of report.xml (DFXML)."
 
-## The second function takes a string (application data)
-## and writes the application (HTTP) header data to the file
-## myOutput.txt located in the python director.
+## The second function writes the application (HTTP) header data
+## to the file myOutput.txt located in the python directory.
 ## This function does not return and simply prints to stdout.
 
-def headerWriter(appData):
+def headerWriter(appData, meta):
     fName = "myOutput.txt"
-    f = open("python/" + fName, 'a')
-    headerFinish = appData.find("\r\n\r\n") + 4
-    headerData = appData[:headerFinish+1]
-    f.write(headerData)
-    f.close()
-    print "Wrote data to " + fName
-
-## The third function takes a string (application data)
-## parses the HTTP message (without headers)
+    data = bytes(appData)
+    headerFinish = data.find(b"\r\n\r\n") + 4
+    headerData = data[:headerFinish+1]
+    with open("python/" + fName, 'ab') as f:
+        f.write(headerData)
+    print("Wrote data to " + fName)
+
+## The third function parses the HTTP message (without headers)
 ## performs a bitwise xor operation with a key defined in the function
 ## and returns the text corresponding to this binary result.
 
-def xorOp(appData):
+def xorOp(appData, meta):
     # Assume variable buffer includes message data.
-    dataStart = appData.find("\r\n\r\n") + 4
-    httpData = appData[dataStart:]
-    binaryData = ''.join(format(ord(x), 'b') for x in httpData)
+    data = bytes(appData)
+    dataStart = data.find(b"\r\n\r\n") + 4
+    httpData = data[dataStart:]
+    binaryData = ''.join(format(x, 'b') for x in httpData)
     if len(binaryData) < 1:
         return 0
 
@@ -47,3 +50,11 @@ def xorOp(appData):
         i += 1
     xorRes = int(binaryData,2) ^ int(newKey,2)
     return '{0:b}'.format(xorRes)
+
+## The fourth function is for -S py_batch=N: it gets a list of
+## (appData, meta) tuples and returns one result per flow, in order.
+
+def flowSummary(flows):
+    return ["%s:%d -> %s:%d %d bytes %s" % (meta['src'], meta['sport'], meta['dst'], meta['dport'],
+                                           len(appData), meta['content'] or "unknown")
+            for appData, meta in flows]
@@ -0,0 +1,481 @@
+/**
+ * arrow_writer.cpp:
+ *
+ * Writes the Arrow IPC file format; see arrow_writer.h.
+ *
+ * The message metadata are flatbuffers, as described by Schema.fbs,
+ * Message.fbs and File.fbs in the Arrow format specification. The
+ * field numbers used below are the order of the fields in those files.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "config.h"
+#include "arrow_writer.h"
+
+#include <errno.h>
+#include <string.h>
+
+/****************************************************************
+ *** A minimal flatbuffer builder
+ ****************************************************************/
+
+/* Like the real flatbuffers builder, this one builds back to front:
+ * children are added before their parents, and a position is the
+ * number of bytes from the end of the buffer, which does not change as
+ * more is prepended. Only the little the Arrow metadata needs is here.
+ */
+class fb_builder {
+    /* These are not implemented */
+    fb_builder(const fb_builder &);
+    fb_builder &operator=(const fb_builder &);
+public:
+    fb_builder():buf(),minalign(1),fields(),table_start(0){}
+
+    uint32_t size() const { return (uint32_t)buf.size(); }
+
+    template<class T> uint32_t scalar(T v) {
+        align(sizeof(T),sizeof(T));
+        prepend(&v,sizeof(T));
+        return size();
+    }
+    uint32_t uoffset(uint32_t target) {
+        align(4,4);
+        uint32_t v = size()+4-target;
+        prepend(&v,4);
+        return size();
+    }
+    uint32_t string(const std::string &s) {
+        align(s.size()+1,4);
+        buf.insert(0,1,'\0');
+        prepend(s.data(),s.size());
+        return scalar<uint32_t>((uint32_t)s.size());
+    }
+    uint32_t offset_vector(const std::vector<uint32_t> &offsets) {
+        align(offsets.size()*4,4);
+        for(size_t i=offsets.size();i>0;i--) uoffset(offsets[i-1]);
+        return scalar<uint32_t>((uint32_t)offsets.size());
+    }
+    uint32_t struct_vector(const void *p,size_t count,size_t elem_size) {
+        align(count*elem_size,8);
+        prepend(p,count*elem_size);
+        return scalar<uint32_t>((uint32_t)count);
+    }
+
+    void start_table() {
+        fields.clear();
+        table_start = size();
+    }
+    template<class T> void add_scalar(int id,T v) { fields.push_back(field(id,scalar(v))); }
+    void add_offset(int id,uint32_t target) { fields.push_back(field(id,uoffset(target))); }
+    uint32_t end_table() {
+        uint32_t table = scalar<int32_t>(0);  // to the vtable, patched below
+        int nfields = 0;
+        for(std::vector<field>::const_iterator it=fields.begin();it!=fields.end();it++){
+            if(it->id+1>nfields) nfields = it->id+1;
+        }
+        std::vector<uint16_t> vt(nfields,0);
+        for(std::vector<field>::const_iterator it=fields.begin();it!=fields.end();it++){
+            vt[it->id] = (uint16_t)(table - it->pos);
+        }
+        for(int i=nfields;i>0;i--) scalar<uint16_t>(vt[i-1]);
+        scalar<uint16_t>((uint16_t)(table - table_start));
+        uint32_t vtable = scalar<uint16_t>((uint16_t)(4+2*nfields));
+        int32_t soffset = (int32_t)(vtable - table);
+        memcpy(&buf[size()-table],&soffset,4);
+        return table;
+    }
+
+    const std::string &finish(uint32_t root) {
+        align(4,minalign>8 ? minalign : 8);
+        uoffset(root);
+        return buf;
+    }
+
+private:
+    struct field {
+        field(int i,uint32_t p):id(i),pos(p){}
+        int      id;
+        uint32_t pos;
+    };
+    std::string buf;
+    size_t      minalign;
+    std::vector<field> fields;          // of the table being built
+    uint32_t    table_start;
+
+    void prepend(const void *p,size_t n) { buf.insert(0,(const char *)p,n); }
+    /* Pad so that len more bytes end on an alignment boundary */
+    void align(size_t len,size_t alignment) {
+        if(alignment>minalign) minalign = alignment;
+        size_t pad = (alignment - (buf.size()+len) % alignment) % alignment;
+        buf.insert(0,pad,'\0');
+    }
+};
+
+/* From the Arrow format specification */
+namespace arrow_fb {
+    enum { METADATA_V5=4 };
+    enum { HEADER_SCHEMA=1, HEADER_DICTIONARY_BATCH=2, HEADER_RECORD_BATCH=3 };
+    enum { TYPE_INT=2, TYPE_UTF8=5, TYPE_TIMESTAMP=10 };
+    enum { UNIT_NANOSECOND=3 };
+    struct field_node { int64_t length; int64_t null_count; };
+    struct buffer     { int64_t offset; int64_t length; };
+    struct block      { int64_t offset; int32_t metadata_len; int32_t pad; int64_t body_len; };
+}
+
+/* The body of a record batch: buffers, each padded to 8 bytes */
+struct batch_body {
+    batch_body():body(),nodes(),buffers(){}
+    std::vector<uint8_t> body;
+    std::vector<arrow_fb::field_node> nodes;
+    std::vector<arrow_fb::buffer> buffers;
+
+    void add_node(int64_t length,int64_t null_count) {
+        arrow_fb::field_node n = {length,null_count};
+        nodes.push_back(n);
+    }
+    void add_buffer(const void *p,size_t len) {
+        arrow_fb::buffer b = {(int64_t)body.size(),(int64_t)len};
+        buffers.push_back(b);
+        body.insert(body.end(),(const uint8_t *)p,(const uint8_t *)p+len);
+        body.resize((body.size()+7) & ~(size_t)7);
+    }
+    /* The RecordBatch table */
+    uint32_t build(fb_builder &b,int64_t length) const {
+        uint32_t bufs  = b.struct_vector(buffers.size() ? &buffers[0] : 0,buffers.size(),sizeof(arrow_fb::buffer));
+        uint32_t nodes_ = b.struct_vector(nodes.size() ? &nodes[0] : 0,nodes.size(),sizeof(arrow_fb::field_node));
+        b.start_table();
+        b.add_scalar<int64_t>(0,length);
+        b.add_offset(1,nodes_);
+        b.add_offset(2,bufs);
+        return b.end_table();
+    }
+};
+
+/* The Message table around a header */
+static std::string build_message(fb_builder &b,uint8_t header_type,uint32_t header,int64_t body_len)
+{
+    b.start_table();
+    b.add_scalar<int64_t>(3,body_len);
+    b.add_offset(2,header);
+    b.add_scalar<int16_t>(0,arrow_fb::METADATA_V5);
+    b.add_scalar<uint8_t>(1,header_type);
+    return b.finish(b.end_table());
+}
+
+/****************************************************************
+ *** arrow_writer
+ ****************************************************************/
+
+static const char ARROW_MAGIC[] = "ARROW1";
+
+arrow_writer::arrow_writer():opt(),err(),columns(),f(0),fbuf(),pos(0),batch_length(0),total_rows(0),
+                             next_dict_id(0),dictionary_blocks(),record_blocks()
+{
+}
+
+arrow_writer::~arrow_writer()
+{
+    close();
+}
+
+int arrow_writer::add_column(const std::string &name,type_t type,bool nullable)
+{
+    columns.push_back(column(name,type,nullable));
+    if(type==DICT_UTF8) columns.back().dict_id = next_dict_id++;
+    if(type==UTF8) columns.back().offsets.push_back(0);
+    return (int)columns.size()-1;
+}
+
+void arrow_writer::write(const void *buf,size_t len)
+{
+    if(fwrite(buf,1,len,f)!=len){
+        fprintf(stderr,"arrow_writer: write failed: %s\n",strerror(errno));
+        exit(1);
+    }
+    pos += len;
+}
+
+uint32_t arrow_writer::build_schema(fb_builder &b) const
+{
+    std::vector<uint32_t> fields;
+    for(std::vector<column>::const_iterator it=columns.begin();it!=columns.end();it++){
+        uint32_t children = b.offset_vector(std::vector<uint32_t>());
+        uint32_t name     = b.string(it->name);
+        uint32_t type     = 0;
+        uint8_t  type_type = 0;
+        uint32_t dictionary = 0;
+        if(it->type==DICT_UTF8){
+            b.start_table();            // the index type
+            b.add_scalar<int32_t>(0,32);
+            b.add_scalar<uint8_t>(1,1);
+            uint32_t index_type = b.end_table();
+            b.start_table();
+            b.add_scalar<int64_t>(0,it->dict_id);
+            b.add_offset(1,index_type);
+            b.add_scalar<uint8_t>(2,0);  // not ordered
+            dictionary = b.end_table();
+        }
+        switch(it->type){
+        case TIMESTAMP_NS: {
+            uint32_t tz = b.string("UTC");
+            b.start_table();
+            b.add_offset(1,tz);
+            b.add_scalar<int16_t>(0,arrow_fb::UNIT_NANOSECOND);
+            type = b.end_table();
+            type_type = arrow_fb::TYPE_TIMESTAMP;
+            break;
+        }
+        case UINT8: case UINT16: case INT32: case UINT64: {
+            int32_t width = it->type==UINT8 ? 8 : it->type==UINT16 ? 16 : it->type==INT32 ? 32 : 64;
+            b.start_table();
+            b.add_scalar<int32_t>(0,width);
+            b.add_scalar<uint8_t>(1,it->type==INT32);
+            type = b.end_table();
+            type_type = arrow_fb::TYPE_INT;
+            break;
+        }
+        case UTF8: case DICT_UTF8:       // for dictionaries, the type of the values
+            b.start_table();
+            type = b.end_table();
+            type_type = arrow_fb::TYPE_UTF8;
+            break;
+        }
+        b.start_table();
+        b.add_offset(0,name);
+        b.add_offset(3,type);
+        if(dictionary) b.add_offset(4,dictionary);
+        b.add_offset(5,children);
+        b.add_scalar<uint8_t>(1,it->nullable);
+        b.add_scalar<uint8_t>(2,type_type);
+        fields.push_back(b.end_table());
+    }
+    uint32_t fv = b.offset_vector(fields);
+    const uint16_t one = 1;
+    b.start_table();
+    b.add_offset(1,fv);
+    b.add_scalar<int16_t>(0,*(const uint8_t *)&one ? 0 : 1); // Little or Big endian
+    return b.end_table();
+}
+
+bool arrow_writer::open(const std::string &fname,const options &opt_)
+{
+    opt = opt_;
+    if(opt.batch_rows==0) opt.batch_rows = 1;
+    f = fopen(fname.c_str(),"wb");
+    if(f==0){
+        err = fname + ": " + strerror(errno);
+        return false;
+    }
+    fbuf.resize(4*1024*1024);
+    setvbuf(f,&fbuf[0],_IOFBF,fbuf.size());
+    const char magic[8] = {'A','R','R','O','W','1',0,0};
+    write(magic,sizeof(magic));
+
+    fb_builder b;
+    uint32_t schema = build_schema(b);
+    write_message(build_message(b,arrow_fb::HEADER_SCHEMA,schema,0),bytes_t());
+    return true;
+}
+
+/* An encapsulated message: continuation marker, metadata length, metadata padded to 8, body */
+arrow_writer::block arrow_writer::write_message(const std::string &metadata,const bytes_t &body)
+{
+    int64_t  offset  = (int64_t)pos;
+    uint32_t padded  = (uint32_t)((metadata.size()+7) & ~(size_t)7);
+    uint32_t prefix[2] = {0xffffffffU,padded};
+    static const char zeros[8] = {0,0,0,0,0,0,0,0};
+    write(prefix,sizeof(prefix));
+    write(metadata.data(),metadata.size());
+    write(zeros,padded-metadata.size());
+    if(body.size()) write(&body[0],body.size());
+    return block(offset,(int32_t)(sizeof(prefix)+padded),(int64_t)body.size());
+}
+
+void arrow_writer::set_valid(column &c,bool valid)
+{
+    if(c.length%8==0) c.validity.push_back(0);
+    if(valid) c.validity.back() |= (uint8_t)(1<<(c.length%8));
+    else c.null_count++;
+    c.length++;
+}
+
+void arrow_writer::append_null(int col)
+{
+    column &c = columns[col];
+    set_valid(c,false);
+    switch(c.type){
+    case TIMESTAMP_NS: case UINT64: c.values.resize(c.values.size()+8); break;
+    case INT32: case DICT_UTF8:     c.values.resize(c.values.size()+4); break;
+    case UINT16:                    c.values.resize(c.values.size()+2); break;
+    case UINT8:                     c.values.resize(c.values.size()+1); break;
+    case UTF8:                      c.offsets.push_back((int32_t)c.data.size()); break;
+    }
+}
+
+void arrow_writer::append(int col,uint64_t v)
+{
+    column &c = columns[col];
+    set_valid(c,true);
+    switch(c.type){
+    case TIMESTAMP_NS: case UINT64: {
+        c.values.insert(c.values.end(),(const uint8_t *)&v,(const uint8_t *)&v+8);
+        break;
+    }
+    case INT32: {
+        int32_t v32 = (int32_t)v;
+        c.values.insert(c.values.end(),(const uint8_t *)&v32,(const uint8_t *)&v32+4);
+        break;
+    }
+    case UINT16: {
+        uint16_t v16 = (uint16_t)v;
+        c.values.insert(c.values.end(),(const uint8_t *)&v16,(const uint8_t *)&v16+2);
+        break;
+    }
+    case UINT8:
+        c.values.push_back((uint8_t)v);
+        break;
+    case UTF8: case DICT_UTF8:
+        abort();                        // a number for a string column
+    }
+}
+
+void arrow_writer::append(int col,int64_t v)
+{
+    append(col,(uint64_t)v);
+}
+
+void arrow_writer::append(int col,const struct timespec &ts)
+{
+    append(col,(int64_t)ts.tv_sec*1000000000 + ts.tv_nsec);
+}
+
+void arrow_writer::append(int col,const std::string &s)
+{
+    column &c = columns[col];
+    set_valid(c,true);
+    if(c.type==UTF8){
+        c.data += s;
+        c.offsets.push_back((int32_t)c.data.size());
+        return;
+    }
+    if(c.type!=DICT_UTF8) abort();      // a string for a number column
+    dict_t::const_iterator it = c.dict.find(s);
+    int32_t index;
+    if(it==c.dict.end()){
+        index = (int32_t)c.dict.size();
+        c.dict[s] = index;
+        c.new_values.push_back(s);
+    } else {
+        index = it->second;
+    }
+    c.values.insert(c.values.end(),(const uint8_t *)&index,(const uint8_t *)&index+4);
+}
+
+void arrow_writer::end_row()
+{
+    batch_length++;
+    total_rows++;
+    if(batch_length>=opt.batch_rows) write_batch();
+}
+
+/* The values added to each dictionary since the last batch */
+void arrow_writer::write_dictionaries()
+{
+    for(std::vector<column>::iterator it=columns.begin();it!=columns.end();it++){
+        if(it->type!=DICT_UTF8) continue;
+        if(it->dict_written && it->new_values.empty()) continue;
+        std::vector<int32_t> offsets(1,0);
+        std::string data;
+        for(std::vector<std::string>::const_iterator v=it->new_values.begin();v!=it->new_values.end();v++){
+            data += *v;
+            offsets.push_back((int32_t)data.size());
+        }
+        batch_body bb;
+        bb.add_node((int64_t)it->new_values.size(),0);
+        bb.add_buffer(0,0);             // no nulls
+        bb.add_buffer(&offsets[0],offsets.size()*4);
+        bb.add_buffer(data.data(),data.size());
+
+        fb_builder b;
+        uint32_t rb = bb.build(b,(int64_t)it->new_values.size());
+        b.start_table();
+        b.add_scalar<int64_t>(0,it->dict_id);
+        b.add_offset(1,rb);
+        b.add_scalar<uint8_t>(2,it->dict_written); // isDelta
+        uint32_t db = b.end_table();
+        dictionary_blocks.push_back(write_message(build_message(b,arrow_fb::HEADER_DICTIONARY_BATCH,db,
+                                                                (int64_t)bb.body.size()),bb.body));
+        it->dict_written = true;
+        it->new_values.clear();
+    }
+}
+
+void arrow_writer::write_batch()
+{
+    if(batch_length==0) return;
+    write_dictionaries();
+    batch_body bb;
+    for(std::vector<column>::iterator it=columns.begin();it!=columns.end();it++){
+        bb.add_node(it->length,it->null_count);
+        if(it->null_count) bb.add_buffer(&it->validity[0],it->validity.size());
+        else bb.add_buffer(0,0);
+        if(it->type==UTF8){
+            bb.add_buffer(&it->offsets[0],it->offsets.size()*4);
+            bb.add_buffer(it->data.data(),it->data.size());
+            it->offsets.assign(1,0);
+            it->data.clear();
+        } else {
+            bb.add_buffer(it->values.size() ? &it->values[0] : 0,it->values.size());
+            it->values.clear();
+        }
+        it->validity.clear();
+        it->null_count = 0;
+        it->length = 0;
+    }
+    fb_builder b;
+    uint32_t rb = bb.build(b,batch_length);
+    record_blocks.push_back(write_message(build_message(b,arrow_fb::HEADER_RECORD_BATCH,rb,
+                                                        (int64_t)bb.body.size()),bb.body));
+    batch_length = 0;
+}
+
+void arrow_writer::close()
+{
+    if(f==0) return;
+    write_batch();
+    /* End of stream */
+    const uint32_t eos[2] = {0xffffffffU,0};
+    write(eos,sizeof(eos));
+
+    /* The footer: the schema again, and where the batches are */
+    std::vector<arrow_fb::block> dicts,records;
+    for(std::vector<block>::const_iterator it=dictionary_blocks.begin();it!=dictionary_blocks.end();it++){
+        arrow_fb::block fbb = {it->offset,it->metadata_len,0,it->body_len};
+        dicts.push_back(fbb);
+    }
+    for(std::vector<block>::const_iterator it=record_blocks.begin();it!=record_blocks.end();it++){
+        arrow_fb::block fbb = {it->offset,it->metadata_len,0,it->body_len};
+        records.push_back(fbb);
+    }
+    fb_builder b;
+    uint32_t rv = b.struct_vector(records.size() ? &records[0] : 0,records.size(),sizeof(arrow_fb::block));
+    uint32_t dv = b.struct_vector(dicts.size() ? &dicts[0] : 0,dicts.size(),sizeof(arrow_fb::block));
+    uint32_t schema = build_schema(b);
+    b.start_table();
+    b.add_offset(1,schema);
+    b.add_offset(2,dv);
+    b.add_offset(3,rv);
+    b.add_scalar<int16_t>(0,arrow_fb::METADATA_V5);
+    const std::string &footer = b.finish(b.end_table());
+    write(footer.data(),footer.size());
+    int32_t footer_len = (int32_t)footer.size();
+    write(&footer_len,4);
+    write(ARROW_MAGIC,6);
+    if(fclose(f)!=0){
+        fprintf(stderr,"arrow_writer: close failed: %s\n",strerror(errno));
+        exit(1);
+    }
+    f = 0;
+}
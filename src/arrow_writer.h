@@ -0,0 +1,140 @@
+/*
+ * arrow_writer.h:
+ *
+ * Writes a table in the Apache Arrow IPC file format (also known as
+ * Feather version 2), which pandas, Spark, DuckDB and R read without
+ * parsing anything: pandas.read_feather(), pyarrow.ipc.open_file().
+ *
+ * Used for the -S flow_summary output: a row per flow, fed from the same
+ * place as the DFXML report. The format is written directly; the
+ * flatbuffer metadata is built by the small builder in arrow_writer.cpp,
+ * so there is no dependency on the Arrow libraries.
+ *
+ * Rows are collected column by column and written as a record batch of
+ * batch_rows rows (the IPC equivalent of a Parquet row group). String
+ * columns with few distinct values, such as addresses, can be dictionary
+ * encoded: each distinct value is stored once, in dictionary batches that
+ * grow by delta as new values appear, and the rows hold 32-bit indices.
+ *
+ * The footer that makes the file random-access is written by close().
+ * If tcpflow dies before that, everything after the 8-byte magic is
+ * still a valid Arrow IPC stream up to the last complete batch.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef ARROW_WRITER_H
+#define ARROW_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_UNORDERED_MAP)
+# include <unordered_map>
+#else
+# if defined(HAVE_TR1_UNORDERED_MAP)
+#  include <tr1/unordered_map>
+# else
+#  include <map>
+# endif
+#endif
+
+class arrow_writer {
+    /* These are not implemented */
+    arrow_writer(const arrow_writer &);
+    arrow_writer &operator=(const arrow_writer &);
+public:
+    typedef enum {
+        TIMESTAMP_NS,                   // timestamp[ns, tz=UTC]
+        UINT8, UINT16, INT32, UINT64,
+        UTF8,
+        DICT_UTF8                       // dictionary<values=utf8, indices=int32>
+    } type_t;
+
+    class options {
+    public:
+        enum { BATCH_ROWS=65536 };
+        options():batch_rows(BATCH_ROWS){}
+        uint32_t batch_rows;            // rows per record batch
+    };
+
+    arrow_writer();
+    virtual ~arrow_writer();            // close()s
+
+    /* Define the columns, then open() */
+    int  add_column(const std::string &name,type_t type,bool nullable);
+    /* Returns false and sets error() if the file cannot be created */
+    bool open(const std::string &fname,const options &opt);
+    const std::string &error() const { return err; }
+
+    /* Append one value to every column, in any order, then end_row() */
+    void append_null(int col);
+    void append(int col,uint64_t v);
+    void append(int col,int64_t v);
+    void append(int col,const struct timespec &ts);
+    void append(int col,const std::string &s);
+    void end_row();
+
+    void close();                       // write the last batch and the footer
+    uint64_t rows() const { return total_rows; }
+
+private:
+    typedef std::vector<uint8_t> bytes_t;
+#if defined(HAVE_UNORDERED_MAP)
+    typedef std::unordered_map<std::string,int32_t> dict_t;
+#elif defined(HAVE_TR1_UNORDERED_MAP)
+    typedef std::tr1::unordered_map<std::string,int32_t> dict_t;
+#else
+    typedef std::map<std::string,int32_t> dict_t;
+#endif
+
+    struct column {
+        column(const std::string &n,type_t t,bool nl):name(n),type(t),nullable(nl),
+                 validity(),values(),offsets(),data(),null_count(0),length(0),
+                 dict(),new_values(),dict_id(-1),dict_written(false){}
+        std::string name;
+        type_t      type;
+        bool        nullable;
+        bytes_t     validity;           // one bit per row of the current batch
+        bytes_t     values;             // fixed-width values, or dictionary indices
+        std::vector<int32_t> offsets;   // UTF8: start of each value in data
+        std::string data;               // UTF8: the values
+        uint32_t    null_count;
+        uint32_t    length;             // rows in the current batch
+        dict_t      dict;               // DICT_UTF8: value -> index
+        std::vector<std::string> new_values; // not yet written to a dictionary batch
+        int64_t     dict_id;
+        bool        dict_written;       // the first dictionary batch is out
+    };
+    struct block {                      // where a message is in the file, for the footer
+        block(int64_t o,int32_t m,int64_t b):offset(o),metadata_len(m),body_len(b){}
+        int64_t offset;
+        int32_t metadata_len;
+        int64_t body_len;
+    };
+
+    options     opt;
+    std::string err;
+    std::vector<column> columns;
+    FILE        *f;
+    std::vector<char> fbuf;
+    uint64_t    pos;                    // bytes written to f
+    uint32_t    batch_length;           // rows in the current batch
+    uint64_t    total_rows;
+    int64_t     next_dict_id;
+    std::vector<block> dictionary_blocks;
+    std::vector<block> record_blocks;
+
+    void     set_valid(column &c,bool valid);
+    void     write(const void *buf,size_t len);
+    block    write_message(const std::string &metadata,const bytes_t &body);
+    void     write_dictionaries();
+    void     write_batch();
+    uint32_t build_schema(class fb_builder &b) const;
+};
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ *
+ * checksum.cpp:
+ *
+ * Internet checksum (RFC 1071) validation for IPv4 headers and TCP
+ * segments, used by tcpdemux when the user asks for checksums to be
+ * checked with -S checksum=count or -S checksum=drop.
+ *
+ * The one's-complement sum does not depend on byte order or on the
+ * width of the words that are added, as long as the carries are folded
+ * back in at the end. We therefore add the packet as native 32-bit
+ * words into 64-bit accumulators, which lets SSE2 and AVX2 add four or
+ * eight words per instruction, and fold once at the end. A packet is
+ * valid if the folded sum over the data (including the checksum field)
+ * is 0xffff.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__MINGW32__)
+# define CKSUM_HAVE_AVX2_DISPATCH
+# include <immintrin.h>
+#endif
+
+/* Add the remaining (fewer than 8) bytes.
+ * An odd final byte is added as if it were followed by a zero byte.
+ */
+static inline uint64_t cksum_tail(const u_char *buf,size_t len,uint64_t sum)
+{
+    if(len>=4){
+        uint32_t w;
+        memcpy(&w,buf,4);
+        sum += w;
+        buf += 4;
+        len -= 4;
+    }
+    if(len>=2){
+        uint16_t w;
+        memcpy(&w,buf,2);
+        sum += w;
+        buf += 2;
+        len -= 2;
+    }
+    if(len){
+        uint16_t w = 0;
+        memcpy(&w,buf,1);
+        sum += w;
+    }
+    return sum;
+}
+
+static uint64_t cksum_add_scalar(const u_char *buf,size_t len,uint64_t sum)
+{
+    while(len>=8){
+        uint64_t w;
+        memcpy(&w,buf,8);
+        sum += (w & 0xffffffff) + (w >> 32);
+        buf += 8;
+        len -= 8;
+    }
+    return cksum_tail(buf,len,sum);
+}
+
+#if defined(__SSE2__)
+/* Widen each 32-bit word to 64 bits and add; a 64-bit lane cannot overflow on anything we see */
+static uint64_t cksum_add_sse2(const u_char *buf,size_t len,uint64_t sum)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    while(len>=16){
+        __m128i v = _mm_loadu_si128((const __m128i *)buf);
+        acc = _mm_add_epi64(acc,_mm_unpacklo_epi32(v,zero));
+        acc = _mm_add_epi64(acc,_mm_unpackhi_epi32(v,zero));
+        buf += 16;
+        len -= 16;
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes,acc);
+    return cksum_add_scalar(buf,len,sum+lanes[0]+lanes[1]);
+}
+#endif
+
+#if defined(CKSUM_HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+static uint64_t cksum_add_avx2(const u_char *buf,size_t len,uint64_t sum)
+{
+    __m256i acc = _mm256_setzero_si256();
+    while(len>=32){
+        __m128i lo = _mm_loadu_si128((const __m128i *)buf);
+        __m128i hi = _mm_loadu_si128((const __m128i *)(buf+16));
+        acc = _mm256_add_epi64(acc,_mm256_cvtepu32_epi64(lo));
+        acc = _mm256_add_epi64(acc,_mm256_cvtepu32_epi64(hi));
+        buf += 32;
+        len -= 32;
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes,acc);
+    return cksum_add_scalar(buf,len,sum+lanes[0]+lanes[1]+lanes[2]+lanes[3]);
+}
+#endif
+
+typedef uint64_t (*cksum_add_t)(const u_char *buf,size_t len,uint64_t sum);
+
+/* Pick the widest implementation this CPU supports. Called once. */
+static cksum_add_t cksum_select()
+{
+#if defined(CKSUM_HAVE_AVX2_DISPATCH)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return cksum_add_avx2;
+#endif
+#if defined(__SSE2__)
+    return cksum_add_sse2;
+#else
+    return cksum_add_scalar;
+#endif
+}
+
+static uint16_t cksum_fold(uint64_t sum)
+{
+    while(sum>>16) sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+/* Add len bytes at buf to a running (unfolded) sum.
+ * Only the last buffer of a checksum may have an odd length.
+ */
+uint64_t cksum_add(const u_char *buf,size_t len,uint64_t sum)
+{
+    static const cksum_add_t impl = cksum_select();
+    return impl(buf,len,sum);
+}
+
+/* Returns true if the IPv4 header checksum is correct */
+bool cksum_ip4_ok(const u_char *ip_header,size_t ip_header_len)
+{
+    return cksum_fold(cksum_add(ip_header,ip_header_len,0))==0xffff;
+}
+
+/* Returns true if the TCP checksum is correct.
+ * src and dst are the IP addresses from the IP header (4 or 16 bytes each);
+ * tcp is the TCP header and payload, tcp_len bytes long.
+ */
+bool cksum_tcp_ok(const u_char *src,const u_char *dst,size_t addr_len,
+                  const u_char *tcp,size_t tcp_len)
+{
+    uint64_t sum = 0;
+    sum = cksum_add(src,addr_len,sum);
+    sum = cksum_add(dst,addr_len,sum);
+    sum += htons(IPPROTO_TCP);
+    sum += htonl((uint32_t)tcp_len);    // 32 bits; for IPv4 the upper half is zero
+    sum = cksum_add(tcp,tcp_len,sum);
+    return cksum_fold(sum)==0xffff;
+}
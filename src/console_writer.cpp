@@ -0,0 +1,137 @@
+/**
+ * console_writer.cpp:
+ *
+ * Buffered console output; see console_writer.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "console_writer.h"
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+void console_writer::set_buffering(size_t buffer_size_,uint32_t flush_ms_)
+{
+    buffer_size = buffer_size_;
+    flush_ms    = flush_ms_;
+    interactive = isatty(fileno(stdout));
+    if(buffer_size>0 && buf.size()<buffer_size+64*1024) buf.resize(buffer_size+64*1024);
+}
+
+/* isprint() in the C locale, which tcpflow runs in, plus CR and LF.
+ * Written without a table or a branch so that the loop vectorizes.
+ */
+static inline uint8_t stripped(uint8_t ch)
+{
+    return ((ch>=0x20 && ch<0x7f) || ch=='\n' || ch=='\r') ? ch : '.';
+}
+
+void console_writer::append_stripped(const uint8_t *data,size_t n)
+{
+    char *p = reserve(n);
+    for(size_t i=0;i<n;i++){
+        p[i] = (char)stripped(data[i]);
+    }
+    len += n;
+}
+
+void console_writer::append_hex(const uint8_t *data,size_t n)
+{
+    static char pairs[512];             // "000102...ff"
+    static bool pairs_made = false;
+    static const char hex[] = "0123456789abcdef";
+    if(!pairs_made){
+        for(int i=0;i<256;i++){
+            pairs[i*2]   = hex[i>>4];
+            pairs[i*2+1] = hex[i&15];
+        }
+        pairs_made = true;
+    }
+
+    const size_t bytes_per_line = 32;
+    size_t max_spaces = 0;
+    for(size_t i=0;i<n;i+=bytes_per_line){
+        size_t line = n-i < bytes_per_line ? n-i : bytes_per_line;
+        char *start = reserve(max_spaces + 160);
+        char *p = start;
+
+        /* The offset, as "%04x: " */
+        char digits[8];
+        int  nd = 0;
+        uint32_t off = (uint32_t)i;
+        do {
+            digits[nd++] = hex[off & 15];
+            off >>= 4;
+        } while(off);
+        for(int k=nd;k<4;k++) *p++ = '0';
+        while(nd>0) *p++ = digits[--nd];
+        *p++ = ':';
+        *p++ = ' ';
+
+        /* The hex bytes, a space after every two */
+        for(size_t j=0;j<line;j++){
+            memcpy(p,&pairs[data[i+j]*2],2);
+            p += 2;
+            if(j%2==1) *p++ = ' ';
+        }
+
+        /* Space out to where the ASCII region is */
+        size_t spaces = p-start;
+        if(spaces>max_spaces) max_spaces = spaces;
+        for(;spaces<max_spaces;spaces++) *p++ = ' ';
+        *p++ = ' ';
+
+        /* The ASCII */
+        for(size_t j=0;j<line;j++){
+            uint8_t ch = data[i+j];
+            *p++ = (ch>=' ' && ch<='~') ? (char)ch : '.';
+        }
+        *p++ = '\n';
+        len += p-start;
+    }
+}
+
+void console_writer::end_packet()
+{
+    if(interactive || live || buffer_size==0 || len>=buffer_size){
+        flush();
+        return;
+    }
+    uint64_t now = now_ms();
+    if(last_flush_ms==0) last_flush_ms = now;
+    if(now-last_flush_ms >= flush_ms) flush();
+}
+
+void console_writer::flush()
+{
+    last_flush_ms = now_ms();
+    if(len==0) return;
+#ifdef HAVE_PTHREAD
+    if(semlock){
+        if(sem_wait(semlock)){
+            fprintf(stderr,"%s: attempt to acquire semaphore failed: %s\n",progname,strerror(errno));
+            exit(1);
+        }
+    }
+#endif
+    if(fwrite(&buf[0],1,len,stdout)!=len || fflush(stdout)!=0){
+        fprintf(stderr,"%s: write error to stdout: %s\n",progname,strerror(errno));
+        exit(1);
+    }
+#ifdef HAVE_PTHREAD
+    if(semlock){
+        if(sem_post(semlock)){
+            fprintf(stderr,"%s: attempt to post semaphore failed: %s\n",progname,strerror(errno));
+            exit(1);
+        }
+    }
+#endif
+    len = 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * console_writer.h:
+ *
+ * Buffered console output for -c, -C, -D and -g.
+ *
+ * tcpip::print_packet() used to write the stripped output with a
+ * fputc() per byte and the -D hex dump with a fprintf("%02x") per byte,
+ * and to fflush(stdout) and take the -L semaphore for every packet.
+ * Now each packet is translated into one large buffer: the -c/-C
+ * printable filter is a table-free loop the compiler vectorizes, and the
+ * hex dump copies digit pairs from a table a line at a time.
+ *
+ * The buffer is written to stdout, under the -L semaphore, when it
+ * reaches buffer_size bytes or flush_ms milliseconds after the last
+ * write, checked as each packet ends; so the semaphore is taken once
+ * per write rather than once per packet, and a packet is never split
+ * between two writers. When stdout is a terminal, when reading a live
+ * interface, or when buffer_size is 0, every packet is written as soon
+ * as it is printed, as before: the deadline is only looked at when a
+ * packet ends, and on a quiet interface the next packet may be a long
+ * time coming.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef CONSOLE_WRITER_H
+#define CONSOLE_WRITER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+class console_writer {
+    /* These are not implemented */
+    console_writer(const console_writer &);
+    console_writer &operator=(const console_writer &);
+public:
+    enum { BUFFER_SIZE=1024*1024, FLUSH_MS=1000 };
+    console_writer():buf(),len(0),buffer_size(BUFFER_SIZE),flush_ms(FLUSH_MS),
+                     interactive(false),live(false),last_flush_ms(0){}
+
+    /* Configure; stdout being a terminal means write every packet */
+    void set_buffering(size_t buffer_size_,uint32_t flush_ms_);
+    void set_live(bool live_) { live = live_; } // packets come from an interface; write every one
+
+    void append(const char *s,size_t n) {
+        char *p = reserve(n);
+        memcpy(p,s,n);
+        len += n;
+    }
+    void append(const char *s) { append(s,strlen(s)); }
+    void put(char ch) {
+        *reserve(1) = ch;
+        len++;
+    }
+    /* Bytes as -c/-C print them: non-printables other than CR and LF become '.' */
+    void append_stripped(const uint8_t *data,size_t n);
+    /* Bytes as -D prints them: offset, 32 bytes of hex and their ASCII per line */
+    void append_hex(const uint8_t *data,size_t n);
+
+    void end_packet();                  // write now if it is time to
+    void flush();                       // write everything now
+
+private:
+    std::vector<char> buf;
+    size_t      len;                    // bytes in buf
+    size_t      buffer_size;
+    uint32_t    flush_ms;
+    bool        interactive;            // stdout is a terminal
+    bool        live;                   // reading an interface, not a file
+    uint64_t    last_flush_ms;
+
+    char *reserve(size_t n) {
+        if(len+n > buf.size()) buf.resize((len+n)*2);
+        return &buf[len];
+    }
+};
+
+#endif
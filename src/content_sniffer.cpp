@@ -0,0 +1,182 @@
+/**
+ * content_sniffer.cpp:
+ *
+ * Magic number detection for flows and HTTP bodies; see content_sniffer.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "content_sniffer.h"
+
+#include <algorithm>
+
+namespace {
+
+/* A signature matches when the first len bytes, masked, equal magic.
+ * The table is sorted by first byte, which is never masked.
+ */
+struct signature {
+    content_sniffer::type_t type;
+    uint8_t len;
+    uint8_t magic[8];
+    uint8_t mask[8];
+};
+
+#define ANY 0x00
+#define ALL 0xff
+const signature signatures[] = {
+    {content_sniffer::TLS_CLIENT_HELLO, 6, {0x16,0x03,0,0,0,0x01},    {ALL,ALL,ANY,ANY,ANY,ALL}},
+    {content_sniffer::TLS_SERVER_HELLO, 6, {0x16,0x03,0,0,0,0x02},    {ALL,ALL,ANY,ANY,ANY,ALL}},
+    {content_sniffer::GZIP,             3, {0x1f,0x8b,0x08},          {ALL,ALL,ALL}},
+    {content_sniffer::PDF,              5, {'%','P','D','F','-'},     {ALL,ALL,ALL,ALL,ALL}},
+    {content_sniffer::GIF,              6, {'G','I','F','8','7','a'}, {ALL,ALL,ALL,ALL,ALL,ALL}},
+    {content_sniffer::GIF,              6, {'G','I','F','8','9','a'}, {ALL,ALL,ALL,ALL,ALL,ALL}},
+    {content_sniffer::PE,               2, {'M','Z'},                 {ALL,ALL}},
+    {content_sniffer::ZIP,              4, {'P','K',0x03,0x04},       {ALL,ALL,ALL,ALL}},
+    {content_sniffer::SSH,              6, {'S','S','H','-','1','.'}, {ALL,ALL,ALL,ALL,ALL,ALL}},
+    {content_sniffer::SSH,              6, {'S','S','H','-','2','.'}, {ALL,ALL,ALL,ALL,ALL,ALL}},
+    {content_sniffer::ELF,              4, {0x7f,'E','L','F'},        {ALL,ALL,ALL,ALL}},
+    {content_sniffer::PNG,              8, {0x89,'P','N','G',0x0d,0x0a,0x1a,0x0a}, {ALL,ALL,ALL,ALL,ALL,ALL,ALL,ALL}},
+    {content_sniffer::JPEG,             3, {0xff,0xd8,0xff},          {ALL,ALL,ALL}},
+};
+#undef ANY
+#undef ALL
+const size_t num_signatures = sizeof(signatures)/sizeof(signatures[0]);
+
+inline uint64_t word(const uint8_t *b)
+{
+    uint64_t w;
+    memcpy(&w,b,sizeof(w));
+    return w;
+}
+
+/* The signatures as words, and where each first byte's signatures start */
+struct signature_index {
+    signature_index():first() {
+        for(size_t i=0;i<256;i++) first[i] = -1;
+        for(size_t i=num_signatures;i-- > 0;){
+            magic[i] = word(signatures[i].magic);
+            mask[i]  = word(signatures[i].mask);
+            first[signatures[i].magic[0]] = (int)i;
+        }
+    }
+    int      first[256];
+    uint64_t magic[num_signatures];
+    uint64_t mask[num_signatures];
+};
+
+inline uint16_t le16(const uint8_t *b) { return (uint16_t)(b[0] | b[1]<<8); }
+inline uint32_t le32(const uint8_t *b) { return (uint32_t)b[0] | (uint32_t)b[1]<<8 | (uint32_t)b[2]<<16 | (uint32_t)b[3]<<24; }
+
+bool starts(const uint8_t *buf,size_t len,const char *s)
+{
+    size_t n = strlen(s);
+    return len>=n && memcmp(buf,s,n)==0;
+}
+
+bool contains(const uint8_t *buf,size_t len,const char *s)
+{
+    size_t n = strlen(s);
+    return std::search(buf,buf+len,s,s+n)!=buf+len;
+}
+
+/* The word matched; look at the rest of the header where it is needed */
+content_sniffer::type_t confirm(content_sniffer::type_t t,const uint8_t *buf,size_t len)
+{
+    switch(t){
+    case content_sniffer::PE: {
+        /* The MZ header points at the PE header; a DOS stub alone doesn't count */
+        if(len<0x40) return content_sniffer::UNKNOWN;
+        uint32_t pe = le32(buf+0x3c);
+        if(pe<0x40 || pe>=0x10000) return content_sniffer::UNKNOWN;
+        if(pe+4<=len && memcmp(buf+pe,"PE\0\0",4)!=0) return content_sniffer::UNKNOWN;
+        return t;
+    }
+    case content_sniffer::ZIP: {
+        /* Office documents begin with [Content_Types].xml or one of their parts */
+        if(len<30) return t;
+        const uint8_t *name = buf+30;
+        size_t name_len = std::min((size_t)le16(buf+26),len-30);
+        if(starts(name,name_len,"word/")) return content_sniffer::DOCX;
+        if(starts(name,name_len,"xl/"))   return content_sniffer::XLSX;
+        if(starts(name,name_len,"ppt/"))  return content_sniffer::PPTX;
+        if(starts(name,name_len,"[Content_Types].xml") || starts(name,name_len,"_rels/")
+           || starts(name,name_len,"docProps/")){
+            if(contains(buf,len,"word/")) return content_sniffer::DOCX;
+            if(contains(buf,len,"xl/"))   return content_sniffer::XLSX;
+            if(contains(buf,len,"ppt/"))  return content_sniffer::PPTX;
+        }
+        return t;
+    }
+    case content_sniffer::TLS_CLIENT_HELLO:
+    case content_sniffer::TLS_SERVER_HELLO:
+        /* SSL 3.0 to TLS 1.3 all say 3.0 to 3.4 in the record layer */
+        if(buf[2]>0x04) return content_sniffer::UNKNOWN;
+        return t;
+    default:
+        return t;
+    }
+}
+
+}
+
+content_sniffer::type_t content_sniffer::sniff(const uint8_t *buf,size_t len)
+{
+    static const signature_index idx;
+    if(len==0) return UNKNOWN;
+    if(len>WINDOW) len = WINDOW;
+    int i = idx.first[buf[0]];
+    if(i<0) return UNKNOWN;
+
+    /* Short data is padded with zeros, which the length check then rejects */
+    uint8_t pad[8] = {0};
+    memcpy(pad,buf,std::min(len,sizeof(pad)));
+    uint64_t w = word(pad);
+    for(;(size_t)i<num_signatures && signatures[i].magic[0]==buf[0];i++){
+        if(len>=signatures[i].len && (w & idx.mask[i])==idx.magic[i]){
+            return confirm(signatures[i].type,buf,len);
+        }
+    }
+    return UNKNOWN;
+}
+
+const char *content_sniffer::name(type_t t)
+{
+    switch(t){
+    case PE:               return "pe";
+    case ELF:              return "elf";
+    case ZIP:              return "zip";
+    case DOCX:             return "docx";
+    case XLSX:             return "xlsx";
+    case PPTX:             return "pptx";
+    case PDF:              return "pdf";
+    case PNG:              return "png";
+    case JPEG:             return "jpeg";
+    case GIF:              return "gif";
+    case GZIP:             return "gzip";
+    case TLS_CLIENT_HELLO: return "tls-client-hello";
+    case TLS_SERVER_HELLO: return "tls-server-hello";
+    case SSH:              return "ssh";
+    default:               return "unknown";
+    }
+}
+
+const char *content_sniffer::extension(type_t t)
+{
+    switch(t){
+    case PE:   return "exe";
+    case ELF:  return "elf";
+    case ZIP:  return "zip";
+    case DOCX: return "docx";
+    case XLSX: return "xlsx";
+    case PPTX: return "pptx";
+    case PDF:  return "pdf";
+    case PNG:  return "png";
+    case JPEG: return "jpg";
+    case GIF:  return "gif";
+    case GZIP: return "gz";
+    default:   return "";
+    }
+}
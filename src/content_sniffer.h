@@ -0,0 +1,38 @@
+/*
+ * content_sniffer.h:
+ *
+ * Identifies what a flow or an HTTP body holds from its first bytes, so
+ * that files get a type even when there is no Content-Type (or no HTTP
+ * at all). Only the magic numbers that matter for triage are known:
+ * executables, archives and documents, images, gzip, and the openings
+ * of TLS and SSH connections.
+ *
+ * Every signature is anchored at the start of the data, so sniffing
+ * indexes a table by the first byte and compares one masked 64-bit word
+ * per candidate. The few formats that need more than that (PE, ZIP and
+ * the Office formats inside it, TLS) are checked further only when their
+ * word matches. The cost does not depend on how long the data is, and
+ * is small enough to do for every flow.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef CONTENT_SNIFFER_H
+#define CONTENT_SNIFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class content_sniffer {
+public:
+    typedef enum { UNKNOWN=0, PE, ELF, ZIP, DOCX, XLSX, PPTX, PDF, PNG, JPEG, GIF, GZIP,
+                   TLS_CLIENT_HELLO, TLS_SERVER_HELLO, SSH, NUM_TYPES } type_t;
+    enum { WINDOW=4096 };               // at most this much of the data is looked at
+
+    static type_t      sniff(const uint8_t *buf,size_t len);
+    static const char *name(type_t t);      // for the DFXML: "pe", "zip", "tls-client-hello", ...
+    static const char *extension(type_t t); // for naming files; "" if there is none
+};
+
+#endif
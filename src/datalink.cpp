@@ -24,12 +24,8 @@
  */
 #define	NULL_HDRLEN 4
 
-/* Some systems hasn't defined ETHERTYPE_IPV6 */
-#ifndef ETHERTYPE_IPV6
-# define ETHERTYPE_IPV6 0x86DD
-#endif
-
 int32_t datalink_tdelta = 0;
+bool    datalink_nsec = false;
 
 #pragma GCC diagnostic ignored "-Wcast-align"
 void dl_null(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
@@ -54,9 +50,7 @@ void dl_null(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
 		 family,AF_INET,AF_INET6);
 	return;
     }
-    struct timeval tv;
-    be13::packet_info pi(DLT_NULL,h,p,tvshift(tv,h->ts),p+NULL_HDRLEN,caplen - NULL_HDRLEN);
-    be13::plugin::process_packet(pi);
+    decap_ip(DLT_NULL,h,p,p+NULL_HDRLEN,caplen - NULL_HDRLEN);
 }
 #pragma GCC diagnostic warning "-Wcast-align"
 
@@ -70,15 +64,13 @@ void dl_raw(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
 	DEBUG(6) ("warning: only captured %d bytes of %d byte raw frame",
 		  h->caplen, h->len);
     }
-    struct timeval tv;
-    be13::packet_info pi(DLT_RAW,h,p,tvshift(tv,h->ts),p, h->caplen);
     counter++;
-    be13::plugin::process_packet(pi);
+    decap_ip(DLT_RAW,h,p,p,h->caplen);
 }
 
 /* Ethernet datalink handler; used by all 10 and 100 mbit/sec
- * ethernet.  We are given the entire ethernet header so we check to
- * make sure it's marked as being IP.
+ * ethernet.  We are given the entire ethernet header; VLAN tags, MPLS
+ * and tunnels are peeled off by decap_ethertype() in datalink_decap.cpp.
  */
 #pragma GCC diagnostic ignored "-Wcast-align"
 void dl_ethernet(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
@@ -87,58 +79,19 @@ void dl_ethernet(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
     u_int length = h->len;
     struct be13::ether_header *eth_header = (struct be13::ether_header *) p;
 
-    /* Variables to support VLAN */
-    const u_short *ether_type = &eth_header->ether_type; /* where the ether type is located */
-    const u_char *ether_data = p+sizeof(struct be13::ether_header); /* where the data is located */
-
     if (length != caplen) {
 	DEBUG(6) ("warning: only captured %d bytes of %d byte ether frame",
 		  caplen, length);
     }
 
-    /* Handle basic VLAN packets */
-    while (ntohs(*ether_type) == ETHERTYPE_VLAN) {
-	//vlan = ntohs(*(u_short *)(p+sizeof(struct ether_header)));
-	ether_type += 2;			/* skip past VLAN header (note it skips by 2s) */
-	ether_data += 4;			/* skip past VLAN header */
-	caplen     -= 4;
-    }
-  
     if (caplen < sizeof(struct be13::ether_header)) {
 	DEBUG(6) ("warning: received incomplete ethernet frame");
 	return;
     }
 
-    /* Create a packet_info structure with ip data and data length  */
-    struct timeval tv;
-    be13::packet_info pi(DLT_IEEE802,h,p,tvshift(tv,h->ts),
-                         ether_data, caplen - sizeof(struct be13::ether_header));
-    switch (ntohs(*ether_type)){
-    case ETHERTYPE_IP:
-    case ETHERTYPE_IPV6:
-        be13::plugin::process_packet(pi);
-        break;
-
-#ifdef ETHERTYPE_ARP
-    case ETHERTYPE_ARP:
-        /* What should we do for ARP? */
-        break;
-#endif
-#ifdef ETHERTYPE_LOOPBACK
-    case ETHERTYPE_LOOPBACK:
-        /* What do do for loopback? */
-        break;
-#endif
-#ifdef ETHERTYPE_REVARP
-    case ETHERTYPE_REVARP:
-        /* What to do for REVARP? */
-        break;
-#endif
-    default:
-        /* Unknown Ethernet Frame Type */
-        DEBUG(6) ("warning: received ethernet frame with unknown type 0x%x", ntohs(eth_header->ether_type));
-	break;
-    }
+    decap_ethertype(DLT_IEEE802,h,p,ntohs(eth_header->ether_type),
+                    p+sizeof(struct be13::ether_header),
+                    caplen - sizeof(struct be13::ether_header));
 }
 
 #pragma GCC diagnostic warning "-Wcast-align"
@@ -164,9 +117,7 @@ void dl_ppp(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
 	return;
     }
 
-    struct timeval tv;
-    be13::packet_info pi(DLT_PPP,h,p,tvshift(tv,h->ts),p + PPP_HDRLEN, caplen - PPP_HDRLEN);
-    be13::plugin::process_packet(pi);
+    decap_ip(DLT_PPP,h,p,p + PPP_HDRLEN, caplen - PPP_HDRLEN);
 }
 
 
@@ -175,13 +126,6 @@ void dl_ppp(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
 
 #define SLL_ADDRLEN 8
 
-#ifndef ETHERTYPE_MPLS
-#define ETHERTYPE_MPLS      0x8847
-#endif
-#ifndef ETHERTYPE_MPLS_MULTI
-#define ETHERTYPE_MPLS_MULTI    0x8848
-#endif
-
 #pragma GCC diagnostic ignored "-Wcast-align"
 void dl_linux_sll(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
 {
@@ -207,22 +151,7 @@ void dl_linux_sll(u_char *user, const struct pcap_pkthdr *h, const u_char *p)
     };
     
     _sll_header *sllp = (_sll_header*)p;
-    u_int mpls_sz = 0;
-    if (ntohs(sllp->sll_protocol) == ETHERTYPE_MPLS) {
-        // unwind MPLS stack
-        do {
-            if(caplen < SLL_HDR_LEN + mpls_sz + 4){
-                DEBUG(6) ("warning: MPLS stack overrun");
-                return;
-            }
-            mpls_sz += 4;
-            caplen -= 4;
-        } while ((p[SLL_HDR_LEN + mpls_sz - 2] & 1) == 0 );
-    }
-    
-    struct timeval tv;
-    be13::packet_info pi(DLT_LINUX_SLL,h,p,tvshift(tv,h->ts),p + SLL_HDR_LEN + mpls_sz, caplen - SLL_HDR_LEN);
-    be13::plugin::process_packet(pi);
+    decap_ethertype(DLT_LINUX_SLL,h,p,ntohs(sllp->sll_protocol),p + SLL_HDR_LEN, caplen - SLL_HDR_LEN);
 }
 #endif
 
@@ -0,0 +1,363 @@
+/**
+ *
+ * datalink_decap.cpp:
+ *
+ * Peels encapsulation headers (802.1Q/QinQ VLAN tags, MPLS label stacks,
+ * GRE, VXLAN, GENEVE, ERSPAN and IP-in-IP) off a frame until the innermost
+ * IP datagram is reached, and then hands that datagram to process_packet().
+ *
+ * The datalink handlers in datalink.cpp call decap_ethertype() or decap_ip()
+ * once they have removed their own link-layer header. Everything here works
+ * on a cursor into the packet buffer that pcap gave us; nothing is copied
+ * and nothing is allocated.
+ *
+ * The outermost tunnel (the one the capture point saw) is remembered in
+ * datalink_tunnel so that tcpdemux can record it in the flow, in the same
+ * way that the VLAN is recorded.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+
+#ifndef ETHERTYPE_IPV6
+# define ETHERTYPE_IPV6 0x86DD
+#endif
+#ifndef ETHERTYPE_QINQ
+# define ETHERTYPE_QINQ 0x88A8          /* 802.1ad service tag */
+#endif
+#ifndef ETHERTYPE_QINQ_OLD
+# define ETHERTYPE_QINQ_OLD 0x9100      /* pre-standard QinQ */
+#endif
+#ifndef ETHERTYPE_MPLS
+# define ETHERTYPE_MPLS 0x8847
+#endif
+#ifndef ETHERTYPE_MPLS_MULTI
+# define ETHERTYPE_MPLS_MULTI 0x8848
+#endif
+#ifndef ETHERTYPE_TEB
+# define ETHERTYPE_TEB 0x6558           /* transparent ethernet bridging */
+#endif
+#ifndef ETHERTYPE_ERSPAN_II
+# define ETHERTYPE_ERSPAN_II 0x88BE     /* also used by ERSPAN type I */
+#endif
+#ifndef ETHERTYPE_ERSPAN_III
+# define ETHERTYPE_ERSPAN_III 0x22EB
+#endif
+
+#define IPPROTO_GRE_  47                /* some systems do not define IPPROTO_GRE */
+#define IPPROTO_IPIP_ 4
+#define IPPROTO_IPV6_ 41
+#define IPPROTO_UDP_  17
+
+#define PORT_VXLAN  4789
+#define PORT_GENEVE 6081
+
+#define DECAP_MAX_DEPTH 16              /* refuse to peel more layers than this */
+
+struct tunnel_info datalink_tunnel = {TUNNEL_NONE,-1};
+
+const char *tunnel_type_name(int type)
+{
+    switch(type){
+    case TUNNEL_MPLS:   return "mpls";
+    case TUNNEL_GRE:    return "gre";
+    case TUNNEL_VXLAN:  return "vxlan";
+    case TUNNEL_GENEVE: return "geneve";
+    case TUNNEL_ERSPAN: return "erspan";
+    case TUNNEL_IPIP:   return "ipip";
+    }
+    return "";
+}
+
+/* Position in the packet being decapsulated.
+ * ethertype describes what begins at data.
+ */
+struct decap_cursor {
+    const u_char *data;
+    u_int        caplen;
+    uint16_t     ethertype;
+};
+
+static inline uint16_t get16(const u_char *p) { return (uint16_t)((p[0]<<8) | p[1]); }
+static inline uint32_t get24(const u_char *p) { return ((uint32_t)p[0]<<16) | (p[1]<<8) | p[2]; }
+static inline uint32_t get32(const u_char *p) { return ((uint32_t)p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3]; }
+
+static inline bool advance(decap_cursor &c,u_int n)
+{
+    if(c.caplen < n) return false;
+    c.data   += n;
+    c.caplen -= n;
+    return true;
+}
+
+/* Only the outermost tunnel is recorded */
+static inline void note_tunnel(tunnel_type_t type,int64_t id)
+{
+    if(datalink_tunnel.type==TUNNEL_NONE){
+        datalink_tunnel.type = type;
+        datalink_tunnel.id   = id;
+    }
+}
+
+/****************************************************************
+ *** Ethertype handlers.
+ *** Each consumes one header at the cursor and sets the ethertype
+ *** of what follows. Returns false if the header is truncated or
+ *** something we do not understand.
+ ****************************************************************/
+
+/* 802.1Q, 802.1ad and pre-standard QinQ tags: TCI followed by the next ethertype */
+static bool decap_vlan(decap_cursor &c)
+{
+    if(c.caplen < 4) return false;
+    c.ethertype = get16(c.data+2);
+    return advance(c,4);
+}
+
+/* An ethernet frame carried inside a tunnel */
+static bool decap_ether(decap_cursor &c)
+{
+    if(c.caplen < sizeof(struct be13::ether_header)) return false;
+    c.ethertype = get16(c.data+12);
+    return advance(c,sizeof(struct be13::ether_header));
+}
+
+/* MPLS label stack. MPLS does not say what the payload is, so we look
+ * at the first nibble after the bottom of the stack: 4 and 6 are IP,
+ * 0 is a pseudowire control word followed by an ethernet frame.
+ */
+static bool decap_mpls(decap_cursor &c)
+{
+    if(c.caplen < 4) return false;
+    note_tunnel(TUNNEL_MPLS,get24(c.data)>>4);
+    bool bottom = false;
+    while(!bottom){
+        if(c.caplen < 4){
+            DEBUG(6) ("warning: MPLS stack overrun");
+            return false;
+        }
+        bottom = c.data[2] & 1;
+        advance(c,4);
+    }
+    if(c.caplen < 1) return false;
+    switch(c.data[0]>>4){
+    case 4: c.ethertype = ETHERTYPE_IP;   return true;
+    case 6: c.ethertype = ETHERTYPE_IPV6; return true;
+    case 0: c.ethertype = ETHERTYPE_TEB;  return advance(c,4);
+    }
+    return false;
+}
+
+/* ERSPAN type II: 8-byte header, session id in the low 10 bits of the second word */
+static bool decap_erspan2(decap_cursor &c)
+{
+    if(c.caplen < 8) return false;
+    note_tunnel(TUNNEL_ERSPAN,get16(c.data+2) & 0x3ff);
+    c.ethertype = ETHERTYPE_TEB;
+    return advance(c,8);
+}
+
+/* ERSPAN type III: 12-byte header, plus an 8-byte platform subheader if the O bit is set */
+static bool decap_erspan3(decap_cursor &c)
+{
+    if(c.caplen < 12) return false;
+    note_tunnel(TUNNEL_ERSPAN,get16(c.data+2) & 0x3ff);
+    u_int hlen = (c.data[11] & 0x01) ? 20 : 12;
+    c.ethertype = ETHERTYPE_TEB;
+    return advance(c,hlen);
+}
+
+typedef struct {
+    uint16_t ethertype;
+    bool (*handler)(decap_cursor &c);
+} decap_handler_t;
+
+/* List of handlers for each encapsulating ethertype.
+ * IPv4 and IPv6 are not here; they are handled by decap_loop() directly.
+ */
+static const decap_handler_t decap_handlers[] = {
+    { ETHERTYPE_VLAN,       decap_vlan },
+    { ETHERTYPE_QINQ,       decap_vlan },
+    { ETHERTYPE_QINQ_OLD,   decap_vlan },
+    { ETHERTYPE_MPLS,       decap_mpls },
+    { ETHERTYPE_MPLS_MULTI, decap_mpls },
+    { ETHERTYPE_TEB,        decap_ether },
+    { ETHERTYPE_ERSPAN_III, decap_erspan3 },
+    { 0, 0 }
+};
+
+/****************************************************************
+ *** IP-level tunnels
+ ****************************************************************/
+
+/* GRE (RFC 2784/2890). The protocol type is an ethertype.
+ * ERSPAN type I uses 0x88BE without a sequence number and has no
+ * ERSPAN header; type II uses the same protocol with a sequence number.
+ */
+static bool decap_gre(decap_cursor &c)
+{
+    if(c.caplen < 4) return false;
+    uint16_t flags = get16(c.data);
+    uint16_t proto = get16(c.data+2);
+    if(flags & 0x0007) return false;    // only version 0; version 1 is PPTP
+    u_int hlen = 4;
+    if(flags & 0x8000) hlen += 4;       // checksum present
+    int64_t key = -1;
+    if(flags & 0x2000){                 // key present
+        if(c.caplen < hlen+4) return false;
+        key = get32(c.data+hlen);
+        hlen += 4;
+    }
+    bool seq = flags & 0x1000;
+    if(seq) hlen += 4;
+    if(!advance(c,hlen)) return false;
+
+    if(proto==ETHERTYPE_ERSPAN_II){
+        if(seq) return decap_erspan2(c);
+        note_tunnel(TUNNEL_ERSPAN,-1);  // type I
+        c.ethertype = ETHERTYPE_TEB;
+        return true;
+    }
+    if(proto!=ETHERTYPE_ERSPAN_III) note_tunnel(TUNNEL_GRE,key); // decap_erspan3() records its session
+    c.ethertype = proto;
+    return true;
+}
+
+/* VXLAN (RFC 7348): 8-byte header with a 24-bit VNI, followed by an ethernet frame */
+static bool decap_vxlan(decap_cursor &c)
+{
+    if(c.caplen < 8) return false;
+    if((c.data[0] & 0x08)==0) return false; // VNI not valid
+    note_tunnel(TUNNEL_VXLAN,get24(c.data+4));
+    c.ethertype = ETHERTYPE_TEB;
+    return advance(c,8);
+}
+
+/* GENEVE (RFC 8926): 8-byte header plus options, protocol type is an ethertype */
+static bool decap_geneve(decap_cursor &c)
+{
+    if(c.caplen < 8) return false;
+    if(c.data[0]>>6) return false;      // only version 0
+    u_int hlen = 8 + (c.data[0] & 0x3f)*4;
+    if(c.caplen < hlen) return false;
+    note_tunnel(TUNNEL_GENEVE,get24(c.data+4));
+    c.ethertype = get16(c.data+2);
+    return advance(c,hlen);
+}
+
+/* Look at the IP datagram at the cursor. If it carries a tunnel we
+ * understand, strip the IP (and UDP) header, peel the tunnel header and
+ * return true. Return false if the datagram should be delivered as-is.
+ *
+ * This is on the path of every packet, so the common case --- TCP ---
+ * is rejected after looking at a single byte.
+ *
+ * IPv6 extension headers are not walked: only a tunnel named directly in
+ * the fixed header's next-header field is peeled, and a datagram with
+ * extension headers is delivered as-is.
+ */
+static bool decap_ip_tunnel(decap_cursor &c)
+{
+    uint8_t proto = 0;
+    u_int   hlen  = 0;
+    if(c.ethertype==ETHERTYPE_IP){
+        if(c.caplen < sizeof(struct be13::ip4)) return false;
+        proto = c.data[9];
+        if(proto==IPPROTO_TCP) return false;
+        if(get16(c.data+6) & 0x3fff) return false; // fragments are never peeled
+        hlen = (c.data[0] & 0x0f)*4;
+        if(hlen < sizeof(struct be13::ip4)) return false; // IHL below 5
+    } else {
+        if(c.caplen < sizeof(struct be13::ip6_hdr)) return false;
+        proto = c.data[6];
+        if(proto==IPPROTO_TCP) return false;
+        hlen = sizeof(struct be13::ip6_hdr);
+    }
+    if(c.caplen < hlen) return false;
+
+    decap_cursor t = c;                 // only commit if the tunnel parses
+    t.data   += hlen;
+    t.caplen -= hlen;
+    switch(proto){
+    case IPPROTO_GRE_:
+        if(!decap_gre(t)) return false;
+        break;
+    case IPPROTO_IPIP_:
+        note_tunnel(TUNNEL_IPIP,-1);
+        t.ethertype = ETHERTYPE_IP;
+        break;
+    case IPPROTO_IPV6_:
+        note_tunnel(TUNNEL_IPIP,-1);
+        t.ethertype = ETHERTYPE_IPV6;
+        break;
+    case IPPROTO_UDP_:
+        {
+            if(t.caplen < 8) return false;
+            uint16_t dport = get16(t.data+2);
+            if(dport!=PORT_VXLAN && dport!=PORT_GENEVE) return false;
+            advance(t,8);
+            if(!(dport==PORT_VXLAN ? decap_vxlan(t) : decap_geneve(t))) return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    c = t;
+    return true;
+}
+
+/****************************************************************
+ *** Entry points
+ ****************************************************************/
+
+static void decap_loop(int dlt,const struct pcap_pkthdr *h,const u_char *p,decap_cursor &c)
+{
+    for(int depth=0;depth<DECAP_MAX_DEPTH;depth++){
+        if(c.ethertype==ETHERTYPE_IP || c.ethertype==ETHERTYPE_IPV6){
+            if(decap_ip_tunnel(c)) continue;
+            struct timeval tv;
+            be13::packet_info pi(dlt,h,p,tvshift(tv,h->ts),c.data,c.caplen);
+            be13::plugin::process_packet(pi);
+            return;
+        }
+        const decap_handler_t *dh = decap_handlers;
+        while(dh->handler && dh->ethertype!=c.ethertype) dh++;
+        if(dh->handler==0){
+            DEBUG(6) ("warning: received frame with unknown encapsulated type 0x%x", c.ethertype);
+            return;
+        }
+        if(!dh->handler(c)){
+            DEBUG(6) ("warning: received truncated or unsupported header of type 0x%x", c.ethertype);
+            return;
+        }
+    }
+    DEBUG(6) ("warning: more than %d encapsulation layers; packet ignored", DECAP_MAX_DEPTH);
+}
+
+/* Decapsulate the payload of a link-layer frame, given its ethertype */
+void decap_ethertype(int dlt,const struct pcap_pkthdr *h,const u_char *p,
+                     uint16_t ethertype,const u_char *data,u_int caplen)
+{
+    datalink_tunnel.type = TUNNEL_NONE;
+    datalink_tunnel.id   = -1;
+    decap_cursor c = {data,caplen,ethertype};
+    decap_loop(dlt,h,p,c);
+}
+
+/* Decapsulate a raw IPv4 or IPv6 datagram */
+void decap_ip(int dlt,const struct pcap_pkthdr *h,const u_char *p,const u_char *data,u_int caplen)
+{
+    int version = caplen>0 ? data[0]>>4 : 0;
+    if(version!=4 && version!=6){
+        /* Not IP; let process_packet() reject it so that it can be saved with -w */
+        datalink_tunnel.type = TUNNEL_NONE;
+        datalink_tunnel.id   = -1;
+        struct timeval tv;
+        be13::packet_info pi(dlt,h,p,tvshift(tv,h->ts),data,caplen);
+        be13::plugin::process_packet(pi);
+        return;
+    }
+    decap_ethertype(dlt,h,p,version==6 ? ETHERTYPE_IPV6 : ETHERTYPE_IP,data,caplen);
+}
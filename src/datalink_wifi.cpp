@@ -16,10 +16,7 @@ void TFCB::Handle80211(const WifiPacket &p, u_int16_t fc, const MAC& sa, const M
 }
 
 void TFCB::HandleLLC(const WifiPacket &p, const struct llc_hdr_t *hdr, const u_char *rest, size_t len) {
-    sbuf_t sb(pos0_t(),rest,len,len,0);
-    struct timeval tv;
-    be13::packet_info pi(p.header_type,p.header,p.packet,tvshift(tv,p.header->ts),rest,len);
-    be13::plugin::process_packet(pi);
+    decap_ip(p.header_type,p.header,p.packet,rest,len);
 }
 
 void TFCB::Handle80211MgmtBeacon(const WifiPacket &p, const mgmt_header_t *hdr, const mgmt_body_t *body)
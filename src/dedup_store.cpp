@@ -0,0 +1,86 @@
+/**
+ * dedup_store.cpp:
+ *
+ * Replaces duplicate output files with hard links; see dedup_store.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "dedup_store.h"
+#include "dfxml/src/hash_t.h"
+
+#include <vector>
+
+const char dedup_store::DIR_NAME[] = "dedup";
+
+dedup_store::dedup_store(const std::string &outdir):
+    files(0),bytes(0),dup_files(0),dup_bytes(0),dir(outdir + "/" + DIR_NAME)
+{
+}
+
+std::string dedup_store::object_name(const std::string &digest,bool create_dir)
+{
+    std::string subdir = dir + "/" + digest.substr(0,2);
+    if(create_dir){
+        mkdir(dir.c_str(),0777);
+        mkdir(subdir.c_str(),0777);
+    }
+    return subdir + "/" + digest;
+}
+
+bool dedup_store::add(const std::string &fname,const std::string &digest,uint64_t size)
+{
+    files++;
+    bytes += size;
+    if(size==0 || digest.size()<2) return false;
+#ifndef HAVE_LINK
+    return false;                       // no hard links here; just count
+#else
+    std::string obj = object_name(digest,false);
+    struct stat st,fst;
+    if(stat(obj.c_str(),&st)==0){
+        if((uint64_t)st.st_size!=size) return false; // can't be the same content
+        if(stat(fname.c_str(),&fst)==0 && fst.st_dev==st.st_dev && fst.st_ino==st.st_ino) return false;
+        /* Link the object beside fname, then rename it over fname */
+        std::string tmp = fname + ".dedup";
+        unlink(tmp.c_str());
+        if(link(obj.c_str(),tmp.c_str())==0){
+            if(rename(tmp.c_str(),fname.c_str())==0){
+                dup_files++;
+                dup_bytes += size;
+                return true;
+            }
+            DEBUG(1)("rename(%s,%s): %s",tmp.c_str(),fname.c_str(),strerror(errno));
+            unlink(tmp.c_str());
+            return false;
+        }
+        if(errno!=EMLINK){
+            DEBUG(1)("link(%s,%s): %s",obj.c_str(),tmp.c_str(),strerror(errno));
+            return false;
+        }
+        /* The object has as many links as the filesystem allows; this file takes over */
+        unlink(obj.c_str());
+    }
+    if(link(fname.c_str(),object_name(digest,true).c_str())!=0 && errno!=EEXIST){
+        DEBUG(1)("link(%s,%s): %s",fname.c_str(),obj.c_str(),strerror(errno));
+    }
+    return false;
+#endif
+}
+
+std::string dedup_store::file_digest(const std::string &fname)
+{
+    int fd = open(fname.c_str(),O_RDONLY|O_BINARY);
+    if(fd<0) return "";
+    sha1_generator g;
+    std::vector<uint8_t> buf(1024*1024);
+    ssize_t n;
+    while((n = read(fd,&buf[0],buf.size()))>0){
+        g.update(&buf[0],n);
+    }
+    close(fd);
+    if(n<0) return "";
+    return g.final().hexdigest();
+}
@@ -0,0 +1,57 @@
+/*
+ * dedup_store.h:
+ *
+ * Deduplicated output (-S dedup=1). The same payloads (software updates,
+ * objects from a CDN) turn up in thousands of flows and HTTP bodies;
+ * this keeps one copy of each on disk.
+ *
+ * Every flow transcript and -HTTPBODY- file is hashed (SHA-1) as it is
+ * written, or read back if it was not written in order. The first file
+ * with a digest is also linked as
+ *
+ *   outdir/dedup/ab/abcdef...     (the digest, in hex)
+ *
+ * and every later file with the same digest and size is replaced by a
+ * hard link to that object, so each file keeps its name and its content
+ * is stored once. Files are never written after they are added.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef DEDUP_STORE_H
+#define DEDUP_STORE_H
+
+#include <stdint.h>
+#include <string>
+
+class dedup_store {
+    /* These are not implemented */
+    dedup_store(const dedup_store &);
+    dedup_store &operator=(const dedup_store &);
+public:
+    static const char DIR_NAME[];       // "dedup", in the output directory
+
+    dedup_store(const std::string &outdir);
+
+    /* fname is finished and holds size bytes with this digest.
+     * Returns true if it is now a link to an earlier copy.
+     */
+    bool add(const std::string &fname,const std::string &digest,uint64_t size);
+    /* The digest of a file, for those that were not hashed as they were written */
+    static std::string file_digest(const std::string &fname);
+
+    uint64_t files;                     // added
+    uint64_t bytes;                     // in them
+    uint64_t dup_files;                 // that were replaced by links
+    uint64_t dup_bytes;                 // the space that saved
+
+    /* bytes / bytes actually stored; 1.0 means no duplicates */
+    double ratio() const { return bytes>dup_bytes ? (double)bytes/(bytes-dup_bytes) : 1.0; }
+
+private:
+    std::string dir;
+    std::string object_name(const std::string &digest,bool create_dir);
+};
+
+#endif
@@ -16,14 +16,11 @@
 #include "tcpflow.h"
 #include "tcpip.h"
 #include "tcpdemux.h"
-
-#ifdef HAVE_ARPA_INET_H
-#include <arpa/inet.h>                  // inet_ntop
-#endif
+#include "flow_template.h"
 
 #include <assert.h>
 #include <iostream>
-#include <sstream>
+#include <dirent.h>
 
 std::string flow::filename_template("%A.%a-%B.%b%V%v%C%c");
 std::string flow::outdir(".");
@@ -35,6 +32,7 @@ void flow::usage()
     std::cout << "  %A/%a - source IP address/port;          %B/%b - dest IP address/port\n";
     std::cout << "  %E/%e - source/dest Ethernet Mac address\n";
     std::cout << "  %V/%v - VLAN number, '--' if no vlan/'' if no vlan\n";
+    std::cout << "  %U/%u - Outer tunnel id (VNI, GRE key, MPLS label), '--' if no tunnel/'' if no tunnel\n";
     std::cout << "  %T/%t - Timestamp in ISO8601 format/unix time_t\n";
     std::cout << "  %c - connection_count for connections>0 / %# for all connections;";
     std::cout << "  %C - 'c' if connection_count >0\n";
@@ -50,106 +48,61 @@ void flow::usage()
     std::cout << "      Filename template format handles '/' to create sub-directories.\n";
 }
 
+/* The template is compiled when it is first used, and again if -T, -F or -o change it */
+static flow_template compiled_template;
+
 std::string flow::filename(uint32_t connection_count)
 {
-    std::stringstream ss;
-
-    /* Add the outdir */
-    if(flow::outdir!="." && flow::outdir!=""){
-        ss << flow::outdir;
-        ss << '/';
+    if(!compiled_template.compiled_from(flow::outdir,filename_template)){
+        compiled_template.compile(flow::outdir,filename_template);
     }
+    return compiled_template.render(*this,connection_count);
+}
 
-    for(unsigned int i=0;i<filename_template.size();i++){
-	switch(filename_template.at(i)){
-	default:
-	    ss << filename_template.at(i);
-	    break;
-	case '%':
-	    if(i==filename_template.size()-1){
-		std::cerr << "Invalid filename_template: " << filename_template << " cannot end with a %\n";
-		exit(1);
-	    }
-	    /* put the substitute in ss or buf */
-	    char buf[1024];
-	    buf[0] = 0;
-	    switch(filename_template.at(++i)){
-	    case 'A': // source IP address
-		switch(family){
-		case AF_INET:
-		    snprintf(buf,sizeof(buf),"%03d.%03d.%03d.%03d",
-                             src.addr[0], src.addr[1], src.addr[2], src.addr[3]);
-		    break;
-		case AF_INET6:
-		    inet_ntop(family, src.addr, buf,sizeof(buf));
-		}
-		break;
-	    case 'a': // source IP port
-		snprintf(buf,sizeof(buf),"%05d",sport);
-		break;
-	    case 'B': // dest IP address
-		switch(family){
-		case AF_INET:
-		    snprintf(buf,sizeof(buf),"%03d.%03d.%03d.%03d",
-                             dst.addr[0], dst.addr[1], dst.addr[2], dst.addr[3]);
-		    break;
-		case AF_INET6:
-		    inet_ntop(family, dst.addr, buf,sizeof(buf));
-		}
-		break;
-	    case 'b': // dest IP port
-		snprintf(buf,sizeof(buf),"%05d",dport);
-		break;
-                /* binning by connection number */
-            case 'E':
-                snprintf(buf,sizeof(buf),"%02x:%02x:%02x:%02x:%02x:%02x",
-                         mac_saddr[0],mac_saddr[1],mac_saddr[2],mac_saddr[3],mac_saddr[4],mac_saddr[5]);
-                break;
-            case 'e':
-                snprintf(buf,sizeof(buf),"%02x:%02x:%02x:%02x:%02x:%02x",
-                         mac_daddr[0],mac_daddr[1],mac_daddr[2],mac_daddr[3],mac_daddr[4],mac_daddr[5]);
-                break;
-            case 'N': snprintf(buf,sizeof(buf),"%03d",(int)(id)             % 1000);break;
-            case 'K': snprintf(buf,sizeof(buf),"%03d",(int)(id /1000 )      % 1000);break;
-            case 'M': snprintf(buf,sizeof(buf),"%03d",(int)(id /1000000)    % 1000);break;
-            case 'G': snprintf(buf,sizeof(buf),"%03d",(int)(id /1000000000) % 1000);break;
+/*
+ * Connection counts for new_filename().
+ *
+ * Flows that reuse a 4-tuple (health checks through a load balancer, for
+ * example) render the same name for connection_count 0, so that name
+ * is the key for the next count to try. The Nth such flow then finds its
+ * name on the first open() rather than after N failed ones.
+ *
+ * Files that were in a directory before we wrote to it are found by
+ * reading the directory once, the first time a flow is named in it.
+ * The O_EXCL open remains the final check, so a name that is taken
+ * behind our back only costs another try.
+ */
+#ifdef HAVE_TR1_UNORDERED_MAP
+typedef std::tr1::unordered_map<std::string,uint32_t> next_count_t;
+typedef std::tr1::unordered_set<std::string> name_set_t;
+#else
+typedef std::unordered_map<std::string,uint32_t> next_count_t;
+typedef std::unordered_set<std::string> name_set_t;
+#endif
+
+static const size_t MAX_NEXT_COUNTS = 4*1024*1024; // forget them all beyond this
+static next_count_t next_count;         // base name -> next connection_count to try
+static name_set_t   scanned_dirs;       // directories that have been read
+static name_set_t   existing_names;     // paths found in them
 
-	    case 'T': // Timestamp in ISO8601 format
-	      {
-		time_t t = tstart.tv_sec;
-		strftime(buf,sizeof(buf),"%Y-%m-%dT%H:%M:%SZ",gmtime(&t));
-		break;
-	      }
-	    case 't': // Unix time_t
-		ss << tstart.tv_sec;
-		break;
-	    case 'V': // '--' if VLAN is present
-		if(vlan!=be13::packet_info::NO_VLAN) ss << "--";
-		break;
-	    case 'v': // VLAN number if VLAN is present
-		if(vlan!=be13::packet_info::NO_VLAN) ss << vlan;
-		break;
-	    case 'C': // 'c' if connection_count >0
-		if(connection_count>0) ss << "c";
-		break;
-	    case 'c': // connection_count if connection_count >0
-		if(connection_count>0) ss << connection_count;
-		break;
-	    case '#': // always output connection count
-		ss << connection_count;
-		break;
-	    case '%': // Output a '%'
-		ss << "%";
-		break;
-	    default:
-		std::cerr << "Invalid filename_template: " << filename_template << "\n";
-		std::cerr << "unknown character: " << filename_template.at(i+1) << "\n";
-		exit(1);
-	    }
-	    if(buf[0]) ss << buf;
-	}
+static bool existed_before(const std::string &path)
+{
+    size_t slash = path.rfind('/');
+    std::string dir = slash==std::string::npos ? std::string(".") : path.substr(0,slash);
+    if(scanned_dirs.find(dir)==scanned_dirs.end()){
+        scanned_dirs.insert(dir);
+        DIR *dirp = opendir(dir.c_str());
+        if(dirp){
+            std::string prefix = slash==std::string::npos ? std::string() : dir + "/";
+            struct dirent *dp;
+            while((dp = readdir(dirp)) != NULL){
+                if(dp->d_name[0]=='.' && (dp->d_name[1]==0 || (dp->d_name[1]=='.' && dp->d_name[2]==0))) continue;
+                existing_names.insert(prefix + dp->d_name);
+            }
+            closedir(dirp);
+        }
     }
-    return ss.str();
+    return existing_names.size() && existing_names.find(path)!=existing_names.end();
 }
 
 /**
@@ -159,12 +112,25 @@ std::string flow::filename(uint32_t connection_count)
 
 std::string flow::new_filename(int *fd,int flags,int mode)
 {
-    /* Loop connection count until we find a file that doesn't exist */
-    for(uint32_t connection_count=0;;connection_count++){
-        std::string nfn = filename(connection_count);
-        if(nfn.find('/')!=std::string::npos) mkdirs_for_path(nfn.c_str());
+    std::string base = filename(0);
+    next_count_t::const_iterator it = next_count.find(base);
+    uint32_t connection_count = it==next_count.end() ? 0 : it->second;
+    if(next_count.size()>=MAX_NEXT_COUNTS) next_count.clear();
+
+    /* Without fd, just reserve the name (segment output has no per-flow files) */
+    if(fd==0){
+        next_count[base] = connection_count+1;
+        return connection_count==0 ? base : filename(connection_count);
+    }
+
+    compiled_template.make_dirs();
+    for(;;connection_count++){
+        std::string nfn = connection_count==0 ? base : filename(connection_count);
+        if(connection_count>0) compiled_template.make_dirs();
+        if(existed_before(nfn)) continue;
         int nfd = tcpdemux::getInstance()->retrying_open(nfn,flags,mode);
         if(nfd>=0){
+            next_count[base] = connection_count+1;
             *fd = nfd;
             return nfn;
         }
@@ -0,0 +1,111 @@
+/**
+ * flow_classifier.cpp:
+ *
+ * Which scanners want which flows; see flow_classifier.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "tcpip.h"
+#include "flow_classifier.h"
+
+/* Does buf start with s, as far as buf goes? A first segment cut short
+ * could still be the start of it.
+ */
+static bool starts(const uint8_t *buf,size_t len,const char *s)
+{
+    size_t n = strlen(s);
+    return memcmp(buf,s,len<n ? len : n)==0;
+}
+
+static bool http_port(uint16_t port)
+{
+    switch(port){
+    case PORT_HTTP:
+    case PORT_HTTP_ALT_0: case PORT_HTTP_ALT_1: case PORT_HTTP_ALT_2:
+    case PORT_HTTP_ALT_3: case PORT_HTTP_ALT_4: case PORT_HTTP_ALT_5:
+        return true;
+    }
+    return false;
+}
+
+/* What scan_http will parse: a response or a request line at the start */
+static bool http_start(const uint8_t *buf,size_t len,content_sniffer::type_t)
+{
+    static const char *starts_with[] = {"HTTP/1.","GET ","POST ","PUT ","HEAD ","DELETE ",
+                                        "OPTIONS ","PATCH ","CONNECT ","TRACE ",0};
+    for(const char **s=starts_with;*s;s++){
+        if(starts(buf,len,*s)) return true;
+    }
+    return false;
+}
+
+static bool tls_port(uint16_t port)
+{
+    return port==PORT_HTTPS;
+}
+
+/* What scan_tls can read: a flow that starts with a hello */
+static bool tls_start(const uint8_t *,size_t,content_sniffer::type_t content)
+{
+    return content==content_sniffer::TLS_CLIENT_HELLO || content==content_sniffer::TLS_SERVER_HELLO;
+}
+
+static const flow_classifier::scanner_class known_scanners[] = {
+    {"tcpdemux", false, 0, 0},
+    {"netviz",   false, 0, 0},
+    {"wifiviz",  false, 0, 0},
+    {"http",     true,  http_port, http_start},
+    {"tls",      true,  tls_port,  tls_start},
+    {0, false, 0, 0}
+};
+
+void flow_classifier::set_scanners(const std::vector<std::string> &enabled)
+{
+    selective.clear();
+    every = false;
+    for(std::vector<std::string>::const_iterator it=enabled.begin();it!=enabled.end();it++){
+        const scanner_class *sc = known_scanners;
+        while(sc->name && *it!=sc->name) sc++;
+        if(sc->name==0 || (sc->flows && sc->wants_port==0 && sc->wants_start==0)){
+            every = true;               // we don't know what it wants, so it gets everything
+        } else if(sc->flows){
+            if(selective.size()==MAX_SELECTIVE) every = true;
+            else selective.push_back(sc);
+        }
+    }
+    DEBUG(5)("%s flows are post-processed",every ? "all" : (selective.size() ? "some" : "no"));
+}
+
+flow_classifier::scanner_set flow_classifier::by_ports(uint16_t sport,uint16_t dport) const
+{
+    if(every) return ~scanner_set(0);
+    scanner_set s = 0;
+    for(size_t i=0;i<selective.size();i++){
+        const scanner_class *sc = selective[i];
+        if(sc->wants_port==0 || (*sc->wants_port)(sport) || (*sc->wants_port)(dport)) s |= 1U<<i;
+    }
+    return s;
+}
+
+bool flow_classifier::wants(scanner_set s,const char *name) const
+{
+    for(size_t i=0;i<selective.size();i++){
+        if(strcmp(selective[i]->name,name)==0) return (s & (1U<<i))!=0;
+    }
+    return false;
+}
+
+flow_classifier::scanner_set flow_classifier::by_start(scanner_set by_port,const uint8_t *buf,size_t len,
+                                                       content_sniffer::type_t content) const
+{
+    if(every) return ~scanner_set(0);
+    scanner_set s = 0;
+    for(size_t i=0;i<selective.size();i++){
+        const scanner_class *sc = selective[i];
+        if(sc->wants_start ? (*sc->wants_start)(buf,len,content) : (by_port & (1U<<i))!=0) s |= 1U<<i;
+    }
+    return s;
+}
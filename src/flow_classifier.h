@@ -0,0 +1,57 @@
+/*
+ * flow_classifier.h:
+ *
+ * Decides, as each flow starts, which of the enabled scanners could do
+ * anything with it, so that post_process() neither reopens nor maps the
+ * files of flows that no scanner wants.
+ *
+ * A flow is first tagged by its ports, when it is created, and then by
+ * its first bytes, when the segment at the start of the flow arrives;
+ * the bytes, when seen, decide. A scanner tcpflow knows nothing about
+ * (md5, python, one loaded with -P) wants every flow, so with one of
+ * those enabled nothing is skipped.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef FLOW_CLASSIFIER_H
+#define FLOW_CLASSIFIER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "content_sniffer.h"
+
+class flow_classifier {
+public:
+    typedef uint32_t scanner_set;       // a bit per enabled scanner that wants only some flows
+    enum { MAX_SELECTIVE=32 };
+
+    /* What tcpflow knows about a scanner's appetite for flows */
+    struct scanner_class {
+        const char *name;
+        bool flows;                     // false: it looks at packets, never at flows
+        bool (*wants_port)(uint16_t port);  // 0: any port
+        bool (*wants_start)(const uint8_t *buf,size_t len,content_sniffer::type_t content); // 0: any start
+    };
+
+    flow_classifier():selective(),every(true){}
+
+    void set_scanners(const std::vector<std::string> &enabled); // the names of the enabled scanners
+
+    /* Nonzero if some scanner could apply */
+    scanner_set by_ports(uint16_t sport,uint16_t dport) const;
+    scanner_set by_start(scanner_set by_port,const uint8_t *buf,size_t len,
+                         content_sniffer::type_t content) const;
+    /* Is the named scanner enabled, and could it apply to a flow tagged s? */
+    bool wants(scanner_set s,const char *name) const;
+
+private:
+    std::vector<const scanner_class *> selective; // bit i is selective[i]
+    bool every;                         // an enabled scanner wants every flow
+};
+
+#endif
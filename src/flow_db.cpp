@@ -0,0 +1,203 @@
+/**
+ * flow_db.cpp:
+ *
+ * The SQLite connection table; see flow_db.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "config.h"
+#include "flow_db.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_SQLITE3
+
+static const char *create_table_sql =
+    "CREATE TABLE IF NOT EXISTS connections ("
+    "starttime TEXT NOT NULL,"
+    "endtime TEXT NOT NULL,"
+    "src_ipn TEXT,"
+    "dst_ipn TEXT,"
+    "mac_daddr TEXT,"
+    "mac_saddr TEXT,"
+    "packets INTEGER,"
+    "srcport INTEGER,"
+    "dstport INTEGER,"
+    "hashdigest_md5 TEXT);";
+
+static const char *insert_sql =
+    "INSERT INTO connections (starttime,endtime,src_ipn,dst_ipn,mac_daddr,mac_saddr,"
+    "packets,srcport,dstport,hashdigest_md5) VALUES (?,?,?,?,?,?,?,?,?,?)";
+
+/* Created once the rows are in; see flow_db.h */
+static const char *create_indexes_sql =
+    "CREATE INDEX IF NOT EXISTS connections_src ON connections (src_ipn,srcport);"
+    "CREATE INDEX IF NOT EXISTS connections_dst ON connections (dst_ipn,dstport);"
+    "CREATE INDEX IF NOT EXISTS connections_starttime ON connections (starttime);";
+
+flow_db::flow_db():err(),rows_written(0),opt(),db(0),insert_stmt(0),pending(),M(),more(),less(),
+                   stopping(false),failed(false),writer()
+{
+}
+
+bool flow_db::exec(const char *sql)
+{
+    char *msg = 0;
+    if(sqlite3_exec(db,sql,0,0,&msg)!=SQLITE_OK){
+        err = std::string(msg ? msg : sqlite3_errmsg(db)) + " (" + sql + ")";
+        sqlite3_free(msg);
+        return false;
+    }
+    return true;
+}
+
+bool flow_db::open(const std::string &fname,const options &opt_)
+{
+    opt = opt_;
+    if(opt.batch_rows==0) opt.batch_rows = 1;
+    if(opt.max_pending<opt.batch_rows) opt.max_pending = opt.batch_rows;
+    if(sqlite3_open_v2(fname.c_str(),&db,SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE,0)!=SQLITE_OK){
+        err = fname + ": " + (db ? sqlite3_errmsg(db) : "cannot open");
+        sqlite3_close(db);
+        db = 0;
+        return false;
+    }
+    /* WAL and synchronous=NORMAL: a commit appends to the log without waiting for a sync */
+    if(!exec("PRAGMA journal_mode=WAL") ||
+       !exec("PRAGMA synchronous=NORMAL") ||
+       !exec(create_table_sql)){
+        sqlite3_close(db);
+        db = 0;
+        return false;
+    }
+    if(sqlite3_prepare_v2(db,insert_sql,-1,&insert_stmt,0)!=SQLITE_OK){
+        err = sqlite3_errmsg(db);
+        sqlite3_close(db);
+        db = 0;
+        return false;
+    }
+    writer = std::thread(&flow_db::run,this);
+    return true;
+}
+
+flow_db::~flow_db()
+{
+    close();
+}
+
+void flow_db::add(const record &r)
+{
+    std::unique_lock<std::mutex> lock(M);
+    if(db==0 || failed) return;
+    while(pending.size()>=opt.max_pending) less.wait(lock);
+    pending.push_back(r);
+    if(pending.size()>=opt.batch_rows) more.notify_one();
+}
+
+static void bind_text(sqlite3_stmt *s,int col,const std::string &str)
+{
+    if(str.size()) sqlite3_bind_text(s,col,str.data(),(int)str.size(),SQLITE_STATIC);
+    else sqlite3_bind_null(s,col);
+}
+
+/* Insert batch in one transaction */
+bool flow_db::insert_batch(const std::vector<record> &batch)
+{
+    if(!exec("BEGIN")) return false;
+    for(std::vector<record>::const_iterator it=batch.begin();it!=batch.end();it++){
+        bind_text(insert_stmt,1,it->starttime);
+        bind_text(insert_stmt,2,it->endtime);
+        bind_text(insert_stmt,3,it->src_ipn);
+        bind_text(insert_stmt,4,it->dst_ipn);
+        bind_text(insert_stmt,5,it->mac_daddr);
+        bind_text(insert_stmt,6,it->mac_saddr);
+        sqlite3_bind_int64(insert_stmt,7,(sqlite3_int64)it->packets);
+        sqlite3_bind_int(insert_stmt,8,it->srcport);
+        sqlite3_bind_int(insert_stmt,9,it->dstport);
+        bind_text(insert_stmt,10,it->hashdigest_md5);
+        int rc = sqlite3_step(insert_stmt);
+        sqlite3_reset(insert_stmt);
+        if(rc!=SQLITE_DONE){
+            err = sqlite3_errmsg(db);
+            exec("ROLLBACK");
+            return false;
+        }
+    }
+    sqlite3_clear_bindings(insert_stmt);
+    return exec("COMMIT");
+}
+
+void flow_db::run()
+{
+    std::vector<record> batch;
+    std::unique_lock<std::mutex> lock(M);
+    while(true){
+        more.wait_for(lock,std::chrono::milliseconds(opt.batch_ms),
+                      [this]{ return stopping || pending.size()>=opt.batch_rows; });
+        if(pending.empty()){
+            if(stopping) break;
+            continue;
+        }
+        batch.swap(pending);
+        less.notify_all();
+        lock.unlock();
+        bool ok = insert_batch(batch);
+        lock.lock();
+        if(!ok){
+            fprintf(stderr,"flow database: %s; no more flows will be recorded\n",err.c_str());
+            failed = true;
+            pending.clear();
+            less.notify_all();
+            break;
+        }
+        rows_written += batch.size();
+        batch.clear();
+    }
+}
+
+void flow_db::close()
+{
+    if(db==0) return;
+    {
+        std::lock_guard<std::mutex> lock(M);
+        stopping = true;
+    }
+    more.notify_one();
+    writer.join();
+    sqlite3_finalize(insert_stmt);
+    insert_stmt = 0;
+    if(opt.create_indexes && !failed && !exec(create_indexes_sql)){
+        fprintf(stderr,"flow database: %s\n",err.c_str());
+    }
+    sqlite3_close(db);
+    db = 0;
+}
+
+#else
+
+flow_db::flow_db():err(),rows_written(0)
+{
+}
+
+flow_db::~flow_db()
+{
+}
+
+bool flow_db::open(const std::string &fname,const options &opt)
+{
+    err = "tcpflow was compiled without SQLite";
+    return false;
+}
+
+void flow_db::add(const record &r)
+{
+}
+
+void flow_db::close()
+{
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * flow_db.h:
+ *
+ * The SQLite connection table (-S sqlite_db=file).
+ *
+ * A row per flow, written as each flow is closed. Inserting rows one at
+ * a time in autocommit mode costs a journal sync per row, which is far
+ * slower than flows close on a busy link, so:
+ *
+ *   - the database is opened in WAL mode with synchronous=NORMAL;
+ *   - add() only queues the row; a background thread inserts the queue
+ *     with one prepared statement, in a transaction per batch of
+ *     batch_rows rows or every batch_ms milliseconds, whichever comes
+ *     first;
+ *   - if the writer falls behind by more than max_pending rows, add()
+ *     waits for it rather than letting the queue grow without bound;
+ *   - the indexes are created when the database is closed, after the
+ *     bulk of the rows are in, instead of being updated on every insert.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef FLOW_DB_H
+#define FLOW_DB_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_SQLITE3_H) && defined(HAVE_LIBSQLITE3)
+#define HAVE_SQLITE3
+#include <sqlite3.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+class flow_db {
+    /* These are not implemented */
+    flow_db(const flow_db &);
+    flow_db &operator=(const flow_db &);
+public:
+    class options {
+    public:
+        enum { BATCH_ROWS=10000, BATCH_MS=500 };
+        options():batch_rows(BATCH_ROWS),batch_ms(BATCH_MS),max_pending(16*BATCH_ROWS),
+                  create_indexes(true){}
+        uint32_t batch_rows;            // rows per transaction
+        uint32_t batch_ms;              // commit at least this often
+        uint32_t max_pending;           // add() waits when this many rows are queued
+        bool     create_indexes;        // index the table on close()
+    };
+
+    /* A row of the connections table; empty strings are stored as NULL */
+    struct record {
+        record():starttime(),endtime(),src_ipn(),dst_ipn(),mac_daddr(),mac_saddr(),
+                 packets(0),srcport(0),dstport(0),hashdigest_md5(){}
+        std::string starttime;
+        std::string endtime;
+        std::string src_ipn;
+        std::string dst_ipn;
+        std::string mac_daddr;
+        std::string mac_saddr;
+        uint64_t    packets;
+        uint16_t    srcport;
+        uint16_t    dstport;
+        std::string hashdigest_md5;
+    };
+
+    flow_db();
+    virtual ~flow_db();                 // close()s
+
+    /* Open (creating if needed) the database and start the writer.
+     * Returns false and sets error() if it cannot.
+     */
+    bool open(const std::string &fname,const options &opt);
+    const std::string &error() const { return err; }
+
+    void add(const record &r);          // queue a row
+    void close();                       // insert what is queued, index, and close
+    uint64_t rows() const { return rows_written; }
+
+private:
+    std::string  err;
+    uint64_t     rows_written;
+#ifdef HAVE_SQLITE3
+    options      opt;
+    sqlite3      *db;
+    sqlite3_stmt *insert_stmt;
+    std::vector<record> pending;        // rows queued by add()
+    std::mutex   M;                     // protects pending and stopping
+    std::condition_variable more;       // the writer has work
+    std::condition_variable less;       // add() may continue
+    bool         stopping;
+    bool         failed;                // the writer hit an error; rows are dropped
+    std::thread  writer;
+
+    bool exec(const char *sql);
+    bool insert_batch(const std::vector<record> &batch);
+    void run();                         // the writer thread
+#endif
+};
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * flow_db_bench.cpp:
+ *
+ * Measures sustained inserts into the connections table, comparing
+ * flow_db (WAL, batched transactions on a writer thread, indexes built
+ * at the end) with one autocommitted INSERT per flow, which is what
+ * the original openDB() stub was heading towards.
+ *
+ * usage: flow_db_bench [-n rows] [-a autocommit_rows] [-b batch_rows] [-m batch_ms] dir
+ *
+ * Each method writes to its own database in dir, which must exist. The
+ * autocommit run syncs the journal on every row and is slow, so it gets
+ * fewer rows (default 2000) than the batched run (default one million).
+ * The batched figures are for add() alone, which is what tcpflow waits
+ * on, and for the whole run including close().
+ *
+ * Build with "make flow_db_bench".
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "config.h"
+#include "flow_db.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#ifndef HAVE_SQLITE3
+int main(int argc,char **argv)
+{
+    fprintf(stderr,"flow_db_bench: compiled without SQLite\n");
+    return 1;
+}
+#else
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+static void make_record(flow_db::record &r,uint64_t n)
+{
+    char buf[64];
+    snprintf(buf,sizeof(buf),"2017-07-14T02:%02d:%02d.%06dZ",(int)(n/60000)%60,(int)(n/1000)%60,(int)(n%1000)*1000);
+    r.starttime = buf;
+    r.endtime   = buf;
+    snprintf(buf,sizeof(buf),"10.%d.%d.%d",(int)(n>>16)&255,(int)(n>>8)&255,(int)n&255);
+    r.src_ipn   = buf;
+    r.dst_ipn   = "192.0.2.1";
+    r.mac_daddr = "00:11:22:33:44:55";
+    r.mac_saddr = "66:77:88:99:aa:bb";
+    r.packets   = 10 + n%100;
+    r.srcport   = (uint16_t)(1024 + n%60000);
+    r.dstport   = 443;
+}
+
+static void report(const char *what,uint64_t rows,double t)
+{
+    printf("%-36s %10.0f rows/sec  %8.2f us/row\n",what,rows/t,t*1e6/rows);
+}
+
+static void autocommit(const std::string &fname,uint64_t rows)
+{
+    sqlite3 *db = 0;
+    unlink(fname.c_str());
+    if(sqlite3_open(fname.c_str(),&db)!=SQLITE_OK){
+        fprintf(stderr,"%s: %s\n",fname.c_str(),sqlite3_errmsg(db));
+        exit(1);
+    }
+    sqlite3_exec(db,"CREATE TABLE connections (starttime TEXT NOT NULL,endtime TEXT NOT NULL,"
+                 "src_ipn TEXT,dst_ipn TEXT,mac_daddr TEXT,mac_saddr TEXT,packets INTEGER,"
+                 "srcport INTEGER,dstport INTEGER,hashdigest_md5 TEXT)",0,0,0);
+    sqlite3_stmt *s = 0;
+    sqlite3_prepare_v2(db,"INSERT INTO connections (starttime,endtime,src_ipn,dst_ipn,mac_daddr,"
+                       "mac_saddr,packets,srcport,dstport,hashdigest_md5) VALUES (?,?,?,?,?,?,?,?,?,?)",
+                       -1,&s,0);
+    flow_db::record r;
+    double t0 = now();
+    for(uint64_t n=0;n<rows;n++){
+        make_record(r,n);
+        sqlite3_bind_text(s,1,r.starttime.c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_text(s,2,r.endtime.c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_text(s,3,r.src_ipn.c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_text(s,4,r.dst_ipn.c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_text(s,5,r.mac_daddr.c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_text(s,6,r.mac_saddr.c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_int64(s,7,(sqlite3_int64)r.packets);
+        sqlite3_bind_int(s,8,r.srcport);
+        sqlite3_bind_int(s,9,r.dstport);
+        sqlite3_bind_null(s,10);
+        if(sqlite3_step(s)!=SQLITE_DONE){
+            fprintf(stderr,"%s: %s\n",fname.c_str(),sqlite3_errmsg(db));
+            exit(1);
+        }
+        sqlite3_reset(s);
+    }
+    report("autocommit, one INSERT per row",rows,now()-t0);
+    sqlite3_finalize(s);
+    sqlite3_close(db);
+}
+
+static void usage()
+{
+    fprintf(stderr,"usage: flow_db_bench [-n rows] [-a autocommit_rows] [-b batch_rows] [-m batch_ms] dir\n");
+    exit(1);
+}
+
+int main(int argc,char **argv)
+{
+    uint64_t rows = 1000000;
+    uint64_t autocommit_rows = 2000;
+    flow_db::options opt;
+    int ch;
+    while((ch = getopt(argc,argv,"n:a:b:m:")) != -1){
+        switch(ch){
+        case 'n': rows = strtoull(optarg,0,10); break;
+        case 'a': autocommit_rows = strtoull(optarg,0,10); break;
+        case 'b': opt.batch_rows = (uint32_t)strtoul(optarg,0,10); break;
+        case 'm': opt.batch_ms = (uint32_t)strtoul(optarg,0,10); break;
+        default: usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if(argc!=1 || rows==0) usage();
+    std::string dir = argv[0];
+
+    if(autocommit_rows) autocommit(dir + "/autocommit.sqlite3",autocommit_rows);
+
+    std::string fname = dir + "/batched.sqlite3";
+    unlink(fname.c_str());
+    unlink((fname + "-wal").c_str());
+    unlink((fname + "-shm").c_str());
+    flow_db db;
+    if(!db.open(fname,opt)){
+        fprintf(stderr,"%s\n",db.error().c_str());
+        exit(1);
+    }
+    flow_db::record r;
+    double t0 = now();
+    for(uint64_t n=0;n<rows;n++){
+        make_record(r,n);
+        db.add(r);
+    }
+    double t1 = now();
+    db.close();
+    double t2 = now();
+    report("flow_db add()",rows,t1-t0);
+    report("flow_db including close() + indexes",rows,t2-t0);
+    if(db.rows()!=rows){
+        fprintf(stderr,"only %llu of %llu rows were written\n",
+                (unsigned long long)db.rows(),(unsigned long long)rows);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,265 @@
+/**
+ * flow_stream.cpp:
+ *
+ * Sends flows to a consumer on a Unix-domain socket; see flow_stream.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "tcpip.h"
+#include "flow_stream.h"
+
+#if defined(HAVE_SYS_UN_H) && defined(HAVE_POLL_H)
+# include <sys/un.h>
+# include <poll.h>
+# define HAVE_UNIX_SOCKETS
+#endif
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0                 // SO_NOSIGPIPE is set instead
+#endif
+
+static_assert(sizeof(stream_proto::header)==16,"stream header");
+static_assert(sizeof(stream_proto::open_msg)==72,"stream open message");
+static_assert(sizeof(stream_proto::data_msg)==24,"stream data message");
+static_assert(sizeof(stream_proto::close_msg)==56,"stream close message");
+
+flow_stream::flow_stream():opt(),err(),fd(-1),queue(),head(0),spill_fd(-1),spill_read(0),spill_write(0),
+                           sent(0),dropped(0),spilled(0)
+{
+}
+
+flow_stream::~flow_stream()
+{
+    close();
+}
+
+bool flow_stream::open(const std::string &path,const options &opt_)
+{
+    opt = opt_;
+#ifdef HAVE_UNIX_SOCKETS
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    if(path.size()>=sizeof(addr.sun_path)){
+        err = path + ": socket path too long";
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path,path.c_str());
+    fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd<0 || connect(fd,(struct sockaddr *)&addr,sizeof(addr))!=0){
+        err = path + ": " + strerror(errno);
+        if(fd>=0) ::close(fd);
+        fd = -1;
+        return false;
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd,SOL_SOCKET,SO_NOSIGPIPE,&one,sizeof(one));
+#endif
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+
+    stream_proto::header h;
+    memset(&h,0,sizeof(h));
+    memcpy(h.magic,stream_proto::MAGIC,sizeof(h.magic));
+    h.byte_order = stream_proto::ORDER_MARK;
+    queue.insert(queue.end(),(const char *)&h,(const char *)&h+sizeof(h));
+    drain(false);
+    return true;
+#else
+    err = "Unix-domain sockets are not supported on this platform";
+    return false;
+#endif
+}
+
+void flow_stream::flow_open(const flow &f)
+{
+    stream_proto::open_msg m;
+    memset(&m,0,sizeof(m));
+    m.h.type      = stream_proto::MSG_OPEN;
+    m.h.len       = sizeof(m);
+    m.h.id        = f.id;
+    m.tstart_sec  = f.tstart.tv_sec;
+    m.tstart_nsec = f.tstart.tv_nsec;
+    m.sport       = f.sport;
+    m.dport       = f.dport;
+    m.ip_version  = f.family==AF_INET6 ? 6 : 4;
+    m.vlan        = f.vlan;
+    memcpy(m.src,f.src.addr,f.family==AF_INET6 ? 16 : 4);
+    memcpy(m.dst,f.dst.addr,f.family==AF_INET6 ? 16 : 4);
+    send_msg(&m,sizeof(m),0,0,false);
+}
+
+bool flow_stream::write(uint64_t id,uint64_t offset,const uint8_t *data,uint32_t length)
+{
+    stream_proto::data_msg m;
+    memset(&m,0,sizeof(m));
+    m.h.type   = stream_proto::MSG_DATA;
+    m.h.len    = sizeof(m) + length;
+    m.h.id     = id;
+    m.offset   = offset;
+    return send_msg(&m,sizeof(m),data,length,true);
+}
+
+void flow_stream::flow_close(const flow &f,uint64_t bytes,uint64_t flow_dropped)
+{
+    stream_proto::close_msg m;
+    memset(&m,0,sizeof(m));
+    m.h.type     = stream_proto::MSG_CLOSE;
+    m.h.len      = sizeof(m);
+    m.h.id       = f.id;
+    m.tlast_sec  = f.tlast.tv_sec;
+    m.tlast_nsec = f.tlast.tv_nsec;
+    m.bytes      = bytes;
+    m.packets    = f.packet_count;
+    m.dropped    = flow_dropped;
+    send_msg(&m,sizeof(m),0,0,false);
+}
+
+/* Queue a message, or apply the policy if the queue is full.
+ * A message is always accepted by an empty queue, however large.
+ */
+bool flow_stream::send_msg(const void *msg,size_t len,const uint8_t *data,uint32_t data_len,bool droppable)
+{
+    if(fd<0) return false;
+    uint64_t total = len + data_len;
+    drain(false);
+    if(spill_read<spill_write){         // stay in order behind what has been spilled
+        spill(msg,len);
+        spill(data,data_len);
+        spilled += total;
+        return true;
+    }
+    if(queue.size()>head && queue.size()-head+total > opt.queue_bytes){
+        switch(opt.policy){
+        case BLOCK:
+            while(queue.size()>head && queue.size()-head+total > opt.queue_bytes){
+                wait_writable();
+                drain(false);
+            }
+            break;
+        case DROP:
+            if(droppable){
+                dropped += data_len;
+                return false;
+            }
+            break;
+        case SPILL:
+            spill(msg,len);
+            spill(data,data_len);
+            spilled += total;
+            return true;
+        }
+    }
+    queue.insert(queue.end(),(const char *)msg,(const char *)msg+len);
+    if(data_len) queue.insert(queue.end(),(const char *)data,(const char *)data+data_len);
+    drain(false);
+    return true;
+}
+
+void flow_stream::drain(bool wait)
+{
+#ifdef HAVE_UNIX_SOCKETS
+    while(fd>=0){
+        if(head==queue.size()){
+            queue.clear();
+            head = 0;
+            if(spill_read<spill_write){
+                refill();
+                continue;
+            }
+            return;
+        }
+        ssize_t n = send(fd,&queue[head],queue.size()-head,MSG_NOSIGNAL);
+        if(n>0){
+            head += n;
+            sent += n;
+            continue;
+        }
+        if(n<0 && errno==EINTR) continue;
+        if(n<0 && (errno==EAGAIN || errno==EWOULDBLOCK)){
+            if(wait){
+                wait_writable();
+                continue;
+            }
+            break;
+        }
+        die("stream consumer: %s",n<0 ? strerror(errno) : "connection closed");
+    }
+    /* Don't let what has been sent accumulate at the front */
+    if(head>1024*1024 && head>queue.size()/2){
+        queue.erase(queue.begin(),queue.begin()+head);
+        head = 0;
+    }
+#endif
+}
+
+void flow_stream::wait_writable()
+{
+#ifdef HAVE_UNIX_SOCKETS
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLOUT;
+    p.revents = 0;
+    while(poll(&p,1,-1)<0){
+        if(errno!=EINTR) die("stream consumer: poll: %s",strerror(errno));
+    }
+    if(p.revents & (POLLERR|POLLHUP)) die("stream consumer: connection closed");
+#endif
+}
+
+void flow_stream::spill(const void *p,size_t len)
+{
+    if(len==0) return;
+    if(spill_fd<0){
+        spill_fd = ::open(opt.spill_name.c_str(),O_RDWR|O_CREAT|O_TRUNC|O_BINARY,0600);
+        if(spill_fd<0) die("cannot create %s: %s",opt.spill_name.c_str(),strerror(errno));
+    }
+    const char *cp = (const char *)p;
+    while(len>0){
+        ssize_t n = pwrite(spill_fd,cp,len,(off_t)spill_write);
+        if(n<0 && errno==EINTR) continue;
+        if(n<=0) die("write to %s failed: %s",opt.spill_name.c_str(),strerror(errno));
+        cp += n;
+        len -= n;
+        spill_write += n;
+    }
+}
+
+/* Called with the queue empty: the oldest spilled messages go back into it */
+void flow_stream::refill()
+{
+    uint64_t chunk = spill_write - spill_read;
+    uint64_t max_chunk = opt.queue_bytes > 65536 ? opt.queue_bytes : 65536;
+    if(chunk>max_chunk) chunk = max_chunk;
+    queue.resize(chunk);
+    size_t got = 0;
+    while(got<chunk){
+        ssize_t n = pread(spill_fd,&queue[got],chunk-got,(off_t)(spill_read+got));
+        if(n<0 && errno==EINTR) continue;
+        if(n<=0) die("read from %s failed: %s",opt.spill_name.c_str(),n<0 ? strerror(errno) : "end of file");
+        got += n;
+    }
+    spill_read += chunk;
+    if(spill_read==spill_write){        // caught up; start the file again
+        if(ftruncate(spill_fd,0)!=0) die("cannot truncate %s: %s",opt.spill_name.c_str(),strerror(errno));
+        spill_read = spill_write = 0;
+    }
+}
+
+void flow_stream::close()
+{
+    if(fd<0) return;
+    drain(true);
+    ::close(fd);
+    fd = -1;
+    if(spill_fd>=0){
+        ::close(spill_fd);
+        spill_fd = -1;
+        unlink(opt.spill_name.c_str());
+    }
+    DEBUG(2)("stream: %" PRIu64 " bytes sent, %" PRIu64 " spilled",sent,spilled);
+    if(dropped) DEBUG(1)("stream: %" PRIu64 " bytes of flow data dropped because the consumer fell behind",dropped);
+}
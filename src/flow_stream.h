@@ -0,0 +1,142 @@
+/*
+ * flow_stream.h:
+ *
+ * Stream output (-S stream=socket): instead of writing a file per flow,
+ * tcpflow connects to a consumer listening on a Unix-domain stream
+ * socket and sends it the flows as they are captured, as messages:
+ *
+ *   OPEN    a new flow: its id, addresses, ports, vlan and start time
+ *   DATA    bytes of flow id, at offset in the flow
+ *   CLOSE   flow id is finished: its end time, length and packet count,
+ *           and how many of its bytes were not sent (see below)
+ *
+ * Data is sent as it is stored in a file: at its offset from the start
+ * of the flow, so retransmissions and out-of-order segments arrive
+ * with their offsets, and a consumer that writes each DATA at its
+ * offset recreates the file tcpflow would have written.
+ *
+ * The connection starts with a header; every message then starts with
+ * its type and total length. Integers are in host byte order: the
+ * consumer is on the same machine.
+ *
+ * Messages are queued in memory, up to queue_bytes, while the consumer
+ * is not reading. When the queue is full, the policy decides:
+ *
+ *   block   wait for the consumer (the capture stalls; the kernel may drop packets)
+ *   drop    discard the DATA; OPEN and CLOSE are always sent
+ *   spill   append everything to a file in the output directory, and
+ *           send it from there, in order, when the consumer catches up
+ *
+ * The queue is only sent as messages are added; close() sends whatever
+ * is left, so at the end of the input nothing queued or spilled is lost.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef FLOW_STREAM_H
+#define FLOW_STREAM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace stream_proto {
+    static const char     MAGIC[8] = {'T','F','S','T','R','M','1','\0'};
+    static const uint32_t ORDER_MARK = 0x01020304; // reads back differently if swapped
+    enum { MSG_OPEN=1, MSG_DATA=2, MSG_CLOSE=3 };
+
+    struct header {
+        char     magic[8];
+        uint32_t byte_order;
+        uint32_t reserved;
+    };
+    /* Every message starts with its type and its total length, header included */
+    struct msg_header {
+        uint32_t type;
+        uint32_t len;
+        uint64_t id;                    // the flow
+    };
+    struct open_msg {
+        msg_header h;
+        int64_t  tstart_sec;
+        uint32_t tstart_nsec;
+        uint16_t sport;
+        uint16_t dport;
+        uint8_t  ip_version;            // 4 or 6
+        uint8_t  reserved0;
+        uint16_t reserved1;
+        int32_t  vlan;                  // -1 for none
+        uint8_t  src[16];
+        uint8_t  dst[16];
+    };
+    struct data_msg {                   // followed by the bytes
+        msg_header h;
+        uint64_t offset;
+    };
+    struct close_msg {
+        msg_header h;
+        int64_t  tlast_sec;
+        uint32_t tlast_nsec;
+        uint32_t reserved;
+        uint64_t bytes;                 // the length of the flow
+        uint64_t packets;
+        uint64_t dropped;               // bytes not sent under the drop policy
+    };
+}
+
+class flow_stream {
+    /* These are not implemented */
+    flow_stream(const flow_stream &);
+    flow_stream &operator=(const flow_stream &);
+public:
+    typedef enum { BLOCK, DROP, SPILL } policy_t;
+
+    class options {
+    public:
+        enum { QUEUE_BYTES=16*1024*1024 };
+        options():queue_bytes(QUEUE_BYTES),policy(BLOCK),spill_name(){}
+        uint64_t    queue_bytes;        // in memory, waiting for the consumer
+        policy_t    policy;             // when that is full
+        std::string spill_name;         // the file for SPILL
+    };
+
+    flow_stream();
+    virtual ~flow_stream();             // close()s
+
+    /* Returns false and sets error() if the consumer cannot be reached */
+    bool open(const std::string &path,const options &opt);
+    const std::string &error() const { return err; }
+
+    void flow_open(const class flow &f);
+    /* Returns false if the data was dropped */
+    bool write(uint64_t id,uint64_t offset,const uint8_t *data,uint32_t length);
+    void flow_close(const class flow &f,uint64_t bytes,uint64_t dropped);
+
+    void close();                       // send everything, then disconnect
+
+    uint64_t sent_bytes() const { return sent; }
+    uint64_t dropped_bytes() const { return dropped; }
+    uint64_t spilled_bytes() const { return spilled; }
+
+private:
+    options     opt;
+    std::string err;
+    int         fd;                     // the socket
+    std::vector<char> queue;
+    size_t      head;                   // next byte of queue to send
+    int         spill_fd;
+    uint64_t    spill_read;             // next byte of the spill file to send
+    uint64_t    spill_write;            // its length
+    uint64_t    sent;                   // bytes of messages sent
+    uint64_t    dropped;                // bytes of DATA dropped
+    uint64_t    spilled;                // bytes of messages that went through the spill file
+
+    bool send_msg(const void *msg,size_t len,const uint8_t *data,uint32_t data_len,bool droppable);
+    void drain(bool wait);              // send what we can; if wait, send it all
+    void refill();                      // move spilled messages back into the queue
+    void spill(const void *p,size_t len);
+    void wait_writable();
+};
+
+#endif
@@ -0,0 +1,230 @@
+/**
+ * flow_template.cpp:
+ *
+ * Compiles and renders the -T filename template; see flow_template.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "tcpip.h"
+#include "flow_template.h"
+
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>                  // inet_ntop
+#endif
+
+#include <iostream>
+
+void flow_template::add_literal(const std::string &text)
+{
+    for(size_t i=0;i<text.size();i++){
+        if(text[i]=='/'){
+            ops.push_back(op(OP_DIR));
+            continue;
+        }
+        if(ops.empty() || ops.back().type!=OP_LITERAL) ops.push_back(op(OP_LITERAL));
+        ops.back().text += text[i];
+    }
+}
+
+void flow_template::compile(const std::string &outdir_,const std::string &tmpl_)
+{
+    outdir = outdir_;
+    tmpl   = tmpl_;
+    ops.clear();
+    level_prefix.clear();
+
+    /* Add the outdir */
+    if(outdir!="." && outdir!=""){
+        add_literal(outdir);
+        add_literal("/");
+    }
+
+    for(size_t i=0;i<tmpl.size();i++){
+        if(tmpl[i]!='%'){
+            add_literal(std::string(1,tmpl[i]));
+            continue;
+        }
+        if(i==tmpl.size()-1){
+            std::cerr << "Invalid filename_template: " << tmpl << " cannot end with a %\n";
+            exit(1);
+        }
+        uint64_t div = 0;
+        switch(tmpl[++i]){
+        case 'A': ops.push_back(op(OP_SRC_ADDR)); break;
+        case 'a': ops.push_back(op(OP_SRC_PORT)); break;
+        case 'B': ops.push_back(op(OP_DST_ADDR)); break;
+        case 'b': ops.push_back(op(OP_DST_PORT)); break;
+        case 'E': ops.push_back(op(OP_SRC_MAC));  break;
+        case 'e': ops.push_back(op(OP_DST_MAC));  break;
+        case 'N': div = 1;          break;    // binning by connection number
+        case 'K': div = 1000;       break;
+        case 'M': div = 1000000;    break;
+        case 'G': div = 1000000000; break;
+        case 'T': ops.push_back(op(OP_ISO_TIME));   break;
+        case 't': ops.push_back(op(OP_UNIX_TIME));  break;
+        case 'V': ops.push_back(op(OP_VLAN_SEP));   break;
+        case 'v': ops.push_back(op(OP_VLAN));       break;
+        case 'U': ops.push_back(op(OP_TUNNEL_SEP)); break;
+        case 'u': ops.push_back(op(OP_TUNNEL_ID));  break;
+        case 'C': ops.push_back(op(OP_CONN_C));     break;
+        case 'c': ops.push_back(op(OP_CONN));       break;
+        case '#': ops.push_back(op(OP_CONN_ALL));   break;
+        case '%': add_literal("%");                 break;
+        default:
+            std::cerr << "Invalid filename_template: " << tmpl << "\n";
+            std::cerr << "unknown character: " << tmpl[i] << "\n";
+            exit(1);
+        }
+        if(div){
+            ops.push_back(op(OP_ID));
+            ops.back().div = div;
+        }
+    }
+    compiled = true;
+}
+
+/* v as a decimal number, zero-padded to width */
+void flow_template::put_dec(uint64_t v,int width)
+{
+    char buf[24];
+    char *p = buf+sizeof(buf);
+    do {
+        *--p = (char)('0' + v%10);
+        v /= 10;
+        width--;
+    } while(v);
+    while(width-- > 0) *--p = '0';
+    out.append(p,buf+sizeof(buf)-p);
+}
+
+void flow_template::put_signed(int64_t v)
+{
+    if(v<0){
+        out += '-';
+        put_dec((uint64_t)0-(uint64_t)v,0);
+    } else {
+        put_dec((uint64_t)v,0);
+    }
+}
+
+void flow_template::put_ip(int family,const uint8_t *addr)
+{
+    switch(family){
+    case AF_INET:
+        for(int i=0;i<4;i++){
+            if(i) out += '.';
+            put_dec(addr[i],3);
+        }
+        break;
+    case AF_INET6: {
+        char buf[INET6_ADDRSTRLEN];
+        if(inet_ntop(family,addr,buf,sizeof(buf))) out += buf;
+        break;
+    }
+    }
+}
+
+void flow_template::put_mac(const uint8_t *mac)
+{
+    static const char hex[] = "0123456789abcdef";
+    for(int i=0;i<6;i++){
+        if(i) out += ':';
+        out += hex[mac[i]>>4];
+        out += hex[mac[i]&0x0f];
+    }
+}
+
+const std::string &flow_template::render(const flow &f,uint32_t connection_count)
+{
+    out.clear();
+    dir_ends.clear();
+    for(std::vector<op>::const_iterator it=ops.begin();it!=ops.end();it++){
+        switch(it->type){
+        case OP_LITERAL:  out += it->text; break;
+        case OP_DIR:
+            dir_ends.push_back(out.size());
+            out += '/';
+            break;
+        case OP_SRC_ADDR: put_ip(f.family,f.src.addr); break;
+        case OP_SRC_PORT: put_dec(f.sport,5); break;
+        case OP_DST_ADDR: put_ip(f.family,f.dst.addr); break;
+        case OP_DST_PORT: put_dec(f.dport,5); break;
+        case OP_SRC_MAC:  put_mac(f.mac_saddr); break;
+        case OP_DST_MAC:  put_mac(f.mac_daddr); break;
+        case OP_ID:       put_dec((f.id / it->div) % 1000,3); break;
+        case OP_ISO_TIME:               // Timestamp in ISO8601 format
+            if(f.tstart.tv_sec!=time_sec){
+                char buf[64];
+                time_t t = f.tstart.tv_sec;
+                struct tm tm;
+                strftime(buf,sizeof(buf),"%Y-%m-%dT%H:%M:%SZ",gmtime_r(&t,&tm));
+                time_sec = f.tstart.tv_sec;
+                time_str = buf;
+            }
+            out += time_str;
+            break;
+        case OP_UNIX_TIME: put_signed(f.tstart.tv_sec); break;
+        case OP_VLAN_SEP:
+            if(f.vlan!=be13::packet_info::NO_VLAN) out += "--";
+            break;
+        case OP_VLAN:
+            if(f.vlan!=be13::packet_info::NO_VLAN) put_signed(f.vlan);
+            break;
+        case OP_TUNNEL_SEP:
+            if(f.tunnel_type!=TUNNEL_NONE) out += "--";
+            break;
+        case OP_TUNNEL_ID:
+            if(f.tunnel_type!=TUNNEL_NONE && f.tunnel_id>=0) put_signed(f.tunnel_id);
+            break;
+        case OP_CONN_C:
+            if(connection_count>0) out += 'c';
+            break;
+        case OP_CONN:
+            if(connection_count>0) put_dec(connection_count,0);
+            break;
+        case OP_CONN_ALL: put_dec(connection_count,0); break;
+        }
+    }
+    return out;
+}
+
+/* Make the directory out[0..end), unless it was made already */
+void flow_template::make_dir(size_t end)
+{
+    std::string path = out.substr(0,end);
+    dir_ids_t::const_iterator it = dir_ids.find(path);
+    uint32_t id;
+    if(it==dir_ids.end()){
+        id = (uint32_t)dir_made.size();
+        dir_ids[path] = id;
+        dir_made.push_back(false);
+    } else {
+        id = it->second;
+    }
+    if(dir_made[id]) return;
+    if(MKDIR(path.c_str(),0777)<0){
+        /* Can't make path; see if we can execute it*/
+        if(access(path.c_str(),X_OK)<0){
+            perror(path.c_str());
+            exit(1);
+        }
+    }
+    dir_made[id] = true;
+}
+
+void flow_template::make_dirs()
+{
+    if(level_prefix.size()<dir_ends.size()) level_prefix.resize(dir_ends.size());
+    for(size_t level=0;level<dir_ends.size();level++){
+        size_t end = dir_ends[level];
+        if(end==0) continue;            // the root of an absolute path
+        /* Same directory as the last flow at this depth? */
+        const std::string &last = level_prefix[level];
+        if(last.size()==end && out.compare(0,end,last)==0) continue;
+        make_dir(end);
+        level_prefix[level].assign(out,0,end);
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * flow_template.h:
+ *
+ * The -T filename template, compiled once into a list of emitters.
+ *
+ * flow::filename() used to walk the template a character at a time for
+ * every new flow. Now the template is parsed when it is first used (and
+ * again only if -T, -F or -o changed it), and rendering a filename runs
+ * the emitters into a buffer that is reused from flow to flow.
+ *
+ * Every '/' in the outdir and the template is a directory boundary known
+ * at compile time, so the directories of a rendered path never have to
+ * be found by splitting it. Each directory prefix is interned to an id
+ * and a bitmap records which ids have been created; consecutive flows
+ * in the same -Fk/-Fm/-Fg bin skip even that lookup.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef FLOW_TEMPLATE_H
+#define FLOW_TEMPLATE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_UNORDERED_MAP)
+# include <unordered_map>
+#else
+# if defined(HAVE_TR1_UNORDERED_MAP)
+#  include <tr1/unordered_map>
+# else
+#  include <map>
+# endif
+#endif
+
+class flow;
+
+class flow_template {
+    /* These are not implemented */
+    flow_template(const flow_template &);
+    flow_template &operator=(const flow_template &);
+public:
+    flow_template():compiled(false),outdir(),tmpl(),ops(),out(),dir_ends(),dir_ids(),dir_made(),
+                    level_prefix(),time_sec(-1),time_str(){}
+
+    /* Compile outdir and template. An invalid template is a fatal error. */
+    void compile(const std::string &outdir_,const std::string &tmpl_);
+    bool compiled_from(const std::string &outdir_,const std::string &tmpl_) const {
+        return compiled && outdir==outdir_ && tmpl==tmpl_;
+    }
+
+    /* The filename for a flow; valid until the next render() */
+    const std::string &render(const flow &f,uint32_t connection_count);
+
+    /* Create the directories of the last rendered filename */
+    void make_dirs();
+
+private:
+    typedef enum {
+        OP_LITERAL,                     // text
+        OP_DIR,                         // '/', ending a directory
+        OP_SRC_ADDR, OP_SRC_PORT, OP_DST_ADDR, OP_DST_PORT,
+        OP_SRC_MAC, OP_DST_MAC,
+        OP_ID,                          // (id / div) % 1000, three digits
+        OP_ISO_TIME, OP_UNIX_TIME,
+        OP_VLAN_SEP, OP_VLAN,
+        OP_TUNNEL_SEP, OP_TUNNEL_ID,
+        OP_CONN_C, OP_CONN, OP_CONN_ALL
+    } op_type_t;
+    struct op {
+        op(op_type_t t):type(t),text(),div(1){}
+        op_type_t   type;
+        std::string text;
+        uint64_t    div;
+    };
+
+#if defined(HAVE_UNORDERED_MAP)
+    typedef std::unordered_map<std::string,uint32_t> dir_ids_t;
+#elif defined(HAVE_TR1_UNORDERED_MAP)
+    typedef std::tr1::unordered_map<std::string,uint32_t> dir_ids_t;
+#else
+    typedef std::map<std::string,uint32_t> dir_ids_t;
+#endif
+
+    bool                compiled;
+    std::string         outdir;         // what we were compiled from
+    std::string         tmpl;
+    std::vector<op>     ops;
+    std::string         out;            // the last rendered filename
+    std::vector<size_t> dir_ends;       // offset of each '/' in out
+    dir_ids_t           dir_ids;        // interned directory paths
+    std::vector<bool>   dir_made;       // by id: directory exists
+    std::vector<std::string> level_prefix; // last directory made at each depth
+    time_t              time_sec;       // %T of the last flow
+    std::string         time_str;
+
+    void add_literal(const std::string &text);
+    void put_dec(uint64_t v,int width);
+    void put_signed(int64_t v);
+    void put_ip(int family,const uint8_t *addr);
+    void put_mac(const uint8_t *mac);
+    void make_dir(size_t end);
+};
+
+#endif
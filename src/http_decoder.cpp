@@ -0,0 +1,292 @@
+/**
+ * http_decoder.cpp:
+ *
+ * Pooled Content-Encoding decoders for scan_http; see http_decoder.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "http_decoder.h"
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#  define ZLIB_CONST
+#  ifdef GNUC_HAS_DIAGNOSTIC_PRAGMA
+#    pragma GCC diagnostic ignored "-Wundef"
+#    pragma GCC diagnostic ignored "-Wcast-qual"
+#  endif
+#  include <zlib.h>
+#  define USE_ZLIB
+#endif
+#if defined(HAVE_LIBBROTLIDEC) && defined(HAVE_BROTLI_DECODE_H)
+#  include <brotli/decode.h>
+#  define USE_BROTLI
+#endif
+#if defined(HAVE_LIBZSTD) && defined(HAVE_ZSTD_H)
+#  include <zstd.h>
+#  define USE_ZSTD
+#endif
+
+struct lib_state {
+    lib_state():zinit(false)
+#ifdef USE_ZLIB
+               ,zs()
+#endif
+#ifdef USE_BROTLI
+               ,br(0)
+#endif
+#ifdef USE_ZSTD
+               ,zd(0)
+#endif
+    {}
+    bool zinit;
+#ifdef USE_ZLIB
+    z_stream zs;
+#endif
+#ifdef USE_BROTLI
+    BrotliDecoderState *br;
+#endif
+#ifdef USE_ZSTD
+    ZSTD_DStream *zd;
+#endif
+};
+
+std::vector<http_decoder *> http_decoder::pool[http_decoder::NUM_ENCODINGS];
+
+http_decoder::encoding_t http_decoder::encoding(const char *value,size_t len)
+{
+    /* Content-Encoding values are case-insensitive tokens (RFC 7231) */
+    switch(len){
+    case 2:
+        if(strncasecmp(value,"br",2)==0) return BROTLI;
+        break;
+    case 4:
+        if(strncasecmp(value,"gzip",4)==0) return GZIP;
+        if(strncasecmp(value,"zstd",4)==0) return ZSTD;
+        break;
+    case 6:
+        if(strncasecmp(value,"x-gzip",6)==0) return GZIP;
+        break;
+    case 7:
+        if(strncasecmp(value,"deflate",7)==0) return GZIP;
+        break;
+    }
+    return IDENTITY;
+}
+
+bool http_decoder::supported(encoding_t e)
+{
+    switch(e){
+#ifdef USE_ZLIB
+    case GZIP:   return true;
+#endif
+#ifdef USE_BROTLI
+    case BROTLI: return true;
+#endif
+#ifdef USE_ZSTD
+    case ZSTD:   return true;
+#endif
+    default:     return false;
+    }
+}
+
+const char *http_decoder::name(encoding_t e)
+{
+    switch(e){
+    case GZIP:   return "gzip";
+    case BROTLI: return "br";
+    case ZSTD:   return "zstd";
+    default:     return "identity";
+    }
+}
+
+const char *http_decoder::extension(encoding_t e)
+{
+    switch(e){
+    case GZIP:   return "gz";
+    case BROTLI: return "br";
+    case ZSTD:   return "zst";
+    default:     return "";
+    }
+}
+
+http_decoder *http_decoder::get(encoding_t e)
+{
+    if(!supported(e)) return 0;
+    http_decoder *d = 0;
+    if(pool[e].size()){
+        d = pool[e].back();
+        pool[e].pop_back();
+    } else {
+        d = new http_decoder(e);
+    }
+    if(!d->reset()){
+        delete d;
+        return 0;
+    }
+    return d;
+}
+
+/* The decoder keeps its output buffer in the pool, which holds about
+ * one decoder per encoding; a brotli instance, which can't be reset,
+ * is freed here.
+ */
+void http_decoder::put(http_decoder *d)
+{
+    if(d==0) return;
+#ifdef USE_BROTLI
+    if(d->st->br){
+        BrotliDecoderDestroyInstance(d->st->br);
+        d->st->br = 0;
+    }
+#endif
+    pool[d->enc].push_back(d);
+}
+
+http_decoder::http_decoder(encoding_t e):bytes_in(0),bytes_out(0),enc(e),st(new lib_state()),
+                                         buf(new uint8_t[OUTPUT_SIZE]),used(0),done(false)
+{
+}
+
+http_decoder::~http_decoder()
+{
+#ifdef USE_ZLIB
+    if(st->zinit) inflateEnd(&st->zs);
+#endif
+#ifdef USE_BROTLI
+    if(st->br) BrotliDecoderDestroyInstance(st->br);
+#endif
+#ifdef USE_ZSTD
+    if(st->zd) ZSTD_freeDStream(st->zd);
+#endif
+    delete st;
+    delete[] buf;
+}
+
+/* Ready the context for a new body. zlib and zstd allocate their
+ * context and window once; later bodies only reset them.
+ */
+bool http_decoder::reset()
+{
+    bytes_in = bytes_out = 0;
+    used = 0;
+    done = false;
+    switch(enc){
+#ifdef USE_ZLIB
+    case GZIP:
+        if(st->zinit) return inflateReset(&st->zs)==Z_OK;
+        memset(&st->zs,0,sizeof(st->zs));
+        if(inflateInit2(&st->zs,32 + MAX_WBITS)!=Z_OK) return false; // 32 auto-detects gzip or deflate
+        st->zinit = true;
+        return true;
+#endif
+#ifdef USE_BROTLI
+    case BROTLI:
+        /* The decoder API has no reset, so each body gets a new instance;
+         * the window is allocated when the first block arrives.
+         */
+        st->br = BrotliDecoderCreateInstance(0,0,0);
+        return st->br!=0;
+#endif
+#ifdef USE_ZSTD
+    case ZSTD:
+        if(st->zd==0) st->zd = ZSTD_createDStream();
+        if(st->zd==0) return false;
+        return !ZSTD_isError(ZSTD_DCtx_reset(st->zd,ZSTD_reset_session_only));
+#endif
+    default:
+        return false;
+    }
+}
+
+bool http_decoder::flush(sink &out)
+{
+    if(used==0) return true;
+    bool ok = out.write(buf,used);
+    bytes_out += used;
+    used = 0;
+    return ok;
+}
+
+bool http_decoder::finish(sink &out)
+{
+    return flush(out);
+}
+
+/* Each loop decodes into what is left of buf and hands buf over when it
+ * fills, until the input is used up and the library has nothing pending.
+ */
+http_decoder::status_t http_decoder::decode(const uint8_t *in,size_t len,sink &out)
+{
+    if(done) return END;                // trailing garbage
+    bytes_in += len;
+    switch(enc){
+#ifdef USE_ZLIB
+    case GZIP: {
+        z_stream &zs = st->zs;
+        zs.next_in  = in;
+        zs.avail_in = len;
+        for(;;){
+            zs.next_out  = buf+used;
+            zs.avail_out = OUTPUT_SIZE-used;
+            int rv = inflate(&zs,Z_SYNC_FLUSH);
+            used = OUTPUT_SIZE-zs.avail_out;
+            if(rv==Z_STREAM_END){
+                done = true;
+                return END;
+            }
+            if(rv!=Z_OK && rv!=Z_BUF_ERROR) return FAILED;
+            if(used==OUTPUT_SIZE){
+                if(!flush(out)) return FAILED;
+                continue;
+            }
+            if(zs.avail_in==0 || rv==Z_BUF_ERROR) return OK;
+        }
+    }
+#endif
+#ifdef USE_BROTLI
+    case BROTLI: {
+        size_t avail_in = len;
+        const uint8_t *next_in = in;
+        for(;;){
+            size_t avail_out = OUTPUT_SIZE-used;
+            uint8_t *next_out = buf+used;
+            BrotliDecoderResult rv = BrotliDecoderDecompressStream(st->br,&avail_in,&next_in,
+                                                                   &avail_out,&next_out,0);
+            used = OUTPUT_SIZE-avail_out;
+            switch(rv){
+            case BROTLI_DECODER_RESULT_SUCCESS:
+                done = true;
+                return END;
+            case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+                if(!flush(out)) return FAILED;
+                continue;
+            case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+                return OK;
+            default:
+                return FAILED;
+            }
+        }
+    }
+#endif
+#ifdef USE_ZSTD
+    case ZSTD: {
+        ZSTD_inBuffer zin = {in,len,0};
+        for(;;){
+            ZSTD_outBuffer zout = {buf,OUTPUT_SIZE,used};
+            size_t rv = ZSTD_decompressStream(st->zd,&zout,&zin);
+            if(ZSTD_isError(rv)) return FAILED;
+            used = zout.pos;
+            if(used==OUTPUT_SIZE){
+                if(!flush(out)) return FAILED;
+                continue;
+            }
+            if(zin.pos==zin.size) return OK; // a body may hold several frames
+        }
+    }
+#endif
+    default:
+        return FAILED;
+    }
+}
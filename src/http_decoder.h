@@ -0,0 +1,78 @@
+/*
+ * http_decoder.h:
+ *
+ * Content-Encoding decoders for scan_http: gzip and deflate (zlib),
+ * br (brotli) and zstd, each one compiled in if its library was found.
+ *
+ * Decoders come from a pool and go back to it when a body is done, so
+ * the zlib and zstd contexts are created once and reset between messages
+ * instead of being set up and torn down for every response (brotli has
+ * no reset, and gets a new instance for each body). Output is collected
+ * in a buffer of OUTPUT_SIZE bytes and handed to the sink only when the
+ * buffer is full or the body ends, so writing a body costs one write()
+ * per OUTPUT_SIZE bytes rather than one per input chunk. The buffer is
+ * allocated with the decoder and goes back to the pool with it.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef HTTP_DECODER_H
+#define HTTP_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class http_decoder {
+    /* These are not implemented */
+    http_decoder(const http_decoder &);
+    http_decoder &operator=(const http_decoder &);
+public:
+    typedef enum { IDENTITY=0, GZIP, BROTLI, ZSTD, NUM_ENCODINGS } encoding_t; // GZIP includes deflate
+    typedef enum { OK, END, FAILED } status_t;
+    enum { OUTPUT_SIZE=1024*1024 };
+
+    /* Where the decoded bytes go */
+    class sink {
+    public:
+        virtual ~sink(){}
+        virtual bool write(const uint8_t *buf,size_t len)=0; // false on error
+    };
+
+    /* The encoding named by a Content-Encoding value; IDENTITY if not one of ours */
+    static encoding_t  encoding(const char *value,size_t len);
+    static bool        supported(encoding_t e);  // was its library compiled in?
+    static const char *name(encoding_t e);       // "gzip", "br", "zstd"
+    static const char *extension(encoding_t e);  // for bodies we can't decode: "gz", "br", "zst"
+
+    /* A decoder ready for a new body, or 0 if the encoding isn't supported */
+    static http_decoder *get(encoding_t e);
+    static void          put(http_decoder *d);   // back to the pool
+
+    /* Decode the next piece of the body. END means the compressed
+     * stream is complete; anything after it is ignored.
+     */
+    status_t decode(const uint8_t *in,size_t len,sink &out);
+    bool     finish(sink &out);                  // hand over the rest of the output
+
+    encoding_t encoding() const { return enc; }
+    uint64_t   bytes_in;                         // of this body, encoded
+    uint64_t   bytes_out;                        // decoded
+
+private:
+    explicit http_decoder(encoding_t e);
+    ~http_decoder();
+    bool reset();                                // for a new body
+    bool flush(sink &out);
+
+    encoding_t  enc;
+    struct lib_state *st;                        // the library's context
+    uint8_t    *buf;                             // OUTPUT_SIZE bytes, not cleared between bodies
+    size_t      used;                            // bytes in buf
+    bool        done;                            // stream ended
+
+    static std::vector<http_decoder *> pool[NUM_ENCODINGS];
+};
+
+#endif
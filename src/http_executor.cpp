@@ -0,0 +1,242 @@
+/**
+ * http_executor.cpp:
+ *
+ * Runs the -S http_cmd hook off the packet path; see http_executor.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "http_executor.h"
+
+#if defined(HAVE_WAITPID) && defined(HAVE_POLL_H)
+# include <sys/wait.h>
+# include <poll.h>
+# define HAVE_PROCESSES
+#endif
+
+http_executor::http_executor(const std::string &cmd_,const options &opt_):
+    submitted(0),completed(0),failed(0),dropped(0),max_queue(0),latency_total_us(0),latency_max_us(0),
+    cmd(cmd_),opt(opt_),started(false),pool(0),cmd_failed(0),queue(),head_written(0),
+    stdin_pid(-1),stdin_fd(-1)
+{
+}
+
+http_executor::~http_executor()
+{
+    close();
+    if(pool) delete pool;
+}
+
+uint64_t http_executor::now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return (uint64_t)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
+bool http_executor::submit(const std::string &path)
+{
+    if(!started) start();
+    if(pool){
+        bool queued = pool->submit(path);
+        submitted++;
+        take_results();
+        if(!queued) DEBUG(2)("http_cmd: queue full; not running it on %s",path.c_str());
+        return queued;
+    }
+    submitted++;
+    queue.push_back(job(path + "\n",now_us()));
+    write_stdin(false);
+    if(queue.size()>opt.queue_max){     // the command isn't keeping up and there's no room
+        queue.pop_back();
+        dropped++;
+        DEBUG(2)("http_cmd: queue full; not running it on %s",path.c_str());
+        return false;
+    }
+    if(queue.size()>max_queue) max_queue = queue.size();
+    return true;
+}
+
+void http_executor::done(uint64_t submit_us)
+{
+    uint64_t latency = now_us() - submit_us;
+    completed++;
+    latency_total_us += latency;
+    if(latency>latency_max_us) latency_max_us = latency;
+}
+
+void http_executor::start()
+{
+    started = true;
+#ifdef HAVE_PROCESSES
+    if(opt.use_stdin){
+        start_stdin();
+        return;
+    }
+#endif
+    /* A body at a time per worker, and only to idle ones */
+    worker_pool::options popt;
+    popt.workers   = opt.workers ? opt.workers : 1;
+    popt.batch     = 1;
+    popt.in_flight = 1;
+    popt.queue_max = opt.queue_max;
+    if(pool==0) pool = new worker_pool("http_cmd",popt,run_command,this);
+}
+
+/* The command's pipe is not passed on to what it runs */
+static void set_cloexec(int fd)
+{
+    fcntl(fd,F_SETFD,fcntl(fd,F_GETFD) | FD_CLOEXEC);
+}
+
+/* The pool's results say whether each command succeeded; its counts are ours */
+void http_executor::take_results()
+{
+    while(pool->results.size()){
+        if(pool->results.front()!="0") cmd_failed++;
+        pool->results.pop_front();
+    }
+    completed        = pool->completed;
+    failed           = pool->failed + cmd_failed;
+    dropped          = pool->dropped;
+    max_queue        = pool->max_queue;
+    latency_total_us = pool->latency_total_us;
+    latency_max_us   = pool->latency_max_us;
+}
+
+/* In a worker (or, without processes, in tcpflow): runs "cmd path" for
+ * each path; the result is "0" if it exited with 0.
+ */
+void http_executor::run_command(const std::vector<std::string> &paths,std::vector<std::string> &results,void *arg)
+{
+    const http_executor *self = static_cast<const http_executor *>(arg);
+    for(size_t i=0;i<paths.size();i++){
+        std::string line = self->cmd + " " + paths[i];
+        bool ok = false;
+#ifdef HAVE_PROCESSES
+        pid_t pid = fork();
+        if(pid==0){
+            portable_signal(SIGINT,SIG_DFL);
+            portable_signal(SIGHUP,SIG_DFL);
+            execl("/bin/sh","sh","-c",line.c_str(),(char *)0);
+            _exit(127);
+        }
+        if(pid>0){
+            int status = 0;
+            while(waitpid(pid,&status,0)<0){
+                if(errno!=EINTR) break;
+            }
+            ok = WIFEXITED(status) && WEXITSTATUS(status)==0;
+        }
+#else
+        ok = system(line.c_str())==0;
+#endif
+        results[i] = ok ? "0" : "1";
+    }
+}
+
+void http_executor::start_stdin()
+{
+#ifdef HAVE_PROCESSES
+    int p[2];
+    if(pipe(p)!=0){
+        DEBUG(1)("http_cmd: pipe: %s",strerror(errno));
+        return;
+    }
+    set_cloexec(p[1]);
+    stdin_pid = fork();
+    if(stdin_pid<0){
+        DEBUG(1)("http_cmd: fork: %s",strerror(errno));
+        ::close(p[0]);
+        ::close(p[1]);
+        return;
+    }
+    if(stdin_pid==0){
+        dup2(p[0],0);
+        ::close(p[0]);
+        portable_signal(SIGINT,SIG_IGN); // tcpflow closes our input when it stops
+        portable_signal(SIGHUP,SIG_IGN);
+        portable_signal(SIGTERM,SIG_DFL);
+        execl("/bin/sh","sh","-c",cmd.c_str(),(char *)0);
+        _exit(127);
+    }
+    ::close(p[0]);
+    stdin_fd = p[1];
+    fcntl(stdin_fd,F_SETFL,fcntl(stdin_fd,F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+/* Write queued paths to the command; with wait, all of them */
+void http_executor::write_stdin(bool wait)
+{
+#ifdef HAVE_PROCESSES
+    if(stdin_fd<0) return;
+    void (*old)(int) = portable_signal(SIGPIPE,SIG_IGN); // the command may have exited
+    while(queue.size()){
+        const job &j = queue.front();
+        ssize_t n = write(stdin_fd,j.path.data()+head_written,j.path.size()-head_written);
+        if(n>0){
+            head_written += n;
+            if(head_written==j.path.size()){
+                done(j.submit_us);
+                queue.pop_front();
+                head_written = 0;
+            }
+            continue;
+        }
+        if(n<0 && errno==EINTR) continue;
+        if(n<0 && (errno==EAGAIN || errno==EWOULDBLOCK)){
+            if(!wait) break;
+            struct pollfd p;
+            p.fd = stdin_fd;
+            p.events = POLLOUT;
+            p.revents = 0;
+            poll(&p,1,-1);
+            continue;
+        }
+        DEBUG(1)("http_cmd: %s",n<0 ? strerror(errno) : "cannot write");
+        dropped += queue.size();
+        queue.clear();
+        head_written = 0;
+        ::close(stdin_fd);
+        stdin_fd = -1;
+        break;
+    }
+    portable_signal(SIGPIPE,old);
+#endif
+}
+
+void http_executor::close()
+{
+    if(!started) return;
+    started = false;
+    if(pool){
+        pool->close();
+        take_results();
+        return;
+    }
+#ifdef HAVE_PROCESSES
+    write_stdin(true);
+    if(stdin_fd>=0) ::close(stdin_fd);
+    stdin_fd = -1;
+    if(stdin_pid>0) waitpid(stdin_pid,0,0);
+    stdin_pid = -1;
+#endif
+}
+
+void http_executor::write_xml(std::ostream &os) const
+{
+    os << "<http_cmd>"
+       << "<submitted>" << submitted << "</submitted>"
+       << "<completed>" << completed << "</completed>"
+       << "<failed>" << failed << "</failed>"
+       << "<dropped>" << dropped << "</dropped>"
+       << "<max_queue>" << max_queue << "</max_queue>";
+    if(completed){
+        os << "<mean_latency_us>" << latency_total_us/completed << "</mean_latency_us>"
+           << "<max_latency_us>" << latency_max_us << "</max_latency_us>";
+    }
+    os << "</http_cmd>\n";
+}
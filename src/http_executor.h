@@ -0,0 +1,92 @@
+/*
+ * http_executor.h:
+ *
+ * Runs the -S http_cmd hook on finished HTTP bodies without stalling
+ * the packet path. Submitting a body never blocks and never forks;
+ * the paths wait in a bounded queue for the processes that run them.
+ *
+ * Two ways to run the command:
+ *
+ *   pool    (default) a worker_pool of processes, forked once. Each
+ *           runs "cmd path" for one body at a time, and the queue
+ *           feeds only idle workers.
+ *   stdin   (-S http_cmd_stdin=1) the command is started once and
+ *           reads the paths from its standard input, one per line.
+ *
+ * When the queue is full, further bodies are dropped and counted.
+ * close() waits for everything queued to be handed over (stdin) or run
+ * (pool). The counts and latencies, from submission to completion
+ * (pool) or to being written to the command (stdin), go in the DFXML.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef HTTP_EXECUTOR_H
+#define HTTP_EXECUTOR_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "worker_pool.h"
+
+class http_executor {
+    /* These are not implemented */
+    http_executor(const http_executor &);
+    http_executor &operator=(const http_executor &);
+public:
+    class options {
+    public:
+        enum { WORKERS=10, QUEUE=1000 };
+        options():workers(WORKERS),queue_max(QUEUE),use_stdin(false){}
+        unsigned int workers;           // processes running the command, one body each
+        size_t   queue_max;             // paths waiting; more than this are dropped
+        bool     use_stdin;             // one command reading a path per line
+    };
+
+    http_executor(const std::string &cmd,const options &opt);
+    virtual ~http_executor();           // close()s
+
+    bool submit(const std::string &path); // false if the path was dropped
+    void close();                       // finish what is queued; the processes exit
+    void write_xml(std::ostream &os) const;
+
+    uint64_t submitted;
+    uint64_t completed;                 // run (pool) or handed to the command (stdin)
+    uint64_t failed;                    // the command exited with an error, or its worker died (pool)
+    uint64_t dropped;                   // because the queue was full
+    size_t   max_queue;                 // the most paths that ever waited
+    uint64_t latency_total_us;          // over the completed
+    uint64_t latency_max_us;
+
+private:
+    struct job {
+        job(const std::string &path_,uint64_t t):path(path_),submit_us(t){}
+        std::string path;
+        uint64_t    submit_us;
+    };
+
+    const std::string cmd;
+    const options opt;
+    bool     started;
+    worker_pool *pool;                  // pool
+    uint64_t cmd_failed;                // pool: results saying the command failed
+    std::deque<job> queue;              // stdin
+    size_t   head_written;              // bytes of queue.front() written
+    pid_t    stdin_pid;                 // the command
+    int      stdin_fd;                  // and its standard input
+
+    static uint64_t now_us();
+    void start();
+    void start_stdin();
+    void take_results();                // count the pool's results
+    void write_stdin(bool wait);        // with wait, until the queue is empty
+    void done(uint64_t submit_us);
+    static void run_command(const std::vector<std::string> &paths,std::vector<std::string> &results,void *arg);
+};
+
+#endif
@@ -10,8 +10,15 @@
 #ifndef MIME_MAP_H
 #define MIME_MAP_H
 
+#include <stddef.h>
 #include <string>
 
+/* The file extension for a Content-Type value such as "text/html;
+ * charset=utf-8" (compared case-insensitively, parameters ignored), or
+ * "" if the type is unknown. Returns a static string; nothing is copied.
+ */
+const char *mime_extension(const char *mime_type, size_t len);
+
 std::string get_extension_for_mime_type(const std::string& mime_type);
 
 #endif /* MIME_MAP_H */
\ No newline at end of file
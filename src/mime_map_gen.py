@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+#
+# Generates mime_map_table.h, the perfect hash table that mime_map.cpp
+# looks MIME types up in, from mime.types:
+#
+#     python3 mime_map_gen.py [mime.types [mime_map_table.h]]
+#
+# Each type hashes (FNV-1a, ASCII case folded) to a bucket; each bucket
+# has a displacement chosen here so that every type in the table lands
+# in a slot of its own. A lookup is one hash, one mix and one compare.
+#
+# This source code is under the GNU Public License (GPL) version 3.
+# See COPYING for details.
+
+import sys
+
+BUCKETS = 256
+SLOTS   = 1024                          # powers of two; SLOTS > number of types
+MASK32  = 0xffffffff
+
+def fnv1a(s):
+    h = 2166136261
+    for c in s.lower().encode('ascii'):
+        h = ((h ^ c) * 16777619) & MASK32
+    return h
+
+def fmix(x):
+    x ^= x >> 16
+    x = (x * 0x85ebca6b) & MASK32
+    x ^= x >> 13
+    x = (x * 0xc2b2ae35) & MASK32
+    x ^= x >> 16
+    return x
+
+def slot(h, d):
+    return fmix(h ^ d) & (SLOTS-1)
+
+def read_types(fname):
+    types = {}
+    for line in open(fname):
+        line = line.split('#')[0].split()
+        if len(line) == 2:
+            types[line[0].lower()] = line[1]
+    return types
+
+def build(types):
+    buckets = [[] for i in range(BUCKETS)]
+    for t in types:
+        buckets[fnv1a(t) & (BUCKETS-1)].append(t)
+    displacement = [0] * BUCKETS
+    slots = [None] * SLOTS
+    for b in sorted(range(BUCKETS), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            continue
+        hashes = [fnv1a(t) for t in buckets[b]]
+        for d in range(1, 65536):
+            wanted = [slot(h, d) for h in hashes]
+            if len(set(wanted)) == len(wanted) and all(slots[s] is None for s in wanted):
+                break
+        else:
+            sys.exit("no displacement for bucket %d; make SLOTS larger" % b)
+        displacement[b] = d
+        for t, s in zip(buckets[b], wanted):
+            slots[s] = t
+    return displacement, slots
+
+def main():
+    src = sys.argv[1] if len(sys.argv) > 1 else 'mime.types'
+    dst = sys.argv[2] if len(sys.argv) > 2 else 'mime_map_table.h'
+    types = read_types(src)
+    displacement, slots = build(types)
+    with open(dst, 'w') as f:
+        f.write("/* Generated by mime_map_gen.py from mime.types; do not edit. */\n\n")
+        f.write("#define MIME_MAP_BUCKETS %d\n#define MIME_MAP_SLOTS %d\n\n" % (BUCKETS, SLOTS))
+        f.write("static const uint16_t mime_map_displacement[MIME_MAP_BUCKETS] = {\n")
+        for i in range(0, BUCKETS, 16):
+            f.write("    " + ",".join("%d" % d for d in displacement[i:i+16]) + ",\n")
+        f.write("};\n\n")
+        f.write("static const mime_map_entry mime_map_slots[MIME_MAP_SLOTS] = {\n")
+        for t in slots:
+            if t is None:
+                f.write("    {0,0,0},\n")
+            else:
+                f.write('    {"%s",%d,"%s"},\n' % (t, len(t), types[t]))
+        f.write("};\n")
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,1050 @@
+/* Generated by mime_map_gen.py from mime.types; do not edit. */
+
+#define MIME_MAP_BUCKETS 256
+#define MIME_MAP_SLOTS 1024
+
+static const uint16_t mime_map_displacement[MIME_MAP_BUCKETS] = {
+    1,2,1,1,1,5,3,3,7,6,6,2,2,4,6,6,
+    7,7,5,2,1,6,6,4,2,3,1,3,6,2,4,2,
+    2,6,4,5,2,3,1,1,2,3,2,1,0,3,1,6,
+    10,8,4,1,1,9,2,1,3,5,37,6,2,1,6,2,
+    1,3,1,1,3,1,3,3,1,2,1,3,1,0,1,1,
+    1,0,14,2,0,1,4,3,1,0,1,10,2,8,1,1,
+    3,9,6,4,2,6,0,1,1,2,1,2,11,3,9,0,
+    4,0,27,0,24,11,11,1,0,1,1,1,2,0,2,4,
+    3,8,1,8,1,2,5,9,12,0,7,4,1,1,7,0,
+    15,2,2,1,2,7,3,2,4,1,3,0,20,3,1,3,
+    1,2,1,1,2,2,3,6,2,8,4,1,1,1,8,3,
+    1,7,18,1,11,2,10,8,0,8,11,10,6,2,6,1,
+    2,7,4,1,2,0,8,3,1,2,1,4,25,2,3,4,
+    6,5,1,6,5,4,0,0,6,20,9,13,13,9,1,4,
+    4,3,3,3,10,4,1,1,1,4,6,11,2,0,1,25,
+    1,4,8,6,11,0,1,0,9,1,1,6,4,4,1,3,
+};
+
+static const mime_map_entry mime_map_slots[MIME_MAP_SLOTS] = {
+    {0,0,0},
+    {"audio/vnd.rip",13,"rip"},
+    {0,0,0},
+    {"application/vnd.isac.fcs",24,"fcs"},
+    {"application/mediaservercontrol+xml",34,"mscml"},
+    {0,0,0},
+    {"image/x-portable-bitmap",23,"pbm"},
+    {"application/vnd.shana.informed.package",38,"ipk"},
+    {0,0,0},
+    {"application/vnd.fdf",19,"fdf"},
+    {"application/vnd.cinderella",26,"cdy"},
+    {0,0,0},
+    {0,0,0},
+    {"image/ief",9,"ief"},
+    {"chemical/x-xyz",14,"xyz"},
+    {"application/vnd.palm",20,"pdb"},
+    {"text/calendar",13,"ics"},
+    {"application/x-tar",17,"tar"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.mcd",19,"mcd"},
+    {"application/x-msschedule",24,"scd"},
+    {"application/cdmi-queue",22,"cdmiq"},
+    {"application/voicexml+xml",24,"vxml"},
+    {"application/vnd.aristanetworks.swi",34,"swi"},
+    {"application/vnd.fdsn.mseed",26,"mseed"},
+    {"application/vnd.kinar",21,"knp"},
+    {"application/vnd.kde.kontour",27,"kon"},
+    {"application/vnd.stardivision.impress",36,"sdd"},
+    {0,0,0},
+    {"application/vnd.data-vision.rdz",31,"rdz"},
+    {"application/java-archive",24,"jar"},
+    {"application/vnd.ms-project",26,"mpp"},
+    {"application/vnd.dpgraph",23,"dpg"},
+    {"application/x-font-ghostscript",30,"gsf"},
+    {"chemical/x-csml",15,"csml"},
+    {"application/vnd.uoml+xml",24,"uoml"},
+    {0,0,0},
+    {"model/vnd.vtu",13,"vtu"},
+    {"application/vnd.recordare.musicxml+xml",38,"musicxml"},
+    {"video/x-flv",11,"flv"},
+    {"application/vnd.framemaker",26,"fm"},
+    {"application/vnd.adobe.air-application-installer-package+zip",59,"air"},
+    {"image/vnd.fpx",13,"fpx"},
+    {"application/vnd.hp-hpid",23,"hpid"},
+    {"model/vnd.mts",13,"mts"},
+    {0,0,0},
+    {"application/rsd+xml",19,"rsd"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.proteus.magazine",32,"mgz"},
+    {0,0,0},
+    {"application/wsdl+xml",20,"wsdl"},
+    {"application/vnd.noblenet-web",28,"nnw"},
+    {"application/winhlp",18,"hlp"},
+    {"application/vnd.groove-vcard",28,"vcg"},
+    {"application/x-pkcs12",20,"p12"},
+    {"application/vnd.ms-pki.seccat",29,"cat"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.llamagraphics.life-balance.exchange+xml",55,"lbe"},
+    {"text/x-fortran",14,"f"},
+    {"audio/adpcm",11,"adp"},
+    {0,0,0},
+    {"application/marcxml+xml",23,"mrcx"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.ezpix-album",27,"ez2"},
+    {0,0,0},
+    {"image/png",9,"png"},
+    {"application/x-font-ttf",22,"ttf"},
+    {"application/vnd.mfmp",20,"mfm"},
+    {"application/x-stuffitx",22,"sitx"},
+    {"application/vnd.oasis.opendocument.presentation",47,"odp"},
+    {"image/x-cmx",11,"cmx"},
+    {"audio/mpeg",10,"mpga"},
+    {0,0,0},
+    {0,0,0},
+    {"video/vnd.dece.sd",17,"uvvs"},
+    {"application/x-msclip",20,"clp"},
+    {0,0,0},
+    {"application/vnd.kidspiration",28,"kia"},
+    {0,0,0},
+    {"image/pict",10,"pict"},
+    {"video/mj2",9,"mj2"},
+    {"application/x-shar",18,"shar"},
+    {"application/vnd.iccprofile",26,"icc"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/x-bzip",18,"bz"},
+    {"application/vnd.novadigm.ext",28,"ext"},
+    {"application/vnd.oasis.opendocument.text-template",48,"ott"},
+    {"application/vnd.ms-powerpoint",29,"ppt"},
+    {"application/vnd.yamaha.hv-voice",31,"hvp"},
+    {0,0,0},
+    {"application/vnd.semd",20,"semd"},
+    {"audio/mp4",9,"mp4a"},
+    {"image/jpeg",10,"jpg"},
+    {0,0,0},
+    {"audio/vnd.dra",13,"dra"},
+    {0,0,0},
+    {"application/vnd.trueapp",23,"tra"},
+    {"application/exi",15,"exi"},
+    {"application/vnd.groove-tool-message",35,"gtm"},
+    {"application/vnd.fsc.weblaunch",29,"fsc"},
+    {0,0,0},
+    {"application/vnd.bmi",19,"bmi"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.pg.osasli",25,"ei6"},
+    {"application/vnd.openxmlformats-officedocument.wordprocessingml.document",71,"docx"},
+    {0,0,0},
+    {"application/x-ustar",19,"ustar"},
+    {"application/vnd.ms-excel",24,"xls"},
+    {"application/vnd.fujitsu.oasys3",30,"oa3"},
+    {"application/vnd.yamaha.smaf-phrase",34,"spf"},
+    {"application/vnd.epson.esf",25,"esf"},
+    {"application/vnd.hydrostatix.sof-data",36,"sfd-hdstx"},
+    {"application/vnd.previewsystems.box",34,"box"},
+    {"application/pkix-cert",21,"cer"},
+    {0,0,0},
+    {"application/vnd.sema",20,"sema"},
+    {"application/ssml+xml",20,"ssml"},
+    {"text/vnd.in3d.3dml",18,"3dml"},
+    {"application/x-msmoney",21,"mny"},
+    {"image/vnd.dvb.subtitle",22,"sub"},
+    {"application/vnd.curl.pcurl",26,"pcurl"},
+    {0,0,0},
+    {"application/vnd.ms-excel.template.macroenabled.12",49,"xltm"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"text/x-setext",13,"etx"},
+    {"application/vnd.hhe.lesson-player",33,"les"},
+    {0,0,0},
+    {"application/vnd.zul",19,"zir"},
+    {"application/vnd.pmi.widget",26,"wg"},
+    {"image/svg+xml",13,"svg"},
+    {"application/vnd.geogebra.file",29,"ggb"},
+    {0,0,0},
+    {0,0,0},
+    {"video/vnd.ms-playready.media.pyv",32,"pyv"},
+    {0,0,0},
+    {"application/vnd.dolby.mlp",25,"mlp"},
+    {"application/vnd.wap.wmlscriptc",30,"wmlsc"},
+    {"application/mac-compactpro",26,"cpt"},
+    {0,0,0},
+    {"text/vnd.wap.wmlscript",22,"wmls"},
+    {"application/vnd.airzip.filesecure.azs",37,"azs"},
+    {0,0,0},
+    {"application/vnd.yamaha.hv-dic",29,"hvd"},
+    {0,0,0},
+    {"application/x-font-otf",22,"otf"},
+    {"application/yin+xml",19,"yin"},
+    {0,0,0},
+    {"application/sdp",15,"sdp"},
+    {"application/rtf",15,"rtf"},
+    {"application/vnd.spotfire.sfs",28,"sfs"},
+    {"audio/x-aac",11,"aac"},
+    {"text/uri-list",13,"urls"},
+    {0,0,0},
+    {"application/vnd.rn-realmedia",28,"rm"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.immervision-ivu",31,"ivu"},
+    {"application/rss+xml",19,"rss"},
+    {"application/vnd.wolfram.player",30,"nbp"},
+    {0,0,0},
+    {"application/vnd.commonspace",27,"csp"},
+    {"application/vnd.frogans.ltf",27,"ltf"},
+    {0,0,0},
+    {"application/vnd.geogebra.tool",29,"ggt"},
+    {"application/x-7z-compressed",27,"7z"},
+    {"application/scvp-vp-response",28,"spp"},
+    {"application/vnd.oasis.opendocument.formula-template",51,"odft"},
+    {"video/vnd.mpegurl",17,"m4u"},
+    {0,0,0},
+    {"application/sbml+xml",20,"sbml"},
+    {"application/vnd.crick.clicker.wordbank",38,"clkw"},
+    {"application/vnd.cluetrust.cartomobile-config-pkg",48,"c11amz"},
+    {"video/x-m4v",11,"m4v"},
+    {0,0,0},
+    {"image/x-rgb",11,"rgb"},
+    {"application/vnd.stardivision.calc",33,"sdc"},
+    {"audio/x-ms-wax",14,"wax"},
+    {"chemical/x-cif",14,"cif"},
+    {"video/h264",10,"h264"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.americandynamics.acc",36,"acc"},
+    {"application/vnd.eszigno3+xml",28,"es3"},
+    {"application/pdf",15,"pdf"},
+    {0,0,0},
+    {"application/vnd.jam",19,"jam"},
+    {"application/vnd.rim.cod",23,"cod"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"image/x-portable-graymap",24,"pgm"},
+    {"application/x-ms-wmz",20,"wmz"},
+    {"application/vnd.sun.xml.writer",30,"sxw"},
+    {0,0,0},
+    {"application/x-netcdf",20,"nc"},
+    {"application/vnd.intercon.formnet",32,"xpw"},
+    {"application/vnd.mozilla.xul+xml",31,"xul"},
+    {"image/x-portable-anymap",23,"pnm"},
+    {"application/dssc+xml",20,"xdssc"},
+    {"application/vnd.ms-excel.addin.macroenabled.12",46,"xlam"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"video/x-f4v",11,"f4v"},
+    {"application/vnd.oasis.opendocument.text",39,"odt"},
+    {"image/vnd.net-fpx",17,"npx"},
+    {"application/vnd.jisp",20,"jisp"},
+    {"image/vnd.wap.wbmp",18,"wbmp"},
+    {0,0,0},
+    {"application/vnd.lotus-screencam",31,"scm"},
+    {0,0,0},
+    {"application/vnd.smart.teacher",29,"teacher"},
+    {"application/pkcs8",17,"p8"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.grafeq",22,"gqf"},
+    {0,0,0},
+    {"application/mads+xml",20,"mads"},
+    {"application/vnd.koan",20,"skp"},
+    {"application/x-doom",18,"wad"},
+    {"application/prs.cww",19,"cww"},
+    {"application/vnd.lotus-approach",30,"apr"},
+    {0,0,0},
+    {"application/vnd.micrografx.igx",30,"igx"},
+    {0,0,0},
+    {"application/cdmi-object",23,"cdmio"},
+    {"application/set-registration-initiation",39,"setreg"},
+    {"application/vnd.openxmlformats-officedocument.presentationml.slideshow",70,"ppsx"},
+    {0,0,0},
+    {"audio/x-wav",11,"wav"},
+    {"application/x-latex",19,"latex"},
+    {"text/richtext",13,"rtx"},
+    {"video/x-sgi-movie",17,"movie"},
+    {0,0,0},
+    {0,0,0},
+    {"image/x-pict",12,"pict"},
+    {"application/vnd.oasis.opendocument.graphics",43,"odg"},
+    {"image/cgm",9,"cgm"},
+    {0,0,0},
+    {"model/vrml",10,"vrml"},
+    {0,0,0},
+    {"application/atomcat+xml",23,"atomcat"},
+    {"application/java-vm",19,"class"},
+    {0,0,0},
+    {0,0,0},
+    {"text/prs.lines.tag",18,"dsc"},
+    {"application/vnd.sun.xml.calc.template",37,"stc"},
+    {"application/x-silverlight-app",29,"xap"},
+    {0,0,0},
+    {"image/x-portable-pixmap",23,"ppm"},
+    {"application/vnd.sailingtracker.track",36,"st"},
+    {"image/vnd.ms-modi",17,"mdi"},
+    {"application/vnd.hp-pcl",22,"pcl"},
+    {"video/vnd.dece.hd",17,"uvvh"},
+    {0,0,0},
+    {"application/rdf+xml",19,"rdf"},
+    {"video/x-ms-wvx",14,"wvx"},
+    {"application/applixware",22,"aw"},
+    {"application/vnd.medcalcdata",27,"mc1"},
+    {"application/mbox",16,"mbox"},
+    {"text/vnd.curl.mcurl",19,"mcurl"},
+    {"image/gif",9,"gif"},
+    {"application/x-chat",18,"chat"},
+    {"application/vnd.genomatix.tuxedo",32,"txd"},
+    {"image/g3fax",11,"g3"},
+    {"application/x-gtar",18,"gtar"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"image/vnd.djvu",14,"djvu"},
+    {"application/resource-lists+xml",30,"rl"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/x-stuffit",21,"sit"},
+    {"application/vnd.oasis.opendocument.database",43,"odb"},
+    {"application/vnd.dynageo",23,"geo"},
+    {0,0,0},
+    {"application/vnd.intu.qfx",24,"qfx"},
+    {0,0,0},
+    {"application/vnd.businessobjects",31,"rep"},
+    {0,0,0},
+    {"application/vnd.pawaafile",25,"paw"},
+    {"model/vnd.gtw",13,"gtw"},
+    {0,0,0},
+    {"application/hyperstudio",23,"stk"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.pvi.ptid1",25,"ptid"},
+    {0,0,0},
+    {"video/x-ms-asf",14,"asf"},
+    {"application/vnd.nokia.n-gage.data",33,"ngdat"},
+    {"audio/vnd.ms-playready.media.pya",32,"pya"},
+    {"application/scvp-cv-response",28,"scs"},
+    {"application/x-font-type1",24,"afm"},
+    {0,0,0},
+    {"text/vnd.fmi.flexstor",21,"flx"},
+    {"application/xspf+xml",20,"xspf"},
+    {"application/mathematica",23,"mb"},
+    {"application/x-hdf",17,"hdf"},
+    {"application/vnd.ms-officetheme",30,"thmx"},
+    {"application/vnd.smaf",20,"mmf"},
+    {"application/oda",15,"oda"},
+    {"application/smil+xml",20,"smil"},
+    {"application/vnd.kde.kchart",26,"chrt"},
+    {"application/set-payment-initiation",34,"setpay"},
+    {"text/css",8,"css"},
+    {0,0,0},
+    {"application/vnd.sun.xml.writer.template",39,"stw"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.syncml.dm+xml",29,"xdm"},
+    {"application/x-wais-source",25,"src"},
+    {"application/java-serialized-object",34,"ser"},
+    {"application/scvp-vp-request",27,"spq"},
+    {"application/vnd.fujixerox.ddd",29,"ddd"},
+    {"application/vnd.ms-works",24,"wps"},
+    {"application/vnd.dna",19,"dna"},
+    {"application/vnd.ms-excel.sheet.macroenabled.12",46,"xlsm"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.ms-powerpoint.slideshow.macroenabled.12",55,"ppsm"},
+    {0,0,0},
+    {"text/x-java-source",18,"java"},
+    {"application/vnd.yamaha.hv-script",32,"hvs"},
+    {"application/vnd.oasis.opendocument.text-master",46,"odm"},
+    {"application/vnd.ecowin.chart",28,"mag"},
+    {"application/scvp-cv-request",27,"scq"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.kodak-descriptor",32,"sse"},
+    {"application/vnd.epson.ssf",25,"ssf"},
+    {0,0,0},
+    {"application/x-font-snf",22,"snf"},
+    {"model/vnd.collada+xml",21,"dae"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.oasis.opendocument.text-web",43,"oth"},
+    {0,0,0},
+    {"application/x-cdlink",20,"vcd"},
+    {"application/x-font-pcf",22,"pcf"},
+    {"application/xenc+xml",20,"xenc"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.is-xpr",22,"xpr"},
+    {"application/vnd.oasis.opendocument.presentation-template",56,"otp"},
+    {0,0,0},
+    {"application/vnd.spotfire.dxp",28,"dxp"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"image/x-cmu-raster",18,"ras"},
+    {"application/vnd.fluxtime.clip",29,"ftc"},
+    {"application/vnd.route66.link66+xml",34,"link66"},
+    {"application/vnd.openxmlformats-officedocument.presentationml.slide",66,"sldx"},
+    {0,0,0},
+    {"application/vnd.sun.xml.calc",28,"sxc"},
+    {"application/pkix-attr-cert",26,"ac"},
+    {0,0,0},
+    {"application/x-shockwave-flash",29,"swf"},
+    {"text/x-vcalendar",16,"vcs"},
+    {0,0,0},
+    {"application/json",16,"json"},
+    {"application/vnd.dvb.service",27,"svc"},
+    {"application/vnd.rig.cryptonote",30,"cryptonote"},
+    {0,0,0},
+    {0,0,0},
+    {"application/pgp-signature",25,"asc"},
+    {"application/tei+xml",19,"teicorpus"},
+    {0,0,0},
+    {"application/vnd.powerbuilder6",29,"pbd"},
+    {"application/vnd.hzn-3d-crossword",32,"x3d"},
+    {"application/thraud+xml",22,"tfi"},
+    {0,0,0},
+    {"text/x-c",8,"c"},
+    {"application/vnd.chipnuts.karaoke-mmd",36,"mmd"},
+    {"application/pskc+xml",20,"pskcxml"},
+    {0,0,0},
+    {"application/vnd.wordperfect",27,"wpd"},
+    {"application/vnd.igloader",24,"igl"},
+    {"application/ipfix",17,"ipfix"},
+    {"application/x-msmetafile",24,"wmf"},
+    {0,0,0},
+    {"application/vnd.lotus-notes",27,"nsf"},
+    {"application/vnd.groove-help",27,"ghf"},
+    {"text/vnd.curl",13,"curl"},
+    {"application/vnd.mseq",20,"mseq"},
+    {"image/prs.btif",14,"btif"},
+    {"application/vnd.adobe.fxp",25,"fxp"},
+    {0,0,0},
+    {"video/ogg",9,"ogv"},
+    {"application/vnd.visio",21,"vsd"},
+    {"image/x-quicktime",17,"qtif"},
+    {0,0,0},
+    {"application/vnd.sun.xml.impress.template",40,"sti"},
+    {"application/vnd.neurolanguage.nlu",33,"nlu"},
+    {"text/vnd.wap.wml",16,"wml"},
+    {"application/vnd.tao.intent-module-archive",41,"tao"},
+    {"application/vnd.mobius.mbk",26,"mbk"},
+    {0,0,0},
+    {"application/mods+xml",20,"mods"},
+    {"image/vnd.dxf",13,"dxf"},
+    {0,0,0},
+    {"image/vnd.fastbidsheet",22,"fbs"},
+    {"video/x-ms-wmv",14,"wmv"},
+    {"application/vnd.hp-pclxl",24,"pclxl"},
+    {"application/xop+xml",19,"xop"},
+    {0,0,0},
+    {"application/zip",15,"zip"},
+    {0,0,0},
+    {"application/mxf",15,"mxf"},
+    {"text/x-vcard",12,"vcf"},
+    {0,0,0},
+    {"application/vnd.oasis.opendocument.spreadsheet-template",55,"ots"},
+    {0,0,0},
+    {0,0,0},
+    {"audio/x-pn-realaudio-plugin",27,"rmp"},
+    {"application/vnd.noblenet-sealer",31,"nns"},
+    {"application/vnd.lotus-freelance",31,"pre"},
+    {"application/vnd.3gpp.pic-bw-small",33,"psb"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.epson.msf",25,"msf"},
+    {0,0,0},
+    {0,0,0},
+    {"application/javascript",22,"js"},
+    {"application/x-ms-application",28,"application"},
+    {0,0,0},
+    {"audio/x-mpegurl",15,"m3u"},
+    {"application/srgs",16,"gram"},
+    {0,0,0},
+    {"application/vnd.geonext",23,"gxt"},
+    {"application/timestamped-data",28,"tsd"},
+    {0,0,0},
+    {"text/tab-separated-values",25,"tsv"},
+    {"application/vnd.lotus-1-2-3",27,"123"},
+    {"video/mpeg",10,"mpg"},
+    {0,0,0},
+    {"application/vnd.xara",20,"xar"},
+    {"text/x-asm",10,"asm"},
+    {"application/x-tex",17,"tex"},
+    {"application/vnd.insors.igm",26,"igm"},
+    {"chemical/x-cmdf",15,"cmdf"},
+    {"application/vnd.fujitsu.oasys2",30,"oa2"},
+    {0,0,0},
+    {"application/x-sv4crc",20,"sv4crc"},
+    {"application/x-csh",17,"csh"},
+    {"application/vnd.nokia.radio-preset",34,"rpst"},
+    {0,0,0},
+    {"application/vnd.airzip.filesecure.azf",37,"azf"},
+    {"video/x-ms-wmx",14,"wmx"},
+    {0,0,0},
+    {"application/x-tex-tfm",21,"tfm"},
+    {"application/vnd.quark.quarkxpress",33,"qxd"},
+    {"application/vnd.curl.car",24,"car"},
+    {"application/vnd.groove-identity-message",39,"gim"},
+    {0,0,0},
+    {"application/metalink4+xml",25,"meta4"},
+    {"application/vnd.oasis.opendocument.chart",40,"odc"},
+    {"application/atomsvc+xml",23,"atomsvc"},
+    {"application/vnd.adobe.xdp+xml",29,"xdp"},
+    {"application/vnd.solent.sdkm+xml",31,"sdkm"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.acucorp",23,"atc"},
+    {"application/vnd.ahead.space",27,"ahead"},
+    {"application/vnd.sun.xml.writer.global",37,"sxg"},
+    {"application/vnd.oasis.opendocument.formula",42,"odf"},
+    {"image/vnd.fujixerox.edmics-rlc",30,"rlc"},
+    {"application/vnd.irepository.package+xml",39,"irp"},
+    {0,0,0},
+    {"image/webp",10,"webp"},
+    {"application/vnd.sun.xml.math",28,"sxm"},
+    {"application/ogg",15,"ogx"},
+    {"application/vnd.lotus-organizer",31,"org"},
+    {"video/jpm",9,"jpm"},
+    {"application/vnd.immervision-ivp",31,"ivp"},
+    {"application/sparql-query",24,"rq"},
+    {"application/vnd.hal+xml",23,"hal"},
+    {0,0,0},
+    {"application/vnd.kde.kivio",25,"flw"},
+    {"text/troff",10,"roff"},
+    {"application/vnd.fujixerox.docuworks",35,"xdw"},
+    {"application/vnd.apple.installer+xml",35,"mpkg"},
+    {"application/vnd.wt.stf",22,"stf"},
+    {"text/x-uuencode",15,"uu"},
+    {0,0,0},
+    {"application/vnd.cups-ppd",24,"ppd"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.chemdraw+xml",28,"cdxml"},
+    {"application/patch-ops-error+xml",31,"xer"},
+    {"application/vnd.joost.joda-archive",34,"joda"},
+    {"application/x-cpio",18,"cpio"},
+    {"application/vnd.fujitsu.oasysgp",31,"fg5"},
+    {0,0,0},
+    {"application/vnd.frogans.fnc",27,"fnc"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.accpac.simply.aso",33,"aso"},
+    {0,0,0},
+    {"image/vnd.xiff",14,"xif"},
+    {0,0,0},
+    {"application/vnd.sus-calendar",28,"sus"},
+    {"application/vnd.lotus-wordpro",29,"lwp"},
+    {"application/vnd.ms-xpsdocument",30,"xps"},
+    {"application/x-ace-compressed",28,"ace"},
+    {0,0,0},
+    {"application/vnd.simtech-mindmapper",34,"twd"},
+    {"application/vnd.unity",21,"unityweb"},
+    {"image/vnd.dece.graphic",22,"uvi"},
+    {"application/vnd.epson.salt",26,"slt"},
+    {"application/vnd.olpc-sugar",26,"xo"},
+    {"application/pics-rules",22,"prf"},
+    {"x-conference/x-cooltalk",23,"ice"},
+    {"image/vnd.fst",13,"fst"},
+    {0,0,0},
+    {"application/srgs+xml",20,"grxml"},
+    {"application/mets+xml",20,"mets"},
+    {0,0,0},
+    {"application/vnd.pg.format",25,"str"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/mp4",15,"mp4s"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.oasis.opendocument.image-template",49,"oti"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.mophun.application",34,"mpn"},
+    {"text/turtle",11,"ttl"},
+    {"application/x-mobipocket-ebook",30,"mobi"},
+    {0,0,0},
+    {"application/vnd.kahootz",23,"ktz"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.publishare-delta-tree",37,"qps"},
+    {"application/x-authorware-seg",28,"aas"},
+    {"application/x-msmediaview",25,"mvb"},
+    {"application/vnd.novadigm.edm",28,"edm"},
+    {"application/vnd.fdsn.seed",25,"seed"},
+    {"application/vnd.webturbo",24,"wtb"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.ezpix-package",29,"ez3"},
+    {0,0,0},
+    {"application/vnd.mobius.dis",26,"dis"},
+    {"application/vnd.realvnc.bed",27,"bed"},
+    {"application/atom+xml",20,"atom"},
+    {"application/vnd.contact.cmsg",28,"cdbcmsg"},
+    {"application/vnd.ipunplugged.rcprofile",37,"rcprofile"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.kenameaapp",26,"htke"},
+    {"image/x-icon",12,"ico"},
+    {0,0,0},
+    {"application/vnd.ufdl",20,"ufdl"},
+    {0,0,0},
+    {"application/andrew-inset",24,"ez"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.audiograph",26,"aep"},
+    {"application/x-texinfo",21,"texi"},
+    {"application/x-xfig",18,"fig"},
+    {0,0,0},
+    {"application/vnd.stardivision.math",33,"smf"},
+    {"application/vnd.mediastation.cdkey",34,"cdkey"},
+    {"application/vnd.crick.clicker.palette",37,"clkp"},
+    {"application/vnd.stardivision.draw",33,"sda"},
+    {"application/vnd.mfer",20,"mwf"},
+    {"application/pkcs10",18,"p10"},
+    {"application/x-font-linux-psf",28,"psf"},
+    {0,0,0},
+    {"application/vnd.yamaha.openscoreformat",38,"osf"},
+    {"application/vnd.ms-powerpoint.presentation.macroenabled.12",58,"pptm"},
+    {0,0,0},
+    {"application/vnd.vcx",19,"vcx"},
+    {"text/cache-manifest",19,"manifest"},
+    {"application/font-tdpfr",22,"pfr"},
+    {"application/vnd.oasis.opendocument.image",40,"odi"},
+    {"application/vnd.handheld-entertainment+xml",42,"zmm"},
+    {0,0,0},
+    {"application/vnd.stardivision.writer-global",42,"sgl"},
+    {0,0,0},
+    {"model/mesh",10,"mesh"},
+    {"application/vnd.syncml+xml",26,"xsm"},
+    {"audio/vnd.dts.hd",16,"dtshd"},
+    {"application/vnd.fuzzysheet",26,"fzs"},
+    {"message/rfc822",14,"eml"},
+    {"application/vnd.openxmlformats-officedocument.presentationml.presentation",73,"pptx"},
+    {"text/vnd.sun.j2me.app-descriptor",32,"jad"},
+    {"application/vnd.picsel",22,"efif"},
+    {0,0,0},
+    {"application/vnd.anser-web-certificate-issue-initiation",54,"cii"},
+    {"application/vnd.oasis.opendocument.chart-template",49,"otc"},
+    {"application/vnd.nokia.radio-presets",35,"rpss"},
+    {"application/vnd.ctc-posml",25,"pml"},
+    {"text/x-pascal",13,"pas"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.geometry-explorer",33,"gex"},
+    {"application/pkix-crl",20,"crl"},
+    {0,0,0},
+    {"application/x-sv4cpio",21,"sv4cpio"},
+    {0,0,0},
+    {0,0,0},
+    {"application/pkcs7-mime",22,"p7m"},
+    {"application/msword",18,"doc"},
+    {"image/x-xpixmap",15,"xpm"},
+    {0,0,0},
+    {"application/x-msterminal",24,"trm"},
+    {"audio/ogg",9,"ogg"},
+    {"application/vnd.uiq.theme",25,"utz"},
+    {"application/vnd.stepmania.stepchart",35,"sm"},
+    {"application/vnd.wqd",19,"wqd"},
+    {0,0,0},
+    {"application/vnd.ms-fontobject",29,"eot"},
+    {0,0,0},
+    {"image/x-xbitmap",15,"xbm"},
+    {"application/vnd.svd",19,"svd"},
+    {0,0,0},
+    {"video/vnd.vivo",14,"viv"},
+    {"application/vnd.gmx",19,"gmx"},
+    {0,0,0},
+    {"application/vnd.google-earth.kml+xml",36,"kml"},
+    {"application/x-bzip2",19,"bz2"},
+    {0,0,0},
+    {"application/vnd.ms-powerpoint.addin.macroenabled.12",51,"ppam"},
+    {"application/x-dvi",17,"dvi"},
+    {0,0,0},
+    {"image/jp2",9,"jp2"},
+    {"application/vnd.antix.game-component",36,"atx"},
+    {0,0,0},
+    {"application/x-java-jnlp-file",28,"jnlp"},
+    {0,0,0},
+    {"application/xslt+xml",20,"xslt"},
+    {"application/vnd.xfdl",20,"xfdl"},
+    {0,0,0},
+    {0,0,0},
+    {"image/x-macpaint",16,"pntg"},
+    {"application/sparql-results+xml",30,"srx"},
+    {"video/vnd.dece.mobile",21,"uvvm"},
+    {"application/ecmascript",22,"ecma"},
+    {"application/vnd.3gpp.pic-bw-var",31,"pvb"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"audio/vnd.nuera.ecelp9600",25,"ecelp9600"},
+    {"application/x-director",22,"dir"},
+    {"application/x-bcpio",19,"bcpio"},
+    {"application/vnd.mobius.mqy",26,"mqy"},
+    {"audio/basic",11,"au"},
+    {0,0,0},
+    {"application/vnd.muvee.style",27,"msty"},
+    {0,0,0},
+    {"application/vnd.cosmocaller",27,"cmc"},
+    {"application/vnd.ibm.modcap",26,"afp"},
+    {0,0,0},
+    {"video/jpeg",10,"jpgv"},
+    {0,0,0},
+    {0,0,0},
+    {"application/x-gnumeric",22,"gnumeric"},
+    {"application/vnd.claymore",24,"cla"},
+    {"application/xhtml+xml",21,"xhtml"},
+    {0,0,0},
+    {"application/vnd.geoplan",23,"g2w"},
+    {"video/quicktime",15,"mov"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"video/x-dv",10,"dv"},
+    {"audio/x-pn-realaudio",20,"ram"},
+    {"text/vnd.curl.scurl",19,"scurl"},
+    {"application/xcap-diff+xml",25,"xdf"},
+    {0,0,0},
+    {"application/vnd.ms-word.template.macroenabled.12",48,"dotm"},
+    {"text/vnd.graphviz",17,"gv"},
+    {"image/vnd.fujixerox.edmics-mmr",30,"mmr"},
+    {"application/vnd.amiga.ami",25,"ami"},
+    {0,0,0},
+    {"image/bmp",9,"bmp"},
+    {0,0,0},
+    {"application/vnd.sun.xml.draw.template",37,"std"},
+    {0,0,0},
+    {"application/dssc+der",20,"dssc"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.acucobol",24,"acu"},
+    {0,0,0},
+    {0,0,0},
+    {"application/x-font-bdf",22,"bdf"},
+    {0,0,0},
+    {"application/vnd.fujitsu.oasys",29,"oas"},
+    {"application/vnd.clonk.c4group",29,"c4g"},
+    {0,0,0},
+    {"application/vnd.sun.xml.impress",31,"sxi"},
+    {"application/vnd.ms-powerpoint.template.macroenabled.12",54,"potm"},
+    {0,0,0},
+    {"application/vnd.hbci",20,"hbci"},
+    {"application/vnd.tmobile-livetv",30,"tmo"},
+    {"application/vnd.openofficeorg.extension",39,"oxt"},
+    {"application/vnd.las.las+xml",27,"lasxml"},
+    {0,0,0},
+    {"image/vnd.dwg",13,"dwg"},
+    {"application/davmount+xml",24,"davmount"},
+    {"application/vnd.mif",19,"mif"},
+    {"application/vnd.groove-injector",31,"grv"},
+    {"video/x-msvideo",15,"avi"},
+    {"application/vnd.ms-htmlhelp",27,"chm"},
+    {0,0,0},
+    {"application/vnd.seemail",23,"see"},
+    {"application/lost+xml",20,"lostxml"},
+    {"application/vnd.oasis.opendocument.graphics-template",52,"otg"},
+    {"image/x-pcx",11,"pcx"},
+    {"application/vnd.pocketlearn",27,"plf"},
+    {"application/vnd.hp-hps",22,"hps"},
+    {0,0,0},
+    {"image/x-xwindowdump",19,"xwd"},
+    {"application/vnd.ms-word.document.macroenabled.12",48,"docm"},
+    {0,0,0},
+    {"application/vnd.semf",20,"semf"},
+    {"application/vnd.hp-hpgl",23,"hpgl"},
+    {"application/vnd.mobius.daf",26,"daf"},
+    {"application/cdmi-capability",27,"cdmia"},
+    {"application/cdmi-domain",23,"cdmid"},
+    {"audio/vnd.dece.audio",20,"uvva"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"audio/mp4a-latm",15,"m4a"},
+    {"application/vnd.trid.tpt",24,"tpt"},
+    {"application/oebps-package+xml",29,"opf"},
+    {0,0,0},
+    {0,0,0},
+    {"application/widget",18,"wgt"},
+    {"application/mp21",16,"mp21"},
+    {0,0,0},
+    {"application/x-mswrite",21,"wri"},
+    {"video/vnd.uvvu.mp4",18,"uvvu"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.kde.karbon",26,"karbon"},
+    {"application/cdmi-container",26,"cdmic"},
+    {"application/emma+xml",20,"emma"},
+    {0,0,0},
+    {0,0,0},
+    {"video/h261",10,"h261"},
+    {"application/vnd.blueice.multipass",33,"mpm"},
+    {"application/vnd.nokia.n-gage.symbian.install",44,"n-gage"},
+    {"application/x-xpinstall",23,"xpi"},
+    {"application/ccxml+xml",21,"ccxml"},
+    {"application/vnd.ms-lrm",22,"lrm"},
+    {"application/x-dtbook+xml",24,"dtb"},
+    {"application/vnd.oasis.opendocument.spreadsheet",46,"ods"},
+    {"application/x-tcl",17,"tcl"},
+    {"model/vnd.dwf",13,"dwf"},
+    {0,0,0},
+    {"audio/vnd.nuera.ecelp7470",25,"ecelp7470"},
+    {0,0,0},
+    {"application/vnd.cluetrust.cartomobile-config",44,"c11amc"},
+    {"text/csv",8,"csv"},
+    {0,0,0},
+    {"audio/vnd.nuera.ecelp4800",25,"ecelp4800"},
+    {"application/vnd.accpac.simply.imp",33,"imp"},
+    {"application/vnd.ms-cab-compressed",33,"cab"},
+    {"application/vnd.android.package-archive",39,"apk"},
+    {"application/x-pkcs7-certificates",32,"p7b"},
+    {"application/vnd.visionary",25,"vis"},
+    {"application/vnd.sun.xml.draw",28,"sxd"},
+    {"application/vnd.ibm.secure-container",36,"sc"},
+    {"application/x-chess-pgn",23,"pgn"},
+    {"application/vnd.ibm.rights-management",37,"irm"},
+    {"application/mac-binhex40",24,"hqx"},
+    {"application/vnd.jcp.javame.midlet-rms",37,"rms"},
+    {0,0,0},
+    {"application/x-mpegurl",21,"m3u8"},
+    {0,0,0},
+    {"application/vnd.oma.dd2+xml",27,"dd2"},
+    {0,0,0},
+    {"video/3gpp",10,"3gp"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.dreamfactory",28,"dfac"},
+    {"video/vnd.dece.pd",17,"uvvp"},
+    {"application/vnd.novadigm.edx",28,"edx"},
+    {0,0,0},
+    {"application/vnd.dvb.ait",23,"ait"},
+    {"video/3gpp2",11,"3g2"},
+    {0,0,0},
+    {"application/x-dtbresource+xml",29,"res"},
+    {"application/pkcs7-signature",27,"p7s"},
+    {"application/x-debian-package",28,"deb"},
+    {"application/vnd.wap.wbxml",25,"wbxml"},
+    {"application/vnd.micrografx.flo",30,"flo"},
+    {0,0,0},
+    {"application/vnd.amazon.ebook",28,"azw"},
+    {"application/vnd.anser-web-funds-transfer-initiation",51,"fti"},
+    {"application/vnd.geospace",24,"g3w"},
+    {0,0,0},
+    {"application/vnd.flographit",26,"gph"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.macports.portpkg",32,"portpkg"},
+    {"application/vnd.osgi.dp",23,"dp"},
+    {"application/x-authorware-map",28,"aam"},
+    {"application/vnd.ms-excel.sheet.binary.macroenabled.12",53,"xlsb"},
+    {0,0,0},
+    {"application/vnd.musician",24,"mus"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.openxmlformats-officedocument.spreadsheetml.sheet",65,"xlsx"},
+    {"application/x-mscardfile",24,"crd"},
+    {"image/x-freehand",16,"fh"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"audio/vnd.dts",13,"dts"},
+    {"application/resource-lists-diff+xml",35,"rld"},
+    {"application/mathml+xml",22,"mathml"},
+    {"audio/x-ms-wma",14,"wma"},
+    {"application/xv+xml",18,"xvml"},
+    {"model/vnd.gdl",13,"gdl"},
+    {0,0,0},
+    {"application/vnd.fujixerox.docuworks.binder",42,"xbd"},
+    {"application/postscript",22,"ps"},
+    {"application/vnd.google-earth.kmz",32,"kmz"},
+    {"application/vnd.groove-tool-template",36,"tpl"},
+    {"video/mp4",9,"m4v"},
+    {0,0,0},
+    {"application/vnd.syncml.dm+wbxml",31,"bdm"},
+    {"video/webm",10,"webm"},
+    {0,0,0},
+    {"application/vnd.crick.clicker.template",38,"clkt"},
+    {"application/vnd.hp-jlyt",23,"jlt"},
+    {"application/vnd.ms-pki.stl",26,"stl"},
+    {"application/x-msaccess",22,"mdb"},
+    {0,0,0},
+    {"application/vnd.kde.kspread",27,"ksp"},
+    {"application/rls-services+xml",28,"rs"},
+    {"text/vnd.curl.dcurl",19,"dcurl"},
+    {"application/vnd.ibm.minipay",27,"mpy"},
+    {"application/vnd.3gpp.pic-bw-large",33,"plb"},
+    {"application/x-abiword",21,"abw"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.epson.quickanime",32,"qam"},
+    {"application/pls+xml",19,"pls"},
+    {0,0,0},
+    {"application/xml",15,"xml"},
+    {"application/vnd.yellowriver-custom-menu",39,"cmp"},
+    {"application/pkix-pkipath",24,"pkipath"},
+    {"application/vnd.ms-powerpoint.slide.macroenabled.12",51,"sldm"},
+    {"application/vnd.crick.clicker",29,"clkx"},
+    {"application/vnd.ms-ims",22,"ims"},
+    {"application/x-ms-wmd",20,"wmd"},
+    {"image/ktx",9,"ktx"},
+    {"application/vnd.groove-account",30,"gac"},
+    {"application/x-bittorrent",24,"torrent"},
+    {"application/x-pkcs7-certreqresp",31,"p7r"},
+    {"application/x-mspublisher",25,"pub"},
+    {"audio/midi",10,"mid"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.openxmlformats-officedocument.presentationml.template",69,"potx"},
+    {"application/vnd.3m.post-it-notes",32,"pwn"},
+    {"application/wspolicy+xml",24,"wspolicy"},
+    {0,0,0},
+    {"application/vnd.apple.mpegurl",29,"m3u8"},
+    {"application/vnd.crick.clicker.keyboard",38,"clkk"},
+    {"video/x-ms-wm",13,"wm"},
+    {0,0,0},
+    {"application/xml-dtd",19,"dtd"},
+    {"application/vnd.yamaha.openscoreformat.osfpvg+xml",49,"osfpvg"},
+    {0,0,0},
+    {"video/x-fli",11,"fli"},
+    {"application/vnd.ms-wpl",22,"wpl"},
+    {"application/onenote",19,"onetoc"},
+    {"application/vnd.yamaha.smaf-audio",33,"saf"},
+    {0,0,0},
+    {"audio/x-aiff",12,"aiff"},
+    {"application/cu-seeme",20,"cu"},
+    {"application/vnd.intu.qbo",24,"qbo"},
+    {"model/iges",10,"iges"},
+    {"image/tiff",10,"tiff"},
+    {"audio/webm",10,"weba"},
+    {0,0,0},
+    {"application/epub+zip",20,"epub"},
+    {"application/vnd.kde.kformula",28,"kfo"},
+    {0,0,0},
+    {"application/vnd.umajin",22,"umj"},
+    {"application/x-msbinder",22,"obd"},
+    {"application/vnd.enliven",23,"nml"},
+    {"application/vnd.recordare.musicxml",34,"mxl"},
+    {"video/vnd.dece.video",20,"uvvv"},
+    {"text/plain",10,"txt"},
+    {0,0,0},
+    {"application/relax-ng-compact-syntax",35,"rnc"},
+    {0,0,0},
+    {0,0,0},
+    {"audio/vnd.lucent.voice",22,"lvp"},
+    {"application/sru+xml",19,"sru"},
+    {"application/vnd.kde.kword",25,"kwd"},
+    {0,0,0},
+    {"application/x-font-woff",23,"woff"},
+    {0,0,0},
+    {0,0,0},
+    {"video/h263",10,"h263"},
+    {"application/vnd.denovo.fcselayout-link",38,"fe_launch"},
+    {"application/pkixcmp",19,"pki"},
+    {"application/vnd.mobius.msl",26,"msl"},
+    {0,0,0},
+    {"image/vnd.adobe.photoshop",25,"psd"},
+    {0,0,0},
+    {"application/marc",16,"mrc"},
+    {0,0,0},
+    {"application/vnd.mobius.txf",26,"txf"},
+    {"application/vnd.fujitsu.oasysprs",32,"bh2"},
+    {"application/x-rar-compressed",28,"rar"},
+    {"application/vnd.ms-artgalry",27,"cil"},
+    {"application/x-x509-ca-cert",26,"crt"},
+    {"application/vnd.cloanto.rp9",27,"rp9"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.3gpp2.tcap",26,"tcap"},
+    {"text/vnd.fly",12,"fly"},
+    {"application/vnd.kde.kpresenter",30,"kpr"},
+    {"application/vnd.adobe.xfdf",26,"xfdf"},
+    {"application/shf+xml",19,"shf"},
+    {"application/vnd.openxmlformats-officedocument.spreadsheetml.template",68,"xltx"},
+    {"video/mp2t",10,"ts"},
+    {0,0,0},
+    {"application/pgp-encrypted",25,"pgp"},
+    {"application/vnd.wap.wmlc",24,"wmlc"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/x-ms-xbap",21,"xbap"},
+    {"application/vnd.vsf",19,"vsf"},
+    {"application/x-sh",16,"sh"},
+    {"application/x-dtbncx+xml",24,"ncx"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.osgeo.mapguide.package",38,"mgp"},
+    {"audio/vnd.digital-winds",23,"eol"},
+    {"application/vnd.shana.informed.interchange",42,"iif"},
+    {"application/vnd.mobius.plc",26,"plc"},
+    {"application/yang",16,"yang"},
+    {"application/vnd.shana.informed.formdata",39,"ifm"},
+    {"text/sgml",9,"sgml"},
+    {"application/vnd.zzazz.deck+xml",30,"zaz"},
+    {0,0,0},
+    {"chemical/x-cdx",14,"cdx"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.stardivision.writer",35,"sdw"},
+    {"application/vnd.noblenet-directory",34,"nnd"},
+    {"video/vnd.fvt",13,"fvt"},
+    {"application/vnd.mophun.certificate",34,"mpc"},
+    {"text/vnd.in3d.spot",18,"spot"},
+    {"application/vnd.triscape.mxs",28,"mxs"},
+    {"application/vnd.openxmlformats-officedocument.wordprocessingml.template",71,"dotx"},
+    {0,0,0},
+    {"application/vnd.llamagraphics.life-balance.desktop",50,"lbd"},
+    {"application/vnd.symbian.install",31,"sis"},
+    {0,0,0},
+    {"chemical/x-cml",14,"cml"},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {0,0,0},
+    {"application/x-futuresplash",26,"spl"},
+    {"application/reginfo+xml",23,"rif"},
+    {0,0,0},
+    {"text/html",9,"html"},
+    {0,0,0},
+    {0,0,0},
+    {"application/vnd.shana.informed.formtemplate",43,"itp"},
+    {"text/n3",7,"n3"},
+    {"application/vnd.intergeo",24,"i2g"},
+    {"application/vnd.criticaltools.wbs+xml",37,"wbs"},
+};
@@ -1,12 +1,45 @@
 /*
  * pcap_writer.h:
- * 
+ *
  * A class for writing pcap files
+ *
+ * Classic pcap files are always written in host byte order, with
+ * microsecond or nanosecond timestamps. When the packets come from a
+ * pcapng file, the output is pcapng as well: the section header and
+ * interface description blocks of the input are copied unchanged, so
+ * interface names, descriptions and timestamp resolutions are kept,
+ * and each packet is written as an enhanced packet block in the byte
+ * order and timestamp units of the input.
+ *
+ * libpcap does not tell us which interface a packet arrived on, so
+ * every enhanced packet block names interface 0.
+ *
+ * Output goes through a large stdio buffer, and each record header is
+ * built in memory and written with a single call. The output can be
+ * rotated after a number of bytes or seconds of capture time, and can
+ * be split into one file per protocol (see pcap_writer::options).
+ * Every file that is opened starts with the same header.
  */
 
 #ifndef HAVE_PCAP_WRITER_H
 #define HAVE_PCAP_WRITER_H
+
+#include <map>
+
 class pcap_writer {
+public:
+    class options {
+    public:
+        options():buffer_size(1024*1024),rotate_bytes(0),rotate_seconds(0),
+                  prealloc_bytes(0),split(false){}
+        size_t   buffer_size;           // stdio buffer for each output file
+        uint64_t rotate_bytes;          // start a new file after this many bytes; 0 for never
+        uint32_t rotate_seconds;        // start a new file after this many seconds of capture time
+        uint64_t prealloc_bytes;        // reserve this much disk space for each new file
+        bool     split;                 // one output per protocol tag given to writepkt()
+    };
+
+private:
     /* These are not implemented */
     pcap_writer &operator=(const pcap_writer &that);
     pcap_writer(const pcap_writer &t);
@@ -15,77 +48,339 @@ class pcap_writer {
             return "write error in pcap_write";
         }
     };
-    
+
     enum {PCAP_RECORD_HEADER_SIZE = 16,
           PCAP_MAX_PKT_LEN = 65535,      // wire shark may reject larger
           PCAP_HEADER_SIZE = 4+2+2+4+4+4+4,
     };
-    FILE *fcap;                         // where file is written
-    void write_bytes(const uint8_t * const val, size_t num_bytes) {
-        size_t count = fwrite(val,1,num_bytes,fcap);
-        if (count != num_bytes) throw new write_error();
-    }
-    void write2(const uint16_t val) {
-        size_t count = fwrite(&val,1,2,fcap);
-        if (count != 2)  throw new write_error();
-    }
-    void write4(const uint32_t val) {
-        size_t count = fwrite(&val,1,4,fcap);
-        if (count != 4) throw new write_error();
-    }
-    void open(const std::string &fname) {
-        fcap = fopen(fname.c_str(),"wb"); // write the output
-        if(fcap==0) throw new write_error();
-    }
-    void write_header(){
-        write4(0xa1b2c3d4);
-        write2(2);			// major version number
-        write2(4);			// minor version number
-        write4(0);			// time zone offset; always 0
-        write4(0);			// accuracy of time stamps in the file; always 0
-        write4(PCAP_MAX_PKT_LEN);	// snapshot length
-        write4(DLT_EN10MB);             // link layer encapsulation
+    enum {PCAP_MAGIC_USEC = 0xa1b2c3d4,
+          PCAP_MAGIC_NSEC = 0xa1b23c4d,
+          PCAPNG_SHB      = 0x0a0d0d0a,  // section header block; also the file magic
+          PCAPNG_BOM      = 0x1a2b3c4d,  // byte-order magic in the section header
+          PCAPNG_IDB      = 1,           // interface description block
+          PCAPNG_EPB      = 6,           // enhanced packet block
+          PCAPNG_OPT_TSRESOL = 9,        // if_tsresol option of an IDB
+          PCAPNG_MAX_BLOCK = 16*1024*1024,
+    };
+
+    /* One file being written */
+    struct output {
+        output():f(0),buf(),bytes(0),tstart(0),seq(0){}
+    private:
+        output(const output &);         // not implemented
+        output &operator=(const output &);
+    public:
+        FILE              *f;
+        std::vector<char>  buf;         // stdio buffer
+        uint64_t           bytes;       // written to the current file
+        time_t             tstart;      // capture time of the first packet in the file
+        unsigned int       seq;         // number of the current file; 0 for the first
+    };
+    typedef std::map<std::string,output *> outputs_t;
+
+    std::string ofname;                 // name of the first (or only) output
+    options     opt;
+    outputs_t   outputs;                // by protocol tag; "" if not split
+    std::string header;                 // starts every output file
+    bool     ng;                        // writing pcapng rather than classic pcap
+    bool     swap;                      // pcapng blocks are in the other byte order
+    bool     out_nsec;                  // classic: nanosecond timestamps
+    uint64_t ng_units;                  // pcapng: timestamp units per second for interface 0
+    bool     in_nsec;                   // writepkt() is given nanoseconds in tv_usec
+
+    static uint32_t swap4(uint32_t v) {
+        return (v>>24) | ((v>>8) & 0xff00) | ((v<<8) & 0xff0000) | (v<<24);
+    }
+    static uint16_t swap2(uint16_t v) {
+        return (uint16_t)((v>>8) | (v<<8));
+    }
+    /* Header construction */
+    void put2(const uint16_t val) { header.append((const char *)&val,2); }
+    void put4(const uint32_t val) { header.append((const char *)&val,4); }
+    void put4ng(const uint32_t val) {    // in the byte order of the pcapng section
+        put4(swap ? swap4(val) : val);
+    }
+    uint32_t ng4(const uint32_t val) const { return swap ? swap4(val) : val; }
+
+    void make_header(uint32_t magic=PCAP_MAGIC_USEC,uint32_t snaplen=PCAP_MAX_PKT_LEN,
+                     uint32_t linktype=DLT_EN10MB){
+        put4(magic);
+        put2(2);			// major version number
+        put2(4);			// minor version number
+        put4(0);			// time zone offset; always 0
+        put4(0);			// accuracy of time stamps in the file; always 0
+        put4(snaplen);	                // snapshot length
+        put4(linktype);                 // link layer encapsulation
+        out_nsec = (magic==PCAP_MAGIC_NSEC);
+    }
+    /* A new pcapng section with one interface that has nanosecond timestamps */
+    void make_ng_header(uint32_t linktype=DLT_EN10MB){
+        ng = true;
+        swap = false;
+        put4ng(PCAPNG_SHB);
+        put4ng(28);                     // block length
+        put4ng(PCAPNG_BOM);
+        put2(1);                        // major version
+        put2(0);                        // minor version
+        put4ng(0xffffffff);             // section length unknown (64 bits)
+        put4ng(0xffffffff);
+        put4ng(28);
+        put4ng(PCAPNG_IDB);
+        put4ng(32);
+        put2(linktype);
+        put2(0);                        // reserved
+        put4ng(PCAP_MAX_PKT_LEN);
+        put2(PCAPNG_OPT_TSRESOL);
+        put2(1);
+        put4ng(9);                      // 10^-9; three bytes of padding
+        put4ng(0);                      // opt_endofopt
+        put4ng(32);
+        ng_units = 1000000000ULL;
+    }
+    /* Read one pcapng block (type, length and body) from f into buf */
+    bool read_ng_block(FILE *f,bool bswap,std::vector<u_char> &buf,uint32_t *type){
+        uint32_t hdr[2];
+        if(fread(hdr,1,sizeof(hdr),f)!=sizeof(hdr)) return false;
+        *type = bswap ? swap4(hdr[0]) : hdr[0];
+        uint32_t len = bswap ? swap4(hdr[1]) : hdr[1];
+        if(len<12 || len%4 || len>PCAPNG_MAX_BLOCK) return false;
+        buf.resize(len);
+        memcpy(&buf[0],hdr,sizeof(hdr));
+        return fread(&buf[8],1,len-8,f)==len-8;
+    }
+    /* Find the if_tsresol option of an IDB and return units per second */
+    uint64_t idb_units(const std::vector<u_char> &idb){
+        size_t i = 16;                  // type, length, linktype+reserved, snaplen
+        while(i+4 <= idb.size()-4){
+            uint16_t code,len;
+            memcpy(&code,&idb[i],2);
+            memcpy(&len,&idb[i+2],2);
+            if(swap){ code = swap2(code); len = swap2(len); }
+            if(code==0) break;          // opt_endofopt
+            if(code==PCAPNG_OPT_TSRESOL && len>=1 && i+4 < idb.size()){
+                uint8_t r = idb[i+4];
+                uint64_t units = 1;
+                if(r & 0x80){
+                    if((r & 0x7f) > 63) return 1000000;
+                    units <<= (r & 0x7f);
+                } else {
+                    if(r > 19) return 1000000;
+                    while(r--) units *= 10;
+                }
+                return units;
+            }
+            i += 4 + ((len+3) & ~3);
+        }
+        return 1000000;                 // the default is microseconds
+    }
+    void copy_ng_header(FILE *f2,const std::string &ifname){
+        /* The section header tells us the byte order */
+        u_char shb[12];
+        if(fread(shb,1,sizeof(shb),f2)!=sizeof(shb)) throw new write_error();
+        uint32_t bom;
+        memcpy(&bom,shb+8,4);
+        if(bom==PCAPNG_BOM)             swap = false;
+        else if(swap4(bom)==PCAPNG_BOM) swap = true;
+        else {
+            std::cout << "pcapng file " << ifname << " has a bad section header. Cannot continue.\n";
+            throw new write_error();
+        }
+        if(fseek(f2,0,SEEK_SET)) throw new write_error();
+        ng = true;
+
+        /* Copy the section header and the interface descriptions that follow it */
+        std::vector<u_char> block;
+        uint32_t type = 0;
+        bool first_idb = true;
+        while(read_ng_block(f2,swap,block,&type)){
+            if(type==PCAPNG_IDB){
+                if(first_idb) ng_units = idb_units(block);
+                first_idb = false;
+            } else if(type!=PCAPNG_SHB){
+                break;
+            }
+            header.append((const char *)&block[0],block.size());
+        }
+        if(first_idb){
+            std::cout << "pcapng file " << ifname << " has no interface description. Cannot continue.\n";
+            throw new write_error();
+        }
     }
     void copy_header(const std::string &ifname){
-        /* assert byte order is correct */
         FILE *f2 = fopen(ifname.c_str(),"rb");
         if(f2==0) throw new write_error();
         u_char buf[PCAP_HEADER_SIZE];
         if(fread(buf,1,sizeof(buf),f2)!=sizeof(buf)) throw new write_error();
-        if((buf[0]!=0xd4) || (buf[1]!=0xc3) || (buf[2]!=0xb2) || (buf[3]!=0xa1)){
-            std::cout << "pcap file " << ifname << " is in wrong byte order. Cannot continue.\n";
-            throw new write_error();
+        uint32_t magic;
+        memcpy(&magic,buf,4);
+        if(magic==PCAPNG_SHB){
+            if(fseek(f2,0,SEEK_SET)) throw new write_error();
+            copy_ng_header(f2,ifname);
+        } else {
+            /* Classic pcap, in either byte order. Records are written in our
+             * byte order, so write a new header rather than copying the old one.
+             */
+            bool bswap = (magic!=PCAP_MAGIC_USEC && magic!=PCAP_MAGIC_NSEC);
+            if(bswap) magic = swap4(magic);
+            if(magic!=PCAP_MAGIC_USEC && magic!=PCAP_MAGIC_NSEC){
+                std::cout << "pcap file " << ifname << " is not a pcap or pcapng file. Cannot continue.\n";
+                throw new write_error();
+            }
+            uint32_t snaplen,linktype;
+            memcpy(&snaplen,buf+16,4);
+            memcpy(&linktype,buf+20,4);
+            if(bswap){
+                snaplen  = swap4(snaplen);
+                linktype = swap4(linktype);
+            }
+            make_header(magic,snaplen,linktype);
         }
-        if(fwrite(buf,1,sizeof(buf),fcap)!=sizeof(buf)) throw new write_error();
         if(fclose(f2)!=0) throw new write_error();
     }
-    pcap_writer():fcap(0){}
+
+    /* unk.pcap, unk-udp.pcap, unk-udp.1.pcap, ... */
+    std::string output_name(const std::string &tag,unsigned int seq) const {
+        std::string stem = ofname;
+        std::string ext;
+        size_t dot   = ofname.rfind('.');
+        size_t slash = ofname.rfind('/');
+        if(dot!=std::string::npos && dot>0 && (slash==std::string::npos || dot>slash+1)){
+            stem = ofname.substr(0,dot);
+            ext  = ofname.substr(dot);
+        }
+        if(tag.size()) stem += "-" + tag;
+        if(seq>0){
+            char buf[16];
+            snprintf(buf,sizeof(buf),".%u",seq);
+            stem += buf;
+        }
+        return stem + ext;
+    }
+    void open_output(output *o,const std::string &tag){
+        std::string fname = output_name(tag,o->seq);
+        o->f = fopen(fname.c_str(),"wb"); // write the output
+        if(o->f==0) throw new write_error();
+        if(opt.buffer_size>0){
+            o->buf.resize(opt.buffer_size);
+            setvbuf(o->f,&o->buf[0],_IOFBF,o->buf.size());
+        }
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+        /* Reserve the space without changing the file size; the blocks
+         * past the end stay allocated until close_output() gives them back.
+         * Failure is harmless.
+         */
+        if(opt.prealloc_bytes>0){
+            if(fallocate(fileno(o->f),FALLOC_FL_KEEP_SIZE,0,(off_t)opt.prealloc_bytes)){
+                DEBUG(2)("fallocate(%s): %s",fname.c_str(),strerror(errno));
+            }
+        }
+#endif
+        if(fwrite(header.data(),1,header.size(),o->f)!=header.size()) throw new write_error();
+        o->bytes  = header.size();
+        o->tstart = 0;
+    }
+    void close_output(output *o){
+        if(o->f==0) return;
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+        /* Free what was reserved past what was written */
+        if(opt.prealloc_bytes>0 && fflush(o->f)==0 && ftruncate(fileno(o->f),(off_t)o->bytes)!=0){
+            DEBUG(2)("ftruncate: %s",strerror(errno));
+        }
+#endif
+        int r = fclose(o->f);
+        o->f = 0;
+        if(r!=0) throw new write_error();
+    }
+    /* The output for a packet, rotated if it is full or old */
+    output *get_output(const char *tag,size_t record_len,time_t when){
+        std::string key = (opt.split && tag) ? tag : "";
+        outputs_t::iterator it = outputs.find(key);
+        output *o = 0;
+        if(it==outputs.end()){
+            o = new output();
+            outputs[key] = o;
+            open_output(o,key);
+        } else {
+            o = it->second;
+        }
+        if(o->bytes>header.size()){     // never rotate an empty file
+            if((opt.rotate_bytes   && o->bytes + record_len > opt.rotate_bytes) ||
+               (opt.rotate_seconds && when - o->tstart >= (time_t)opt.rotate_seconds)){
+                close_output(o);
+                o->seq++;
+                open_output(o,key);
+            }
+        }
+        if(o->bytes==header.size()) o->tstart = when;
+        return o;
+    }
+
+    pcap_writer(const std::string &ofname_,const options &opt_):
+        ofname(ofname_),opt(opt_),outputs(),header(),
+        ng(false),swap(false),out_nsec(false),ng_units(1000000),in_nsec(false){}
 
 public:
-    static pcap_writer *open_new(const std::string &ofname){
-        pcap_writer *pcw = new pcap_writer();
-        pcw->open(ofname);
-        pcw->write_header();
+    static pcap_writer *open_new(const std::string &ofname,bool pcapng=false,
+                                 const options &opt=options()){
+        pcap_writer *pcw = new pcap_writer(ofname,opt);
+        if(pcapng) pcw->make_ng_header();
+        else       pcw->make_header();
+        pcw->get_output(0,0,0);
         return pcw;
     }
-    static pcap_writer *open_copy(const std::string &ofname,const std::string &ifname){
-        pcap_writer *pcw = new pcap_writer();
-        pcw->open(ofname);
+    static pcap_writer *open_copy(const std::string &ofname,const std::string &ifname,
+                                  const options &opt=options()){
+        pcap_writer *pcw = new pcap_writer(ofname,opt);
         pcw->copy_header(ifname);
+        if(!opt.split) pcw->get_output(0,0,0); // split outputs are created as needed
         return pcw;
     }
     virtual ~pcap_writer(){
-        if(fcap) fclose(fcap);
+        for(outputs_t::iterator it = outputs.begin(); it!=outputs.end(); it++){
+            if(it->second->f) fclose(it->second->f);
+            delete it->second;
+        }
     }
-    void writepkt(const struct pcap_pkthdr *h,const u_char *p) {
+    /* Tell the writer whether the timestamps it is given are in nanoseconds
+     * (libpcap opened with PCAP_TSTAMP_PRECISION_NANO) or microseconds.
+     */
+    void set_input_nsec(bool nsec) { in_nsec = nsec; }
+    bool split() const { return opt.split; }
+    /* Write a packet. With options::split, tag names the output it goes to. */
+    void writepkt(const struct pcap_pkthdr *h,const u_char *p,const char *tag=0) {
+        uint64_t nsec = in_nsec ? (uint64_t)h->ts.tv_usec : (uint64_t)h->ts.tv_usec * 1000;
+        if(ng){
+            /* Enhanced packet block */
+            static const u_char pad[4] = {0,0,0,0};
+            uint32_t padlen = (4 - (h->caplen % 4)) % 4;
+            uint32_t blen   = 32 + h->caplen + padlen;
+            uint64_t ts     = (uint64_t)h->ts.tv_sec * ng_units
+                + (ng_units>=1000000000ULL ? nsec * (ng_units/1000000000ULL)
+                                           : nsec / (1000000000ULL/ng_units));
+            uint32_t rec[7] = {ng4(PCAPNG_EPB),ng4(blen),
+                               ng4(0),  // interface id
+                               ng4((uint32_t)(ts >> 32)),ng4((uint32_t)ts),
+                               ng4(h->caplen),ng4(h->len)};
+            uint32_t trailer = ng4(blen);
+            output *o = get_output(tag,blen,h->ts.tv_sec);
+            if(fwrite(rec,1,sizeof(rec),o->f)!=sizeof(rec)) throw new write_error();
+            if(fwrite(p,1,h->caplen,o->f)!=h->caplen) throw new write_error();
+            if(padlen && fwrite(pad,1,padlen,o->f)!=padlen) throw new write_error();
+            if(fwrite(&trailer,1,4,o->f)!=4) throw new write_error();
+            o->bytes += blen;
+            return;
+        }
         /* Write a packet */
-        write4(h->ts.tv_sec);		// time stamp, seconds avalue
-        write4(h->ts.tv_usec);		// time stamp, microseconds
-        write4(h->caplen);
-        write4(h->len);
-        size_t count = fwrite(p,1,h->caplen,fcap);	// the packet
+        uint32_t rec[4] = {(uint32_t)h->ts.tv_sec, // time stamp, seconds avalue
+                           (uint32_t)(out_nsec ? nsec : nsec/1000), // microseconds or nanoseconds
+                           h->caplen,
+                           h->len};
+        output *o = get_output(tag,PCAP_RECORD_HEADER_SIZE+h->caplen,h->ts.tv_sec);
+        if(fwrite(rec,1,sizeof(rec),o->f)!=sizeof(rec)) throw new write_error();
+        size_t count = fwrite(p,1,h->caplen,o->f);	// the packet
         if(count!=h->caplen) throw new write_error();
+        o->bytes += PCAP_RECORD_HEADER_SIZE + h->caplen;
     }
 };
-    
+
 #endif
@@ -0,0 +1,485 @@
+/**
+ * pktfilter.cpp:
+ *
+ * Parser, compiler and evaluator for the pcap-filter subset described
+ * in pktfilter.h.
+ *
+ * As in libpcap, "not" binds tightest, while "and" and "or" have equal
+ * precedence and associate left to right.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "config.h"
+#include "pktfilter.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdio.h>
+
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+
+#define PF_IPPROTO_ICMP   1
+#define PF_IPPROTO_TCP    6
+#define PF_IPPROTO_UDP    17
+#define PF_IPPROTO_ICMPV6 58
+
+/****************************************************************
+ *** prefix_trie
+ ****************************************************************/
+
+void pktfilter::prefix_trie::insert(const uint8_t *addr,unsigned bits)
+{
+    uint32_t n = 0;
+    for(unsigned i=0;i<bits;i++){
+        if(tn[n].terminal) return;      // a shorter prefix already covers this one
+        int b = (addr[i/8] >> (7-(i%8))) & 1;
+        if(tn[n].child[b]==0){
+            tn[n].child[b] = tn.size();
+            tn.push_back(tnode());      // may move tn; do not hold references across this
+        }
+        n = tn[n].child[b];
+    }
+    tn[n].terminal = true;
+    tn[n].child[0] = tn[n].child[1] = 0; // longer prefixes below are now redundant
+}
+
+void pktfilter::prefix_trie::merge_from(const prefix_trie &that,uint32_t from,uint8_t *addr,
+                                        unsigned depth,unsigned max_bits)
+{
+    const tnode &t = that.tn[from];
+    if(t.terminal){
+        insert(addr,depth);
+        return;
+    }
+    if(depth==max_bits) return;
+    for(int b=0;b<2;b++){
+        if(t.child[b]==0) continue;
+        if(b) addr[depth/8] |=  (0x80 >> (depth%8));
+        else  addr[depth/8] &= ~(0x80 >> (depth%8));
+        merge_from(that,t.child[b],addr,depth+1,max_bits);
+    }
+}
+
+void pktfilter::prefix_trie::merge(const prefix_trie &that,size_t addr_bytes)
+{
+    uint8_t addr[16];
+    memset(addr,0,sizeof(addr));
+    merge_from(that,0,addr,0,addr_bytes*8);
+}
+
+/****************************************************************
+ *** evaluation
+ ****************************************************************/
+
+bool pktfilter::eval(uint32_t n,const fields &f) const
+{
+    const node &nd = nodes[n];
+    switch(nd.type){
+    case N_TRUE:
+        return true;
+    case N_AND:
+        for(std::vector<uint32_t>::const_iterator it=nd.kids.begin();it!=nd.kids.end();it++){
+            if(!eval(*it,f)) return false;
+        }
+        return true;
+    case N_OR:
+        for(std::vector<uint32_t>::const_iterator it=nd.kids.begin();it!=nd.kids.end();it++){
+            if(eval(*it,f)) return true;
+        }
+        return false;
+    case N_NOT:
+        return !eval(nd.kids[0],f);
+    case N_VERSION:
+        return f.ip_version==(int)nd.arg;
+    case N_PROTO:
+        if(f.ip_version==0) return false;
+        if(nd.arg==PF_IPPROTO_ICMP) return f.proto==(f.ip_version==6 ? PF_IPPROTO_ICMPV6 : PF_IPPROTO_ICMP);
+        return f.proto==nd.arg;
+    case N_ADDR:
+        {
+            if(f.ip_version==0) return false;
+            const addr_set &as = addr_sets[nd.arg];
+            const prefix_trie &t = f.ip_version==6 ? as.v6 : as.v4;
+            unsigned bits = f.ip_version==6 ? 128 : 32;
+            switch(nd.dir){
+            case DIR_SRC:    return t.contains(f.src,bits);
+            case DIR_DST:    return t.contains(f.dst,bits);
+            case DIR_EITHER: return t.contains(f.src,bits) || t.contains(f.dst,bits);
+            case DIR_BOTH:   return t.contains(f.src,bits) && t.contains(f.dst,bits);
+            }
+            return false;
+        }
+    case N_PORT:
+        {
+            if(!f.has_ports) return false;
+            if(nd.proto && f.proto!=nd.proto) return false;
+            const port_set &ps = port_sets[nd.arg];
+            switch(nd.dir){
+            case DIR_SRC:    return ps.test(f.sport);
+            case DIR_DST:    return ps.test(f.dport);
+            case DIR_EITHER: return ps.test(f.sport) || ps.test(f.dport);
+            case DIR_BOTH:   return ps.test(f.sport) && ps.test(f.dport);
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+size_t pktfilter::count_nodes(uint32_t n) const
+{
+    size_t count = 1;
+    for(std::vector<uint32_t>::const_iterator it=nodes[n].kids.begin();it!=nodes[n].kids.end();it++){
+        count += count_nodes(*it);
+    }
+    return count;
+}
+
+/****************************************************************
+ *** tree construction
+ ****************************************************************/
+
+uint32_t pktfilter::add_node(node_type_t t,uint32_t arg)
+{
+    nodes.push_back(node(t,arg));
+    return nodes.size()-1;
+}
+
+/* Two leaves can be folded into one set if they test the same field the
+ * same way. Not "src and dst": (src in A and dst in A) or (src in B and
+ * dst in B) is not src and dst in A+B, which would also match A to B.
+ */
+bool pktfilter::mergeable(uint32_t a,uint32_t b) const
+{
+    const node &na = nodes[a];
+    const node &nb = nodes[b];
+    return (na.type==N_ADDR || na.type==N_PORT) && na.dir!=DIR_BOTH
+        && na.type==nb.type && na.dir==nb.dir && na.proto==nb.proto;
+}
+
+void pktfilter::merge_into(uint32_t a,uint32_t b)
+{
+    if(nodes[a].type==N_ADDR){
+        addr_set &to = addr_sets[nodes[a].arg];
+        const addr_set &from = addr_sets[nodes[b].arg];
+        to.v4.merge(from.v4,4);
+        to.v6.merge(from.v6,16);
+    } else {
+        port_sets[nodes[a].arg] |= port_sets[nodes[b].arg];
+    }
+}
+
+/* Build l AND r or l OR r. Chains become a single n-ary node, and
+ * in an OR, a leaf that tests the same field as an earlier leaf is
+ * folded into that leaf's set.
+ */
+uint32_t pktfilter::make_bool(node_type_t t,uint32_t l,uint32_t r)
+{
+    uint32_t n = l;
+    if(nodes[l].type!=t){
+        n = add_node(t);
+        nodes[n].kids.push_back(l);
+    }
+    if(t==N_OR){
+        for(std::vector<uint32_t>::const_iterator it=nodes[n].kids.begin();it!=nodes[n].kids.end();it++){
+            if(mergeable(*it,r)){
+                merge_into(*it,r);
+                return n;
+            }
+        }
+    }
+    if(nodes[r].type==t){
+        std::vector<uint32_t> rk = nodes[r].kids;
+        nodes[n].kids.insert(nodes[n].kids.end(),rk.begin(),rk.end());
+    } else {
+        nodes[n].kids.push_back(r);
+    }
+    return n;
+}
+
+/****************************************************************
+ *** parser
+ ****************************************************************/
+
+bool pktfilter::fail(const std::string &msg)
+{
+    if(err.size()==0) err = msg;
+    return false;
+}
+
+bool pktfilter::tokenize(const std::string &e)
+{
+    toks.clear();
+    size_t i=0;
+    while(i<e.size()){
+        if(isspace((unsigned char)e[i])){ i++; continue; }
+        if(e[i]=='(' || e[i]==')'){
+            toks.push_back(std::string(1,e[i]));
+            i++;
+            continue;
+        }
+        if(e.compare(i,2,"&&")==0 || e.compare(i,2,"||")==0){
+            toks.push_back(e[i]=='&' ? "and" : "or");
+            i+=2;
+            continue;
+        }
+        if(e[i]=='!'){
+            toks.push_back("not");
+            i++;
+            continue;
+        }
+        size_t j=i;
+        while(j<e.size() && !isspace((unsigned char)e[j]) && e[j]!='(' && e[j]!=')' && e[j]!='!' && e[j]!='&' && e[j]!='|'){
+            j++;
+        }
+        if(j==i) return fail("unexpected character '" + e.substr(i,1) + "'");
+        toks.push_back(e.substr(i,j-i));
+        i=j;
+    }
+    return true;
+}
+
+bool pktfilter::compile(const std::string &expression)
+{
+    nodes.clear();
+    addr_sets.clear();
+    port_sets.clear();
+    err.clear();
+    last = qualifier();
+    pos = 0;
+    if(!tokenize(expression)) return false;
+    if(toks.size()==0){
+        root = add_node(N_TRUE);
+        return true;
+    }
+    if(!parse_expr(&root)) return false;
+    if(!at_end()) return fail("unexpected '" + peek() + "'");
+    return true;
+}
+
+/* expr := factor (("and"|"or") factor)* */
+bool pktfilter::parse_expr(uint32_t *n)
+{
+    if(!parse_factor(n)) return false;
+    while(peek()=="and" || peek()=="or"){
+        node_type_t t = peek()=="and" ? N_AND : N_OR;
+        pos++;
+        uint32_t r;
+        if(!parse_factor(&r)) return false;
+        *n = make_bool(t,*n,r);
+    }
+    return true;
+}
+
+/* factor := "not" factor | "(" expr ")" | primitive */
+bool pktfilter::parse_factor(uint32_t *n)
+{
+    if(at_end()) return fail("expression ends unexpectedly");
+    if(peek()=="not"){
+        pos++;
+        uint32_t k;
+        if(!parse_factor(&k)) return false;
+        *n = add_node(N_NOT);
+        nodes[*n].kids.push_back(k);
+        return true;
+    }
+    if(peek()=="("){
+        pos++;
+        if(!parse_expr(n)) return false;
+        if(peek()!=")") return fail("missing ')'");
+        pos++;
+        return true;
+    }
+    return parse_primitive(n);
+}
+
+static bool is_kind(const std::string &s)
+{
+    return s=="host" || s=="net" || s=="port" || s=="portrange";
+}
+
+static bool is_dir(const std::string &s)
+{
+    return s=="src" || s=="dst";
+}
+
+bool pktfilter::parse_primitive(uint32_t *n)
+{
+    qualifier q;
+    bool have_qualifier = false;
+
+    /* protocol qualifier or protocol primitive */
+    std::string t = peek();
+    if(t=="ip" || t=="ip6" || t=="tcp" || t=="udp" || t=="icmp"){
+        std::string next = peek(1);
+        if(is_kind(next) || is_dir(next)){
+            if(t=="ip")  q.version = 4;
+            if(t=="ip6") q.version = 6;
+            if(t=="tcp") q.proto = PF_IPPROTO_TCP;
+            if(t=="udp") q.proto = PF_IPPROTO_UDP;
+            if(t=="icmp") return fail("icmp cannot qualify " + next);
+            pos++;
+            have_qualifier = true;
+        } else {
+            pos++;
+            if(t=="ip")   *n = add_node(N_VERSION,4);
+            if(t=="ip6")  *n = add_node(N_VERSION,6);
+            if(t=="tcp")  *n = add_node(N_PROTO,PF_IPPROTO_TCP);
+            if(t=="udp")  *n = add_node(N_PROTO,PF_IPPROTO_UDP);
+            if(t=="icmp") *n = add_node(N_PROTO,PF_IPPROTO_ICMP);
+            return true;
+        }
+    }
+
+    /* direction: src, dst, "src or dst", "src and dst" */
+    if(is_dir(peek())){
+        q.dir = peek()=="src" ? DIR_SRC : DIR_DST;
+        pos++;
+        if((peek()=="or" || peek()=="and") && is_dir(peek(1))){
+            q.dir = peek()=="or" ? DIR_EITHER : DIR_BOTH;
+            pos+=2;
+        }
+        have_qualifier = true;
+    }
+
+    if(is_kind(peek())){
+        q.kind = peek();
+        pos++;
+        have_qualifier = true;
+    } else if(have_qualifier){
+        q.kind = "host";                // "src 10.0.0.1"
+    }
+
+    if(!have_qualifier){
+        /* a bare value reuses the qualifiers of the previous primitive, as in libpcap */
+        if(last.kind.size()==0) q.kind = "host";
+        else q = last;
+    }
+    if(q.proto && q.kind!="port" && q.kind!="portrange"){
+        return fail("tcp/udp can only qualify port and portrange");
+    }
+    last = q;
+    return parse_value(q,n);
+}
+
+static bool parse_port(const std::string &s,uint32_t *port)
+{
+    if(s.size()==0 || s.size()>5) return false;
+    for(size_t i=0;i<s.size();i++){
+        if(!isdigit((unsigned char)s[i])) return false;
+    }
+    *port = atoi(s.c_str());
+    return *port<=65535;
+}
+
+bool pktfilter::parse_value(const qualifier &q,uint32_t *n)
+{
+    if(at_end()) return fail("missing value after " + q.kind);
+    std::string value = peek();
+    pos++;
+
+    if(q.kind=="port" || q.kind=="portrange"){
+        uint32_t lo=0,hi=0;
+        size_t dash = value.find('-');
+        if(q.kind=="port"){
+            if(!parse_port(value,&lo)) return fail("bad port '" + value + "'");
+            hi = lo;
+        } else {
+            if(dash==std::string::npos
+               || !parse_port(value.substr(0,dash),&lo)
+               || !parse_port(value.substr(dash+1),&hi)
+               || lo>hi){
+                return fail("bad portrange '" + value + "'");
+            }
+        }
+        port_sets.push_back(port_set());
+        for(uint32_t p=lo;p<=hi;p++) port_sets.back().set(p);
+        *n = add_node(N_PORT,port_sets.size()-1);
+        nodes[*n].dir   = q.dir;
+        nodes[*n].proto = q.proto;
+        return true;
+    }
+
+    /* host or net */
+    if(q.kind=="net" && peek()=="mask"){
+        pos++;
+        std::string mask = peek();
+        pos++;
+        struct in_addr m;
+        if(inet_pton(AF_INET,mask.c_str(),&m)!=1) return fail("bad mask '" + mask + "'");
+        uint32_t bits = ntohl(m.s_addr);
+        unsigned len = 0;
+        while(len<32 && (bits & (0x80000000U>>len))) len++;
+        if(len<32 && (bits << len)!=0) return fail("non-contiguous mask '" + mask + "'");
+        char buf[8];
+        snprintf(buf,sizeof(buf),"/%u",len);
+        value += buf;
+    }
+    addr_sets.push_back(addr_set());
+    if(!parse_net(value,q.version,q.kind=="host",addr_sets.size()-1)) return false;
+    *n = add_node(N_ADDR,addr_sets.size()-1);
+    nodes[*n].dir = q.dir;
+    return true;
+}
+
+/* Parse ADDR, ADDR/LEN or a short dotted-quad network into the set.
+ * version is 0 if the family was not qualified; a host needs the full address.
+ */
+bool pktfilter::parse_net(const std::string &value,int version,bool host,uint32_t set)
+{
+    std::string a = value;
+    int len = -1;
+    size_t slash = value.find('/');
+    if(slash!=std::string::npos){
+        if(host) return fail("host '" + value + "' has a prefix length");
+        a = value.substr(0,slash);
+        std::string l = value.substr(slash+1);
+        if(l.size()==0 || l.size()>3 || l.find_first_not_of("0123456789")!=std::string::npos){
+            return fail("bad prefix length in '" + value + "'");
+        }
+        len = atoi(l.c_str());
+    }
+
+    uint8_t addr[16];
+    memset(addr,0,sizeof(addr));
+    if(a.find(':')!=std::string::npos){
+        if(version==4) return fail("'" + value + "' is not an IPv4 address");
+        if(inet_pton(AF_INET6,a.c_str(),addr)!=1) return fail("bad IPv6 address '" + value + "'");
+        if(len<0) len = 128;
+        if(len>128) return fail("bad prefix length in '" + value + "'");
+        addr_sets[set].v6.insert(addr,len);
+        return true;
+    }
+    if(version==6) return fail("'" + value + "' is not an IPv6 address");
+
+    /* IPv4; "net 10.1" means 10.1.0.0/16 as in libpcap */
+    int octets = 0;
+    size_t i = 0;
+    while(i<a.size() && octets<4){
+        size_t j = a.find('.',i);
+        if(j==std::string::npos) j = a.size();
+        std::string o = a.substr(i,j-i);
+        if(o.size()==0 || o.size()>3 || o.find_first_not_of("0123456789")!=std::string::npos){
+            return fail("'" + value + "' is not an address (hostnames need libpcap)");
+        }
+        int v = atoi(o.c_str());
+        if(v>255) return fail("bad address '" + value + "'");
+        addr[octets++] = v;
+        i = j+1;
+        if(j==a.size()) break;
+    }
+    if(i<a.size()) return fail("bad address '" + value + "'");
+    if(octets<4 && (host || len>=0)) return fail("bad address '" + value + "'");
+    if(len<0) len = octets*8;
+    if(len>32) return fail("bad prefix length in '" + value + "'");
+    addr_sets[set].v4.insert(addr,len);
+    return true;
+}
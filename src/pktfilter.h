@@ -0,0 +1,159 @@
+/*
+ * pktfilter.h:
+ *
+ * A compiled packet filter for the subset of the pcap-filter(7) language
+ * that is useful for TCP reassembly:
+ *
+ *   ip, ip6, tcp, udp, icmp
+ *   [src|dst|src or dst|src and dst] host ADDR
+ *   [src|dst|src or dst|src and dst] net ADDR/LEN | net ADDR mask MASK | net A.B[.C]
+ *   [tcp|udp] [src|dst|...] port N | portrange N-M
+ *   not/!, and/&&, or/||, parentheses, and the implicit qualifier
+ *   of "port 80 or 443" and "host a or b".
+ *
+ * Instead of running libpcap's BPF interpreter on every packet and then
+ * parsing the headers a second time, tcpdemux evaluates the compiled
+ * expression on the header fields it has already parsed.
+ *
+ * Runs of "or" between primitives of the same kind are folded into a
+ * single set when the expression is compiled: addresses and networks into
+ * a binary prefix trie per address family, ports into a 64K-bit bitmap.
+ * An expression with hundreds of CIDR or port clauses therefore costs
+ * one trie walk or one bit test per packet.
+ *
+ * Expressions outside the subset (hostnames, ether, vlan, byte offsets...)
+ * fail to compile; the caller then falls back to libpcap.
+ */
+
+#ifndef PKTFILTER_H
+#define PKTFILTER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <bitset>
+
+class pktfilter {
+    /* These are not implemented */
+    pktfilter(const pktfilter &);
+    pktfilter &operator=(const pktfilter &);
+public:
+    /* Header fields of one packet, filled in after the IP header has been parsed */
+    struct fields {
+        fields():ip_version(0),proto(0),src(0),dst(0),has_ports(false),sport(0),dport(0){}
+        int            ip_version;      // 4, 6, or 0 if the packet is not IP
+        uint8_t        proto;           // IP protocol or IPv6 next header
+        const uint8_t *src;             // 4 or 16 bytes, network order
+        const uint8_t *dst;
+        bool           has_ports;       // TCP or UDP header captured, first fragment
+        uint16_t       sport;           // host order
+        uint16_t       dport;
+    };
+
+    pktfilter():nodes(),addr_sets(),port_sets(),root(0),err(),toks(),pos(0),last(){}
+
+    /* Compile an expression. Returns false and sets error() if the
+     * expression uses anything outside the supported subset.
+     */
+    bool compile(const std::string &expression);
+    const std::string &error() const { return err; }
+
+    bool match(const fields &f) const { return eval(root,f); }
+
+    size_t node_count() const { return count_nodes(root); } // after folding
+
+private:
+    /* A set of prefixes, as a binary trie over the address bits.
+     * child[] are indexes into the node vector; 0 means no child (node 0 is the root).
+     */
+    class prefix_trie {
+        struct tnode {
+            tnode():terminal(false){ child[0]=child[1]=0; }
+            uint32_t child[2];
+            bool     terminal;          // a prefix ends here; everything below matches
+        };
+        std::vector<tnode> tn;
+    public:
+        prefix_trie():tn(1){}
+        void insert(const uint8_t *addr,unsigned bits);
+        void merge(const prefix_trie &that,size_t addr_bytes);
+        bool contains(const uint8_t *addr,unsigned addr_bits) const {
+            uint32_t n = 0;
+            for(unsigned i=0;;i++){
+                if(tn[n].terminal) return true;
+                if(i==addr_bits) return false;
+                n = tn[n].child[(addr[i/8] >> (7-(i%8))) & 1];
+                if(n==0) return false;
+            }
+        }
+        bool empty() const { return tn.size()==1 && !tn[0].terminal; }
+    private:
+        void merge_from(const prefix_trie &that,uint32_t from,uint8_t *addr,unsigned depth,unsigned max_bits);
+    };
+    struct addr_set {
+        prefix_trie v4;
+        prefix_trie v6;
+    };
+    typedef std::bitset<65536> port_set;
+
+    typedef enum {
+        N_TRUE,
+        N_AND,                          // kids
+        N_OR,                           // kids
+        N_NOT,                          // kids[0]
+        N_VERSION,                      // arg = 4 or 6
+        N_PROTO,                        // arg = IP protocol
+        N_ADDR,                         // arg = index into addr_sets
+        N_PORT                          // arg = index into port_sets, proto = 0 or IPPROTO_TCP/UDP
+    } node_type_t;
+    typedef enum { DIR_EITHER, DIR_SRC, DIR_DST, DIR_BOTH } dir_t;
+
+    struct node {
+        node(node_type_t t,uint32_t a):type(t),dir(DIR_EITHER),proto(0),arg(a),kids(){}
+        node_type_t type;
+        dir_t       dir;
+        uint8_t     proto;
+        uint32_t    arg;
+        std::vector<uint32_t> kids;
+    };
+
+    /* The qualifiers of the last primitive, for "port 80 or 443" */
+    struct qualifier {
+        qualifier():kind(),dir(DIR_EITHER),proto(0),version(0){}
+        std::string kind;               // host, net, port, portrange; empty if none yet
+        dir_t       dir;
+        uint8_t     proto;
+        int         version;            // 0, 4 or 6 (from "ip host" / "ip6 net")
+    };
+
+    std::vector<node>     nodes;
+    std::vector<addr_set> addr_sets;
+    std::vector<port_set> port_sets;
+    uint32_t              root;
+    std::string           err;
+
+    /* Parser state */
+    std::vector<std::string> toks;
+    size_t                   pos;
+    qualifier                last;
+
+    bool   eval(uint32_t n,const fields &f) const;
+    size_t count_nodes(uint32_t n) const;
+
+    uint32_t add_node(node_type_t t,uint32_t arg=0);
+    uint32_t make_bool(node_type_t t,uint32_t l,uint32_t r);
+    bool     mergeable(uint32_t a,uint32_t b) const;
+    void     merge_into(uint32_t a,uint32_t b);
+
+    bool        tokenize(const std::string &expression);
+    bool        at_end() const { return pos>=toks.size(); }
+    std::string peek(size_t ahead=0) const { return pos+ahead<toks.size() ? toks[pos+ahead] : std::string(); }
+    bool        fail(const std::string &msg);
+    bool        parse_expr(uint32_t *n);
+    bool        parse_factor(uint32_t *n);
+    bool        parse_primitive(uint32_t *n);
+    bool        parse_value(const qualifier &q,uint32_t *n);
+    bool        parse_net(const std::string &value,int version,bool host,uint32_t set);
+};
+
+#endif
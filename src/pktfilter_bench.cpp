@@ -0,0 +1,201 @@
+/**
+ * pktfilter_bench.cpp:
+ *
+ * Compares the compiled filter in pktfilter.cpp with libpcap's BPF
+ * interpreter on the same capture and expression. Both are run over
+ * every packet several times; the time per packet and any packets on
+ * which the two disagree are reported.
+ *
+ * usage: pktfilter_bench [-n iterations] file.pcap expression...
+ *
+ * Only Ethernet (with 802.1Q tags) and raw IP captures are understood.
+ * The compiled filter is timed including the header parsing it needs,
+ * which in tcpflow is done by tcpdemux anyway.
+ *
+ * Build with "make pktfilter_bench".
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "config.h"
+#include "pktfilter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <pcap.h>
+
+#include <string>
+#include <vector>
+
+struct packet {
+    struct pcap_pkthdr h;
+    std::vector<u_char> data;
+};
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+static uint16_t get16(const u_char *p) { return (uint16_t)((p[0]<<8) | p[1]); }
+
+/* Parse the headers the way tcpdemux does and fill in the filter fields */
+static void parse_fields(int dlt,const packet &pkt,pktfilter::fields &f)
+{
+    const u_char *p = &pkt.data[0];
+    size_t len = pkt.h.caplen;
+    f = pktfilter::fields();
+    if(dlt==DLT_EN10MB){
+        if(len<14) return;
+        uint16_t type = get16(p+12);
+        p += 14; len -= 14;
+        while(type==0x8100 && len>=4){
+            type = get16(p+2);
+            p += 4; len -= 4;
+        }
+        if(type!=0x0800 && type!=0x86DD) return;
+    }
+    if(len<1) return;
+    if((p[0]>>4)==4 && len>=20){
+        size_t hl = (p[0] & 0x0f)*4;
+        f.ip_version = 4;
+        f.proto = p[9];
+        f.src = p+12;
+        f.dst = p+16;
+        if((f.proto==6 || f.proto==17) && (get16(p+6) & 0x1fff)==0 && len>=hl+4){
+            f.has_ports = true;
+            f.sport = get16(p+hl);
+            f.dport = get16(p+hl+2);
+        }
+    } else if((p[0]>>4)==6 && len>=40){
+        f.ip_version = 6;
+        f.proto = p[6];
+        f.src = p+8;
+        f.dst = p+24;
+        if((f.proto==6 || f.proto==17) && len>=44){
+            f.has_ports = true;
+            f.sport = get16(p+40);
+            f.dport = get16(p+42);
+        }
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr,"usage: pktfilter_bench [-n iterations] file.pcap expression...\n");
+    exit(1);
+}
+
+int main(int argc,char **argv)
+{
+    int iterations = 100;
+    int ch;
+    while((ch = getopt(argc,argv,"n:")) != -1){
+        switch(ch){
+        case 'n': iterations = atoi(optarg); break;
+        default: usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if(argc<2 || iterations<1) usage();
+
+    std::string expression;
+    for(int i=1;i<argc;i++){
+        if(expression.size()) expression += " ";
+        expression += argv[i];
+    }
+
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *pd = pcap_open_offline(argv[0],errbuf);
+    if(pd==0){
+        fprintf(stderr,"%s\n",errbuf);
+        exit(1);
+    }
+    int dlt = pcap_datalink(pd);
+    if(dlt!=DLT_EN10MB && dlt!=DLT_RAW){
+        fprintf(stderr,"%s: only Ethernet and raw IP captures are supported\n",argv[0]);
+        exit(1);
+    }
+
+    struct bpf_program fcode;
+    if(pcap_compile(pd,&fcode,expression.c_str(),1,0) < 0){
+        fprintf(stderr,"libpcap: %s\n",pcap_geterr(pd));
+        exit(1);
+    }
+    pktfilter pf;
+    if(!pf.compile(expression)){
+        fprintf(stderr,"pktfilter: %s\n",pf.error().c_str());
+        exit(1);
+    }
+
+    /* Load the capture into memory so that only the filters are timed */
+    std::vector<packet> packets;
+    struct pcap_pkthdr *h;
+    const u_char *data;
+    while(pcap_next_ex(pd,&h,&data)==1){
+        packet pkt;
+        pkt.h = *h;
+        pkt.data.assign(data,data+h->caplen);
+        if(pkt.data.size()==0) pkt.data.push_back(0);
+        packets.push_back(pkt);
+    }
+    if(packets.size()==0){
+        fprintf(stderr,"%s: no packets\n",argv[0]);
+        exit(1);
+    }
+
+    /* Check that the two filters agree */
+    size_t matched = 0;
+    size_t disagree = 0;
+    for(size_t i=0;i<packets.size();i++){
+        const packet &pkt = packets[i];
+        bool bpf = bpf_filter(fcode.bf_insns,&pkt.data[0],pkt.h.len,pkt.h.caplen)!=0;
+        pktfilter::fields f;
+        parse_fields(dlt,pkt,f);
+        bool cf = pf.match(f);
+        if(bpf) matched++;
+        if(bpf!=cf){
+            if(disagree<10) fprintf(stderr,"packet %zu: libpcap=%d compiled=%d\n",i+1,bpf,cf);
+            disagree++;
+        }
+    }
+
+    size_t count = 0;
+    double t0 = now();
+    for(int it=0;it<iterations;it++){
+        for(size_t i=0;i<packets.size();i++){
+            const packet &pkt = packets[i];
+            count += bpf_filter(fcode.bf_insns,&pkt.data[0],pkt.h.len,pkt.h.caplen)!=0;
+        }
+    }
+    double t_bpf = now()-t0;
+
+    t0 = now();
+    for(int it=0;it<iterations;it++){
+        for(size_t i=0;i<packets.size();i++){
+            pktfilter::fields f;
+            parse_fields(dlt,packets[i],f);
+            count += pf.match(f);
+        }
+    }
+    double t_cf = now()-t0;
+
+    double n = (double)packets.size()*iterations;
+    printf("expression:      %zu characters, %u BPF instructions, %zu compiled nodes\n",
+           expression.size(),fcode.bf_len,pf.node_count());
+    printf("packets:         %zu (%zu match), %d iterations\n",packets.size(),matched,iterations);
+    printf("libpcap BPF:     %8.1f ns/packet\n",t_bpf*1e9/n);
+    printf("compiled filter: %8.1f ns/packet\n",t_cf*1e9/n);
+    printf("disagreements:   %zu\n",disagree);
+    if(count==0) printf("\n");         // keep the loops from being optimized away
+    pcap_freecode(&fcode);
+    pcap_close(pd);
+    return disagree ? 1 : 0;
+}
@@ -14,48 +14,73 @@
 #include "http-parser/http_parser.h"
 
 #include "mime_map.h"
-
-#ifdef HAVE_SYS_WAIT_H
-#include <sys/wait.h>
-#endif
-
-
-#ifdef HAVE_LIBZ
-#  define ZLIB_CONST
-#  ifdef GNUC_HAS_DIAGNOSTIC_PRAGMA
-#    pragma GCC diagnostic ignored "-Wundef"
-#    pragma GCC diagnostic ignored "-Wcast-qual"
-#  endif
-#  ifdef HAVE_ZLIB_H
-#    include <zlib.h>
-#  endif
-#else
-#  define z_stream void *               // prevents z_stream from generating an error
-#endif
+#include "http_decoder.h"
+#include "http_executor.h"
+#include "content_sniffer.h"
 
 #define MIN_HTTP_BUFSIZE 80             // don't bother parsing smaller than this
+#define MIN_HTTP_REQUEST_BUFSIZE 18     // "GET / HTTP/1.0\r\n\r\n"
 
 #include <sys/types.h>
 #include <iostream>
 #include <algorithm>
-#include <map>
-#include <iomanip>
+#include <vector>
 
 #define HTTP_CMD "http_cmd"
 #define HTTP_ALERT_FD "http_alert_fd"
+#define HTTP_XML_HEADERS "http_xml_headers"
+#define HTTP_CMD_WORKERS "http_cmd_workers"
+#define HTTP_CMD_QUEUE "http_cmd_queue"
+#define HTTP_CMD_STDIN "http_cmd_stdin"
 
 /* options */
 std::string http_cmd;                   // command to run on each http object
-int http_subproc_max = 10;              // how many subprocesses are we allowed?
-int http_subproc = 0;                   // how many do we currently have?
+http_executor::options http_cmd_opt;    // and how to run it
+http_executor *http_hooks = 0;          // which runs it, once there is a body
 int http_alert_fd = -1;                 // where should we send alerts?
+bool http_xml_headers = false;          // put every response header in the DFXML?
+
+
+/* A piece of the buffer being parsed. The whole response is one mapped
+ * buffer, so a header name or value that arrives in several callbacks
+ * is still contiguous and the span just grows; nothing is copied.
+ */
+struct http_span {
+    http_span():p(0),len(0){}
+    http_span(const char *p_,size_t len_):p(p_),len(len_){}
+    const char *p;
+    size_t      len;
+    void extend(const char *at,size_t length) {
+        if(p && at==p+len) len += length;
+        else { p = at; len = length; }
+    }
+    /* Case-insensitive comparison with a lowercase name */
+    bool is(const char *name,size_t n) const { return len==n && strncasecmp(p,name,n)==0; }
+};
 
+/* What the other direction of the connection said in message n: a
+ * request's method and URL, or a response's status. Responses are paired
+ * with requests in order; interim (1xx) responses don't count.
+ */
+struct http_peer_message {
+    http_peer_message():method(),url(),status(0){}
+    std::string  method;
+    std::string  url;
+    unsigned int status;
+};
+typedef std::vector<http_peer_message> http_peer_list_t;
+
+static bool http_interim(unsigned int status)
+{
+    return status>=100 && status<200 && status!=101; // 101 Switching Protocols is final
+}
 
 /* define a callback object for sharing state between scan_http() and its callbacks
  */
-class scan_http_cbo {
+class scan_http_cbo : public http_decoder::sink {
 private:
     typedef enum {NOTHING,FIELD,VALUE} last_on_header_t;
+    typedef std::vector<std::pair<http_span,http_span> > header_list_t;
     scan_http_cbo(const scan_http_cbo& c); // not implemented
     scan_http_cbo &operator=(const scan_http_cbo &c); // not implemented
 
@@ -63,10 +88,14 @@ public:
     virtual ~scan_http_cbo(){
         on_message_complete();          // make sure message was ended
     }
-    scan_http_cbo(const std::string& path_,const char *base_,std::stringstream *xmlstream_) :
+    scan_http_cbo(const std::string& path_,const char *base_,std::stringstream *xmlstream_,
+                  http_parser_type type_,const http_peer_list_t &peer_,http_peer_list_t &messages_) :
         path(path_), base(base_),xmlstream(xmlstream_),xml_fo(),request_no(0),
-        headers(), last_on_header(NOTHING), header_value(), header_field(),
-        output_path(), fd(-1), first_body(true),bytes_written(0),unzip(false),zs(),zinit(false),zfail(false){};
+        type(type_),peer(peer_),messages(messages_),paired(0),url(),method(0),status_code(0),this_peer(0),
+        last_on_header(NOTHING), header_field(), header_value(),
+        content_type(), content_encoding(), all_headers(),
+        output_path(), sniff_extension(false), content(content_sniffer::UNKNOWN),
+        fd(-1), first_body(true),bytes_written(0),hasher(0),decoder(0),decode_failed(false){};
 private:        
         
     const std::string path;             // where data gets written
@@ -74,43 +103,58 @@ private:
     std::stringstream *xmlstream;       // if present, where to put the fileobject annotations
     std::stringstream xml_fo;           // xml stream for this file object
     int request_no;                     // request number
+
+    /* Requests and responses are paired across the two directions */
+    const http_parser_type type;        // what this direction holds
+    const http_peer_list_t &peer;       // and the messages of the other direction
+    http_peer_list_t &messages;         // this direction's, for when the other is scanned
+    size_t      paired;                 // the next peer message to pair with
+    http_span   url;                    // of this request
+    unsigned int method;                // of this request
+    unsigned int status_code;           // of this response
+    const http_peer_message *this_peer; // paired with this message, if any
         
-    /* parsed headers */
-    std::map<std::string, std::string> headers;
-        
-    /* placeholders for possibly-incomplete header data */
+    /* The header being parsed, and the ones we act on */
     last_on_header_t last_on_header;
-    std::string header_value, header_field;
+    http_span header_field, header_value;
+    http_span content_type, content_encoding;
+    header_list_t all_headers;          // only with http_xml_headers
     std::string output_path;
+    bool        sniff_extension;        // the headers didn't give output_path an extension
+    content_sniffer::type_t content;    // what the start of the (decoded) body looks like
     int         fd;                         // fd for writing
     bool        first_body;                 // first call to on_body after headers
     uint64_t    bytes_written;
+    sha1_generator *hasher;                 // what has been written, with -S dedup=1
 
-    /* decompression for gzip-encoded streams. */
-    bool     unzip;           // should we be decompressing?
-    z_stream zs;              // zstream (avoids casting and memory allocation)
-    bool     zinit;           // we have initialized the zstream 
-    bool     zfail;           // zstream failed in some manner, so ignore the rest of this stream
+    /* decompression for gzip, deflate, br and zstd bodies */
+    http_decoder *decoder;              // from the pool; 0 if not decompressing
+    bool     decode_failed;             // the stream was corrupt, so ignore the rest of it
 
     /* The static functions are callbacks; they wrap the method calls */
 #define CBO (reinterpret_cast<scan_http_cbo*>(parser->data))
 public:
     static int scan_http_cb_on_message_begin(http_parser * parser) { return CBO->on_message_begin();}
-    static int scan_http_cb_on_url(http_parser * parser, const char *at, size_t length) { return 0;}
+    static int scan_http_cb_on_url(http_parser * parser, const char *at, size_t length) { return CBO->on_url(at,length);}
     static int scan_http_cb_on_header_field(http_parser * parser, const char *at, size_t length) { return CBO->on_header_field(at,length);}
     static int scan_http_cb_on_header_value(http_parser * parser, const char *at, size_t length) { return CBO->on_header_value(at,length); }
-    static int scan_http_cb_on_headers_complete(http_parser * parser) { return CBO->on_headers_complete();}
+    static int scan_http_cb_on_headers_complete(http_parser * parser) { return CBO->on_headers_complete(parser);}
     static int scan_http_cb_on_body(http_parser * parser, const char *at, size_t length) { return CBO->on_body(at,length);}
     static int scan_http_cb_on_message_complete(http_parser * parser) {return CBO->on_message_complete();}
 #undef CBO
+    int on_message_complete();          // also called when parsing stops in mid-message
 private:
     int on_message_begin();
     int on_url(const char *at, size_t length);
     int on_header_field(const char *at, size_t length);
     int on_header_value(const char *at, size_t length);
-    int on_headers_complete();
+    int on_headers_complete(const http_parser *parser);
     int on_body(const char *at, size_t length);
-    int on_message_complete();          
+    void header_complete();
+    void open_output();
+    void write_xml_headers();
+    void write_xml_message();           // method, URL, status and, with http_xml_headers, headers
+    bool write(const uint8_t *buf,size_t len); // the decoder's output
 };
     
 
@@ -126,41 +170,34 @@ int scan_http_cbo::on_message_begin()
 }
 
 /**
- * on_url currently not implemented.
+ * on_url: the request's URL, which may arrive in pieces
  */
 
 int scan_http_cbo::on_url(const char *at, size_t length)
 {
+    url.extend(at,length);
     return 0;
 }
 
 
-/* Note 1: The state machine is defined in http-parser/README.md
- * Note 2: All header field names are converted to lowercase.
- *         This is consistent with the RFC.
+/* Note: The state machine is defined in http-parser/README.md
  */
 
 int scan_http_cbo::on_header_field(const char *at,size_t length)
 {
-    std::string field(at,length);
-    std::transform(field.begin(), field.end(), field.begin(), ::tolower);
-    
+    if(length==0) return 0;
     switch(last_on_header){
-    case NOTHING:                       
-        // Allocate new buffer and copy callback data into it
-        header_field = field;
+    case NOTHING:
+        header_field = http_span(at,length);
         break;
     case VALUE:
-        // New header started.
-        // Copy current name,value buffers to headers
-        // list and allocate new buffer for new name
-        headers[header_field] = header_value;
-        header_field = field;
+        // New header started; the previous one is complete
+        header_complete();
+        header_field = http_span(at,length);
         break;
     case FIELD:
-        // Previous name continues. Reallocate name
-        // buffer and append callback data to it
-        header_field.append(field);
+        // Previous name continues
+        header_field.extend(at,length);
         break;
     }
     last_on_header = FIELD;
@@ -169,17 +206,15 @@ int scan_http_cbo::on_header_field(const char *at,size_t length)
 
 int scan_http_cbo::on_header_value(const char *at, size_t length)
 {
-    const std::string value(at,length);
+    if(length==0) return 0;
     switch(last_on_header){
     case FIELD:
-        //Value for current header started. Allocate
-        //new buffer and copy callback data to it
-        header_value = value;
+        //Value for current header started
+        header_value = http_span(at,length);
         break;
     case VALUE:
-        //Value continues. Reallocate value buffer
-        //and append callback data to it
-        header_value.append(value);
+        //Value continues
+        header_value.extend(at,length);
         break;
     case NOTHING:
         // this shouldn't happen
@@ -191,165 +226,217 @@ int scan_http_cbo::on_header_value(const char *at, size_t length)
     return 0;
 }
 
+/* Keep the headers we act on; header names are case-insensitive (RFC 7230) */
+void scan_http_cbo::header_complete()
+{
+    switch(header_field.len){
+    case 12:
+        if(header_field.is("content-type",12)) content_type = header_value;
+        break;
+    case 16:
+        if(header_field.is("content-encoding",16)) content_encoding = header_value;
+        break;
+    }
+    if(http_xml_headers) all_headers.push_back(std::make_pair(header_field,header_value));
+    header_field = http_span();
+    header_value = http_span();
+}
+
+/* Only with http_xml_headers: the headers of this response, with lowercase names */
+void scan_http_cbo::write_xml_headers()
+{
+    for(header_list_t::const_iterator it=all_headers.begin();it!=all_headers.end();it++){
+        std::string name(it->first.p,it->first.len);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        xml_fo << "<http_header name='" << dfxml_writer::xmlescape(name) << "'>"
+               << dfxml_writer::xmlescape(std::string(it->second.p,it->second.len)) << "</http_header>";
+    }
+}
+
+/* The request and the response this message belongs to */
+void scan_http_cbo::write_xml_message()
+{
+    const char *m = type==HTTP_REQUEST ? http_method_str((enum http_method)method)
+                                       : (this_peer && this_peer->method.size() ? this_peer->method.c_str() : 0);
+    if(m) xml_fo << "<http_method>" << m << "</http_method>";
+    if(type==HTTP_REQUEST && url.len){
+        xml_fo << "<http_url>" << dfxml_writer::xmlescape(std::string(url.p,url.len)) << "</http_url>";
+    } else if(type==HTTP_RESPONSE && this_peer && this_peer->url.size()){
+        xml_fo << "<http_url>" << dfxml_writer::xmlescape(this_peer->url) << "</http_url>";
+    }
+    unsigned int st = type==HTTP_RESPONSE ? status_code : (this_peer ? this_peer->status : 0);
+    if(st) xml_fo << "<http_status>" << st << "</http_status>";
+    if(http_xml_headers) write_xml_headers();
+}
+
 /**
  * called when last header is read.
  * Determine the filename based on request_no and extension.
  * Also see if decompressing is happening...
  */
 
-int scan_http_cbo::on_headers_complete()
+int scan_http_cbo::on_headers_complete(const http_parser *parser)
 {
     tcpdemux *demux = tcpdemux::getInstance();
 
-    /* Add the most recently read header to the map, if any */
-    if (last_on_header==VALUE) {
-        headers[header_field] = header_value;
-        header_field="";
+    /* The most recently read header, if any */
+    if (last_on_header==VALUE) header_complete();
+    last_on_header = NOTHING;
+
+    /* Pair this message with its request or response */
+    this_peer = paired<peer.size() ? &peer[paired] : 0;
+    if (type==HTTP_REQUEST) {
+        method = parser->method;
+        paired++;
+    } else {
+        status_code = parser->status_code;
+        if (!http_interim(status_code)) paired++;
+    }
+    if (type==HTTP_REQUEST || !http_interim(status_code)) {
+        messages.push_back(http_peer_message());
+        http_peer_message &m = messages.back();
+        if (type==HTTP_REQUEST) {
+            m.method = http_method_str((enum http_method)method);
+            m.url.assign(url.p ? url.p : "",url.len);
+        } else {
+            m.status = status_code;
+        }
     }
         
     /* Set output path to <path>-HTTPBODY-nnn.ext for each part.
      * This is not consistent with tcpflow <= 1.3.0, which supported only one HTTPBODY,
      * but it's correct...
      */
-    
-    std::stringstream os;
-    os << path << "-HTTPBODY-" << std::setw(3) << std::setfill('0') << request_no << std::setw(0);
-
-    /* See if we can guess a file extension */
-    std::string extension = get_extension_for_mime_type(headers["content-type"]);
-    if (extension.size()) {
-        os << "." << extension;
+    char num[32];
+    snprintf(num,sizeof(num),"-HTTPBODY-%03d",request_no);
+    output_path.assign(path);
+    output_path.append(num);
+
+    /* See if we can guess a file extension; if not, on_body() sniffs the body for one */
+    sniff_extension = true;
+    if (content_type.len) {
+        const char *extension = mime_extension(content_type.p,content_type.len);
+        if (extension[0]) {
+            output_path.append(".");
+            output_path.append(extension);
+            sniff_extension = false;
+        }
     }
         
-    output_path = os.str();
-        
     /* Choose an output function based on the content encoding */
-    std::string content_encoding(headers["content-encoding"]);
-
-    if ((content_encoding == "gzip" || content_encoding == "deflate") && (demux->opt.gzip_decompress)){
-#ifdef HAVE_LIBZ
-        DEBUG(10) ( "%s: detected zlib content, decompressing", output_path.c_str());
-        unzip = true;
-#else
-        /* We can't decompress, so just give it a .gz */
-        output_path.append(".gz");
-        DEBUG(5) ( "%s: refusing to decompress since zlib is unavailable", output_path.c_str() );
-#endif
+    http_decoder::encoding_t enc = http_decoder::encoding(content_encoding.p,content_encoding.len);
+    if (enc!=http_decoder::IDENTITY && demux->opt.gzip_decompress){
+        decoder = http_decoder::get(enc);
+        if (decoder) {
+            DEBUG(10) ( "%s: detected %s content, decompressing", output_path.c_str(), http_decoder::name(enc));
+        } else {
+            /* We can't decompress, so just give it the usual extension */
+            sniff_extension = false;
+            output_path.append(".");
+            output_path.append(http_decoder::extension(enc));
+            DEBUG(5) ( "%s: refusing to decompress since %s is unsupported", output_path.c_str(), http_decoder::name(enc) );
+        }
     } 
         
-    /* Open the output path */
+    first_body = true;                  // next call to on_body will be the first one
+        
+    /* We can do something smart with the headers here.
+     *
+     * For example, we could:
+     *  - Record all headers into the report.xml (done with http_xml_headers)
+     *  - Pick the intended filename if we see Content-Disposition: attachment; name="..."
+     *  - Record headers into filesystem extended attributes on the body file
+     */
+
+    /* A response to HEAD has no body, whatever its Content-Length says */
+    if (type==HTTP_RESPONSE && this_peer && this_peer->method=="HEAD") return 1;
+    return 0;
+}
+
+/* Open the output path when the body starts, so that the requests and
+ * responses without one (most GETs, 304s) don't create a file. A file
+ * left by an earlier run with -S dedup=1 may be a link to a shared
+ * object, so it is replaced rather than truncated, whether or not this
+ * run deduplicates.
+ */
+void scan_http_cbo::open_output()
+{
+    tcpdemux *demux = tcpdemux::getInstance();
+    ::unlink(output_path.c_str());
     fd = demux->retrying_open(output_path.c_str(), O_WRONLY|O_CREAT|O_BINARY|O_TRUNC, 0644);
     if (fd < 0) {
         DEBUG(1) ("unable to open HTTP body file %s", output_path.c_str());
+        return;
     }
+    if (demux->dedup) hasher = new sha1_generator();
     if(http_alert_fd>=0){
         std::stringstream ss;
         ss << "open\t" << output_path << "\n";
         const std::string &sso = ss.str();
-        if(write(http_alert_fd,sso.c_str(),sso.size())!=(int)sso.size()){
+        if(::write(http_alert_fd,sso.c_str(),sso.size())!=(int)sso.size()){
             perror("write");
         }
     }
-
-    first_body = true;                  // next call to on_body will be the first one
-        
-    /* We can do something smart with the headers here.
-     *
-     * For example, we could:
-     *  - Record all headers into the report.xml
-     *  - Pick the intended filename if we see Content-Disposition: attachment; name="..."
-     *  - Record headers into filesystem extended attributes on the body file
-     */
-    return 0;
 }
 
 /* Write to fd, optionally decompressing as we go */
 int scan_http_cbo::on_body(const char *at,size_t length)
 {
-    if (fd < 0)    return -1;              // no open fd? (internal error)x
     if (length==0) return 0;               // nothing to write
 
     if(first_body){                      // stuff for first time on_body is called
+        if(decoder==0){
+            content = content_sniffer::sniff((const uint8_t *)at,length);
+            const char *extension = content_sniffer::extension(content);
+            if(sniff_extension && extension[0]){
+                output_path.append(".");
+                output_path.append(extension);
+            }
+        }
+        open_output();
         xml_fo << "     <byte_run file_offset='" << (at-base) << "'><fileobject><filename>" << output_path << "</filename>";
+        write_xml_message();
         first_body = false;
     }
+    if (fd < 0)    return -1;              // couldn't open the output
 
     /* If not decompressing, just write the data and return. */
-    if(unzip==false){
-        int rv = write(fd,at,length);
+    if(decoder==0){
+        int rv = ::write(fd,at,length);
         if(rv<0) return -1;             // write error; that's bad
+        if(hasher) hasher->update((const uint8_t *)at,rv);
         bytes_written += rv;
         return 0;
     }
 
-#ifndef HAVE_LIBZ
-    assert(0);                          // shoudln't have gotten here
-#endif    
-    if(zfail) return 0;                 // stream was corrupt; ignore rest
-    /* set up this round of decompression, using a small local buffer */
-
-    /* Call init if we are not initialized */
-    char decompressed[65536];           // where decompressed data goes
-    if (!zinit) {
-        memset(&zs,0,sizeof(zs));
-        zs.next_in = (Bytef*)at;
-        zs.avail_in = length;
-        zs.next_out = (Bytef*)decompressed;
-        zs.avail_out = sizeof(decompressed);
-        
-        int rv = inflateInit2(&zs, 32 + MAX_WBITS);      /* 32 auto-detects gzip or deflate */
-        if (rv != Z_OK) {
-            /* fail! */
-            DEBUG(3) ("decompression failed at stream initialization; rv=%d bad Content-Encoding?",rv);
-            zfail = true;
-            return 0;
-        }
-        zinit = true;                   // successfully initted
-    } else {
-        zs.next_in = (Bytef*)at;
-        zs.avail_in = length;
-        zs.next_out = (Bytef*)decompressed;
-        zs.avail_out = sizeof(decompressed);
-    }
-        
-    /* iteratively decompress, writing each time */
-    while (zs.avail_in > 0) {
-        /* decompress as much as possible */
-        int rv = inflate(&zs, Z_SYNC_FLUSH);
-                
-        if (rv == Z_STREAM_END) {
-            /* are we done with the stream? */
-            if (zs.avail_in > 0) {
-                /* ...no. */
-                DEBUG(3) ("decompression completed, but with trailing garbage");
-                return 0;
-            }
-        } else if (rv != Z_OK) {
-            /* some other error */
-            DEBUG(3) ("decompression failed (corrupted stream?)");
-            zfail = true;               // ignore the rest of this stream
-            return 0;
-        }
-                
-        /* successful decompression, at least partly */
-        /* write the result */
-        int bytes_decompressed = sizeof(decompressed) - zs.avail_out;
-        ssize_t written = write(fd, decompressed, bytes_decompressed);
-
-        if (written < bytes_decompressed) {
-            DEBUG(3) ("writing decompressed data failed");
-            zfail= true;
-            return 0;
-        }
-        bytes_written += written;
-                
-        /* reset the buffer for the next iteration */
-        zs.next_out = (Bytef*)decompressed;
-        zs.avail_out = sizeof(decompressed);
+    if(decode_failed) return 0;         // stream was corrupt; ignore rest
+    switch(decoder->decode((const uint8_t *)at,length,*this)){
+    case http_decoder::OK:
+    case http_decoder::END:             // anything after the end of the stream is ignored
+        break;
+    case http_decoder::FAILED:
+        DEBUG(3) ("%s: %s decompression failed (corrupted stream?)",
+                  output_path.c_str(), http_decoder::name(decoder->encoding()));
+        decode_failed = true;           // ignore the rest of this stream
+        break;
     }
     return 0;
 }
 
+/* A buffer of decompressed output; the decoder calls this when its buffer fills */
+bool scan_http_cbo::write(const uint8_t *buf,size_t len)
+{
+    if(bytes_written==0) content = content_sniffer::sniff(buf,len);
+    ssize_t written = ::write(fd,buf,len);
+    if (written < (ssize_t)len) {
+        DEBUG(3) ("writing decompressed data failed");
+        if (written<=0) return false;
+    }
+    if(hasher) hasher->update(buf,written);
+    bytes_written += written;
+    return written==(ssize_t)len;
+}
+
 
 /**
  * called at the conclusion of each HTTP body.
@@ -358,11 +445,27 @@ int scan_http_cbo::on_body(const char *at,size_t length)
 
 int scan_http_cbo::on_message_complete()
 {
+    /* A message without a body (a 204 or 304, the response to a HEAD,
+     * Content-Length: 0) has no file, but still has headers to record;
+     * the byte_run is where they start.
+     */
+    if(http_xml_headers && xmlstream && first_body && output_path.size() && all_headers.size()){
+        xml_fo << "     <byte_run file_offset='" << (all_headers.front().first.p-base) << "'><fileobject>";
+        write_xml_message();
+        xml_fo << "</fileobject></byte_run>\n";
+        *xmlstream << xml_fo.str();
+    }
+
     /* Close the file */
-    headers.clear();
-    header_field = "";
-    header_value = "";
+    header_field = http_span();
+    header_value = http_span();
+    content_type = http_span();
+    content_encoding = http_span();
+    all_headers.clear();
     last_on_header = NOTHING;
+    if(decoder && fd >= 0) {
+        decoder->finish(*this);         // what was decoded before the end, or before an error
+    }
     if(fd >= 0) {
         if (::close(fd) != 0) {
             perror("close() of http body");
@@ -372,62 +475,144 @@ int scan_http_cbo::on_message_complete()
 
     /* Erase zero-length files and update the DFXML */
     if(bytes_written>0){
+        if(hasher){
+            tcpdemux::getInstance()->dedup->add(output_path,hasher->final().hexdigest(),bytes_written);
+        }
         /* Update DFXML */
         if(xmlstream){
-            xml_fo << "<filesize>" << bytes_written << "</filesize></fileobject></byte_run>\n";
+            xml_fo << "<filesize>" << bytes_written << "</filesize>";
+            if(content!=content_sniffer::UNKNOWN){
+                xml_fo << "<content>" << content_sniffer::name(content) << "</content>";
+            }
+            if(decoder){
+                xml_fo << "<content_encoding>" << http_decoder::name(decoder->encoding()) << "</content_encoding>"
+                       << "<encoded_size>" << decoder->bytes_in << "</encoded_size>";
+                if(decoder->bytes_in>0){
+                    char ratio[32];
+                    snprintf(ratio,sizeof(ratio),"%.3f",(double)decoder->bytes_out/decoder->bytes_in);
+                    xml_fo << "<decompression_ratio>" << ratio << "</decompression_ratio>";
+                }
+            }
+            xml_fo << "</fileobject></byte_run>\n";
             if(xmlstream) *xmlstream << xml_fo.str();
         }
         if(http_alert_fd>=0){
             std::stringstream ss;
             ss << "close\t" << output_path << "\n";
             const std::string &sso = ss.str();
-            if(write(http_alert_fd,sso.c_str(),sso.size()) != (int)sso.size()){
+            if(::write(http_alert_fd,sso.c_str(),sso.size()) != (int)sso.size()){
                 perror("write");
             }
         }
         if(http_cmd.size()>0 && output_path.size()>0){
-            /* If we are at maximum number of subprocesses, wait for one to exit */
-            std::string cmd = http_cmd + " " + output_path;
-#ifdef HAVE_FORK
-            int status=0;
-            pid_t pid = 0;
-            while(http_subproc >= http_subproc_max){
-                pid = wait(&status);
-                http_subproc--;
-            }
-            /* Fork off a child */
-            pid = fork();
-            if(pid<0) die("Cannot fork child");
-            if(pid==0){
-                /* We are the child */
-                exit(system(cmd.c_str()));
-            }
-            http_subproc++;
-#else
-            system(cmd.c_str());
-#endif            
+            /* Queued for the workers; this never waits for them */
+            if(http_hooks==0) http_hooks = new http_executor(http_cmd,http_cmd_opt);
+            http_hooks->submit(output_path);
         }
     } else {
-        /* Nothing written; erase the file */
-        if(output_path.size() > 0){
+        /* Nothing written; erase the file, if the body started */
+        if(output_path.size() > 0 && !first_body){
             ::unlink(output_path.c_str());
         }
     }
 
     /* Erase the state variables for this part */
+    url = http_span();
+    this_peer = 0;
     xml_fo.str("");
     output_path = "";
     bytes_written=0;
-    unzip = false;
-    if(zinit){
-        inflateEnd(&zs);
-        zinit = false;
+    content = content_sniffer::UNKNOWN;
+    if(hasher){
+        delete hasher;
+        hasher = 0;
     }
-    zfail = false;
+    if(decoder){
+        http_decoder::put(decoder);     // reset when it is next used
+        decoder = 0;
+    }
+    decode_failed = false;
     return 0;
 }
 
 
+/* Collects the method and URL, or the status, of each message in the
+ * other direction of the connection. Only the headers matter here;
+ * the parser skips over the bodies without calling us.
+ */
+class http_peer_reader {
+    http_peer_reader(const http_peer_reader &);            // not implemented
+    http_peer_reader &operator=(const http_peer_reader &); // not implemented
+public:
+    http_peer_reader(http_peer_list_t &list_):list(list_),url(){}
+    http_peer_list_t &list;
+    std::string url;                    // of the request being parsed
+
+#define READER (reinterpret_cast<http_peer_reader*>(parser->data))
+    static int on_url(http_parser *parser,const char *at,size_t length) {
+        READER->url.append(at,length);
+        return 0;
+    }
+    static int on_headers_complete(http_parser *parser) {
+        http_peer_reader *r = READER;
+        if(parser->type==HTTP_RESPONSE && http_interim(parser->status_code)) return 0;
+        r->list.push_back(http_peer_message());
+        http_peer_message &m = r->list.back();
+        if(parser->type==HTTP_REQUEST){
+            m.method = http_method_str((enum http_method)parser->method);
+            m.url.swap(r->url);
+        } else {
+            m.status = parser->status_code;
+        }
+        r->url.clear();
+        return 0;
+    }
+#undef READER
+};
+
+/* The messages of the flow scanned last. tcpdemux scans the two
+ * directions of an HTTP connection one after the other, so the second
+ * finds the first's here rather than parsing its headers again.
+ */
+static std::string      scanned_path;
+static http_peer_list_t scanned_messages;
+
+/* The messages in fname, which holds the other direction of the connection */
+static void read_peer_messages(const std::string &fname,http_parser_type type,http_peer_list_t &list)
+{
+    int fd = open(fname.c_str(),O_RDONLY|O_BINARY);
+    if(fd<0) return;
+    sbuf_t *sbuf = sbuf_t::map_file(fname,fd);
+    if(sbuf){
+        http_parser_settings settings;
+        memset(&settings,0,sizeof(settings));
+        settings.on_url              = http_peer_reader::on_url;
+        settings.on_headers_complete = http_peer_reader::on_headers_complete;
+        http_peer_reader reader(list);
+        const char *buf = reinterpret_cast<const char *>(sbuf->buf);
+        for(size_t offset=0;offset<sbuf->bufsize;){
+            http_parser parser;
+            http_parser_init(&parser,type);
+            parser.data = &reader;
+            size_t parsed = http_parser_execute(&parser,&settings,buf+offset,sbuf->bufsize-offset);
+            if(parsed==0 || parser.upgrade) break;
+            offset += parsed;
+        }
+        delete sbuf;
+    }
+    close(fd);
+}
+
+/* Does the buffer start with a request line? */
+static bool http_request_start(const sbuf_t &sbuf)
+{
+    static const char *methods[] = {"GET ","POST ","PUT ","HEAD ","DELETE ","OPTIONS ","PATCH ","CONNECT ","TRACE ",0};
+    for(const char **m=methods;*m;m++){
+        if(sbuf.memcmp(reinterpret_cast<const uint8_t *>(*m),0,strlen(*m))==0) return true;
+    }
+    return false;
+}
+
 /***
  * the HTTP scanner plugin itself
  */
@@ -446,13 +631,49 @@ void  scan_http(const class scanner_params &sp,const recursion_control_block &rc
         sp.info->flags = scanner_info::SCANNER_DISABLED; // default disabled
         sp.info->get_config(HTTP_CMD,&http_cmd,"Command to execute on each HTTP attachment");
         sp.info->get_config(HTTP_ALERT_FD,&http_alert_fd,"File descriptor to send information about completed HTTP attachments");
+        sp.info->get_config(HTTP_XML_HEADERS,&http_xml_headers,"Record every HTTP response header in the DFXML");
+        sp.info->get_config(HTTP_CMD_WORKERS,&http_cmd_opt.workers,"Processes running http_cmd, one body each");
+        uint64_t queue_max = http_cmd_opt.queue_max;
+        sp.info->get_config(HTTP_CMD_QUEUE,&queue_max,"Bodies waiting for http_cmd; more are dropped");
+        http_cmd_opt.queue_max = queue_max;
+        sp.info->get_config(HTTP_CMD_STDIN,&http_cmd_opt.use_stdin,"Start http_cmd once and write it a body path per line");
         return;         /* No feature files created */
     }
 
+    if(sp.phase==scanner_params::PHASE_SHUTDOWN){
+        /* Let the hooks finish, and record how they went */
+        if(http_hooks){
+            http_hooks->close();
+            if(sp.sxml) http_hooks->write_xml(*sp.sxml);
+            delete http_hooks;
+            http_hooks = 0;
+        }
+        return;
+    }
+
     if(sp.phase==scanner_params::PHASE_SCAN){
-        /* See if there is an HTTP response */
+        /* See if there are HTTP responses, or requests */
+        http_parser_type type = HTTP_BOTH;  // neither
         if(sp.sbuf.bufsize>=MIN_HTTP_BUFSIZE && sp.sbuf.memcmp(reinterpret_cast<const uint8_t *>("HTTP/1."),0,7)==0){
-            /* Smells enough like HTTP to try parsing */
+            type = HTTP_RESPONSE;
+        } else if(sp.sbuf.bufsize>=MIN_HTTP_REQUEST_BUFSIZE && http_request_start(sp.sbuf)){
+            type = HTTP_REQUEST;
+        }
+        if(type!=HTTP_BOTH){
+            /* Smells enough like HTTP to try parsing. The other direction of the
+             * connection, if it was written, supplies the other half of each pair.
+             */
+            http_peer_list_t peer;
+            tcpdemux *demux = tcpdemux::getInstance();
+            if(demux->scan_flow){
+                std::string peer_path = demux->reverse_pathname(demux->scan_flow->myflow);
+                if(peer_path.size() && peer_path==scanned_path){
+                    peer.swap(scanned_messages);
+                } else if(peer_path.size()){
+                    read_peer_messages(peer_path,type==HTTP_RESPONSE ? HTTP_REQUEST : HTTP_RESPONSE,peer);
+                }
+            }
+
             /* Set up callbacks */
             http_parser_settings scan_http_parser_settings;
             memset(&scan_http_parser_settings,0,sizeof(scan_http_parser_settings)); // in the event that new callbacks get created
@@ -463,10 +684,17 @@ void  scan_http(const class scanner_params &sp,const recursion_control_block &rc
             scan_http_parser_settings.on_headers_complete       = scan_http_cbo::scan_http_cb_on_headers_complete;
             scan_http_parser_settings.on_body                   = scan_http_cbo::scan_http_cb_on_body;
             scan_http_parser_settings.on_message_complete       = scan_http_cbo::scan_http_cb_on_message_complete;
+
+            /* One callback object for the whole transcript, so that message
+             * numbers and pairing carry on when the parser is restarted.
+             */
+            const char *base = reinterpret_cast<const char*>(sp.sbuf.buf);
+            http_peer_list_t messages;
+            scan_http_cbo cbo(sp.sbuf.pos0.path,base,sp.sxml,type,peer,messages);
                         
             if(sp.sxml) (*sp.sxml) << "\n    <byte_runs>\n";
             for(size_t offset=0;;){
-                /* Set up a parser instance for the next chunk of HTTP responses and data.
+                /* Set up a parser instance for the next chunk of HTTP messages and data.
                  * This might be repeated several times due to connection re-use and multiple requests.
                  * Note that the parser is not a C++ library but it can pass a "data" to the
                  * callback. We put the address for the scan_http_cbo object in the data and
@@ -479,16 +707,14 @@ void  scan_http(const class scanner_params &sp,const recursion_control_block &rc
                  */
                 sbuf_t sub_buf(sp.sbuf, offset);
                                 
-                const char *base = reinterpret_cast<const char*>(sub_buf.buf);
+                const char *start = reinterpret_cast<const char*>(sub_buf.buf);
                 http_parser parser;
-                http_parser_init(&parser, HTTP_RESPONSE);
-
-                scan_http_cbo cbo(sp.sbuf.pos0.path,base,sp.sxml);
+                http_parser_init(&parser, type);
                 parser.data = &cbo;
 
                 /* Parse */
                 size_t parsed = http_parser_execute(&parser, &scan_http_parser_settings,
-                                                    base, sub_buf.size());
+                                                    start, sub_buf.size());
                 assert(parsed <= sub_buf.size());
                                 
                 /* Indicate EOF (flushing callbacks) and terminate if we parsed the entire buffer.
@@ -497,6 +723,7 @@ void  scan_http(const class scanner_params &sp,const recursion_control_block &rc
                     http_parser_execute(&parser, &scan_http_parser_settings, NULL, 0);
                     break;
                 }
+                cbo.on_message_complete();  // whatever the parser stopped in is finished
                                 
                 /* Stop parsing if we parsed nothing, as that indicates something header! */
                 if (parsed == 0) {
@@ -512,7 +739,10 @@ void  scan_http(const class scanner_params &sp,const recursion_control_block &rc
                 /* Bump the offset for next iteration */
                 offset += parsed;
             }
+            cbo.on_message_complete();
             if(sp.sxml) (*sp.sxml) << "    </byte_runs>";
+            scanned_path = sp.sbuf.pos0.path;
+            scanned_messages.swap(messages);
         }
     }
 }
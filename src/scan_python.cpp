@@ -3,20 +3,140 @@
  *
  * scan_python:
  * Use external python scripts to post-process flow files
+ *
+ * The function is called as function(data, meta): data is a read-only
+ * memoryview of the flow as tcpflow has it mapped, so nothing is copied,
+ * and meta is a dict describing the flow. The memoryview is released
+ * when the function returns; a function that keeps the data must copy it.
+ *
+ * With -S py_batch=N the function is called with a list of N (data, meta)
+ * tuples at a time and returns a list of N results. With -S py_workers=N
+ * the flows are run by N worker processes, each with its own interpreter,
+ * so the function neither runs under tcpflow's GIL nor holds up the
+ * capture. Results that are not ready when their flow's fileobject is
+ * written (batches, workers) go in the report's summary instead.
  */
 
 #include "config.h"
 #include "dfxml/src/hash_t.h"
 #include "tcpflow.h"
+#include "tcpip.h"
+#include "tcpdemux.h"
+#include "worker_pool.h"
 
 #include <iostream>
+#include <sstream>
 #include <sys/types.h>
+#include <sys/mman.h>
 
-#if HAVE_PYTHON2_7_PYTHON_H
-#  include <python2.7/Python.h> // Get header: install package "python-devel"
+#if HAVE_PYTHON_H
+#  define PY_SSIZE_T_CLEAN
+#  include <Python.h>           // Get header: install package "python3-devel"
 #endif
 
 
+/* What the function is told about a flow. In a worker it is all that
+ * arrives, as a line of tab-separated fields.
+ */
+struct py_flow
+{
+    py_flow(): path(), src(), dst(), sport(0), dport(0), family(0),
+               start(0), end(0), packets(0), content() { }
+
+    std::string path;
+    std::string src;
+    std::string dst;
+    unsigned int sport;
+    unsigned int dport;
+    unsigned int family;
+    double start;
+    double end;
+    uint64_t packets;
+    std::string content;
+
+    static double seconds(const struct timespec &ts) {
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    void set(const tcpip &tcp) {
+        char ipbuf[INET6_ADDRSTRLEN];
+        const flow &f = tcp.myflow;
+        path    = tcp.flow_pathname;
+        src     = inet_ntop(f.family, f.src.addr, ipbuf, sizeof(ipbuf)) ? ipbuf : "";
+        dst     = inet_ntop(f.family, f.dst.addr, ipbuf, sizeof(ipbuf)) ? ipbuf : "";
+        sport   = f.sport;
+        dport   = f.dport;
+        family  = f.family;
+        start   = seconds(f.tstart);
+        end     = seconds(f.tlast);
+        packets = f.packet_count;
+        content = tcp.content == content_sniffer::UNKNOWN ? "" : content_sniffer::name(tcp.content);
+    }
+
+    std::string job() const {
+        std::stringstream ss;
+        ss.precision(9);
+        ss << std::fixed << path << '\t' << src << '\t' << dst << '\t' << sport << '\t' << dport << '\t'
+           << family << '\t' << start << '\t' << end << '\t' << packets << '\t' << content;
+        return ss.str();
+    }
+
+    bool parse(const std::string &line) {
+        std::vector<std::string> f;
+        size_t pos = 0;
+        for (;;) {
+            size_t tab = line.find('\t', pos);
+            f.push_back(line.substr(pos, tab == std::string::npos ? std::string::npos : tab - pos));
+            if (tab == std::string::npos) break;
+            pos = tab + 1;
+        }
+        if (f.size() != 10) return false;
+        path    = f[0];
+        src     = f[1];
+        dst     = f[2];
+        sport   = strtoul(f[3].c_str(), 0, 10);
+        dport   = strtoul(f[4].c_str(), 0, 10);
+        family  = strtoul(f[5].c_str(), 0, 10);
+        start   = strtod(f[6].c_str(), 0);
+        end     = strtod(f[7].c_str(), 0);
+        packets = strtoull(f[8].c_str(), 0, 10);
+        content = f[9];
+        return true;
+    }
+};
+
+
+/* A flow file mapped for as long as a batch needs it */
+class py_mapping
+{
+    /* These are not implemented */
+    py_mapping(const py_mapping &);
+    py_mapping &operator=(const py_mapping &);
+public:
+    explicit py_mapping(const std::string &path) : buf(0), len(0), map(0) {
+        int fd = open(path.c_str(), O_RDONLY | O_BINARY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                map = p;
+                buf = static_cast<const uint8_t *>(p);
+                len = st.st_size;
+            }
+        }
+        ::close(fd);
+    }
+    ~py_mapping() {
+        if (map) munmap(map, len);
+    }
+    const uint8_t *buf;
+    size_t len;
+private:
+    void *map;
+};
+
+
 struct ScanPython
 {
     ScanPython()
@@ -24,7 +144,12 @@ struct ScanPython
         , py_module()
         , py_function()
         , init_script()
-#if HAVE_PYTHON2_7_PYTHON_H
+        , py_batch(1)
+        , pool_opt()
+        , pool(NULL)
+        , pending()
+        , deferred()
+#if HAVE_PYTHON_H
         , pythonFunction (NULL)
 #endif
     { }
@@ -34,7 +159,12 @@ struct ScanPython
         , py_module(o.py_module)
         , py_function(o.py_function)
         , init_script(o.init_script)
-#if HAVE_PYTHON2_7_PYTHON_H
+        , py_batch(o.py_batch)
+        , pool_opt(o.pool_opt)
+        , pool(NULL)
+        , pending()
+        , deferred()
+#if HAVE_PYTHON_H
         , pythonFunction (NULL)
 #endif
     { }
@@ -44,7 +174,12 @@ struct ScanPython
         py_module   = o.py_module;
         py_function = o.py_function;
         init_script = o.init_script;
-#if HAVE_PYTHON2_7_PYTHON_H
+        py_batch    = o.py_batch;
+        pool_opt    = o.pool_opt;
+        pool        = NULL;
+        pending.clear();
+        deferred.str("");
+#if HAVE_PYTHON_H
         pythonFunction = NULL;
 #endif
         return *this;
@@ -54,15 +189,31 @@ struct ScanPython
     void init(const scanner_params& sp);
     void before();
     void scan(const scanner_params& sp);
-    void shutdown();
+    void shutdown(const scanner_params& sp);
 
     std::string py_path;
     std::string py_module;
     std::string py_function;
     std::string init_script;
+    unsigned int py_batch;              // flows per call
+    worker_pool::options pool_opt;      // workers==0: call it in tcpflow
+    worker_pool *pool;
+
+    /* Flows waiting for a batch to fill, with their files mapped */
+    std::vector<std::pair<py_flow, py_mapping *> > pending;
+    std::stringstream deferred;         // results for the summary
+
+    bool start_python();
+    void run_batch();
+    std::string result_xml(const py_flow *f, const char *result, bool none) const;
+    static void work(const std::vector<std::string> &jobs, std::vector<std::string> &results, void *arg);
 
-#if HAVE_PYTHON2_7_PYTHON_H
+#if HAVE_PYTHON_H
     PyObject* pythonFunction;
+    std::string call_result(PyObject *result, const py_flow *f) const;
+    void call(const std::vector<const py_flow *> &flows,
+              const std::vector<std::pair<const uint8_t *, size_t> > &data,
+              std::vector<std::string> &results);
 #endif
 };
 
@@ -82,6 +233,15 @@ void ScanPython::startup(const scanner_params& sp)
     sp.info->get_config("py_path", &py_path, "    Directory to find python module (optional)");
     sp.info->get_config("py_module", &py_module, "  Name of python module (script name without extension)");
     sp.info->get_config("py_function", &py_function, "Function name within the python module");
+    pool_opt.workers = 0;
+    sp.info->get_config("py_batch", &py_batch, "   Flows per call of the function, as a list of (data, meta)");
+    sp.info->get_config("py_workers", &pool_opt.workers, " Worker processes running the function; 0 runs it in tcpflow");
+    uint64_t queue_max = pool_opt.queue_max;
+    sp.info->get_config("py_queue", &queue_max, "   Flows waiting for a worker; more are not scanned");
+    pool_opt.queue_max = queue_max;
+    if (py_batch == 0) py_batch = 1;
+    pool_opt.batch = py_batch;
+    if (pool_opt.queue_max < py_batch) pool_opt.queue_max = py_batch;
 }
 
 
@@ -102,9 +262,6 @@ void ScanPython::init(const scanner_params& /*sp*/)
     if (py_module.empty() || py_function.empty()) {
         DEBUG(1)("[scan_python] Cannot call python becase no provided module/function."  "\n"
                  "\t\t\t\t"  "Please use arguments -S py_module=module -S py_function=foo" );
-        // "\n"  "\t\t\t\t"  "The scanner 'python' is disabled to avoid warning messages.");
-        // sp.info->flags = scanner_info::SCANNER_DISABLED;
-        // TODO(simsong): Should we disable the scanner to avoid warnings?
         return;
     }
 
@@ -112,41 +269,229 @@ void ScanPython::init(const scanner_params& /*sp*/)
     init_script = "import sys, os"                          "\n"
                            "workingDir = " + get_working_dir(py_path) + "\n"
                            "sys.path.append(workingDir)"             "\n";
+}
 
-#if HAVE_PYTHON2_7_PYTHON_H
-    // Spawn python interpreter
+/* Spawn the interpreter and find the function; in tcpflow, or in a worker */
+bool ScanPython::start_python()
+{
+#if HAVE_PYTHON_H
+    if (pythonFunction) return true;
+    if (init_script.empty()) return false;
     Py_Initialize();
 
     DEBUG(10) ("[scan_python]  Initialize Python using script:" "\n" "%s", init_script.c_str());
     PyRun_SimpleString(init_script.c_str());
 
-    // Create PyObject from script filename
-    PyObject* pName = PyString_FromString(py_module.c_str());
-    if (pName == NULL) {
-        DEBUG(2) ("[scan_python] Cannot create PyObject from path='%s' and module='%s'"   "\n"
-                  "\t\t\t" "Try using three arguments: -S py_path=path -S py_module=module -S py_function=foo",
-                  py_path.c_str(), py_module.c_str());
-        return;
-    }
-
     // Import script file in python interpreter
-    PyObject* pModule = PyImport_Import(pName);
+    PyObject* pModule = PyImport_ImportModule(py_module.c_str());
     if (pModule == NULL) {
+        if (debug >= 2) PyErr_Print();
+        PyErr_Clear();
         DEBUG(2) ("[scan_python] Cannot import module='%s' from path='%s' in Python interpreter"   "\n"
                   "\t\t\t" "Try using three arguments: -S py_path=path -S py_module=module -S py_function=foo",
                   py_module.c_str(), py_path.c_str());
-        return;
+        return false;
     }
 
     // Identify function to be used
     pythonFunction = PyObject_GetAttrString(pModule, py_function.c_str());
-    if (pythonFunction == NULL) {
+    Py_DECREF(pModule);
+    if (pythonFunction == NULL || !PyCallable_Check(pythonFunction)) {
+        PyErr_Clear();
+        Py_XDECREF(pythonFunction);
+        pythonFunction = NULL;
         DEBUG(2) ("[scan_python] Cannot identify function='%s' in module='%s' from path='%s'"   "\n"
                   "\t\t\t" "Try using three arguments: -S py_path=path -S py_module=module -S py_function=foo",
                   py_function.c_str(), py_module.c_str(), py_path.c_str());
-        return;
+        return false;
+    }
+    return true;
+#else
+    DEBUG(2)
+    ("[scan_python] tcpflow cannot call python scripts required by the scanner 'python'"        "\n"
+     "\t\t" "because the header <Python.h> of Python 3 was not present during the tcpflow build." "\n"
+     "\t\t" "Try to install package 'python3-devel' and build again tcpflow (./configure)");
+    return false;
+#endif
+}
+
+
+/* The <tcpflow:result> for a flow; it names the flow's file when it
+ * goes in the summary rather than in the flow's fileobject.
+ */
+std::string ScanPython::result_xml(const py_flow *f, const char *result, bool none) const
+{
+    std::stringstream ss;
+    ss << "<tcpflow:result scan=\"python\" "
+          "path=\""<< py_path <<"\" "
+          "module=\""<< py_module <<"\" "
+          "function=\""<< py_function << "\"";
+    if (f) ss << " filename=\"" << dfxml_writer::xmlescape(f->path) << "\"";
+    if (none) ss << "/>";
+    else      ss << ">" << dfxml_writer::xmlescape(result) << "</tcpflow:result>";
+    return ss.str();
+}
+
+#if HAVE_PYTHON_H
+static PyObject *py_meta(const py_flow &f, size_t len)
+{
+    PyObject *d = PyDict_New();
+    if (d == NULL) return NULL;
+    PyObject *v;
+#define SET(key, value) v = (value); if (v) { PyDict_SetItemString(d, key, v); Py_DECREF(v); }
+    SET("path",    PyUnicode_DecodeFSDefault(f.path.c_str()));
+    SET("src",     PyUnicode_FromString(f.src.c_str()));
+    SET("dst",     PyUnicode_FromString(f.dst.c_str()));
+    SET("sport",   PyLong_FromUnsignedLong(f.sport));
+    SET("dport",   PyLong_FromUnsignedLong(f.dport));
+    SET("proto",   PyUnicode_FromString("tcp"));
+    SET("family",  PyLong_FromUnsignedLong(f.family));
+    SET("start",   PyFloat_FromDouble(f.start));
+    SET("end",     PyFloat_FromDouble(f.end));
+    SET("packets", PyLong_FromUnsignedLongLong(f.packets));
+    SET("len",     PyLong_FromSize_t(len));
+    SET("content", PyUnicode_FromString(f.content.c_str()));
+#undef SET
+    PyErr_Clear();
+    return d;
+}
+
+/* A memoryview straight onto tcpflow's memory; nothing is copied */
+static PyObject *py_view(const uint8_t *buf, size_t len)
+{
+    static char empty[1];
+    return PyMemoryView_FromMemory(len ? (char *)buf : empty, (Py_ssize_t)len, PyBUF_READ);
+}
+
+/* The memory goes away after the call, so the view must not outlive it */
+static void py_release(PyObject *view)
+{
+    PyObject *r = PyObject_CallMethod(view, "release", NULL);
+    if (r == NULL) {
+        DEBUG(2) ("[scan_python] the function kept a view of the data; it must copy it");
+        PyErr_Clear();
+    }
+    Py_XDECREF(r);
+    Py_DECREF(view);
+}
+
+/* A string result is recorded; None (or nothing) is an empty result */
+std::string ScanPython::call_result(PyObject *result, const py_flow *f) const
+{
+    if (result == NULL || result == Py_None) return result_xml(f, "", true);
+    PyObject *s = PyUnicode_Check(result) ? (Py_INCREF(result), result) : PyObject_Str(result);
+    const char *str = s ? PyUnicode_AsUTF8(s) : NULL;
+    std::string xml = result_xml(f, str ? str : "", str == NULL);
+    PyErr_Clear();
+    Py_XDECREF(s);
+    return xml;
+}
+
+/* Call the function on one flow, or on all of them as a batch */
+void ScanPython::call(const std::vector<const py_flow *> &flows,
+                      const std::vector<std::pair<const uint8_t *, size_t> > &data,
+                      std::vector<std::string> &results)
+{
+    bool summary = pool || py_batch > 1;
+    results.assign(flows.size(), std::string());
+    std::vector<PyObject *> views;
+    PyObject *pResult = NULL;
+    if (py_batch == 1 && flows.size() == 1) {
+        PyObject *view = py_view(data[0].first, data[0].second);
+        PyObject *meta = py_meta(*flows[0], data[0].second);
+        if (view && meta) {
+            views.push_back(view);
+            pResult = PyObject_CallFunctionObjArgs(pythonFunction, view, meta, NULL);
+        } else {
+            Py_XDECREF(view);
+        }
+        Py_XDECREF(meta);
+    } else {
+        PyObject *list = PyList_New(flows.size());
+        for (size_t i = 0; list && i < flows.size(); i++) {
+            PyObject *view = py_view(data[i].first, data[i].second);
+            PyObject *meta = py_meta(*flows[i], data[i].second);
+            PyObject *tuple = (view && meta) ? PyTuple_Pack(2, view, meta) : NULL;
+            if (view) views.push_back(view);
+            Py_XDECREF(meta);
+            PyList_SET_ITEM(list, i, tuple ? tuple : (Py_INCREF(Py_None), Py_None));
+        }
+        if (list) pResult = PyObject_CallFunctionObjArgs(pythonFunction, list, NULL);
+        Py_XDECREF(list);
+    }
+    if (pResult == NULL) {
+        if (debug >= 2) PyErr_Print();
+        PyErr_Clear();
+    }
+
+    if (py_batch == 1 && flows.size() == 1) {
+        if (pResult) results[0] = call_result(pResult, summary ? flows[0] : NULL);
+    } else if (pResult) {
+        /* One result per flow, in order */
+        PyObject *seq = PySequence_Fast(pResult, "the function must return a list");
+        if (seq && (size_t)PySequence_Fast_GET_SIZE(seq) == flows.size()) {
+            for (size_t i = 0; i < flows.size(); i++) {
+                results[i] = call_result(PySequence_Fast_GET_ITEM(seq, i), flows[i]);
+            }
+        } else {
+            DEBUG(2) ("[scan_python] function='%s' did not return a list of %d results",
+                      py_function.c_str(), (int)flows.size());
+            PyErr_Clear();
+        }
+        Py_XDECREF(seq);
     }
+    Py_XDECREF(pResult);
+    for (size_t i = 0; i < views.size(); i++) py_release(views[i]);
+}
 #endif
+
+
+/* In a worker: map each flow and call the function on the batch */
+void ScanPython::work(const std::vector<std::string> &jobs, std::vector<std::string> &results, void *arg)
+{
+    ScanPython *self = static_cast<ScanPython *>(arg);
+    if (!self->start_python()) return;
+#if HAVE_PYTHON_H
+    std::vector<py_flow> flows(jobs.size());
+    std::vector<py_mapping *> maps;
+    std::vector<const py_flow *> fp;
+    std::vector<std::pair<const uint8_t *, size_t> > data;
+    std::vector<size_t> which;          // the job each call slot is for
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (!flows[i].parse(jobs[i])) continue;
+        py_mapping *m = new py_mapping(flows[i].path);
+        maps.push_back(m);
+        if (m->buf == 0) continue;      // gone, or empty
+        fp.push_back(&flows[i]);
+        data.push_back(std::make_pair(m->buf, m->len));
+        which.push_back(i);
+    }
+    std::vector<std::string> r;
+    if (fp.size()) self->call(fp, data, r);
+    for (size_t i = 0; i < r.size(); i++) results[which[i]] = r[i];
+    for (size_t i = 0; i < maps.size(); i++) delete maps[i];
+#else
+    (void)jobs;
+    (void)results;
+#endif
+}
+
+/* In tcpflow: call the function on the flows waiting for a batch */
+void ScanPython::run_batch()
+{
+#if HAVE_PYTHON_H
+    std::vector<const py_flow *> fp;
+    std::vector<std::pair<const uint8_t *, size_t> > data;
+    for (size_t i = 0; i < pending.size(); i++) {
+        fp.push_back(&pending[i].first);
+        data.push_back(std::make_pair(pending[i].second->buf, pending[i].second->len));
+    }
+    std::vector<std::string> r;
+    if (fp.size()) call(fp, data, r);
+    for (size_t i = 0; i < r.size(); i++) deferred << r[i] << "\n";
+#endif
+    for (size_t i = 0; i < pending.size(); i++) delete pending[i].second;
+    pending.clear();
 }
 
 
@@ -158,58 +503,80 @@ void ScanPython::before()
 
 void ScanPython::scan(const scanner_params& sp)
 {
-#if HAVE_PYTHON2_7_PYTHON_H
-    if (pythonFunction == NULL) {
+    if (init_script.empty()) {
         init(sp);
-        if (pythonFunction == NULL) {
-            // DEBUG(1)("[scan_python] Cannot initialize => Disabled the scanner to avoid warning messages.");
-            // sp.info->flags = scanner_info::SCANNER_DISABLED;
-            // TODO(simsong): Should we disable the scanner to avoid warnings?
-            return;
+        if (init_script.empty()) return;
+    }
+#if !HAVE_PYTHON_H
+    start_python();                     // says why not
+    return;
+#endif
+    const tcpip *tcp = tcpdemux::getInstance()->scan_flow;
+    py_flow f;
+    if (tcp) f.set(*tcp);
+
+    /* With workers, tcpflow only says which flow; the worker maps it */
+    if (pool_opt.workers > 0) {
+        if (tcp == 0 || f.path.find_first_of("\t\n") != std::string::npos) return;
+        if (pool == NULL) pool = new worker_pool("python_workers", pool_opt, work, this);
+        pool->submit(f.job());
+        while (pool->results.size()) {
+            if (pool->results.front().size()) deferred << pool->results.front() << "\n";
+            pool->results.pop_front();
         }
+        return;
     }
 
-    // Cast packet buffer contents into a string and create pyObject
-    std::string data(reinterpret_cast<char const*>(sp.sbuf.buf));
-    PyObject* pData = PyString_FromString(data.c_str());
-
-    // Compose python argument in the form of a tuple and pass the argument to
-    // the chosen function; if the function does not return anything or
-    // encounters an error, return to exit and/or display the error
-    PyObject* pArgs = PyTuple_New(1);
-    PyTuple_SetItem(pArgs, 0, pData);
-    PyObject* pResult = PyObject_CallObject(pythonFunction, pArgs);
-    if (pResult) {
-        // If XML-reporting enabled => Insert the string returned by the python function
-        if (sp.sxml) {
-            const char* returned_string = PyString_AsString(pResult);
-
-            (*sp.sxml) << "<tcpflow:result scan=\"python\" "
-                          "path=\""<< py_path <<"\" "
-                          "module=\""<< py_module <<"\" "
-                          "function=\""<< py_function;
-
-            if (returned_string)
-                (*sp.sxml)  <<"\">"<< returned_string <<"</tcpflow:result>";
-            else
-                (*sp.sxml) << "\"/>";
+    if (!start_python()) return;
+
+    if (py_batch > 1) {
+        if (tcp == 0) return;
+        py_mapping *m = new py_mapping(f.path);
+        if (m->buf == 0) {
+            delete m;
+            return;
         }
+        pending.push_back(std::make_pair(f, m));
+        if (pending.size() >= py_batch) run_batch();
+        return;
     }
-#else
-    DEBUG(2)
-    ("[scan_python] tcpflow cannot call python scripts required by the scanner 'python'"        "\n"
-     "\t\t" "because the header <python2.7/Python.h> was not present during the tcpflow build." "\n"
-     "\t\t" "Try to install package 'python-devel' and build again tcpflow (./configure)");
+
+#if HAVE_PYTHON_H
+    // Call the function on the flow where it is in memory, and write
+    // the result in the flow's fileobject
+    std::vector<const py_flow *> fp(1, &f);
+    std::vector<std::pair<const uint8_t *, size_t> > data(1, std::make_pair(sp.sbuf.buf, sp.sbuf.bufsize));
+    std::vector<std::string> r;
+    call(fp, data, r);
+    if (sp.sxml && r.size() && r[0].size()) (*sp.sxml) << r[0];
 #endif
 }
 
 
-void ScanPython::shutdown()
+void ScanPython::shutdown(const scanner_params& sp)
 {
-#if HAVE_PYTHON2_7_PYTHON_H
+    /* Finish the batches and the workers; their results go in the summary */
+    if (pool) {
+        pool->close();
+        while (pool->results.size()) {
+            if (pool->results.front().size()) deferred << pool->results.front() << "\n";
+            pool->results.pop_front();
+        }
+        if (sp.sxml) pool->write_xml(*sp.sxml);
+        delete pool;
+        pool = NULL;
+    }
+    if (pending.size()) run_batch();
+    if (sp.sxml) (*sp.sxml) << deferred.str();
+    deferred.str("");
+
+#if HAVE_PYTHON_H
     // Terminate the python interpreter and exit
-    Py_Finalize();
-    pythonFunction = NULL;
+    if (pythonFunction) {
+        Py_DECREF(pythonFunction);
+        pythonFunction = NULL;
+        Py_Finalize();
+    }
 #endif
 }
 
@@ -247,7 +614,7 @@ extern "C" void scan_python(const scanner_params& sp,
 
     // Called in main thread when scanner is shutdown
     case scanner_params::PHASE_SHUTDOWN:
-        singleton.shutdown();
+        singleton.shutdown(sp);
         break;
     }
 }
@@ -0,0 +1,176 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/**
+ *
+ * scan_tls:
+ * Records what the unencrypted start of a TLS flow says: the server
+ * name, ALPN protocols, cipher suites and JA3/JA3S fingerprint of the
+ * hello, and the server's certificates, which are also written out.
+ */
+
+#include "config.h"
+
+#include "tcpflow.h"
+#include "tcpip.h"
+#include "tcpdemux.h"
+#include "tls_parser.h"
+#include "dfxml/src/hash_t.h"
+
+#if defined(HAVE_OPENSSL_X509_H) && defined(HAVE_OPENSSL_BIO_H) && defined(HAVE_LIBCRYPTO)
+# include <openssl/x509.h>
+# include <openssl/bio.h>
+# define HAVE_X509
+#endif
+
+#include <sys/types.h>
+#include <iostream>
+#include <algorithm>
+
+#define TLS_MAX_BYTES "tls_max_bytes"
+#define TLS_CERTS "tls_certs"
+
+/* options */
+uint64_t tls_max_bytes = 65536;         // how far into a flow to look for the handshake
+bool tls_certs = true;                  // write each certificate to a file?
+
+static const size_t TLS_CHUNK = 4096;   // fed to the parser at a time
+
+#ifdef HAVE_X509
+static std::string x509_name(X509_NAME *name)
+{
+    char buf[1024];
+    if(name==0 || X509_NAME_oneline(name,buf,sizeof(buf))==0) return std::string();
+    return std::string(buf);
+}
+
+static std::string x509_time(const ASN1_TIME *t)
+{
+    std::string s;
+    BIO *bio = BIO_new(BIO_s_mem());
+    if(bio==0) return s;
+    if(t && ASN1_TIME_print(bio,t)){
+        char *p = 0;
+        long len = BIO_get_mem_data(bio,&p);
+        if(p && len>0) s.assign(p,len);
+    }
+    BIO_free(bio);
+    return s;
+}
+#endif
+
+/* Write a certificate to <flow>-CERT-nnn.der and describe it */
+static void write_certificate(const std::string &flow_path,int n,const std::string &der,std::stringstream &xml)
+{
+    xml << "\n      <certificate size='" << der.size() << "'";
+    if(tls_certs){
+        char num[16];
+        snprintf(num,sizeof(num),"-CERT-%03d.der",n);
+        std::string path = flow_path + num;
+        tcpdemux *demux = tcpdemux::getInstance();
+        ::unlink(path.c_str());         // it may be a -S dedup=1 link; don't truncate the others
+        int fd = demux->retrying_open(path.c_str(),O_WRONLY|O_CREAT|O_BINARY|O_TRUNC,0644);
+        if(fd<0){
+            DEBUG(1) ("unable to open certificate file %s",path.c_str());
+        } else {
+            if(::write(fd,der.data(),der.size())!=(ssize_t)der.size()){
+                DEBUG(1) ("write %s: %s",path.c_str(),strerror(errno));
+            }
+            ::close(fd);
+            xml << " filename='" << dfxml_writer::xmlescape(path) << "'";
+        }
+    }
+#ifdef HAVE_EVP_GET_DIGESTBYNAME
+    xml << " sha1='" << sha1_generator::hash_buf(reinterpret_cast<const uint8_t *>(der.data()),der.size()).hexdigest() << "'";
+#endif
+#ifdef HAVE_X509
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(der.data());
+    X509 *x = d2i_X509(0,&p,der.size());
+    if(x){
+        xml << " subject='"    << dfxml_writer::xmlescape(x509_name(X509_get_subject_name(x))) << "'"
+            << " issuer='"     << dfxml_writer::xmlescape(x509_name(X509_get_issuer_name(x))) << "'"
+            << " not_before='" << dfxml_writer::xmlescape(x509_time(X509_get_notBefore(x))) << "'"
+            << " not_after='"  << dfxml_writer::xmlescape(x509_time(X509_get_notAfter(x))) << "'";
+        X509_free(x);
+    }
+#endif
+    xml << "/>";
+}
+
+static void write_tls_xml(const tls_parser &tls,const std::string &flow_path,std::stringstream &xml)
+{
+    uint16_t version = tls.selected_version ? tls.selected_version : tls.version;
+    const char *vname = tls_parser::version_name(version);
+    char hex[8];
+
+    xml << "\n    <tls hello='" << (tls.client_hello ? "client" : "server") << "'";
+    if(vname) xml << " version='" << vname << "'";
+    xml << ">";
+    if(tls.sni.size()) xml << "\n      <sni>" << dfxml_writer::xmlescape(tls.sni) << "</sni>";
+    for(std::vector<std::string>::const_iterator it=tls.alpn.begin();it!=tls.alpn.end();it++){
+        xml << "\n      <alpn>" << dfxml_writer::xmlescape(*it) << "</alpn>";
+    }
+    if(tls.client_hello){
+        xml << "\n      <cipher_suites>";
+        const char *sep = "";
+        for(std::vector<uint16_t>::const_iterator it=tls.ciphers.begin();it!=tls.ciphers.end();it++){
+            if(tls_parser::grease(*it)) continue;
+            snprintf(hex,sizeof(hex),"%04x",*it);
+            xml << sep << hex;
+            sep = " ";
+        }
+        xml << "</cipher_suites>";
+    } else {
+        snprintf(hex,sizeof(hex),"%04x",tls.cipher);
+        xml << "\n      <cipher_suite>" << hex << "</cipher_suite>";
+    }
+
+    const char *tag = tls.client_hello ? "ja3" : "ja3s";
+    std::string ja3 = tls.ja3();
+    xml << "\n      <" << tag;
+#ifdef HAVE_EVP_GET_DIGESTBYNAME
+    xml << " md5='" << md5_generator::hash_buf(reinterpret_cast<const uint8_t *>(ja3.data()),ja3.size()).hexdigest() << "'";
+#endif
+    xml << ">" << ja3 << "</" << tag << ">";
+
+    int n = 1;
+    for(std::vector<std::string>::const_iterator it=tls.certificates.begin();it!=tls.certificates.end();it++){
+        write_certificate(flow_path,n++,*it,xml);
+    }
+    xml << "\n    </tls>";
+}
+
+extern "C"
+void  scan_tls(const class scanner_params &sp,const recursion_control_block &rcb)
+{
+    if(sp.sp_version!=scanner_params::CURRENT_SP_VERSION){
+        std::cerr << "scan_tls requires sp version " << scanner_params::CURRENT_SP_VERSION << "; "
+                  << "got version " << sp.sp_version << "\n";
+        exit(1);
+    }
+
+    if(sp.phase==scanner_params::PHASE_STARTUP){
+        sp.info->name  = "tls";
+        sp.info->flags = scanner_info::SCANNER_DISABLED; // default disabled
+        sp.info->get_config(TLS_MAX_BYTES,&tls_max_bytes,"Bytes at the start of a flow to look for the TLS handshake in");
+        sp.info->get_config(TLS_CERTS,&tls_certs,"Write each TLS certificate to <flow>-CERT-nnn.der");
+        return;         /* No feature files created */
+    }
+
+    if(sp.phase==scanner_params::PHASE_SCAN){
+        /* Only a flow that starts with a handshake record */
+        const uint8_t *buf = sp.sbuf.buf;
+        if(sp.sbuf.bufsize<5 || buf[0]!=tls_parser::CONTENT_HANDSHAKE || buf[1]!=3) return;
+
+        /* A piece at a time, so that the pages of the flow after the
+         * handshake, which is most of it, are never read in.
+         */
+        tls_parser tls;
+        size_t len = std::min<uint64_t>(sp.sbuf.bufsize,tls_max_bytes);
+        for(size_t off=0;off<len && !tls.done();off+=TLS_CHUNK){
+            tls.feed(buf+off,std::min(TLS_CHUNK,len-off));
+        }
+        if(!tls.client_hello && !tls.server_hello) return;
+        std::stringstream xml;          // the certificates are written out either way
+        write_tls_xml(tls,sp.sbuf.pos0.path,xml);
+        if(sp.sxml) (*sp.sxml) << xml.str();
+    }
+}
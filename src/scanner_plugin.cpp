@@ -0,0 +1,39 @@
+/**
+ * scanner_plugin.cpp:
+ *
+ * Loads scanners from shared objects for -P; see scanner_plugin.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "scanner_plugin.h"
+
+#ifdef HAVE_DLFCN_H
+# include <dlfcn.h>
+#endif
+
+scanner_t *load_scanner_plugin(const std::string &path)
+{
+#ifdef HAVE_DLFCN_H
+    /* A name without a slash would be searched for on the library path */
+    std::string fname = path.find('/')==std::string::npos ? "./" + path : path;
+    void *lib = dlopen(fname.c_str(),RTLD_NOW | RTLD_LOCAL);
+    if(lib==0) die("-P %s: %s",path.c_str(),dlerror());
+
+    const tcpflow_plugin *p = static_cast<const tcpflow_plugin *>(dlsym(lib,"tcpflow_plugin_info"));
+    if(p==0) die("-P %s: not a tcpflow scanner (no TCPFLOW_SCANNER_PLUGIN)",path.c_str());
+    if(p->abi!=TCPFLOW_PLUGIN_ABI || p->sp_version!=scanner_params::CURRENT_SP_VERSION
+       || p->si_version!=scanner_info::CURRENT_SI_VERSION || p->sp_size!=sizeof(scanner_params)){
+        die("-P %s: built for plugin ABI %d, sp version %d, si version %d; this tcpflow has %d, %d, %d",
+            path.c_str(),p->abi,p->sp_version,p->si_version,
+            TCPFLOW_PLUGIN_ABI,(int)scanner_params::CURRENT_SP_VERSION,(int)scanner_info::CURRENT_SI_VERSION);
+    }
+    if(p->scanner==0) die("-P %s: no scanner",path.c_str());
+    DEBUG(5)("loaded scanner plugin %s",path.c_str());
+    return p->scanner;                  // the library stays loaded until tcpflow exits
+#else
+    die("-P %s: this tcpflow was built without dlopen()",path.c_str());
+#endif
+}
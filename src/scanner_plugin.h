@@ -0,0 +1,60 @@
+/*
+ * scanner_plugin.h:
+ *
+ * Scanners built as shared objects and loaded with -P file.so, so that
+ * a decoder can be added to tcpflow without patching and rebuilding it.
+ *
+ * A plugin is an ordinary scanner_t, compiled against the same
+ * be13_api headers as tcpflow, that declares itself with
+ *
+ *     #include "tcpflow.h"
+ *     #include "scanner_plugin.h"
+ *
+ *     extern "C" void scan_foo(const scanner_params &sp,const recursion_control_block &rcb);
+ *     TCPFLOW_SCANNER_PLUGIN(scan_foo)
+ *
+ * and is built with, e.g., g++ -shared -fPIC -I<tcpflow>/src scan_foo.cpp.
+ * It gets the same phases as the built-in scanners: PHASE_STARTUP to
+ * set its name, options and packet callback, PHASE_SCAN for each flow
+ * post-processed, and PHASE_SHUTDOWN.
+ *
+ * The macro records the versions of the interfaces the plugin was built
+ * with. tcpflow refuses a plugin whose versions differ from its own
+ * before calling its scanner, since a scanner_params or scanner_info of
+ * a different layout would be misread rather than rejected. The check
+ * can only be made once the library is loaded, so the plugin's static
+ * constructors have run by then, whatever its version; a plugin should
+ * leave its setup to PHASE_STARTUP.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef SCANNER_PLUGIN_H
+#define SCANNER_PLUGIN_H
+
+#include <string>
+#include "be13_api/bulk_extractor_i.h"
+
+/* Bumped when what tcpflow itself shares with scanners changes:
+ * the tcpdemux, tcpip and flow classes a scanner may look at.
+ */
+#define TCPFLOW_PLUGIN_ABI 1
+
+struct tcpflow_plugin {
+    int abi;                            // TCPFLOW_PLUGIN_ABI
+    int sp_version;                     // scanner_params::CURRENT_SP_VERSION
+    int si_version;                     // scanner_info::CURRENT_SI_VERSION
+    size_t sp_size;                     // sizeof(scanner_params)
+    scanner_t *scanner;
+};
+
+#define TCPFLOW_SCANNER_PLUGIN(fn)                                      \
+    extern "C" const tcpflow_plugin tcpflow_plugin_info = {             \
+        TCPFLOW_PLUGIN_ABI, scanner_params::CURRENT_SP_VERSION,         \
+        scanner_info::CURRENT_SI_VERSION, sizeof(scanner_params), fn };
+
+/* Load the scanner in a plugin; exits if it can't be used */
+scanner_t *load_scanner_plugin(const std::string &path);
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * segment_writer.cpp:
+ *
+ * Appends flow data to segment files and records it in the index;
+ * see segment_writer.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "tcpip.h"
+#include "segment_writer.h"
+
+static_assert(sizeof(segment_index::header)==16,"segment index header");
+static_assert(sizeof(segment_index::flow_rec)==72,"segment index flow record");
+static_assert(sizeof(segment_index::extent_rec)==40,"segment index extent record");
+static_assert(sizeof(segment_index::shift_rec)==24,"segment index shift record");
+
+segment_writer::segment_writer(const std::string &outdir_,uint64_t segment_size_):
+    outdir(outdir_),segment_size(segment_size_),seg(0),seg_buf(BUFFER_SIZE),segment(0),seg_bytes(0),
+    idx(0),idx_buf(BUFFER_SIZE),pending(),have_pending(false)
+{
+    std::string fname = outdir + "/" + segment_index::INDEX_NAME;
+    idx = fopen(fname.c_str(),"wb");
+    if(idx==0) die("cannot create %s: %s",fname.c_str(),strerror(errno));
+    setvbuf(idx,&idx_buf[0],_IOFBF,idx_buf.size());
+
+    segment_index::header h;
+    memset(&h,0,sizeof(h));
+    memcpy(h.magic,segment_index::MAGIC,sizeof(h.magic));
+    h.byte_order = segment_index::ORDER_MARK;
+    write_idx(&h,sizeof(h));
+    open_segment();
+}
+
+segment_writer::~segment_writer()
+{
+    flush_pending();
+    if(seg && fclose(seg)) perror("segment close");
+    if(idx && fclose(idx)) perror("segment index close");
+}
+
+void segment_writer::open_segment()
+{
+    if(seg && fclose(seg)) die("cannot close %s: %s",segment_index::segment_name(segment).c_str(),strerror(errno));
+    if(seg) segment++;
+    std::string fname = outdir + "/" + segment_index::segment_name(segment);
+    seg = fopen(fname.c_str(),"wb");
+    if(seg==0) die("cannot create %s: %s",fname.c_str(),strerror(errno));
+    setvbuf(seg,&seg_buf[0],_IOFBF,seg_buf.size());
+    seg_bytes = 0;
+}
+
+void segment_writer::write_idx(const void *rec,size_t len)
+{
+    if(fwrite(rec,1,len,idx)!=len) die("cannot write %s: %s",segment_index::INDEX_NAME,strerror(errno));
+}
+
+void segment_writer::flush_pending()
+{
+    if(have_pending) write_idx(&pending,sizeof(pending));
+    have_pending = false;
+}
+
+void segment_writer::add_flow(const flow &f,const std::string &name)
+{
+    segment_index::flow_rec r;
+    memset(&r,0,sizeof(r));
+    size_t name_len = name.size() < 65535 ? name.size() : 65535;
+    size_t padded   = (name_len + 7) & ~(size_t)7;
+    r.h.type        = segment_index::REC_FLOW;
+    r.h.len         = sizeof(r) + padded;
+    r.id            = f.id;
+    r.tstart_sec    = f.tstart.tv_sec;
+    r.tstart_nsec   = f.tstart.tv_nsec;
+    r.sport         = f.sport;
+    r.dport         = f.dport;
+    r.ip_version    = f.family==AF_INET6 ? 6 : 4;
+    r.name_len      = name_len;
+    memcpy(r.src,f.src.addr,f.family==AF_INET6 ? 16 : 4);
+    memcpy(r.dst,f.dst.addr,f.family==AF_INET6 ? 16 : 4);
+
+    static const char zeros[8] = {0,0,0,0,0,0,0,0};
+    flush_pending();
+    write_idx(&r,sizeof(r));
+    write_idx(name.data(),name_len);
+    write_idx(zeros,padded-name_len);
+}
+
+segment_writer::extent segment_writer::write(uint64_t id,uint64_t flow_offset,const uint8_t *data,uint32_t length)
+{
+    if(seg_bytes>0 && seg_bytes+length > segment_size) open_segment();
+    if(fwrite(data,1,length,seg)!=length){
+        die("cannot write %s: %s",segment_index::segment_name(segment).c_str(),strerror(errno));
+    }
+    extent e(flow_offset,segment,seg_bytes,length);
+    seg_bytes += length;
+
+    /* Extend the last extent if this continues it, as bulk transfers do */
+    if(have_pending && pending.id==id && pending.segment==segment
+       && pending.seg_offset+pending.length==e.seg_offset
+       && pending.flow_offset+pending.length==flow_offset
+       && (uint64_t)pending.length+length <= 0xffffffffULL){
+        pending.length += length;
+        return e;
+    }
+    flush_pending();
+    memset(&pending,0,sizeof(pending));
+    pending.h.type      = segment_index::REC_EXTENT;
+    pending.h.len       = sizeof(pending);
+    pending.id          = id;
+    pending.flow_offset = flow_offset;
+    pending.seg_offset  = e.seg_offset;
+    pending.segment     = segment;
+    pending.length      = length;
+    have_pending = true;
+    return e;
+}
+
+void segment_writer::shift(uint64_t id,uint64_t bytes)
+{
+    segment_index::shift_rec r;
+    memset(&r,0,sizeof(r));
+    r.h.type = segment_index::REC_SHIFT;
+    r.h.len  = sizeof(r);
+    r.id     = id;
+    r.bytes  = bytes;
+    flush_pending();
+    write_idx(&r,sizeof(r));
+}
+
+void segment_writer::flush()
+{
+    flush_pending();
+    if(fflush(seg) || fflush(idx)) die("cannot write segment output: %s",strerror(errno));
+}
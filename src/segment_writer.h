@@ -0,0 +1,128 @@
+/*
+ * segment_writer.h:
+ *
+ * Segment output (-S segments=1): instead of one file per flow, the
+ * bytes of every flow are appended to a few large segment files, and an
+ * index records where each piece of each flow went.
+ *
+ *   outdir/tcpflow-000000.seg    flow data, written once, sequentially
+ *   outdir/tcpflow-000001.seg    ...started when the previous one is full
+ *   outdir/tcpflow.idx           the index
+ *
+ * The index is a header followed by records, in host byte order:
+ *
+ *   FLOW    a new flow: its id, addresses, ports, start time and the
+ *           name it would have had as a file (relative to outdir)
+ *   EXTENT  length bytes of flow id, at flow_offset in the flow,
+ *           stored at seg_offset in segment number segment
+ *   SHIFT   bytes were inserted at the start of flow id, so every
+ *           earlier extent of the flow moves up by that much
+ *
+ * Replaying the records of a flow in order (later extents overwrite
+ * earlier ones) recreates the file that tcpflow would have written;
+ * tcpflow-extract does that.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef SEGMENT_WRITER_H
+#define SEGMENT_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace segment_index {
+    static const char     MAGIC[8] = {'T','F','S','E','G','I','X','1'};
+    static const uint32_t ORDER_MARK = 0x01020304; // reads back differently if swapped
+    enum { REC_FLOW=1, REC_EXTENT=2, REC_SHIFT=3 };
+
+    struct header {
+        char     magic[8];
+        uint32_t byte_order;
+        uint32_t reserved;
+    };
+    /* Every record starts with type and its total length, a multiple of 8 */
+    struct rec_header {
+        uint32_t type;
+        uint32_t len;
+    };
+    struct flow_rec {                   // followed by the name, NUL-padded to a multiple of 8
+        rec_header h;
+        uint64_t id;
+        int64_t  tstart_sec;
+        uint32_t tstart_nsec;
+        uint16_t sport;
+        uint16_t dport;
+        uint8_t  ip_version;            // 4 or 6
+        uint8_t  reserved0;
+        uint16_t name_len;
+        uint32_t reserved;
+        uint8_t  src[16];
+        uint8_t  dst[16];
+    };
+    struct extent_rec {
+        rec_header h;
+        uint64_t id;
+        uint64_t flow_offset;
+        uint64_t seg_offset;
+        uint32_t segment;
+        uint32_t length;
+    };
+    struct shift_rec {
+        rec_header h;
+        uint64_t id;
+        uint64_t bytes;
+    };
+
+    inline std::string segment_name(uint32_t segment) {
+        char buf[32];
+        snprintf(buf,sizeof(buf),"tcpflow-%06u.seg",segment);
+        return std::string(buf);
+    }
+    static const char INDEX_NAME[] = "tcpflow.idx";
+}
+
+class segment_writer {
+    /* These are not implemented */
+    segment_writer(const segment_writer &);
+    segment_writer &operator=(const segment_writer &);
+public:
+    /* Where a piece of a flow was stored; also kept by tcpip for DFXML */
+    struct extent {
+        extent(uint64_t fo,uint32_t s,uint64_t so,uint32_t l):flow_offset(fo),segment(s),seg_offset(so),length(l){}
+        uint64_t flow_offset;
+        uint32_t segment;
+        uint64_t seg_offset;
+        uint32_t length;
+    };
+
+    segment_writer(const std::string &outdir,uint64_t segment_size);
+    virtual ~segment_writer();
+
+    void   add_flow(const class flow &f,const std::string &name);
+    extent write(uint64_t id,uint64_t flow_offset,const uint8_t *data,uint32_t length);
+    void   shift(uint64_t id,uint64_t bytes);
+    void   flush();
+
+private:
+    enum { BUFFER_SIZE = 4*1024*1024 };
+    std::string  outdir;
+    uint64_t     segment_size;          // start a new segment beyond this many bytes
+    FILE        *seg;                   // current segment
+    std::vector<char> seg_buf;
+    uint32_t     segment;               // its number
+    uint64_t     seg_bytes;             // bytes in it
+    FILE        *idx;
+    std::vector<char> idx_buf;
+    segment_index::extent_rec pending;  // the last extent, which the next may extend
+    bool         have_pending;
+
+    void open_segment();
+    void write_idx(const void *rec,size_t len);
+    void flush_pending();
+};
+
+#endif
@@ -23,64 +23,153 @@
 /* static */ uint32_t tcpdemux::tcp_timeout = 0;
 
 tcpdemux::tcpdemux():
-#ifdef HAVE_SQLITE3
-    db(),insert_flow(),
-#endif
-    outdir("."),flow_counter(0),packet_counter(0),
-    xreport(0),pwriter(0),max_open_flows(),max_fds(get_max_fds()-NUM_RESERVED_FDS),
+    db(0),
+    outdir("."),flow_counter(0),packet_counter(0),bad_checksum_counter(0),unscanned_flow_counter(0),
+    xreport(0),xml_unflushed(0),xml_last_flush(0),pwriter(0),pfilter(0),segments(0),stream(0),dedup(0),summary(0),console(),scan_flow(0),classifier(),max_open_flows(),max_fds(get_max_fds()-NUM_RESERVED_FDS),
     flow_map(),open_flows(),saved_flow_map(),
-    saved_flows(),start_new_connections(false),opt(),fs()
+    saved_flows(),deferred_flows(),start_new_connections(false),opt(),fs()
 {
 }
 
-void tcpdemux::openDB()
+void tcpdemux::openDB(const std::string &fname,const flow_db::options &dbopt)
 {
-#ifdef HAVE_SQLITE3
-    int rc = sqlite3_open("test.db", &db);
-    if( rc ){
-        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
-        db = 0;
-    }
-    /* Create SQL statement */
-    const char *sql = "CREATE TABLE connections ("
-        "starttime TEXT NOT NULL,"
-        "endtime TEXT NOT NULL,"
-        "src_ipn TEXT,"  
-        "dst_ipn TEXT,"
-        "mac_daddr TEXT,"
-        "mac_saddr TEXT,"
-        "packets INTEGER,"
-        "srcport INTEGER,"
-        "dstport INTEGER,"
-        "hashdigest_md5 TEXT);";
-
-    /* Execute SQL statement */
-    rc = sqlite3_exec(db, sql, callback, 0, &zErrMsg);
-    if( rc != SQLITE_OK ){
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
-        sqlite3_close(db);
-        return 0;
+    db = new flow_db();
+    if(!db->open(fname,dbopt)){
+        die("cannot open flow database %s: %s",fname.c_str(),db->error().c_str());
     }
-    const char* zSql = "INSERT INTO connections (starttime,endtime,src_ipn,dst_ipn,mac_daddr,mac_saddr,packets,srcport,dstport,hashdigest_md5) VALUES (?,?,?,?,?,?,?,?,?,?)";
-    if(sqlite3_prepare_v2(db, zSql, strlen(zSql), &insert_stmt, NULL)!=SQLITE_OK ){
-        fprintf(stderr, "SQL prepare error");
+}
+
+void tcpdemux::closeDB()
+{
+    if(db){
+        db->close();
+        delete db;
         db = 0;
-        insert_stmt=0;
-        return(0);
     }
-#endif
 }
 
+/* Queues the row; flow_db inserts it later, in a batch */
 void  tcpdemux::write_flow_record(const std::string &starttime,const std::string &endtime,
                         const std::string &src_ipn,const std::string &dst_ipn,
                         const std::string &mac_daddr,const std::string &mac_saddr,
                         uint64_t packets,uint16_t srcport,uint16_t dstport,
                         const std::string &hashdigest_md5)
 {
+    if(db==0) return;
+    flow_db::record r;
+    r.starttime = starttime;
+    r.endtime   = endtime;
+    r.src_ipn   = src_ipn;
+    r.dst_ipn   = dst_ipn;
+    r.mac_daddr = mac_daddr;
+    r.mac_saddr = mac_saddr;
+    r.packets   = packets;
+    r.srcport   = srcport;
+    r.dstport   = dstport;
+    r.hashdigest_md5 = hashdigest_md5;
+    db->add(r);
 }
 
+/* The columns of the flow summary, in the order openSummary() adds them */
+enum {
+    SUM_STARTIME, SUM_ENDTIME, SUM_FAMILY, SUM_SRC_IP, SUM_DST_IP, SUM_SRCPORT, SUM_DSTPORT,
+    SUM_MAC_SADDR, SUM_MAC_DADDR, SUM_VLAN, SUM_PACKETS, SUM_LEN, SUM_CAPLEN,
+    SUM_OUT_OF_ORDER, SUM_VIOLATIONS, SUM_MD5, SUM_FILENAME
+};
 
+void tcpdemux::openSummary(const std::string &fname,const arrow_writer::options &aopt)
+{
+    summary = new arrow_writer();
+    summary->add_column("startime",arrow_writer::TIMESTAMP_NS,false);
+    summary->add_column("endtime",arrow_writer::TIMESTAMP_NS,false);
+    summary->add_column("family",arrow_writer::UINT8,false);
+    summary->add_column("src_ipn",arrow_writer::DICT_UTF8,false);
+    summary->add_column("dst_ipn",arrow_writer::DICT_UTF8,false);
+    summary->add_column("srcport",arrow_writer::UINT16,false);
+    summary->add_column("dstport",arrow_writer::UINT16,false);
+    summary->add_column("mac_saddr",arrow_writer::DICT_UTF8,true);
+    summary->add_column("mac_daddr",arrow_writer::DICT_UTF8,true);
+    summary->add_column("vlan",arrow_writer::INT32,true);
+    summary->add_column("packets",arrow_writer::UINT64,false);
+    summary->add_column("len",arrow_writer::UINT64,false);
+    summary->add_column("caplen",arrow_writer::UINT64,false);
+    summary->add_column("out_of_order_count",arrow_writer::UINT64,false);
+    summary->add_column("violations",arrow_writer::UINT64,false);
+    summary->add_column("hashdigest_md5",arrow_writer::UTF8,true);
+    int last = summary->add_column("filename",arrow_writer::UTF8,true);
+    assert(last==SUM_FILENAME);
+    (void)last;
+    if(!summary->open(fname,aopt)){
+        die("cannot create flow summary %s",summary->error().c_str());
+    }
+}
+
+void tcpdemux::write_summary(const tcpip *tcp,const std::string &md5)
+{
+    const flow &f = tcp->myflow;
+    char ipbuf[INET6_ADDRSTRLEN];
+    summary->append(SUM_STARTIME,f.tstart);
+    summary->append(SUM_ENDTIME,f.tlast);
+    summary->append(SUM_FAMILY,(uint64_t)f.family);
+    summary->append(SUM_SRC_IP,std::string(inet_ntop(f.family,f.src.addr,ipbuf,sizeof(ipbuf)) ? ipbuf : ""));
+    summary->append(SUM_DST_IP,std::string(inet_ntop(f.family,f.dst.addr,ipbuf,sizeof(ipbuf)) ? ipbuf : ""));
+    summary->append(SUM_SRCPORT,(uint64_t)f.sport);
+    summary->append(SUM_DSTPORT,(uint64_t)f.dport);
+    if(f.has_mac_saddr()) summary->append(SUM_MAC_SADDR,macaddr(f.mac_saddr));
+    else summary->append_null(SUM_MAC_SADDR);
+    if(f.has_mac_daddr()) summary->append(SUM_MAC_DADDR,macaddr(f.mac_daddr));
+    else summary->append_null(SUM_MAC_DADDR);
+    if(f.vlan!=be13::packet_info::NO_VLAN) summary->append(SUM_VLAN,(int64_t)f.vlan);
+    else summary->append_null(SUM_VLAN);
+    summary->append(SUM_PACKETS,f.packet_count);
+    summary->append(SUM_LEN,f.len);
+    summary->append(SUM_CAPLEN,f.caplen);
+    summary->append(SUM_OUT_OF_ORDER,tcp->out_of_order_count);
+    summary->append(SUM_VIOLATIONS,tcp->violations);
+    if(md5.size()) summary->append(SUM_MD5,md5);
+    else summary->append_null(SUM_MD5);
+    if(tcp->flow_pathname.size()) summary->append(SUM_FILENAME,tcp->flow_pathname);
+    else summary->append_null(SUM_FILENAME);
+    summary->end_row();
+}
+
+void tcpdemux::closeSummary()
+{
+    if(summary){
+        summary->close();
+        delete summary;
+        summary = 0;
+    }
+}
+
+/* The digest that scan_md5 put in the <fileobject> additions, if it ran */
+static std::string md5_from_xml(const std::string &xml)
+{
+    static const std::string hash0("<hashdigest type='MD5'>");
+    size_t start = xml.find(hash0);
+    if(start==std::string::npos) return std::string();
+    start += hash0.size();
+    size_t end = xml.find('<',start);
+    if(end==std::string::npos) return std::string();
+    return xml.substr(start,end-start);
+}
+
+/* ISO 8601 time for the flow database, to the precision of the capture */
+static std::string db_time(const struct timespec &ts)
+{
+    struct tm tm;
+    char buf[64];
+    time_t t = ts.tv_sec;
+    gmtime_r(&t,&tm);
+    size_t len = strftime(buf,sizeof(buf),"%Y-%m-%dT%H:%M:%S",&tm);
+    if(datalink_nsec){
+        if(ts.tv_nsec>0) len += snprintf(buf+len,sizeof(buf)-len,".%09ld",(long)ts.tv_nsec);
+    } else {
+        if(ts.tv_nsec/1000>0) len += snprintf(buf+len,sizeof(buf)-len,".%06ld",(long)ts.tv_nsec/1000);
+    }
+    snprintf(buf+len,sizeof(buf)-len,"Z");
+    return std::string(buf);
+}
 
 /* static */ tcpdemux *tcpdemux::getInstance()
 {
@@ -132,6 +221,18 @@ tcpip *tcpdemux::find_tcpip(const flow_addr &flow)
     return it->second;
 }
 
+std::string tcpdemux::reverse_pathname(const flow_addr &flow) const
+{
+    flow_addr reverse(flow.dst,flow.src,flow.dport,flow.sport,flow.family);
+    flow_map_t::const_iterator it = flow_map.find(reverse);
+    if(it!=flow_map.end()){
+        return it->second->file_created ? it->second->flow_pathname : "";
+    }
+    saved_flow_map_t::const_iterator sit = saved_flow_map.find(reverse);
+    if(sit!=saved_flow_map.end()) return sit->second->saved_filename;
+    return "";
+}
+
 /* Create a new flow state structure for a given flow.
  * Puts the flow in the map.
  * Returns a pointer to the new state.
@@ -160,6 +261,7 @@ tcpip *tcpdemux::create_tcpip(const flow_addr &flowa, be13::tcp_seq isn,const be
               flowa.str().c_str(),new_tcpip->flow_pathname.c_str(),new_tcpip->nsn);
     flow_map[flow] = new_tcpip;
     open_flows.reset(new_tcpip);
+    if(stream) stream->flow_open(new_tcpip->myflow);
     return new_tcpip;
 }
 
@@ -177,12 +279,62 @@ tcpip *tcpdemux::create_tcpip(const flow_addr &flowa, be13::tcp_seq isn,const be
  * Amended to trigger the packet/data location index sort as part of the post-processing.  This sorts
  * the (potentially out of order) index to make it simple for external applications.  No processing is
  * done if the (-I) index generation feature is turned off.  --GDD
+ *
+ * scan_http pairs the requests in one direction of a connection with the
+ * responses in the other, so an HTTP flow that closes while the other
+ * direction is still being written waits for it, closed but not yet
+ * scanned; both are then scanned, complete, one after the other.
  */
 
 void tcpdemux::post_process(tcpip *tcp)
+{
+    if(defer_post_process(tcp)) return;
+    finish_flow(tcp,true);
+}
+
+bool tcpdemux::defer_post_process(tcpip *tcp)
+{
+    if(!opt.post_processing || !tcp->file_created || tcp->last_byte==0) return false;
+    if(!classifier.wants(tcp->scanners,"http")) return false;
+    if(deferred_flows.find(tcp->myflow)!=deferred_flows.end()) return false; // the other one is waiting for us
+
+    const flow &f = tcp->myflow;
+    flow_addr reverse(f.dst,f.src,f.dport,f.sport,f.family);
+    if(flow_map.find(reverse)==flow_map.end()) return false; // nothing to wait for
+    if(deferred_flows.find(reverse)!=deferred_flows.end()) return false; // an earlier connection already waits
+
+    DEBUG(10)("%s waits for the other direction",tcp->flow_pathname.c_str());
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+    /* It is read back once the other direction closes */
+    if(opt.fadvise && tcp->fd>=0) posix_fadvise(tcp->fd,0,0,POSIX_FADV_WILLNEED);
+#endif
+    tcp->close_file();
+    save_flow(tcp);                     // stragglers still find it
+    deferred_flows[reverse] = tcp;
+    return true;
+}
+
+void tcpdemux::finish_flow(tcpip *tcp,bool save)
 {
     std::stringstream xmladd;		// for this <fileobject>
-    if(opt.post_processing && tcp->file_created && tcp->last_byte>0){
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+    /* The other direction, if it waits for this one, is scanned next;
+     * have the kernel read in what it needs while this one is scanned.
+     */
+    flow_map_t::const_iterator waiting = deferred_flows.find(tcp->myflow);
+    if(opt.fadvise && waiting!=deferred_flows.end()){
+        int fd = ::open(waiting->second->flow_pathname.c_str(),O_RDONLY|O_BINARY);
+        if(fd>=0){
+            posix_fadvise(fd,0,0,POSIX_FADV_WILLNEED);
+            ::close(fd);
+        }
+    }
+#endif
+    if(opt.post_processing && tcp->file_created && tcp->last_byte>0 && tcp->scanners==0){
+        /* No enabled scanner would do anything with it; don't read it back */
+        unscanned_flow_counter++;
+        DEBUG(10)("not post-processing %s",tcp->flow_pathname.c_str());
+    } else if(opt.post_processing && tcp->file_created && tcp->last_byte>0){
         /** 
          * After the flow is finished, if more than a byte was
          * written, then put it in an SBUF and process it.  if we are
@@ -195,18 +347,71 @@ void tcpdemux::post_process(tcpip *tcp)
         if(tcp->fd>=0){
             sbuf_t *sbuf = sbuf_t::map_file(tcp->flow_pathname,tcp->fd);
             if(sbuf){
+                scan_flow = tcp;
                 be13::plugin::process_sbuf(scanner_params(scanner_params::PHASE_SCAN,*sbuf,*(fs),&xmladd));
+                scan_flow = 0;
                 delete sbuf;
                 sbuf = 0;
             }
         }
     }
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+    /* Nothing reads the flow again, so its clean pages, those read back to
+     * be scanned or already written out, can go first. Pages still dirty
+     * are left to the kernel's writeback; this doesn't force it.
+     */
+    if(opt.fadvise && tcp->fd>=0) posix_fadvise(tcp->fd,0,0,POSIX_FADV_DONTNEED);
+#endif
     tcp->close_file();
-    if(xreport) tcp->dump_xml(xreport,xmladd.str());
+    if(stream) stream->flow_close(tcp->myflow,tcp->last_byte,tcp->stream_dropped);
+    if(dedup && tcp->file_created){
+        struct stat st;
+        if(stat(tcp->flow_pathname.c_str(),&st)==0){
+            std::string digest = (tcp->hasher && tcp->hashed==(uint64_t)st.st_size) ?
+                tcp->hasher->final().hexdigest() : dedup_store::file_digest(tcp->flow_pathname);
+            dedup->add(tcp->flow_pathname,digest,st.st_size);
+        }
+    }
+    std::string xml = xmladd.str();
+    if(xreport){
+        tcp->dump_xml(xreport,xml);
+        /* Flushing after every flow costs a write() per flow; unless asked to, let
+         * the report buffer and flush it every so many flows or seconds.
+         */
+        xml_unflushed++;
+        time_t now = time(0);
+        if(xml_last_flush==0) xml_last_flush = now;
+        if(opt.xml_crash_safe || xml_unflushed>=opt.xml_flush_flows
+           || now-xml_last_flush>=(time_t)opt.xml_flush_seconds){
+            xreport->flush();
+            xml_unflushed  = 0;
+            xml_last_flush = now;
+        }
+    }
+    if(db){
+        const flow &f = tcp->myflow;
+        char src[INET6_ADDRSTRLEN],dst[INET6_ADDRSTRLEN];
+        if(inet_ntop(f.family,f.src.addr,src,sizeof(src))==0) src[0] = 0;
+        if(inet_ntop(f.family,f.dst.addr,dst,sizeof(dst))==0) dst[0] = 0;
+        write_flow_record(db_time(f.tstart),db_time(f.tlast),src,dst,
+                          f.has_mac_daddr() ? macaddr(f.mac_daddr) : "",
+                          f.has_mac_saddr() ? macaddr(f.mac_saddr) : "",
+                          f.packet_count,f.sport,f.dport,md5_from_xml(xml));
+    }
+    if(summary) write_summary(tcp,md5_from_xml(xml));
+
+    /* The other direction, if it was waiting for this one to close */
+    flow_map_t::iterator it = deferred_flows.find(tcp->myflow);
+    if(it!=deferred_flows.end()){
+        tcpip *other = it->second;
+        deferred_flows.erase(it);
+        finish_flow(other,false);       // it was saved when it closed
+    }
+
     /**
      * Before we delete the tcp structure, save information about the saved flow
      */
-    save_flow(tcp);
+    if(save) save_flow(tcp);
     delete tcp;
 }
 
@@ -221,10 +426,13 @@ void tcpdemux::remove_flow(const flow_addr &flow)
 
 void tcpdemux::remove_all_flows()
 {
-    for(flow_map_t::iterator it=flow_map.begin();it!=flow_map.end();it++){
-        post_process(it->second);
+    /* One at a time, so that the flows still in the map are the ones
+     * still open when each is post-processed.
+     */
+    while(!flow_map.empty()){
+        flow_addr addr = flow_map.begin()->first;
+        remove_flow(addr);
     }
-    flow_map.clear();
 }
 
 /****************************************************************
@@ -297,9 +505,10 @@ unsigned int tcpdemux::get_max_fds(void)
 /*
  * open the packet save flow
  */
-void tcpdemux::save_unk_packets(const std::string &ofname,const std::string &ifname)
+void tcpdemux::save_unk_packets(const std::string &ofname,const std::string &ifname,
+                                const pcap_writer::options &popt)
 {
-    pwriter = pcap_writer::open_copy(ofname,ifname);
+    pwriter = pcap_writer::open_copy(ofname,ifname,popt);
 }
 
 /**
@@ -344,7 +553,7 @@ void tcpdemux::save_flow(tcpip *tcp)
 
 int tcpdemux::process_tcp(const ipaddr &src, const ipaddr &dst,sa_family_t family,
                           const u_char *ip_data, uint32_t ip_payload_len,
-                          const be13::packet_info &pi)
+                          const be13::packet_info &pi, bool bad_checksum)
 {
     if (ip_payload_len < sizeof(struct be13::tcphdr)) {
 	DEBUG(6) ("received truncated TCP segment! (%u<%u)",
@@ -381,6 +590,15 @@ int tcpdemux::process_tcp(const ipaddr &src, const ipaddr &dst,sa_family_t famil
     DEBUG(60)("%s%s%s%s tcp_header_len=%d tcp_datalen=%d seq=%u tcp=%p",
               (syn_set?"SYN ":""),(ack_set?"ACK ":""),(fin_set?"FIN ":""),(rst_set?"RST ":""),(int)tcp_header_len,(int)tcp_datalen,(int)seq,tcp);
 
+    /* Segments with a bad checksum are dropped before they can create or change a flow.
+     * Return 1 so that they are written with -w.
+     */
+    if(bad_checksum && opt.checksum_mode==options::CHECKSUM_DROP){
+        DEBUG(6) ("dropping TCP segment with bad checksum");
+        if(tcp) tcp->bad_checksum_count++;
+        return 1;
+    }
+
     /* If this_flow is not in the database and the start_new_connections flag is false, just return */
     if(tcp==0 && start_new_connections==false) return 0; 
 
@@ -468,11 +686,12 @@ int tcpdemux::process_tcp(const ipaddr &src, const ipaddr &dst,sa_family_t famil
     }
 
     /* Now tcp is valid */
-    tcp->myflow.tlast = pi.ts;		// most recently seen packet
+    tcp->myflow.tlast = pkt_timespec(pi);	// most recently seen packet
     tcp->last_packet_number = packet_counter++;
     tcp->myflow.len += pi.pcap_hdr->len;
     tcp->myflow.caplen += pi.pcap_hdr->caplen;
     tcp->myflow.packet_count++;
+    if(bad_checksum) tcp->bad_checksum_count++;
 
     // Does not seem consitent => Print a notice
     // See also https://stackoverflow.com/q/1491660
@@ -520,11 +739,22 @@ int tcpdemux::process_tcp(const ipaddr &src, const ipaddr &dst,sa_family_t famil
      * since they both have no data by definition.
      */
     if (tcp_datalen>0){
+        /* The segment at the start of the flow says what it carries */
+        if ((int64_t)tcp->pos+delta==0){
+            tcp->content  = content_sniffer::sniff(tcp_data,tcp_datalen);
+            tcp->scanners = classifier.by_start(tcp->scanners,tcp_data,tcp_datalen,tcp->content);
+            if(opt.tls_truncate && tcp->tls==0 && (tcp->content==content_sniffer::TLS_CLIENT_HELLO ||
+                                                   tcp->content==content_sniffer::TLS_SERVER_HELLO)){
+                tcp->tls = new tls_framer();
+            }
+        }
 	if (opt.console_output) {
 	    tcp->print_packet(tcp_data, tcp_datalen);
+	} else if (stream) {
+	    tcp->stream_packet(tcp_data, tcp_datalen, delta);
 	} else {
 	    if (opt.store_output){
-		tcp->store_packet(tcp_data, tcp_datalen, delta,pi.ts);
+		tcp->store_packet(tcp_data, tcp_datalen, delta,tcp->myflow.tlast);
 	    }
 	}
     }
@@ -586,6 +816,25 @@ int tcpdemux::process_ip4(const be13::packet_info &pi)
 	sbuf.hex_dump(std::cerr);
     }
 
+    /* Apply the compiled filter. Packets it rejects are treated as if
+     * libpcap had never delivered them, so they are not written with -w.
+     */
+    if(pfilter){
+        pktfilter::fields f;
+        size_t hl = ip_header->ip_hl * 4;
+        f.ip_version = 4;
+        f.proto      = ip_header->ip_p;
+        f.src        = (const uint8_t *)&ip_header->ip_src;
+        f.dst        = (const uint8_t *)&ip_header->ip_dst;
+        if((f.proto==IPPROTO_TCP || f.proto==IPPROTO_UDP)
+           && (ntohs(ip_header->ip_off) & 0x1fff)==0 && pi.ip_datalen >= hl+4){
+            f.has_ports = true;
+            f.sport     = ntohs(*(const uint16_t *)(pi.ip_data+hl));
+            f.dport     = ntohs(*(const uint16_t *)(pi.ip_data+hl+2));
+        }
+        if(!pfilter->match(f)) return 0;
+    }
+
     /* for now we're only looking for TCP; throw away everything else */
     if (ip_header->ip_p != IPPROTO_TCP) {
 	DEBUG(50) ("got non-TCP frame -- IP proto %d", ip_header->ip_p);
@@ -621,11 +870,23 @@ int tcpdemux::process_ip4(const be13::packet_info &pi)
 
     /* do TCP processing, faking an ipv6 address  */
     uint16_t ip_payload_len = ip_len - ip_header_len;
+
+    /* Validate the checksums if asked. A segment that was not completely
+     * captured cannot be checked and is given the benefit of the doubt.
+     */
+    bool bad_checksum = false;
+    if(opt.checksum_mode!=options::CHECKSUM_IGNORE && pi.ip_datalen >= ip_len){
+        bad_checksum = !cksum_ip4_ok(pi.ip_data,ip_header_len)
+            || !cksum_tcp_ok((const u_char *)&ip_header->ip_src,(const u_char *)&ip_header->ip_dst,4,
+                             pi.ip_data + ip_header_len,ip_payload_len);
+        if(bad_checksum) bad_checksum_counter++;
+    }
+
     ipaddr src(ip_header->ip_src.addr);
     ipaddr dst(ip_header->ip_dst.addr);
     return process_tcp(src, dst, AF_INET,
                        pi.ip_data + ip_header_len, ip_payload_len,
-                       pi);
+                       pi, bad_checksum);
 }
 #pragma GCC diagnostic warning "-Wcast-align"
 
@@ -647,6 +908,21 @@ int tcpdemux::process_ip6(const be13::packet_info &pi)
 
     const struct be13::ip6_hdr *ip_header = (struct be13::ip6_hdr *) pi.ip_data;
 
+    if(pfilter){
+        pktfilter::fields f;
+        size_t hl = sizeof(struct be13::ip6_hdr);
+        f.ip_version = 6;
+        f.proto      = ip_header->ip6_ctlun.ip6_un1.ip6_un1_nxt;
+        f.src        = ip_header->ip6_src.addr.addr8;
+        f.dst        = ip_header->ip6_dst.addr.addr8;
+        if((f.proto==IPPROTO_TCP || f.proto==IPPROTO_UDP) && pi.ip_datalen >= hl+4){
+            f.has_ports = true;
+            f.sport     = ntohs(*(const uint16_t *)(pi.ip_data+hl));
+            f.dport     = ntohs(*(const uint16_t *)(pi.ip_data+hl+2));
+        }
+        if(!pfilter->match(f)) return 0;
+    }
+
     /* for now we're only looking for TCP; throw away everything else */
     if (ip_header->ip6_ctlun.ip6_un1.ip6_un1_nxt != IPPROTO_TCP) {
 	DEBUG(50) ("got non-TCP frame -- IP proto %d", ip_header->ip6_ctlun.ip6_un1.ip6_un1_nxt);
@@ -655,11 +931,37 @@ int tcpdemux::process_ip6(const be13::packet_info &pi)
 
     /* do TCP processing */
     uint16_t ip_payload_len = ntohs(ip_header->ip6_ctlun.ip6_un1.ip6_un1_plen);
+
+    /* IPv6 has no header checksum; only the TCP checksum is checked */
+    bool bad_checksum = false;
+    if(opt.checksum_mode!=options::CHECKSUM_IGNORE
+       && pi.ip_datalen >= sizeof(struct be13::ip6_hdr) + ip_payload_len){
+        bad_checksum = !cksum_tcp_ok(ip_header->ip6_src.addr.addr8,ip_header->ip6_dst.addr.addr8,16,
+                                     pi.ip_data + sizeof(struct be13::ip6_hdr),ip_payload_len);
+        if(bad_checksum) bad_checksum_counter++;
+    }
+
     ipaddr src(ip_header->ip6_src.addr.addr8);
     ipaddr dst(ip_header->ip6_dst.addr.addr8);
     
     return process_tcp(src, dst ,AF_INET6,
-                       pi.ip_data + sizeof(struct be13::ip6_hdr),ip_payload_len,pi);
+                       pi.ip_data + sizeof(struct be13::ip6_hdr),ip_payload_len,pi,bad_checksum);
+}
+
+/* Which -w output a packet that was not processed goes to, if they are split by protocol */
+static const char *unk_packet_protocol(const be13::packet_info &pi)
+{
+    int proto = -1;
+    if(pi.ip_version()==4 && pi.ip_datalen>=20) proto = pi.ip_data[9];
+    if(pi.ip_version()==6 && pi.ip_datalen>=40) proto = pi.ip_data[6];
+    switch(proto){
+    case -1:           return "other";
+    case IPPROTO_TCP:  return "tcp";
+    case IPPROTO_UDP:  return "udp";
+    case IPPROTO_ICMP:
+    case 58:           return "icmp";  // ICMPv6
+    default:           return "ip";
+    }
 }
 
 /* This is called when we receive an IPv4 or IPv6 datagram.
@@ -679,10 +981,14 @@ int tcpdemux::process_pkt(const be13::packet_info &pi)
     case 6:
         r = process_ip6(pi);
         break;
+    default:
+        if(pfilter && !pfilter->match(pktfilter::fields())) r = 0; // not IP and filtered out
+        break;
     }
     if(r!=0){                           // packet not processed?
         /* Write the packet if we didn't process it */
-        if(pwriter) pwriter->writepkt(pi.pcap_hdr,pi.pcap_data);
+        if(pwriter) pwriter->writepkt(pi.pcap_hdr,pi.pcap_data,
+                                      pwriter->split() ? unk_packet_protocol(pi) : 0);
     }
 
     /* Process the timeout, if there is any */
@@ -18,13 +18,17 @@
  */
 
 #include "pcap_writer.h"
+#include "pktfilter.h"
+#include "segment_writer.h"
+#include "flow_stream.h"
+#include "dedup_store.h"
+#include "flow_db.h"
+#include "arrow_writer.h"
+#include "console_writer.h"
+#include "flow_classifier.h"
 #include "dfxml/src/dfxml_writer.h"
 #include "dfxml/src/hash_t.h"
 
-#if defined(HAVE_SQLITE3_H)
-#include <sqlite3.h>
-#endif
-
 #if defined(HAVE_UNORDERED_MAP)
 # include <unordered_map>
 # include <unordered_set>
@@ -70,10 +74,7 @@ class tcpdemux {
 
 
     tcpdemux();
-#ifdef HAVE_SQLITE3
-    sqlite3 *db;
-    sqlite3_stmt *insert_flow;
-#endif
+    flow_db *db;                        // the connection table, if -S sqlite_db was given
 
 public:
     static uint32_t tcp_timeout;
@@ -81,19 +82,36 @@ public:
     virtual ~tcpdemux(){
         if(xreport) delete xreport;
         if(pwriter) delete pwriter;
+        if(pfilter) delete pfilter;
+        if(segments) delete segments;
+        if(stream) delete stream;
+        if(dedup) delete dedup;
+        if(db) delete db;
+        if(summary) delete summary;
     }
 
     /* The pure options class means we can add new options without having to modify the tcpdemux constructor. */
     class options {
     public:;
         enum { MAX_SEEK=1024*1024*16 };
+        enum { XML_FLUSH_FLOWS=1000, XML_FLUSH_SECONDS=5 };
+        enum { PREALLOC_RATE=1024*1024 };
+        typedef enum {
+            CHECKSUM_IGNORE=0,          // don't look at checksums (captures with checksum offload)
+            CHECKSUM_COUNT,             // count bad checksums per flow, but keep the data
+            CHECKSUM_DROP               // count bad checksums and discard the segment
+        } checksum_mode_t;
         options():console_output(false),console_output_nonewline(false),
                   store_output(true),opt_md5(false),
                   post_processing(false),gzip_decompress(true),
                   max_bytes_per_flow(-1),
                   max_flows(0),suppress_header(0),
                   output_strip_nonprint(true),output_hex(false),use_color(0),
-                  output_packet_index(false),max_seek(MAX_SEEK) {
+                  output_packet_index(false),max_seek(MAX_SEEK),
+                  checksum_mode(CHECKSUM_IGNORE),
+                  xml_flush_flows(XML_FLUSH_FLOWS),xml_flush_seconds(XML_FLUSH_SECONDS),
+                  xml_crash_safe(false),
+                  prealloc_rate(PREALLOC_RATE),fadvise(true),tls_truncate(false) {
         }
         bool    console_output;
         bool    console_output_nonewline;
@@ -110,6 +128,13 @@ public:
         bool    output_packet_index;    // Generate a packet index file giving the timestamp and location
                                         // bytes written to the flow file.
         int32_t max_seek;               // signed becuase we compare with abs()
+        checksum_mode_t checksum_mode;  // what to do with IPv4 and TCP checksums
+        uint32_t xml_flush_flows;       // flush the DFXML report after this many flows...
+        uint32_t xml_flush_seconds;     // ...or this many seconds, whichever comes first
+        bool    xml_crash_safe;         // flush the DFXML report after every flow
+        uint64_t prealloc_rate;         // reserve disk ahead of flows faster than this, bytes/sec (0 for never)
+        bool    fadvise;                // tell the kernel which closed flows will be read again
+        bool    tls_truncate;           // stop storing a TLS flow where its handshake ends
     };
 
     enum { WARN_TOO_MANY_FILES=10000};  // warn if more than this number of files in a directory
@@ -117,8 +142,20 @@ public:
     std::string outdir;                 /* output directory */
     uint64_t    flow_counter;           // how many flows have we seen?
     uint64_t    packet_counter;         // monotomically increasing 
+    uint64_t    bad_checksum_counter;   // IPv4 or TCP checksum failures, if checked
+    uint64_t    unscanned_flow_counter; // flows no enabled scanner wanted, so not post-processed
     dfxml_writer  *xreport;               // DFXML output file
+    uint32_t    xml_unflushed;          // flows written to xreport since it was last flushed
+    time_t      xml_last_flush;         // when it was
     pcap_writer *pwriter;               // where we should write packets
+    pktfilter   *pfilter;               // compiled filter used instead of libpcap's, if any
+    segment_writer *segments;           // flow data goes here instead of per-flow files, if set
+    flow_stream *stream;                // or to a consumer on a socket, with -S stream
+    dedup_store *dedup;                 // finished files with the same content are linked, with -S dedup=1
+    arrow_writer *summary;              // a row per flow, if -S flow_summary was given
+    console_writer console;             // -c, -C, -D and -g output
+    const tcpip *scan_flow;             // the flow post_process() is running the scanners on
+    flow_classifier classifier;         // which scanners want which flows
     unsigned int max_open_flows;        // how large did it ever get?
     unsigned int max_fds;               // maximum number of file descriptors for this tcpdemux
 
@@ -127,6 +164,7 @@ public:
 
     saved_flow_map_t saved_flow_map;  // db of saved flows, indexed by flow
     saved_flows_t    saved_flows;     // the flows that were saved
+    flow_map_t       deferred_flows;  // closed HTTP flows waiting for the other direction, indexed by it
     bool             start_new_connections;  // true if we should start new connections
 
     options     opt;
@@ -137,7 +175,13 @@ public:
 
     /* Databse */
 
-    void  openDB();                    // open the database file if we are using it in outdir directory.
+    void  openDB(const std::string &fname,const flow_db::options &dbopt); // start recording flows in fname
+    void  closeDB();                   // write the queued flows and index the table
+
+    /* Columnar flow summary */
+    void  openSummary(const std::string &fname,const arrow_writer::options &aopt);
+    void  write_summary(const tcpip *tcp,const std::string &md5);
+    void  closeSummary();              // write the footer
     void  write_flow_record(const std::string &starttime,const std::string &endtime,
                             const std::string &src_ipn,const std::string &dst_ipn,
                             const std::string &mac_daddr,const std::string &mac_saddr,
@@ -145,9 +189,12 @@ public:
                             const std::string &hashdigest_md5);
 
 
-    void  save_unk_packets(const std::string &wfname,const std::string &ifname);
+    void  save_unk_packets(const std::string &wfname,const std::string &ifname,
+                           const pcap_writer::options &popt);
                                        // save unknown packets at this location
     void  post_process(tcpip *tcp);    // just before closing; writes XML and closes fd
+    bool  defer_post_process(tcpip *tcp); // hold tcp until the other direction closes?
+    void  finish_flow(tcpip *tcp,bool save); // scan, record and delete tcp
 
     /* management of open fds and in-process tcpip flows*/
     void  close_tcpip_fd(tcpip *);         
@@ -161,6 +208,8 @@ public:
     /* the flow database holds in-process tcpip connections */
     tcpip *create_tcpip(const flow_addr &flow, be13::tcp_seq isn, const be13::packet_info &pi);
     tcpip *find_tcpip(const flow_addr &flow);
+    /* the file holding the other direction of a connection, open or saved; "" if none */
+    std::string reverse_pathname(const flow_addr &flow) const;
 
     /* saved flows are completed flows that we remember in case straggling packets
      * show up. Remembering the flows lets us resolve the packets rather than creating
@@ -173,7 +222,7 @@ public:
      */
     int  process_tcp(const ipaddr &src, const ipaddr &dst,sa_family_t family,
                      const u_char *tcp_data, uint32_t tcp_length,
-                     const be13::packet_info &pi);
+                     const be13::packet_info &pi, bool bad_checksum=false);
     int  process_ip4(const be13::packet_info &pi);
     int  process_ip6(const be13::packet_info &pi);
     int  process_pkt(const be13::packet_info &pi);
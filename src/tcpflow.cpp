@@ -17,6 +17,7 @@
 #include "tcpdemux.h"
 #include "bulk_extractor_i.h"
 #include "iptree.h"
+#include "scanner_plugin.h"
 
 #include "be13_api/utils.h"
 
@@ -57,6 +58,32 @@ typedef struct {
 
 default_t defaults[] = {
     {"tdelta","0","Time delta in seconds"},
+    {"checksum","ignore","Validate IPv4/TCP checksums: ignore, count or drop bad segments"},
+    {"compiled_filter","0","Evaluate the filter expression in tcpflow instead of libpcap's BPF"},
+    {"pcap_buffer","1048576","Bytes of buffer for each -w output file"},
+    {"pcap_rotate_size","0","Start a new -w output file after this many bytes (0 for never)"},
+    {"pcap_rotate_seconds","0","Start a new -w output file after this many seconds of capture"},
+    {"pcap_prealloc","0","Reserve this many bytes of disk for each -w output file"},
+    {"pcap_split","0","Write -w packets to one file per protocol: tcp, udp, icmp, ip, other"},
+    {"segments","0","Append all flows to large segment files with an index instead of one file per flow"},
+    {"segment_size","1073741824","Start a new segment file after this many bytes"},
+    {"xml_flush_flows","1000","Flush the DFXML report after this many flows"},
+    {"xml_flush_seconds","5","Flush the DFXML report after this many seconds"},
+    {"xml_crash_safe","0","Flush the DFXML report after every flow"},
+    {"sqlite_db","","Record the flows in this SQLite database (relative names are in the output directory)"},
+    {"sqlite_batch_rows","10000","Insert this many flows per SQLite transaction"},
+    {"sqlite_batch_ms","500","Commit queued flows to SQLite at least this often"},
+    {"flow_summary","","Write a row per flow to this Arrow IPC (Feather) file (relative names are in the output directory)"},
+    {"flow_summary_batch","65536","Rows per record batch of the flow summary"},
+    {"flow_prealloc_rate","1048576","Reserve disk ahead of flows arriving faster than this many bytes/sec (0 for never)"},
+    {"flow_fadvise","1","Tell the kernel which closed flow files will be read again"},
+    {"tls_truncate","0","Stop storing a TLS flow where its handshake ends"},
+    {"dedup","0","Store files with the same content once, as hard links to dedup/<sha1>"},
+    {"stream","","Send the flows to the consumer listening on this Unix-domain socket instead of writing files"},
+    {"stream_queue","16777216","Bytes of stream messages to queue while the consumer is not reading"},
+    {"stream_policy","block","When the stream queue is full: block, drop (flow data) or spill (to a file)"},
+    {"console_buffer","1048576","Bytes of -c/-C/-D output to collect before writing to stdout (0 for every packet)"},
+    {"console_flush_ms","1000","Write collected -c/-C/-D output at least this often"},
     {0,0,0}
 };
 
@@ -84,12 +111,17 @@ scanner_t *scanners_builtin[] = {
     scan_http,
     scan_netviz,
     scan_python,
+    scan_tls,
     scan_tcpdemux,
 #ifdef USE_WIFI
     scan_wifiviz,
 #endif
     0};
 
+/* The built-in scanners followed by those loaded with -P */
+std::vector<scanner_t *> scanners_loaded(scanners_builtin,
+                                         scanners_builtin+sizeof(scanners_builtin)/sizeof(scanners_builtin[0])-1);
+
 bool opt_no_promisc = false;		// true if we should not use promiscious mode
 
 /* Long options!
@@ -117,9 +149,9 @@ static void usage(int level)
     std::cout << PACKAGE_NAME << " version " << PACKAGE_VERSION << "\n\n";
     std::cout << "usage: " << progname << " [-aBcCDhIpsvVZ] [-b max_bytes] [-d debug_level] \n";
     std::cout << "     [-[eE] scanner] [-f max_fds] [-F[ctTXMkmg]] [-h|--help] [-i iface]\n";
-    std::cout << "     [-l files...] [-L semlock] [-m min_bytes] [-o outdir] [-r file] [-R file]\n";
-    std::cout << "     [-S name=value] [-T template] [-U|--relinquish-privileges user] [-v|--verbose]\n";
-    std::cout << "     [-w file] [-x scanner] [-X xmlfile] [-z|--chroot dir] [expression]\n\n";
+    std::cout << "     [-l files...] [-L semlock] [-m min_bytes] [-o outdir] [-P file.so] [-r file]\n";
+    std::cout << "     [-R file] [-S name=value] [-T template] [-U|--relinquish-privileges user]\n";
+    std::cout << "     [-v|--verbose] [-w file] [-x scanner] [-X xmlfile] [-z|--chroot dir] [expression]\n\n";
     std::cout << "   -a: do ALL post-processing.\n";
     std::cout << "   -b max_bytes: max number of bytes per flow to save\n";
     std::cout << "   -d debug_level: debug level; default is " << DEFAULT_DEBUG_LEVEL << "\n";
@@ -154,6 +186,7 @@ static void usage(int level)
 
     std::cout << "\nControl of Scanners:\n";
     std::cout << "   -E scanner   - turn off all scanners except scanner\n";
+    std::cout << "   -P file.so   - load a scanner from a shared object (may be repeated)\n";
     std::cout << "   -S name=value  Set a configuration parameter (-hh for info)\n";
     if(level > 1) {
         std::cout << "\n" "Activated options -S name=value:";
@@ -161,7 +194,7 @@ static void usage(int level)
             std::cout <<"\n   -S "<< defaults[i].name << "=" << defaults[i].dvalue <<'\t'<< defaults[i].help;
         }
         std::cout << '\n';
-        be13::plugin::info_scanners(false,true,scanners_builtin,'e','x');
+        be13::plugin::info_scanners(false,true,&scanners_loaded[0],'e','x');
     }
     std::cout << "\n"
                  "Console output options:\n";
@@ -237,6 +270,8 @@ dfxml_writer *xreport = 0;
 void terminate(int sig)
 {
     DEBUG(1) ("terminating");
+    if(xreport) xreport->flush();       // the flows that are still buffered
+    tcpdemux::getInstance()->console.flush();
     be13::plugin::phase_shutdown(*the_fs);	// give plugins a chance to do a clean shutdown
     exit(0); /* libpcap uses onexit to clean up */
 }
@@ -400,6 +435,65 @@ void tcpflow_droproot(tcpdemux &demux)
     }
 }
 
+#ifdef HAVE_PCAP_OPEN_OFFLINE_WITH_TSTAMP_PRECISION
+/* Does a capture file have nanosecond timestamps? libpcap converts to
+ * whatever precision it is opened with and can't tell us, so look at the
+ * pcap magic number or at the pcapng interfaces' if_tsresol. A pipe (a
+ * decompressed file) can't be looked at without losing what is read, so
+ * it is taken to have microseconds.
+ */
+static uint32_t pcapng_u32(const uint8_t *p,bool be)
+{
+    return be ? (p[0]<<24 | p[1]<<16 | p[2]<<8 | p[3]) : (p[3]<<24 | p[2]<<16 | p[1]<<8 | p[0]);
+}
+
+static uint16_t pcapng_u16(const uint8_t *p,bool be)
+{
+    return be ? (p[0]<<8 | p[1]) : (p[1]<<8 | p[0]);
+}
+
+static bool file_has_nsec(const std::string &path)
+{
+    struct stat st;
+    if(stat(path.c_str(),&st)!=0 || !S_ISREG(st.st_mode)) return false;
+    FILE *f = fopen(path.c_str(),"rb");
+    if(f==0) return false;
+    uint8_t buf[65536];
+    size_t len = fread(buf,1,sizeof(buf),f);
+    fclose(f);
+    if(len<4) return false;
+
+    uint32_t magic = buf[0]<<24 | buf[1]<<16 | buf[2]<<8 | buf[3];
+    if(magic==0xa1b23c4d || magic==0x4d3cb2a1) return true;    // nanosecond pcap, either byte order
+    if(magic!=0x0a0d0d0a || len<12) return false;              // microsecond pcap, or unknown
+
+    /* pcapng: the section header's byte-order magic says how to read the rest */
+    bool be = (buf[8]==0x1a && buf[9]==0x2b);
+    bool nsec = false;
+    for(size_t pos=0;pos+12<=len;){
+        uint32_t type = pcapng_u32(buf+pos,be);
+        uint32_t blen = pcapng_u32(buf+pos+4,be);
+        if(blen<12 || pos+blen>len) break;
+        if(type==1){                    // interface description; options follow 8 bytes of fields
+            for(size_t o=pos+16;o+4<=pos+blen-4;){
+                uint16_t code = pcapng_u16(buf+o,be);
+                uint16_t olen = pcapng_u16(buf+o+2,be);
+                if(code==0 || o+4+olen>pos+blen-4) break;
+                if(code==9 && olen>=1){ // if_tsresol: a power of 10, or of 2 with the top bit
+                    uint8_t r = buf[o+4];
+                    if((r & 0x80) ? (r & 0x7f)>20 : r>6) nsec = true;
+                }
+                o += 4 + ((olen+3) & ~3);
+            }
+        } else if(type!=0x0a0d0d0a){
+            break;                      // the packets have started
+        }
+        pos += blen;
+    }
+    return nsec;
+}
+#endif
+
 /*
  * process an input file or device
  * May be repeated.
@@ -441,9 +535,19 @@ static void process_infile(tcpdemux &demux,const std::string &expression,const c
             }
         }
 #endif
+#ifdef HAVE_PCAP_OPEN_OFFLINE_WITH_TSTAMP_PRECISION
+        /* Keep nanosecond timestamps from files that have them, and only those */
+        datalink_nsec = file_has_nsec(file_path);
+	if ((pd = pcap_open_offline_with_tstamp_precision(file_path.c_str(),
+                  datalink_nsec ? PCAP_TSTAMP_PRECISION_NANO : PCAP_TSTAMP_PRECISION_MICRO, error)) == NULL){
+	    die("%s", error);
+	}
+#else
 	if ((pd = pcap_open_offline(file_path.c_str(), error)) == NULL){	/* open the capture file */
 	    die("%s", error);
 	}
+        datalink_nsec = false;
+#endif
         tcpflow_droproot(demux);        // drop root if requested
 	dlt = pcap_datalink(pd);	/* get the handler for this kind of packets */
 	handler = find_handler(dlt, infile.c_str());
@@ -459,6 +563,8 @@ static void process_infile(tcpdemux &demux,const std::string &expression,const c
 	if ((pd = pcap_open_live(device, SNAPLEN, !opt_no_promisc, 1000, error)) == NULL){
 	    die("%s", error);
 	}
+        datalink_nsec = false;
+        demux.console.set_live(true);               // don't hold output until the next packet
         tcpflow_droproot(demux);                     // drop root if requested
 	/* get the handler for this kind of packets */
 	dlt = pcap_datalink(pd);
@@ -476,6 +582,7 @@ static void process_infile(tcpdemux &demux,const std::string &expression,const c
     if (pcap_setfilter(pd, &fcode) < 0){
 	die("%s", pcap_geterr(pd));
     }
+    if(demux.pwriter) demux.pwriter->set_input_nsec(datalink_nsec);
 
     /* initialize our flow state structures */
 
@@ -568,7 +675,7 @@ int main(int argc, char *argv[])
 
     bool trailing_input_list = false;
     int arg;
-    while ((arg = getopt_long(argc, argv, "aA:Bb:cCd:DE:e:E:F:f:gHhIi:lL:m:o:pqR:r:S:sT:U:Vvw:x:X:z:Z0", longopts, NULL)) != EOF) {
+    while ((arg = getopt_long(argc, argv, "aA:Bb:cCd:DE:e:E:F:f:gHhIi:lL:m:o:P:pqR:r:S:sT:U:Vvw:x:X:z:Z0", longopts, NULL)) != EOF) {
 	switch (arg) {
 	case 'a':
 	    demux.opt.post_processing = true;
@@ -659,6 +766,7 @@ int main(int argc, char *argv[])
             demux.outdir = optarg;
             flow::outdir = optarg;
             break;
+	case 'P': scanners_loaded.push_back(load_scanner_plugin(optarg)); break;
 	case 'p': opt_no_promisc = true; DEBUG(10) ("NOT turning on promiscuous mode"); break;
         case 'q': opt_quiet = true; break;
 	case 'R': Rfiles.push_back(optarg); break;
@@ -713,10 +821,11 @@ int main(int argc, char *argv[])
     si.config = &be_config;
 
     si.get_config("enable_report",&opt_enable_report,"Enable report.xml");
-    be13::plugin::load_scanners(scanners_builtin,be_config);
+    scanners_loaded.push_back(0);
+    be13::plugin::load_scanners(&scanners_loaded[0],be_config);
 
     if(opt_Help){
-        be13::plugin::info_scanners(true,true,scanners_builtin,'e','x');
+        be13::plugin::info_scanners(true,true,&scanners_loaded[0],'e','x');
         exit(0);
     }
 
@@ -734,6 +843,11 @@ int main(int argc, char *argv[])
     if(demux.opt.opt_md5) be13::plugin::scanners_enable("md5");
     be13::plugin::scanners_process_enable_disable_commands();
 
+    /* Post-process only the flows some enabled scanner could use */
+    std::vector<std::string> enabled_scanners;
+    be13::plugin::get_enabled_scanners(enabled_scanners);
+    demux.classifier.set_scanners(enabled_scanners);
+
     /* If there is no report filename, call it report.xml in the output directory */
     if( reportfilename.size()==0 ){
 	reportfilename = demux.outdir + "/" + DEFAULT_REPORT_FILENAME;
@@ -809,7 +923,15 @@ int main(int argc, char *argv[])
             exit(1);
         }
         if(access(input_fname.c_str(),R_OK)) die("cannot read: %s: %s",input_fname.c_str(),strerror(errno));
-        demux.save_unk_packets(opt_unk_packets,input_fname);
+        pcap_writer::options popt;
+        uint64_t pcap_buffer = popt.buffer_size;
+        si.get_config("pcap_buffer",&pcap_buffer,"Bytes of buffer for each -w output file");
+        popt.buffer_size = pcap_buffer;
+        si.get_config("pcap_rotate_size",&popt.rotate_bytes,"Start a new -w output file after this many bytes");
+        si.get_config("pcap_rotate_seconds",&popt.rotate_seconds,"Start a new -w output file after this many seconds");
+        si.get_config("pcap_prealloc",&popt.prealloc_bytes,"Reserve this many bytes of disk for each -w output file");
+        si.get_config("pcap_split",&popt.split,"Write -w packets to one file per protocol");
+        demux.save_unk_packets(opt_unk_packets,input_fname,popt);
     }
 
 
@@ -833,11 +955,116 @@ int main(int argc, char *argv[])
 
     si.get_config("tdelta",&datalink_tdelta,"Time offset for packets");
 
+    std::string checksum_mode("ignore");
+    si.get_config("checksum",&checksum_mode,"IPv4/TCP checksums: ignore, count (record bad ones) or drop");
+    if(checksum_mode=="ignore")     demux.opt.checksum_mode = tcpdemux::options::CHECKSUM_IGNORE;
+    else if(checksum_mode=="count") demux.opt.checksum_mode = tcpdemux::options::CHECKSUM_COUNT;
+    else if(checksum_mode=="drop")  demux.opt.checksum_mode = tcpdemux::options::CHECKSUM_DROP;
+    else {
+        std::cerr << "ERROR: -S checksum must be ignore, count or drop\n";
+        exit(1);
+    }
+
+    /* How often the DFXML report is flushed */
+    si.get_config("xml_flush_flows",&demux.opt.xml_flush_flows,"Flush the DFXML report after this many flows");
+    si.get_config("xml_flush_seconds",&demux.opt.xml_flush_seconds,"Flush the DFXML report after this many seconds");
+    si.get_config("xml_crash_safe",&demux.opt.xml_crash_safe,"Flush the DFXML report after every flow");
+
+    /* Disk and page cache hints for the flow files */
+    si.get_config("flow_prealloc_rate",&demux.opt.prealloc_rate,"Reserve disk ahead of flows arriving faster than this many bytes/sec");
+    si.get_config("flow_fadvise",&demux.opt.fadvise,"Tell the kernel which closed flow files will be read again");
+    si.get_config("tls_truncate",&demux.opt.tls_truncate,"Stop storing a TLS flow where its handshake ends");
+
+    /* The SQLite connection table */
+    std::string sqlite_db;
+    flow_db::options dbopt;
+    si.get_config("sqlite_db",&sqlite_db,"Record the flows in this SQLite database");
+    si.get_config("sqlite_batch_rows",&dbopt.batch_rows,"Insert this many flows per SQLite transaction");
+    si.get_config("sqlite_batch_ms",&dbopt.batch_ms,"Commit queued flows to SQLite at least this often");
+    if(sqlite_db.size()){
+        if(sqlite_db[0]!='/' && demux.outdir!=".") sqlite_db = demux.outdir + "/" + sqlite_db;
+        if(dbopt.max_pending<16*dbopt.batch_rows) dbopt.max_pending = 16*dbopt.batch_rows;
+        demux.openDB(sqlite_db,dbopt);
+    }
+
+    /* The columnar flow summary, for analytics without parsing the DFXML */
+    std::string flow_summary;
+    arrow_writer::options aopt;
+    si.get_config("flow_summary",&flow_summary,"Write a row per flow to this Arrow IPC (Feather) file");
+    si.get_config("flow_summary_batch",&aopt.batch_rows,"Rows per record batch of the flow summary");
+    if(flow_summary.size()){
+        if(flow_summary[0]!='/' && demux.outdir!=".") flow_summary = demux.outdir + "/" + flow_summary;
+        demux.openSummary(flow_summary,aopt);
+    }
+
+    /* Console output is collected and written in large blocks unless stdout is a terminal */
+    uint64_t console_buffer = console_writer::BUFFER_SIZE;
+    uint32_t console_flush_ms = console_writer::FLUSH_MS;
+    si.get_config("console_buffer",&console_buffer,"Bytes of -c/-C/-D output to collect before writing to stdout");
+    si.get_config("console_flush_ms",&console_flush_ms,"Write collected -c/-C/-D output at least this often");
+    demux.console.set_buffering((size_t)console_buffer,console_flush_ms);
+
+    /* Stream the flows to a local consumer instead of writing files? */
+    std::string stream_path;
+    std::string stream_policy("block");
+    flow_stream::options sopt;
+    si.get_config("stream",&stream_path,"Send the flows to the consumer listening on this Unix-domain socket");
+    si.get_config("stream_queue",&sopt.queue_bytes,"Bytes of stream messages to queue while the consumer is not reading");
+    si.get_config("stream_policy",&stream_policy,"When the stream queue is full: block, drop or spill");
+    if(stream_policy=="block")      sopt.policy = flow_stream::BLOCK;
+    else if(stream_policy=="drop")  sopt.policy = flow_stream::DROP;
+    else if(stream_policy=="spill") sopt.policy = flow_stream::SPILL;
+    else {
+        std::cerr << "ERROR: -S stream_policy must be block, drop or spill\n";
+        exit(1);
+    }
+    if(stream_path.size() && !demux.opt.console_output){
+        sopt.spill_name = demux.outdir + "/tcpflow-stream.spill";
+        demux.stream = new flow_stream();
+        if(!demux.stream->open(stream_path,sopt)){
+            die("cannot connect to stream consumer %s",demux.stream->error().c_str());
+        }
+    }
+
+    /* Segment output instead of a file per flow? Read back with tcpflow-extract. */
+    bool opt_segments = false;
+    uint64_t segment_size = 1024*1024*1024;
+    si.get_config("segments",&opt_segments,"Append all flows to large segment files with an index");
+    si.get_config("segment_size",&segment_size,"Start a new segment file after this many bytes");
+    if(opt_segments && demux.opt.store_output && !demux.opt.console_output && !demux.stream){
+        demux.segments = new segment_writer(demux.outdir,segment_size);
+    }
+
+    /* Files with the same content stored once? */
+    bool opt_dedup = false;
+    si.get_config("dedup",&opt_dedup,"Store files with the same content once, as hard links to dedup/<sha1>");
+    if(opt_dedup && demux.opt.store_output && !demux.opt.console_output && !demux.stream && !demux.segments){
+        demux.dedup = new dedup_store(demux.outdir);
+    }
+
+    /* Evaluate the filter ourselves, on the headers that tcpdemux parses anyway?
+     * Falls back to libpcap if the expression is outside the subset we compile.
+     */
+    bool opt_compiled_filter = false;
+    si.get_config("compiled_filter",&opt_compiled_filter,"Evaluate the filter expression in tcpflow instead of libpcap's BPF");
+    if(opt_compiled_filter && expression.size()>0){
+        pktfilter *pf = new pktfilter();
+        if(pf->compile(expression)){
+            DEBUG(1)("compiled filter '%s' to %d nodes",expression.c_str(),(int)pf->node_count());
+            demux.pfilter = pf;
+            expression = "";
+        } else {
+            std::cerr << "compiled_filter: " << pf->error() << "; using libpcap's filter\n";
+            delete pf;
+        }
+    }
+
     /* Record the configuration */
     if(xreport){
         xreport->push("configuration");
         xreport->pop();			// configuration
         xreport->xmlout("tdelta",datalink_tdelta);
+        xreport->xmlout("checksum",checksum_mode);
     }
 
 
@@ -876,6 +1103,14 @@ int main(int argc, char *argv[])
     int flow_map_size = (int)demux.flow_map.size();
 
     demux.remove_all_flows();	// empty the map to capture the state
+    demux.console.flush();
+    demux.closeDB();
+    demux.closeSummary();
+    if(demux.segments){
+        delete demux.segments;          // write the last of the index
+        demux.segments = 0;
+    }
+    if(demux.stream) demux.stream->close(); // send what is still queued
     std::stringstream ss;
     be13::plugin::phase_shutdown(fs,xreport ? &ss : 0);
 
@@ -887,6 +1122,7 @@ int main(int argc, char *argv[])
 
     DEBUG(2)(total_flow_processed.c_str(),demux.flow_counter);
     DEBUG(2)(total_packets_processed.c_str(),demux.packet_counter);
+    DEBUG(2)("Flows not post-processed:           %d",(int)demux.unscanned_flow_counter);
 
     if(xreport){
         xreport->pop();                 // fileobjects
@@ -896,13 +1132,37 @@ int main(int argc, char *argv[])
         xreport->xmlout("total_flows",demux.flow_counter);
         xreport->xmlout("flow_map_size",flow_map_size);
         xreport->xmlout("total_packets",demux.packet_counter);
+        if(demux.opt.post_processing){
+            xreport->xmlout("unscanned_flows",demux.unscanned_flow_counter);
+        }
+        if(demux.opt.checksum_mode!=tcpdemux::options::CHECKSUM_IGNORE){
+            xreport->xmlout("bad_checksums",demux.bad_checksum_counter);
+        }
+        if(demux.dedup){
+            char ratio[32];
+            snprintf(ratio,sizeof(ratio),"%.3f",demux.dedup->ratio());
+            xreport->push("dedup");
+            xreport->xmlout("files",demux.dedup->files);
+            xreport->xmlout("bytes",demux.dedup->bytes);
+            xreport->xmlout("duplicate_files",demux.dedup->dup_files);
+            xreport->xmlout("duplicate_bytes",demux.dedup->dup_bytes);
+            xreport->xmlout("ratio",ratio);
+            xreport->pop();             // dedup
+        }
+        if(demux.stream){
+            xreport->push("stream");
+            xreport->xmlout("sent_bytes",demux.stream->sent_bytes());
+            xreport->xmlout("spilled_bytes",demux.stream->spilled_bytes());
+            xreport->xmlout("dropped_bytes",demux.stream->dropped_bytes());
+            xreport->pop();             // stream
+        }
 	xreport->add_rusage();
 	xreport->pop();                 // bulk_extractor
 	xreport->close();
 	delete xreport;
     }
 
-    if(demux.flow_counter > tcpdemux::WARN_TOO_MANY_FILES){
+    if(demux.flow_counter > tcpdemux::WARN_TOO_MANY_FILES && !opt_segments){
         if(!opt_quiet){
             /* Start counting how many files we have in the output directory.
              * If we find more than 10,000, print the warning, and keep counting...
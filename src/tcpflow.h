@@ -276,6 +276,7 @@ extern int debug;
 
 /* datalink.cpp - callback for libpcap */
 extern int32_t datalink_tdelta;                                   // time delta to add to each packet
+extern bool datalink_nsec;                                        // libpcap gives nanoseconds in tv_usec
 pcap_handler find_handler(int datalink_type, const char *device); // callback for pcap
 typedef struct {
     pcap_handler handler;
@@ -285,6 +286,26 @@ typedef struct {
 void dl_ieee802_11_radio(u_char *user, const struct pcap_pkthdr *h, const u_char *p);
 void dl_prism(u_char *user, const struct pcap_pkthdr *h, const u_char *p);
 
+/* datalink_decap.cpp - peels VLAN, MPLS and tunnel headers and calls process_packet() */
+typedef enum {
+    TUNNEL_NONE=0,
+    TUNNEL_MPLS,                        // id is the top label
+    TUNNEL_GRE,                         // id is the GRE key, if present
+    TUNNEL_VXLAN,                       // id is the VNI
+    TUNNEL_GENEVE,                      // id is the VNI
+    TUNNEL_ERSPAN,                      // id is the session id
+    TUNNEL_IPIP                         // no id
+} tunnel_type_t;
+struct tunnel_info {
+    tunnel_type_t type;                 // outermost tunnel the packet arrived in
+    int64_t       id;                   // -1 if the tunnel has no id
+};
+extern struct tunnel_info datalink_tunnel; // tunnel of the packet being processed
+const char *tunnel_type_name(int type);
+void decap_ethertype(int dlt,const struct pcap_pkthdr *h,const u_char *p,
+                     uint16_t ethertype,const u_char *data,u_int caplen);
+void decap_ip(int dlt,const struct pcap_pkthdr *h,const u_char *p,const u_char *data,u_int caplen);
+
 /**
  * shift the time value, in line with what the user requested...
  * previously this returned a structure on the stack, but that
@@ -293,11 +314,35 @@ void dl_prism(u_char *user, const struct pcap_pkthdr *h, const u_char *p);
 inline const timeval &tvshift(struct timeval &tv,const struct timeval &tv_)
 {
     tv.tv_sec  = tv_.tv_sec + datalink_tdelta;
-    tv.tv_usec = tv_.tv_usec;
+    tv.tv_usec = datalink_nsec ? tv_.tv_usec/1000 : tv_.tv_usec;
     return tv;
 }
 
+/**
+ * The shifted time of a packet with the full precision of the capture.
+ * pi.ts is always in microseconds; the pcap header has nanoseconds
+ * when the file was opened with nanosecond precision.
+ */
+inline struct timespec pkt_timespec(const be13::packet_info &pi)
+{
+    struct timespec ts;
+    if(pi.pcap_hdr){
+        ts.tv_sec  = pi.pcap_hdr->ts.tv_sec + datalink_tdelta;
+        ts.tv_nsec = datalink_nsec ? pi.pcap_hdr->ts.tv_usec : pi.pcap_hdr->ts.tv_usec * 1000;
+    } else {
+        ts.tv_sec  = pi.ts.tv_sec;
+        ts.tv_nsec = pi.ts.tv_usec * 1000;
+    }
+    return ts;
+}
+
+
 
+/* checksum.cpp - IPv4 header and TCP checksum validation */
+uint64_t cksum_add(const u_char *buf,size_t len,uint64_t sum); // unfolded one's-complement sum
+bool cksum_ip4_ok(const u_char *ip_header,size_t ip_header_len);
+bool cksum_tcp_ok(const u_char *src,const u_char *dst,size_t addr_len,
+                  const u_char *tcp,size_t tcp_len);
 
 /* util.cpp - utility functions */
 extern int debug;
@@ -317,6 +362,7 @@ void debug_real(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 extern "C" scanner_t scan_md5;
 extern "C" scanner_t scan_http;
 extern "C" scanner_t scan_python;
+extern "C" scanner_t scan_tls;
 extern "C" scanner_t scan_tcpdemux;
 extern "C" scanner_t scan_netviz;
 extern "C" scanner_t scan_wifiviz;
@@ -329,6 +375,13 @@ inline std::ostream& operator<<(std::ostream& os, const struct timeval *t)
     return os << t->tv_sec << "." << std::setw(6) << std::setfill('0') << t->tv_usec;
     
 }
+
+/* Microseconds, or nanoseconds if the capture has them */
+inline std::ostream& operator<<(std::ostream& os, const struct timespec *t)
+{
+    if(datalink_nsec) return os << t->tv_sec << "." << std::setw(9) << std::setfill('0') << t->tv_nsec;
+    return os << t->tv_sec << "." << std::setw(6) << std::setfill('0') << t->tv_nsec/1000;
+}
 #endif
 
 #endif /* __TCPFLOW_H__ */
@@ -0,0 +1,243 @@
+/**
+ * tcpflow_extract.cpp:
+ *
+ * Recreates flow files from the segment output of tcpflow -S segments=1.
+ *
+ * usage: tcpflow-extract [-l] [-o outdir] segdir [flow ...]
+ *
+ *   segdir   the -o directory of the tcpflow run, which holds
+ *            tcpflow.idx and the tcpflow-NNNNNN.seg files
+ *   flow     a flow id or the name tcpflow gave the flow; with none,
+ *            every flow is extracted
+ *   -l       list the flows (id, bytes, extents, name) instead
+ *   -o       where to write the files (default: the current directory)
+ *
+ * Each flow is written to outdir/name, exactly as tcpflow would have
+ * written it without -S segments=1.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "config.h"
+#include "segment_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+struct flow_info {
+    flow_info():name(),ops(),selected(false){}
+    std::string name;
+    std::vector<segment_index::extent_rec> ops; // extents; shifts have length 0 and seg_offset = bytes
+    bool selected;
+};
+typedef std::map<uint64_t,flow_info> flows_t;
+
+static void usage()
+{
+    fprintf(stderr,"usage: tcpflow-extract [-l] [-o outdir] segdir [flow ...]\n");
+    exit(1);
+}
+
+static void mkdirs_for(const std::string &path)
+{
+    for(size_t i=1;i<path.size();i++){
+        if(path[i]!='/') continue;
+        std::string dir = path.substr(0,i);
+        if(mkdir(dir.c_str(),0777)<0 && errno!=EEXIST){
+            perror(dir.c_str());
+            exit(1);
+        }
+    }
+}
+
+/* Read the index into flows. Returns false if it is not a tcpflow segment index. */
+static bool read_index(const std::string &fname,flows_t &flows)
+{
+    FILE *f = fopen(fname.c_str(),"rb");
+    if(f==0){
+        perror(fname.c_str());
+        exit(1);
+    }
+    segment_index::header h;
+    if(fread(&h,1,sizeof(h),f)!=sizeof(h) || memcmp(h.magic,segment_index::MAGIC,sizeof(h.magic))!=0){
+        fprintf(stderr,"%s: not a tcpflow segment index\n",fname.c_str());
+        return false;
+    }
+    if(h.byte_order!=segment_index::ORDER_MARK){
+        fprintf(stderr,"%s: written on a machine with the other byte order\n",fname.c_str());
+        return false;
+    }
+    std::vector<char> buf;
+    segment_index::rec_header rh;
+    while(fread(&rh,1,sizeof(rh),f)==sizeof(rh)){
+        if(rh.len<sizeof(rh) || rh.len%8){
+            fprintf(stderr,"%s: corrupt record\n",fname.c_str());
+            return false;
+        }
+        buf.resize(rh.len);
+        memcpy(&buf[0],&rh,sizeof(rh));
+        if(fread(&buf[sizeof(rh)],1,rh.len-sizeof(rh),f)!=rh.len-sizeof(rh)) break; // truncated
+        switch(rh.type){
+        case segment_index::REC_FLOW: {
+            segment_index::flow_rec r;
+            if(rh.len<sizeof(r)) return false;
+            memcpy(&r,&buf[0],sizeof(r));
+            if(sizeof(r)+r.name_len>rh.len) return false;
+            flows[r.id].name.assign(&buf[sizeof(r)],r.name_len);
+            break;
+        }
+        case segment_index::REC_EXTENT: {
+            segment_index::extent_rec r;
+            if(rh.len<sizeof(r)) return false;
+            memcpy(&r,&buf[0],sizeof(r));
+            flows[r.id].ops.push_back(r);
+            break;
+        }
+        case segment_index::REC_SHIFT: {
+            segment_index::shift_rec r;
+            if(rh.len<sizeof(r)) return false;
+            memcpy(&r,&buf[0],sizeof(r));
+            segment_index::extent_rec op;
+            memset(&op,0,sizeof(op));
+            op.id         = r.id;
+            op.seg_offset = r.bytes;
+            flows[r.id].ops.push_back(op);
+            break;
+        }
+        default:                        // a newer record type; skip it
+            break;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* The extents of a flow with the shifts applied, in the order they were written */
+static std::vector<segment_index::extent_rec> resolve(const flow_info &fi)
+{
+    std::vector<segment_index::extent_rec> ext;
+    for(size_t i=0;i<fi.ops.size();i++){
+        if(fi.ops[i].length==0){
+            for(size_t j=0;j<ext.size();j++) ext[j].flow_offset += fi.ops[i].seg_offset;
+        } else {
+            ext.push_back(fi.ops[i]);
+        }
+    }
+    return ext;
+}
+
+int main(int argc,char **argv)
+{
+    bool opt_list = false;
+    std::string outdir(".");
+    int ch;
+    while((ch = getopt(argc,argv,"lo:h")) != -1){
+        switch(ch){
+        case 'l': opt_list = true; break;
+        case 'o': outdir = optarg; break;
+        default: usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if(argc<1) usage();
+    std::string segdir = argv[0];
+
+    flows_t flows;
+    if(!read_index(segdir + "/" + segment_index::INDEX_NAME,flows)) exit(1);
+
+    /* Which flows? */
+    std::set<std::string> names;
+    std::set<uint64_t> ids;
+    for(int i=1;i<argc;i++){
+        char *end = 0;
+        uint64_t id = strtoull(argv[i],&end,10);
+        if(*argv[i] && *end==0) ids.insert(id);
+        else names.insert(argv[i]);
+    }
+    for(flows_t::iterator it=flows.begin();it!=flows.end();it++){
+        it->second.selected = (argc==1) || ids.count(it->first) || names.count(it->second.name);
+    }
+
+    if(opt_list){
+        for(flows_t::const_iterator it=flows.begin();it!=flows.end();it++){
+            if(!it->second.selected) continue;
+            std::vector<segment_index::extent_rec> ext = resolve(it->second);
+            uint64_t bytes = 0;
+            for(size_t i=0;i<ext.size();i++){
+                if(ext[i].flow_offset+ext[i].length > bytes) bytes = ext[i].flow_offset+ext[i].length;
+            }
+            printf("%" PRIu64 "\t%" PRIu64 "\t%zu\t%s\n",it->first,bytes,ext.size(),it->second.name.c_str());
+        }
+        return 0;
+    }
+
+    std::map<uint32_t,int> segfds;      // open segment files
+    std::vector<char> buf;
+    int extracted = 0;
+    for(flows_t::const_iterator it=flows.begin();it!=flows.end();it++){
+        if(!it->second.selected) continue;
+        if(it->second.name.size()==0){
+            fprintf(stderr,"flow %" PRIu64 " has no name in the index; skipped\n",it->first);
+            continue;
+        }
+        std::string path = outdir + "/" + it->second.name;
+        mkdirs_for(path);
+        unlink(path.c_str());           // it may be a -S dedup=1 link; don't truncate the others
+        int fd = open(path.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_BINARY,0666);
+        if(fd<0){
+            perror(path.c_str());
+            exit(1);
+        }
+        std::vector<segment_index::extent_rec> ext = resolve(it->second);
+        for(size_t i=0;i<ext.size();i++){
+            std::map<uint32_t,int>::const_iterator sf = segfds.find(ext[i].segment);
+            int sfd;
+            if(sf==segfds.end()){
+                std::string sname = segdir + "/" + segment_index::segment_name(ext[i].segment);
+                sfd = open(sname.c_str(),O_RDONLY|O_BINARY);
+                if(sfd<0){
+                    perror(sname.c_str());
+                    exit(1);
+                }
+                segfds[ext[i].segment] = sfd;
+            } else {
+                sfd = sf->second;
+            }
+            buf.resize(ext[i].length);
+            if(pread(sfd,&buf[0],ext[i].length,(off_t)ext[i].seg_offset)!=(ssize_t)ext[i].length){
+                fprintf(stderr,"%s: short read from %s\n",path.c_str(),
+                        segment_index::segment_name(ext[i].segment).c_str());
+                exit(1);
+            }
+            if(pwrite(fd,&buf[0],ext[i].length,(off_t)ext[i].flow_offset)!=(ssize_t)ext[i].length){
+                perror(path.c_str());
+                exit(1);
+            }
+        }
+        close(fd);
+        extracted++;
+    }
+    for(std::map<uint32_t,int>::const_iterator it=segfds.begin();it!=segfds.end();it++) close(it->second);
+    if(ids.size()+names.size()>0 && extracted==0){
+        fprintf(stderr,"no matching flows\n");
+        return 1;
+    }
+    return 0;
+}
@@ -15,6 +15,7 @@
 #include "tcpflow.h"
 #include "tcpip.h"
 #include "tcpdemux.h"
+#include "xml_attrs.h"
 
 #include <iostream>
 #include <sstream>
@@ -35,11 +36,12 @@
 tcpip::tcpip(tcpdemux &demux_,const flow &flow_,be13::tcp_seq isn_):
     demux(demux_),myflow(flow_),dir(unknown),isn(isn_),nsn(0),
     syn_count(0),fin_count(0),fin_size(0),pos(0),
-    flow_pathname(),fd(-1),file_created(false),
+    flow_pathname(),fd(-1),file_created(false),extents(),prealloc_end(0),hasher(0),hashed(0),
+    content(content_sniffer::UNKNOWN),scanners(demux_.classifier.by_ports(flow_.sport,flow_.dport)),tls(0),
     flow_index_pathname(),idx_file(),
     seen(new recon_set()),
     last_byte(),
-    last_packet_number(),out_of_order_count(0),violations(0)
+    last_packet_number(),out_of_order_count(0),violations(0),bad_checksum_count(0),stream_dropped(0)
 {
 }
 
@@ -60,37 +62,62 @@ void tcpip::dump_seen()
     }
 }
 
+/* Writes the <fileobject> of this flow. The report is not flushed here;
+ * tcpdemux::post_process() decides when to.
+ */
 void tcpip::dump_xml(class dfxml_writer *xreport,const std::string &xmladd)
 {
     static const std::string fileobject_str("fileobject");
     static const std::string filesize_str("filesize");
     static const std::string filename_str("filename");
     static const std::string tcpflow_str("tcpflow");
+    static const std::string byte_runs_str("byte_runs");
+    static const std::string byte_run_str("byte_run");
+    static xml_attrs attrs;             // reused from flow to flow
 
     xreport->push(fileobject_str);
     if(flow_pathname.size()) xreport->xmlout(filename_str,flow_pathname);
 
     xreport->xmlout(filesize_str,last_byte);
-	
-    std::stringstream attrs;
-    attrs << "startime='" << dfxml_writer::to8601(myflow.tstart) << "' ";
-    attrs << "endtime='"  << dfxml_writer::to8601(myflow.tlast)  << "' ";
-    if(myflow.has_mac_daddr()) attrs << "mac_daddr='" << macaddr(myflow.mac_daddr) << "' ";
-    if(myflow.has_mac_saddr()) attrs << "mac_saddr='" << macaddr(myflow.mac_saddr) << "' ";
-    attrs << "family='"   << (int)myflow.family << "' ";
-    attrs << "src_ipn='"  << ipaddr_prn(myflow.src, myflow.family) << "' ";
-    attrs << "dst_ipn='"  << ipaddr_prn(myflow.dst, myflow.family) << "' ";
-    attrs << "srcport='"  << myflow.sport << "' ";
-    attrs << "dstport='"  << myflow.dport << "' ";
-    attrs << "packets='"  << myflow.packet_count << "' ";
-    if(out_of_order_count) attrs << "out_of_order_count='" << out_of_order_count << "' ";
-    if(violations)         attrs << "violations='" << violations << "' ";
-    attrs << "len='"      << myflow.len << "' ";
-    if(myflow.len != myflow.caplen) attrs << "caplen='"   << myflow.caplen << "' ";
+
+    char ipbuf[INET6_ADDRSTRLEN];
+    attrs.clear();
+    attrs.add_time("startime",myflow.tstart,datalink_nsec);
+    attrs.add_time("endtime",myflow.tlast,datalink_nsec);
+    if(myflow.has_mac_daddr()) attrs.add("mac_daddr",macaddr(myflow.mac_daddr));
+    if(myflow.has_mac_saddr()) attrs.add("mac_saddr",macaddr(myflow.mac_saddr));
+    attrs.add("family",(uint64_t)myflow.family);
+    attrs.add("src_ipn",inet_ntop(myflow.family,myflow.src.addr,ipbuf,sizeof(ipbuf)) ? ipbuf : "");
+    attrs.add("dst_ipn",inet_ntop(myflow.family,myflow.dst.addr,ipbuf,sizeof(ipbuf)) ? ipbuf : "");
+    attrs.add("srcport",(uint64_t)myflow.sport);
+    attrs.add("dstport",(uint64_t)myflow.dport);
+    attrs.add("packets",myflow.packet_count);
+    if(myflow.has_tunnel()){
+        attrs.add("tunnel",tunnel_type_name(myflow.tunnel_type));
+        if(myflow.tunnel_id>=0) attrs.add_signed("tunnel_id",myflow.tunnel_id);
+    }
+    if(content!=content_sniffer::UNKNOWN) attrs.add("content",content_sniffer::name(content));
+    if(out_of_order_count) attrs.add("out_of_order_count",out_of_order_count);
+    if(violations)         attrs.add("violations",violations);
+    if(bad_checksum_count) attrs.add("bad_checksums",bad_checksum_count);
+    attrs.add("len",myflow.len);
+    if(myflow.len != myflow.caplen) attrs.add("caplen",myflow.caplen);
     xreport->xmlout(tcpflow_str,"",attrs.str(),false);
+    if(extents.size()){
+        /* With -S segments=1 the flow is in the segment files, not in filename */
+        xreport->push(byte_runs_str);
+        for(std::vector<segment_writer::extent>::const_iterator ext=extents.begin();ext!=extents.end();ext++){
+            attrs.clear();
+            attrs.add("file_offset",ext->flow_offset);
+            attrs.add("len",(uint64_t)ext->length);
+            attrs.add("segment",segment_index::segment_name(ext->segment));
+            attrs.add("seg_offset",ext->seg_offset);
+            xreport->xmlout(byte_run_str,"",attrs.str(),false);
+        }
+        xreport->pop();
+    }
     if(xmladd.size()>0) xreport->xmlout("",xmladd,"",false);
     xreport->pop();
-    xreport->flush();
 }
 
 
@@ -104,6 +131,8 @@ tcpip::~tcpip()
 {
     assert(fd<0);                       // file must be closed
     if(seen) delete seen;
+    if(hasher) delete hasher;
+    if(tls) delete tls;
 }
 
 #pragma GCC diagnostic warning "-Weffc++"
@@ -129,8 +158,20 @@ void tcpip::close_file()
 {
     if (fd>=0){
 	struct timeval times[2];
-	times[0] = myflow.tstart;
-	times[1] = myflow.tstart;
+	times[0].tv_sec  = myflow.tstart.tv_sec;
+	times[0].tv_usec = myflow.tstart.tv_nsec / 1000;
+	times[1] = times[0];
+
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+	/* Give back the disk reserved beyond the end of the file */
+	if(prealloc_end>0 && prealloc_end!=PREALLOC_FAILED){
+	    struct stat st;
+	    if(fstat(fd,&st)==0 && ftruncate(fd,st.st_size)!=0){
+		DEBUG(2)("ftruncate(%s): %s",flow_pathname.c_str(),strerror(errno));
+	    }
+	}
+	prealloc_end = 0;
+#endif
 
 	DEBUG(5) ("%s: closing file in tcpip::close_file", flow_pathname.c_str());
 	/* close the file and remember that it's closed */
@@ -141,10 +182,8 @@ void tcpip::close_file()
 	}
 #elif defined(HAVE_FUTIMENS) 
 	struct timespec tstimes[2];
-	for(int i=0;i<2;i++){
-	    tstimes[i].tv_sec = times[i].tv_sec;
-	    tstimes[i].tv_nsec = times[i].tv_usec * 1000;
-	}
+	tstimes[0] = myflow.tstart;
+	tstimes[1] = myflow.tstart;
 	if(futimens(fd,tstimes)){
 	    perror("futimens(fd=%d)",fd);
 	}
@@ -160,6 +199,40 @@ void tcpip::close_file()
     //std::cerr << "close_file1 " << *this << "\n";
 }
 
+/*
+ * Reserve disk ahead of a flow that is arriving quickly, so that the
+ * blocks of thousands of files written at once are not interleaved.
+ * The reservation doubles with the file, up to PREALLOC_MAX, and does
+ * not change the file size; close_file() gives back what was not used.
+ * Called by store_packet() with the end of what it just wrote.
+ */
+void tcpip::preallocate(uint64_t end)
+{
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+    if(demux.opt.prealloc_rate==0 || fd<0 || end<=prealloc_end || prealloc_end==PREALLOC_FAILED) return;
+
+    int64_t secs = myflow.tlast.tv_sec - myflow.tstart.tv_sec;
+    if(secs<1) secs = 1;
+    if(end/(uint64_t)secs < demux.opt.prealloc_rate) return;
+
+    uint64_t chunk = end;
+    if(chunk<PREALLOC_MIN) chunk = PREALLOC_MIN;
+    if(chunk>PREALLOC_MAX) chunk = PREALLOC_MAX;
+    if(demux.opt.max_bytes_per_flow>=0 && end+chunk>(uint64_t)demux.opt.max_bytes_per_flow){
+        if(end>=(uint64_t)demux.opt.max_bytes_per_flow) return;
+        chunk = demux.opt.max_bytes_per_flow - end;
+    }
+    if(fallocate(fd,FALLOC_FL_KEEP_SIZE,(off_t)end,(off_t)chunk)){
+        DEBUG(2)("fallocate(%s): %s",flow_pathname.c_str(),strerror(errno));
+        prealloc_end = PREALLOC_FAILED; // don't try again for this flow
+        return;
+    }
+    prealloc_end = end+chunk;
+#else
+    (void)end;
+#endif
+}
+
 /*
  * Opens the file transcript file (creating file if necessary).
  * Called by store_packet()
@@ -175,6 +248,7 @@ int tcpip::open_file()
         if(flow_pathname.size()==0) {
             flow_pathname = myflow.new_filename(&fd,O_RDWR|O_BINARY|O_CREAT|O_EXCL,0666);
             file_created = true;		// remember we made it
+            if(demux.dedup && fd>=0) hasher = new sha1_generator();
             create_idx_needed = true;	// We created a new stream, so we need to create a new flow file. --GDD
             DEBUG(5) ("%s: created new file",flow_pathname.c_str());
         } else {
@@ -247,97 +321,31 @@ void tcpip::print_packet(const u_char *data, uint32_t length)
 	}
     }
 
-#ifdef HAVE_PTHREAD
-    if(semlock){
-	if(sem_wait(semlock)){
-	    fprintf(stderr,"%s: attempt to acquire semaphore failed: %s\n",progname,strerror(errno));
-	    exit(1);
-	}
-    }
-#endif
-
-    if (demux.opt.use_color) fputs(dir==dir_cs ? color[1] : color[2], stdout);
+    console_writer &out = demux.console;
+    if (demux.opt.use_color) out.append(dir==dir_cs ? color[1] : color[2]);
     if (demux.opt.suppress_header == 0){
         if(flow_pathname.size()==0) flow_pathname = myflow.filename(0);
-        printf("%s: ", flow_pathname.c_str());
-        if(demux.opt.output_hex) putchar('\n');
+        out.append(flow_pathname.data(),flow_pathname.size());
+        out.append(": ",2);
+        if(demux.opt.output_hex) out.put('\n');
     }
 
-    size_t written = 0;
     if(demux.opt.output_hex){
-        const size_t bytes_per_line = 32;
-        size_t max_spaces = 0;
-        for(u_int i=0;i<length;i+=bytes_per_line){
-            size_t spaces=0;
-            
-            /* Print the offset */
-            char b[64];
-            size_t count = snprintf(b,sizeof(b),"%04x: ",(int)i);
-            if(fwrite(b,1,count,stdout)!=count){
-	      perror("fwrite");
-	    }
-            spaces += count;
-            
-            /* Print the hext bytes */
-            for(size_t j=0;j<bytes_per_line && i+j<length ;j++){
-                unsigned char ch = data[i+j];
-                fprintf(stdout,"%02x",ch);  spaces += 2;
-                if(j%2==1){
-                    fputc(' ',stdout);
-                    spaces += 1;
-                }
-            }
-            /* space out to where the ASCII region is */
-            if(spaces>max_spaces) max_spaces=spaces;
-            for(;spaces<max_spaces;spaces++){
-                fputc(' ',stdout);
-            }
-            putchar(' ');
-            /* Print the ascii */
-            for(size_t j=0;j<bytes_per_line && i+j<length;j++){
-                unsigned char ch = data[i+j];
-                if(ch>=' ' && ch<='~') fputc(ch,stdout);
-                else fputc('.',stdout);
-            }
-            fputc('\n',stdout);
-        }
-        written = length;               // just fake it.
+        out.append_hex(data,length);
     }
     else if(demux.opt.output_strip_nonprint){
-	for(const u_char *cc = data;cc<data+length;cc++){
-	    if(isprint(*cc) || (*cc=='\n') || (*cc=='\r')){
-                int ret = fputc(*cc,stdout);
-                if(ret==EOF){
-                    std::cerr << "EOF on write to stdout\n";
-                    exit(1);
-                
-                }
-	    }
-	    else fputc('.',stdout);
-            written += 1; // treat even unprintable characters as "written". It
-                          // really means "processed"
-	}
+        out.append_stripped(data,length);
     }
     else {
-	written = fwrite(data,1,length,stdout);
-        if(length != written) std::cerr << "\nwrite error to stdout (" << length << "!=" << written << ") \n";
+        out.append((const char *)data,length);
     }
 
     last_byte += length;
 
-    if (demux.opt.use_color) printf("\033[0m");
+    if (demux.opt.use_color) out.append("\033[0m");
 
-    if (! demux.opt.console_output_nonewline) putchar('\n');
-    fflush(stdout);
-
-#ifdef HAVE_PTHREAD
-    if(semlock){
-	if(sem_post(semlock)){
-	    fprintf(stderr,"%s: attempt to post semaphore failed: %s\n",progname,strerror(errno));
-	    exit(1);
-	}
-    }
-#endif
+    if (! demux.opt.console_output_nonewline) out.put('\n');
+    out.end_packet();
 }
 
 /*
@@ -398,7 +406,7 @@ void update_seen(recon_set *seen,uint64_t pos,uint32_t length)
  *
  * called from tcpdemux::process_tcp_packet()
  */
-void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,struct timeval ts)
+void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,struct timespec ts)
 {
     if(length==0) return;               // no need to do anything
 
@@ -440,7 +448,17 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
      * save the return value because open_tcpfile() puts the file pointer
      * into the structure for us.
      */
-    if (fd < 0) {
+    if (demux.segments) {
+        /* Segment output: name the flow, but there is no file to open */
+        if(flow_pathname.size()==0){
+            flow_pathname = myflow.new_filename(0,0,0);
+            std::string name = flow_pathname;
+            if(flow::outdir!="." && flow::outdir!="" && name.compare(0,flow::outdir.size()+1,flow::outdir+"/")==0){
+                name = name.substr(flow::outdir.size()+1);
+            }
+            demux.segments->add_flow(myflow,name);
+        }
+    } else if (fd < 0) {
 	if (open_file()) {
 	    DEBUG(1)("unable to open TCP file %s  fd=%d  wlength=%d",
                      flow_pathname.c_str(),fd,(int)wlength);
@@ -452,8 +470,15 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
 
     if(insert_bytes>0){
 	if(fd>=0) shift_file(fd,insert_bytes);
+        if(demux.segments){
+            demux.segments->shift(myflow.id,insert_bytes);
+            for(std::vector<segment_writer::extent>::iterator ext=extents.begin();ext!=extents.end();ext++){
+                ext->flow_offset += insert_bytes;
+            }
+        }
+        if(tls) tls->shift(insert_bytes); // where it found the records to be
 	isn -= insert_bytes;		// it's really earlier
-	lseek(fd,(off_t)0,SEEK_SET);	// put at the beginning
+	if(fd>=0) lseek(fd,(off_t)0,SEEK_SET); // put at the beginning
 	pos = 0;
 	nsn = isn+1;
 	out_of_order_count++;
@@ -468,6 +493,11 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
         }
     }
 
+    /* Likewise, nothing after a TLS handshake, with -S tls_truncate=1;
+     * only now is offset where the flow has been shifted to.
+     */
+    if (tls) wlength = tls_length(offset,data,length,wlength);
+
     /* if we're not at the correct point in the file, seek there */
     if (offset != pos) {
         /* Check for a keepalive */
@@ -490,6 +520,18 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
                fd>=0 ? "will" : "won't",
                (long) wlength, offset);
     
+    if(demux.segments && wlength>0){
+        segment_writer::extent e = demux.segments->write(myflow.id,offset,data,wlength);
+        if(extents.size()){
+            segment_writer::extent &last = extents.back();
+            if(last.segment==e.segment && last.seg_offset+last.length==e.seg_offset
+               && last.flow_offset+last.length==e.flow_offset && (uint64_t)last.length+e.length<=0xffffffffULL){
+                last.length += e.length;
+                e.length = 0;
+            }
+        }
+        if(e.length) extents.push_back(e);
+    }
     if(fd>=0){
       if ((uint32_t)write(fd,data, wlength) != wlength) {
 	    DEBUG(1) ("write to %s failed: ", flow_pathname.c_str());
@@ -497,7 +539,7 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
 	}
 	// Write to the index file if needed.  Note, index file is sorted before close, so no need to jump around --GDD
 		if (demux.opt.output_packet_index && idx_file.is_open()) {
-			idx_file << offset << "|" << ts.tv_sec << "." << std::setw(6) << std::setfill('0') << ts.tv_usec << "|"
+			idx_file << offset << "|" << &ts << "|"
 					<< wlength << "\n";
 			if (idx_file.bad()){
 				DEBUG(1)("write to index file %s failed: ",flow_index_pathname.c_str());
@@ -512,6 +554,19 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
 	}
     }
 
+    if(fd>=0 && wlength>0) preallocate(offset+wlength);
+
+    /* Hash as we go while the data arrives in order; otherwise the file is read back at the end */
+    if(hasher){
+        if(insert_bytes==0 && offset==hashed){
+            hasher->update(data,wlength);
+            hashed += wlength;
+        } else {
+            delete hasher;
+            hasher = 0;
+        }
+    }
+
     /* Update the database of bytes that we've seen */
     if(seen) update_seen(seen,pos,length);
 
@@ -521,7 +576,7 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
 
     if(pos>last_byte) last_byte = pos;
 
-    if(debug>=100){
+    if(debug>=100 && fd>=0){
         uint64_t rpos = lseek(fd,(off_t)0,SEEK_CUR);
         DEBUG(100)("    pos=%" PRId64 "  lseek(fd,0,SEEK_CUR)=%" PRId64,pos,rpos);
         assert(pos==rpos);
@@ -533,6 +588,59 @@ void tcpip::store_packet(const u_char *data, uint32_t length, int32_t delta,stru
 #endif
 }
 
+/* How many of the wlength bytes of a segment at offset come before the
+ * end of the TLS handshake; the framer sees the whole segment.
+ */
+uint32_t tcpip::tls_length(uint64_t offset,const u_char *data,uint32_t length,uint32_t wlength)
+{
+    uint64_t handshake_end = tls->segment(offset,data,length);
+    if(handshake_end==0 || offset+wlength<=handshake_end) return wlength;
+    if(offset>=handshake_end) return 0;
+    DEBUG(2) ("packet truncated at the end of the TLS handshake on %s", myflow.str().c_str());
+    return handshake_end - offset;
+}
+
+/* send the contents of this packet to the -S stream consumer at its
+ * offset in the flow, tracking pos and nsn as store_packet() does.
+ * There is no file to insert into, so data from before the start of
+ * the flow is dropped and counted as a violation.
+ *
+ * called from tcpdemux::process_tcp_packet()
+ */
+void tcpip::stream_packet(const u_char *data, uint32_t length, int32_t delta)
+{
+    if(length==0) return;
+
+    int64_t offset = (int64_t)pos+delta;
+    if(offset < 0){
+	DEBUG(2)("packet received with offset %" PRId64 " on stream %s; ignoring",offset,myflow.str().c_str());
+	violations++;
+	return;
+    }
+    if (offset != (int64_t)pos) {
+        if(delta == -1 && length == 1) return; // RFC1122 keepalive
+	if(delta<0) out_of_order_count++;
+	pos += delta;
+	nsn += delta;
+    }
+
+    uint32_t wlength = length;
+    if (demux.opt.max_bytes_per_flow >= 0){
+        uint64_t max_bytes_per_flow = (uint64_t)demux.opt.max_bytes_per_flow;
+	if((uint64_t)offset >= max_bytes_per_flow) wlength = 0;
+	else if((uint64_t)offset+length > max_bytes_per_flow) wlength = max_bytes_per_flow - offset;
+    }
+    if(tls) wlength = tls_length(offset,data,length,wlength);
+    if(wlength>0 && !demux.stream->write(myflow.id,(uint64_t)offset,data,wlength)){
+        stream_dropped += wlength;
+    }
+
+    if(seen) update_seen(seen,pos,length);
+    pos += length;
+    nsn += length;
+    if(pos>last_byte) last_byte = pos;
+}
+
 /*
  * Compare two index strings and return the result.  Called by
  * the vector::sort in sort_index.
@@ -158,12 +158,13 @@ public:;
     static void usage();			// print information on flow notation
     static std::string filename_template;	// 
     static std::string outdir;                  // where the output gets written
-    flow():id(),vlan(),mac_daddr(),mac_saddr(),tstart(),tlast(),len(),caplen(),packet_count(){};
+    flow():id(),vlan(),tunnel_type(TUNNEL_NONE),tunnel_id(-1),mac_daddr(),mac_saddr(),tstart(),tlast(),len(),caplen(),packet_count(){};
     flow(const flow_addr &flow_addr_,uint64_t id_,const be13::packet_info &pi):
 	flow_addr(flow_addr_),id(id_),vlan(pi.vlan()),
+        tunnel_type(datalink_tunnel.type),tunnel_id(datalink_tunnel.id),
         mac_daddr(),
         mac_saddr(),
-        tstart(pi.ts),tlast(pi.ts),
+        tstart(pkt_timespec(pi)),tlast(pkt_timespec(pi)),
         len(0),
         caplen(0),
 	packet_count(0){
@@ -175,10 +176,12 @@ public:;
     virtual ~flow(){};
     uint64_t  id;			// flow_counter when this flow was created
     int32_t   vlan;			// vlan interface we first observed; -1 means no vlan 
+    int32_t   tunnel_type;		// outer tunnel of first packet; TUNNEL_NONE means no tunnel
+    int64_t   tunnel_id;		// VNI, GRE key, MPLS label or ERSPAN session; -1 means no id
     uint8_t mac_daddr[6];               // dst mac address of first packet
     uint8_t mac_saddr[6];               // source mac address of first packet
-    struct timeval tstart;		// when first seen
-    struct timeval tlast;		// when last seen
+    struct timespec tstart;		// when first seen
+    struct timespec tlast;		// when last seen
     uint64_t len;     		        // off-wire length
     uint64_t caplen;    		// captured length
     uint64_t packet_count;		// packet count
@@ -189,11 +192,15 @@ public:;
     // optionally opening the file and returning a fd if &fd is provided
     std::string new_filename(int *fd,int flags,int mode);	
 
-    bool has_mac_daddr(){
+    bool has_mac_daddr() const {
         return mac_daddr[0] || mac_daddr[1] || mac_daddr[2] || mac_daddr[3] || mac_daddr[4] || mac_daddr[5];
     }
 
-    bool has_mac_saddr(){
+    bool has_tunnel() const {
+        return tunnel_type!=TUNNEL_NONE;
+    }
+
+    bool has_mac_saddr() const {
         return mac_saddr[0] || mac_saddr[1] || mac_saddr[2] || mac_saddr[3] || mac_saddr[4] || mac_saddr[5];
     }
 };
@@ -261,6 +268,11 @@ typedef boost::icl::interval_set<uint64_t> recon_set; // Boost interval set of b
 #endif
 
 #include "intrusive_list.h"
+#include "segment_writer.h"
+#include "content_sniffer.h"
+#include "flow_classifier.h"
+#include "tls_parser.h"
+#include "dfxml/src/hash_t.h"
 
 #pragma GCC diagnostic warning "-Weffc++"
 #pragma GCC diagnostic warning "-Wshadow"
@@ -275,6 +287,8 @@ public:
 	dir_sc,				// server-to-client 1 
 	dir_cs				// client-to-server 2
     } dir_t;
+    enum { PREALLOC_MIN=1024*1024, PREALLOC_MAX=64*1024*1024 }; // fallocate() chunk sizes
+    static const uint64_t PREALLOC_FAILED = ~(uint64_t)0;
 	
 private:
     /*** Begin Effective C++ error suppression                ***
@@ -304,6 +318,13 @@ public:;
     std::string flow_pathname;		// path where flow is saved
     int		fd;			// file descriptor for file storing this flow's data 
     bool	file_created;		// true if file was created
+    std::vector<segment_writer::extent> extents; // where the flow went, with -S segments=1
+    uint64_t    prealloc_end;           // disk is reserved up to here; see preallocate()
+    sha1_generator *hasher;             // with -S dedup=1, the file so far, while it is written in order
+    uint64_t    hashed;                 // how much of it that is
+    content_sniffer::type_t content;    // what the first segment of the flow looks like
+    flow_classifier::scanner_set scanners; // the scanners that could apply; none, and it isn't post-processed
+    tls_framer  *tls;                   // with -S tls_truncate=1, finds where a TLS flow's handshake ends
 
     /* Flow Index information - only used if flow packet/data indexing is requested --GDD */
     std::string flow_index_pathname;	// Path for the flow index file
@@ -315,6 +336,8 @@ public:;
     uint64_t	last_packet_number;	// for finding most recent packet written
     uint64_t	out_of_order_count;	// all packets were contigious
     uint64_t    violations;		// protocol violation count
+    uint64_t    bad_checksum_count;	// segments with a bad IPv4 or TCP checksum (-S checksum=count|drop)
+    uint64_t    stream_dropped;         // bytes the -S stream consumer did not keep up with
 
     /* File Acess Order */
     intrusive_list<tcpip>::iterator it;
@@ -323,7 +346,10 @@ public:;
     void close_file();			// close fd
     int  open_file();                   // opens save file; return -1 if failure, 0 if success
     void print_packet(const u_char *data, uint32_t length);
-    void store_packet(const u_char *data, uint32_t length, int32_t delta,struct timeval ts);
+    void store_packet(const u_char *data, uint32_t length, int32_t delta,struct timespec ts);
+    void preallocate(uint64_t end);
+    void stream_packet(const u_char *data, uint32_t length, int32_t delta);
+    uint32_t tls_length(uint64_t offset,const u_char *data,uint32_t length,uint32_t wlength); // -S tls_truncate
     void process_packet(const struct timeval &ts,const int32_t delta,const u_char *data,const uint32_t length);
     uint32_t seen_bytes();
     void dump_seen();
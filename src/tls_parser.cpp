@@ -0,0 +1,248 @@
+/**
+ * tls_parser.cpp:
+ *
+ * The unencrypted start of a TLS connection; see tls_parser.h.
+ * The formats are those of RFC 5246 (TLS 1.2) and RFC 8446 (TLS 1.3).
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "tls_parser.h"
+
+#include <sstream>
+
+/* Reads big-endian fields from a message, reading zeros, and no longer
+ * ok, once it runs out; so a short or lying message yields nothing.
+ */
+class tls_reader {
+public:
+    tls_reader(const uint8_t *p_,size_t len_):p(p_),len(len_),ok(true){}
+    const uint8_t *p;
+    size_t len;
+    bool   ok;
+
+    size_t left() const { return ok ? len : 0; }
+    uint8_t u8() {
+        if(left()<1){ ok = false; return 0; }
+        uint8_t v = p[0];
+        p++; len--;
+        return v;
+    }
+    uint16_t u16() {
+        if(left()<2){ ok = false; return 0; }
+        uint16_t v = (p[0]<<8) | p[1];
+        p += 2; len -= 2;
+        return v;
+    }
+    uint32_t u24() {
+        if(left()<3){ ok = false; return 0; }
+        uint32_t v = (p[0]<<16) | (p[1]<<8) | p[2];
+        p += 3; len -= 3;
+        return v;
+    }
+    /* The next n bytes, as a reader of their own */
+    tls_reader sub(size_t n) {
+        tls_reader r(p,n);
+        if(left()<n){
+            ok = r.ok = false;
+            return r;
+        }
+        p += n; len -= n;
+        return r;
+    }
+};
+
+const char *tls_parser::version_name(uint16_t v)
+{
+    switch(v){
+    case 0x0300: return "SSL 3.0";
+    case 0x0301: return "TLS 1.0";
+    case 0x0302: return "TLS 1.1";
+    case 0x0303: return "TLS 1.2";
+    case 0x0304: return "TLS 1.3";
+    }
+    return 0;
+}
+
+void tls_parser::feed(const uint8_t *buf,size_t len)
+{
+    if(stopped) return;
+    rec.append(reinterpret_cast<const char *>(buf),len);
+    size_t pos = 0;
+    while(!stopped && rec.size()-pos>=5){
+        const uint8_t *h = reinterpret_cast<const uint8_t *>(rec.data())+pos;
+        size_t rlen = (h[3]<<8) | h[4];
+        if(h[1]!=3 || h[0]<CONTENT_CHANGE_CIPHER_SPEC || h[0]>CONTENT_APPLICATION_DATA || rlen>(1<<14)+2048){
+            stopped = true;             // not TLS, or we lost our place
+            break;
+        }
+        if(rec.size()-pos-5<rlen) break; // the rest of it is still to come
+        if(h[0]==CONTENT_HANDSHAKE){
+            hs.append(reinterpret_cast<const char *>(h+5),rlen);
+            size_t hp = 0;
+            while(!stopped && hs.size()-hp>=4){
+                const uint8_t *m = reinterpret_cast<const uint8_t *>(hs.data())+hp;
+                size_t mlen = (m[1]<<16) | (m[2]<<8) | m[3];
+                if(mlen>MAX_HANDSHAKE){
+                    stopped = true;
+                    break;
+                }
+                if(hs.size()-hp-4<mlen) break;
+                handshake(m[0],m+4,mlen);
+                hp += 4+mlen;
+            }
+            hs.erase(0,hp);
+        } else if(h[0]!=CONTENT_ALERT){
+            stopped = true;             // everything from here is encrypted
+        }
+        pos += 5+rlen;
+    }
+    rec.erase(0,pos);
+}
+
+void tls_parser::handshake(uint8_t type,const uint8_t *p,size_t len)
+{
+    switch(type){
+    case CLIENT_HELLO:
+        parse_hello(true,p,len);
+        break;
+    case SERVER_HELLO:
+        parse_hello(false,p,len);
+        if(selected_version>=0x0304) stopped = true; // TLS 1.3 encrypts the rest
+        break;
+    case CERTIFICATE:
+        parse_certificates(p,len);
+        break;
+    }
+}
+
+void tls_parser::parse_hello(bool client,const uint8_t *p,size_t len)
+{
+    tls_reader r(p,len);
+    version = r.u16();
+    r.sub(32);                          // random
+    r.sub(r.u8());                      // session id
+    if(client){
+        tls_reader cs = r.sub(r.u16());
+        while(cs.left()>=2) ciphers.push_back(cs.u16());
+        r.sub(r.u8());                  // compression methods
+    } else {
+        cipher = r.u16();
+        r.u8();                         // compression method
+    }
+    if(!r.ok){
+        stopped = true;
+        return;
+    }
+    if(client) client_hello = true;
+    else       server_hello = true;
+
+    tls_reader ext = r.sub(r.u16());    // absent before TLS 1.2, which is fine
+    while(ext.left()>=4){
+        uint16_t type = ext.u16();
+        tls_reader d = ext.sub(ext.u16());
+        extensions.push_back(type);
+        switch(type){
+        case 0: {                       // server_name
+            tls_reader names = d.sub(d.u16());
+            while(names.left()>=3){
+                uint8_t name_type = names.u8();
+                tls_reader name = names.sub(names.u16());
+                if(name_type==0 && name.ok) sni.assign(reinterpret_cast<const char *>(name.p),name.len);
+            }
+            break;
+        }
+        case 10: {                      // supported_groups
+            tls_reader g = d.sub(d.u16());
+            while(g.left()>=2) groups.push_back(g.u16());
+            break;
+        }
+        case 11: {                      // ec_point_formats
+            tls_reader f = d.sub(d.u8());
+            while(f.left()>=1) point_formats.push_back(f.u8());
+            break;
+        }
+        case 16: {                      // application_layer_protocol_negotiation
+            tls_reader protos = d.sub(d.u16());
+            while(protos.left()>=1){
+                tls_reader proto = protos.sub(protos.u8());
+                if(proto.ok) alpn.push_back(std::string(reinterpret_cast<const char *>(proto.p),proto.len));
+            }
+            break;
+        }
+        case 43:                        // supported_versions; the client's is a list
+            if(!client) selected_version = d.u16();
+            break;
+        }
+    }
+}
+
+void tls_parser::parse_certificates(const uint8_t *p,size_t len)
+{
+    tls_reader r(p,len);
+    tls_reader list = r.sub(r.u24());
+    while(list.left()>=3){
+        tls_reader cert = list.sub(list.u24());
+        if(cert.ok) certificates.push_back(std::string(reinterpret_cast<const char *>(cert.p),cert.len));
+    }
+}
+
+static void ja3_list(std::ostream &os,const std::vector<uint16_t> &v)
+{
+    const char *sep = "";
+    for(std::vector<uint16_t>::const_iterator it=v.begin();it!=v.end();it++){
+        if(tls_parser::grease(*it)) continue;
+        os << sep << *it;
+        sep = "-";
+    }
+}
+
+/* The fields in decimal, GREASE values left out:
+ *   JA3:  version,ciphers,extensions,groups,point formats
+ *   JA3S: version,cipher,extensions
+ */
+std::string tls_parser::ja3() const
+{
+    std::stringstream ss;
+    ss << version << ",";
+    if(client_hello){
+        ja3_list(ss,ciphers);
+        ss << ",";
+        ja3_list(ss,extensions);
+        ss << ",";
+        ja3_list(ss,groups);
+        ss << ",";
+        const char *sep = "";
+        for(std::vector<uint8_t>::const_iterator it=point_formats.begin();it!=point_formats.end();it++){
+            ss << sep << (int)*it;
+            sep = "-";
+        }
+    } else {
+        ss << cipher << ",";
+        ja3_list(ss,extensions);
+    }
+    return ss.str();
+}
+
+uint64_t tls_framer::segment(uint64_t offset,const uint8_t *data,size_t len)
+{
+    while(end==0 && !lost){
+        uint64_t p = next+have;
+        if(p<offset || p>=offset+len) break; // the next header isn't in this segment
+        while(have<sizeof(hdr) && p<offset+len) hdr[have++] = data[p++ - offset];
+        if(have<sizeof(hdr)) break;     // it goes on in the next segment
+        if(hdr[1]!=3 || hdr[0]<tls_parser::CONTENT_CHANGE_CIPHER_SPEC || hdr[0]>tls_parser::CONTENT_APPLICATION_DATA){
+            lost = true;
+            break;
+        }
+        if(hdr[0]==tls_parser::CONTENT_APPLICATION_DATA){
+            end = next;
+            break;
+        }
+        next += sizeof(hdr) + ((hdr[3]<<8) | hdr[4]);
+        have = 0;
+    }
+    return end;
+}
@@ -0,0 +1,85 @@
+/*
+ * tls_parser.h:
+ *
+ * Reads the unencrypted start of one direction of a TLS connection:
+ * the ClientHello or ServerHello, and, before TLS 1.3, the server's
+ * certificates. Bytes are fed in as they come; records and handshake
+ * messages may be split anywhere. Parsing stops at the first encrypted
+ * or malformed record, since nothing after it can be read.
+ *
+ * tls_framer only follows the record headers, to find where the
+ * handshake ends without keeping any of it, so that tcpflow can stop
+ * storing a flow there (-S tls_truncate=1).
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef TLS_PARSER_H
+#define TLS_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class tls_parser {
+public:
+    enum { CONTENT_CHANGE_CIPHER_SPEC=20, CONTENT_ALERT=21, CONTENT_HANDSHAKE=22, CONTENT_APPLICATION_DATA=23 };
+    enum { CLIENT_HELLO=1, SERVER_HELLO=2, CERTIFICATE=11 };
+    enum { MAX_HANDSHAKE=1<<20 };       // a longer handshake message is taken as garbage
+
+    tls_parser():client_hello(false),server_hello(false),version(0),selected_version(0),
+                 cipher(0),sni(),alpn(),ciphers(),extensions(),groups(),point_formats(),
+                 certificates(),rec(),hs(),stopped(false){}
+
+    void feed(const uint8_t *buf,size_t len);
+    bool done() const { return stopped; } // nothing more can be learned
+
+    bool        client_hello;           // which hello was seen
+    bool        server_hello;
+    uint16_t    version;                // the hello's legacy_version, 0x0303 for TLS 1.2
+    uint16_t    selected_version;       // from supported_versions in a ServerHello, if any
+    uint16_t    cipher;                 // the server's choice
+    std::string sni;
+    std::vector<std::string> alpn;      // offered by the client or chosen by the server
+    std::vector<uint16_t> ciphers;      // offered by the client
+    std::vector<uint16_t> extensions;   // in the order sent
+    std::vector<uint16_t> groups;       // supported_groups (elliptic curves)
+    std::vector<uint8_t>  point_formats;
+    std::vector<std::string> certificates; // DER, the server's first
+
+    std::string ja3() const;            // JA3 of a ClientHello, JA3S of a ServerHello
+    static const char *version_name(uint16_t v); // "TLS 1.2"; 0 if unknown
+    static bool grease(uint16_t v) { return (v & 0x0f0f)==0x0a0a && (v>>8)==(v & 0xff); }
+
+private:
+    std::string rec;                    // a record read in part
+    std::string hs;                     // handshake messages read in part
+    bool        stopped;
+
+    void handshake(uint8_t type,const uint8_t *p,size_t len);
+    void parse_hello(bool client,const uint8_t *p,size_t len);
+    void parse_certificates(const uint8_t *p,size_t len);
+};
+
+class tls_framer {
+public:
+    tls_framer():next(0),hdr(),have(0),end(0),lost(false){}
+    /* Looks at a segment of the flow starting at offset, in any order.
+     * Returns where the handshake ended, once that is known, else 0.
+     */
+    uint64_t segment(uint64_t offset,const uint8_t *data,size_t len);
+    /* The flow turned out to start n bytes earlier, so what has been
+     * found so far is n bytes further on.
+     */
+    void shift(uint64_t n) { next += n; if(end) end += n; }
+private:
+    uint64_t next;                      // where the next record header starts
+    uint8_t  hdr[5];                    // as much of it as has been seen
+    size_t   have;
+    uint64_t end;
+    bool     lost;                      // not TLS after all
+};
+
+#endif
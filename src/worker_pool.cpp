@@ -0,0 +1,325 @@
+/**
+ * worker_pool.cpp:
+ *
+ * Forked workers for jobs that can't run in parallel in tcpflow
+ * itself; see worker_pool.h.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#include "tcpflow.h"
+#include "worker_pool.h"
+
+#if defined(HAVE_WAITPID) && defined(HAVE_POLL_H)
+# include <sys/socket.h>
+# include <sys/wait.h>
+# include <poll.h>
+# define HAVE_PROCESSES
+#endif
+
+worker_pool::worker_pool(const std::string &name_,const options &opt_,work_fn fn_,void *arg_):
+    results(),submitted(0),completed(0),failed(0),dropped(0),max_queue(0),latency_total_us(0),latency_max_us(0),
+    name(name_),opt(opt_),fn(fn_),arg(arg_),started(false),queue(),workers()
+{
+}
+
+worker_pool::~worker_pool()
+{
+    close();
+}
+
+uint64_t worker_pool::now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv,0);
+    return (uint64_t)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
+void worker_pool::done(uint64_t submit_us)
+{
+    uint64_t latency = now_us() - submit_us;
+    completed++;
+    latency_total_us += latency;
+    if(latency>latency_max_us) latency_max_us = latency;
+}
+
+bool worker_pool::submit(const std::string &line)
+{
+    submitted++;
+    if(!started) start();
+    queue.push_back(job(line,now_us()));
+#ifdef HAVE_PROCESSES
+    dispatch(false);
+    poll_workers(0);
+#else
+    dispatch(false);                    // runs full batches here
+#endif
+    if(queue.size()>opt.queue_max){     // nobody could take it and there's no room
+        queue.pop_back();
+        dropped++;
+        DEBUG(2)("%s: queue full; dropping a job",name.c_str());
+        return false;
+    }
+    if(queue.size()>max_queue) max_queue = queue.size();
+    return true;
+}
+
+void worker_pool::start()
+{
+    started = true;
+#ifdef HAVE_PROCESSES
+    for(uint32_t i=0;i<(opt.workers ? opt.workers : 1);i++){
+        int sv[2];
+        if(socketpair(AF_UNIX,SOCK_STREAM,0,sv)!=0){
+            DEBUG(1)("%s: socketpair: %s",name.c_str(),strerror(errno));
+            break;
+        }
+        pid_t pid = fork();
+        if(pid<0){
+            DEBUG(1)("%s: fork: %s",name.c_str(),strerror(errno));
+            ::close(sv[0]);
+            ::close(sv[1]);
+            break;
+        }
+        if(pid==0){
+            /* The worker keeps only its own socket, not the flow files and
+             * the other workers' sockets that tcpflow has open.
+             */
+            long max_fd = sysconf(_SC_OPEN_MAX);
+            if(max_fd<0 || max_fd>65536) max_fd = 65536;
+            for(int fd=3;fd<max_fd;fd++){
+                if(fd!=sv[1]) ::close(fd);
+            }
+            fcntl(sv[1],F_SETFD,fcntl(sv[1],F_GETFD) | FD_CLOEXEC); // not for what fn runs
+            run_worker(sv[1]);          // does not return
+        }
+        ::close(sv[1]);
+        fcntl(sv[0],F_SETFD,fcntl(sv[0],F_GETFD) | FD_CLOEXEC);
+        fcntl(sv[0],F_SETFL,fcntl(sv[0],F_GETFL) | O_NONBLOCK);
+        workers.push_back(worker());
+        workers.back().pid = pid;
+        workers.back().fd  = sv[0];
+    }
+    DEBUG(5)("%s: started %d workers",name.c_str(),(int)workers.size());
+#endif
+}
+
+/* A worker: reads the jobs it is sent, one per line, calls fn on up to
+ * a batch of them at a time and writes back each result as a 32-bit
+ * length and the bytes. Exits when its socket is closed.
+ */
+void worker_pool::run_worker(int fd)
+{
+#ifdef HAVE_PROCESSES
+    /* A ^C is for tcpflow, which finishes the queue and then closes our socket */
+    portable_signal(SIGINT,SIG_IGN);
+    portable_signal(SIGHUP,SIG_IGN);
+    portable_signal(SIGTERM,SIG_DFL);
+    std::string buf;
+    std::vector<std::string> jobs;
+    std::vector<std::string> res;
+    char tmp[65536];
+    for(;;){
+        while(buf.find('\n')==std::string::npos){
+            ssize_t r = read(fd,tmp,sizeof(tmp));
+            if(r<0 && errno==EINTR) continue;
+            if(r<=0) _exit(0);
+            buf.append(tmp,r);
+        }
+        jobs.clear();
+        size_t start = 0,nl;
+        while(jobs.size()<opt.batch && (nl = buf.find('\n',start))!=std::string::npos){
+            jobs.push_back(buf.substr(start,nl-start));
+            start = nl+1;
+        }
+        buf.erase(0,start);
+
+        res.clear();
+        res.resize(jobs.size());
+        (*fn)(jobs,res,arg);
+        res.resize(jobs.size());
+
+        std::string out;
+        for(std::vector<std::string>::const_iterator it=res.begin();it!=res.end();it++){
+            uint32_t len = it->size();
+            out.append(reinterpret_cast<const char *>(&len),sizeof(len));
+            out.append(*it);
+        }
+        for(size_t done=0;done<out.size();){
+            ssize_t w = write(fd,out.data()+done,out.size()-done);
+            if(w<0 && errno==EINTR) continue;
+            if(w<=0) _exit(1);
+            done += w;
+        }
+    }
+#else
+    (void)fd;
+#endif
+}
+
+/* Hand queued jobs to the workers with the fewest outstanding, a batch at
+ * a time, keeping at most in_flight batches with any one worker. Unless
+ * flushing, a partial batch waits for more jobs.
+ */
+void worker_pool::dispatch(bool flush)
+{
+    size_t batch = opt.batch ? opt.batch : 1;
+#ifdef HAVE_PROCESSES
+    size_t in_flight = opt.in_flight ? opt.in_flight : 1;
+    while(queue.size()>=batch || (flush && queue.size())){
+        worker *w = 0;
+        for(std::vector<worker>::iterator it=workers.begin();it!=workers.end();it++){
+            if(it->fd>=0 && (w==0 || it->sent_us.size()<w->sent_us.size())) w = &*it;
+        }
+        if(w==0 || w->sent_us.size()>=in_flight*batch) return;
+        for(size_t i=0;i<batch && queue.size();i++){
+            w->out.append(queue.front().line);
+            w->out.push_back('\n');
+            w->sent_us.push_back(queue.front().submit_us);
+            queue.pop_front();
+        }
+    }
+#else
+    /* No processes to hand them to; run them here */
+    while(queue.size()>=batch || (flush && queue.size())){
+        std::vector<std::string> jobs;
+        std::vector<uint64_t> submit_us;
+        std::vector<std::string> res;
+        for(size_t i=0;i<batch && queue.size();i++){
+            jobs.push_back(queue.front().line);
+            submit_us.push_back(queue.front().submit_us);
+            queue.pop_front();
+        }
+        res.resize(jobs.size());
+        (*fn)(jobs,res,arg);
+        res.resize(jobs.size());
+        results.insert(results.end(),res.begin(),res.end());
+        for(size_t i=0;i<submit_us.size();i++) done(submit_us[i]);
+    }
+#endif
+}
+
+void worker_pool::lost(worker &w)
+{
+#ifdef HAVE_PROCESSES
+    DEBUG(1)("%s: worker %d exited",name.c_str(),(int)w.pid);
+    failed += w.sent_us.size();
+    w.sent_us.clear();
+    w.out.clear();
+    w.in.clear();
+    if(w.fd>=0) ::close(w.fd);
+    w.fd = -1;
+    if(w.pid>0) waitpid(w.pid,0,0);
+    w.pid = -1;
+#else
+    (void)w;
+#endif
+}
+
+void worker_pool::poll_workers(int timeout_ms)
+{
+#ifdef HAVE_PROCESSES
+    std::vector<struct pollfd> fds;
+    std::vector<worker *> ws;
+    for(std::vector<worker>::iterator it=workers.begin();it!=workers.end();it++){
+        if(it->fd<0 || (it->sent_us.empty() && it->out.empty())) continue;
+        struct pollfd p;
+        p.fd = it->fd;
+        p.events = POLLIN | (it->out.size() ? POLLOUT : 0);
+        p.revents = 0;
+        fds.push_back(p);
+        ws.push_back(&*it);
+    }
+    if(fds.empty()) return;
+    if(poll(&fds[0],fds.size(),timeout_ms)<=0) return;
+
+    void (*old)(int) = portable_signal(SIGPIPE,SIG_IGN); // a worker may have died
+    char tmp[65536];
+    for(size_t i=0;i<fds.size();i++){
+        worker &w = *ws[i];
+        if((fds[i].revents & POLLOUT) && w.out.size()){
+            ssize_t n = write(w.fd,w.out.data(),w.out.size());
+            if(n>0) w.out.erase(0,n);
+            else if(n<0 && errno!=EINTR && errno!=EAGAIN && errno!=EWOULDBLOCK){
+                lost(w);
+                continue;
+            }
+        }
+        if(fds[i].revents & (POLLIN|POLLHUP|POLLERR)){
+            for(;;){
+                ssize_t n = read(w.fd,tmp,sizeof(tmp));
+                if(n<0 && errno==EINTR) continue;
+                if(n<0) break;          // EAGAIN: nothing more yet
+                if(n==0){
+                    lost(w);
+                    break;
+                }
+                w.in.append(tmp,n);
+            }
+            /* Take the complete results */
+            size_t pos = 0;
+            uint32_t len;
+            while(w.in.size()-pos>=sizeof(len)){
+                memcpy(&len,w.in.data()+pos,sizeof(len));
+                if(w.in.size()-pos-sizeof(len)<len) break;
+                results.push_back(w.in.substr(pos+sizeof(len),len));
+                pos += sizeof(len)+len;
+                if(w.sent_us.size()){   // a worker runs its jobs in the order sent
+                    done(w.sent_us.front());
+                    w.sent_us.pop_front();
+                }
+            }
+            w.in.erase(0,pos);
+        }
+    }
+    portable_signal(SIGPIPE,old);
+#else
+    (void)timeout_ms;
+#endif
+}
+
+void worker_pool::close()
+{
+    if(!started) return;
+    started = false;
+#ifdef HAVE_PROCESSES
+    for(;;){
+        dispatch(true);
+        bool busy = false;
+        bool alive = false;
+        for(std::vector<worker>::const_iterator it=workers.begin();it!=workers.end();it++){
+            if(it->sent_us.size()) busy = true;
+            if(it->fd>=0) alive = true;
+        }
+        if(!alive){                     // nobody left to run what is queued
+            dropped += queue.size();
+            queue.clear();
+        }
+        if(queue.empty() && !busy) break;
+        poll_workers(1000);
+    }
+    for(std::vector<worker>::iterator it=workers.begin();it!=workers.end();it++){
+        if(it->fd>=0) ::close(it->fd);
+        if(it->pid>0) waitpid(it->pid,0,0);
+    }
+    workers.clear();
+#else
+    dispatch(true);
+#endif
+}
+
+void worker_pool::write_xml(std::ostream &os) const
+{
+    os << "<" << name << ">"
+       << "<submitted>" << submitted << "</submitted>"
+       << "<completed>" << completed << "</completed>"
+       << "<failed>" << failed << "</failed>"
+       << "<dropped>" << dropped << "</dropped>"
+       << "<max_queue>" << max_queue << "</max_queue>";
+    if(completed){
+        os << "<mean_latency_us>" << latency_total_us/completed << "</mean_latency_us>"
+           << "<max_latency_us>" << latency_max_us << "</max_latency_us>";
+    }
+    os << "</" << name << ">\n";
+}
@@ -0,0 +1,107 @@
+/*
+ * worker_pool.h:
+ *
+ * Runs a function over jobs in forked worker processes, so that work
+ * which would hold a lock or a single thread (scan_python and the GIL)
+ * runs in parallel and off the packet path.
+ *
+ * A job is one line of text. Submitting one never blocks: jobs wait in
+ * a bounded queue and are handed to the workers with the fewest jobs
+ * outstanding, a batch at a time, up to in_flight batches per worker
+ * (with in_flight=1, only to idle ones). Each worker takes up to a
+ * batch of the jobs it has been sent, calls the function once for all
+ * of them, and sends back one result per job. The results are collected
+ * in order of completion; a job whose worker died gets no result and
+ * counts as failed. When the queue is full, further jobs are dropped and
+ * counted. The latency of each job, from submission to its result, goes
+ * in the DFXML with the counts.
+ *
+ * scan_python runs its function in the workers; http_executor runs
+ * the -S http_cmd command, a body per job.
+ *
+ * The workers are forked when the first job is submitted, so the
+ * function must set up whatever it needs (an interpreter) in the worker
+ * itself, the first time it is called.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class worker_pool {
+    /* These are not implemented */
+    worker_pool(const worker_pool &);
+    worker_pool &operator=(const worker_pool &);
+public:
+    /* Called in a worker with a batch of jobs; results[i] is for jobs[i] */
+    typedef void (*work_fn)(const std::vector<std::string> &jobs,std::vector<std::string> &results,void *arg);
+
+    class options {
+    public:
+        enum { WORKERS=4, BATCH=1, QUEUE=1000, IN_FLIGHT=2 };
+        options():workers(WORKERS),batch(BATCH),queue_max(QUEUE),in_flight(IN_FLIGHT){}
+        unsigned int workers;
+        unsigned int batch;             // jobs per call of the function
+        size_t   queue_max;             // jobs waiting; more than this are dropped
+        unsigned int in_flight;         // batches sent to a worker ahead of its results
+    };
+
+    worker_pool(const std::string &name,const options &opt,work_fn fn,void *arg);
+    virtual ~worker_pool();             // close()s
+
+    bool submit(const std::string &job); // false if the job was dropped
+    void close();                       // wait for every job's result; the workers exit
+    void write_xml(std::ostream &os) const;
+
+    std::deque<std::string> results;    // for the caller to take
+
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t failed;                    // the worker running it died
+    uint64_t dropped;                   // because the queue was full
+    size_t   max_queue;                 // the most jobs that ever waited
+    uint64_t latency_total_us;          // over the completed
+    uint64_t latency_max_us;
+
+private:
+    struct job {
+        job(const std::string &line_,uint64_t t):line(line_),submit_us(t){}
+        std::string line;
+        uint64_t    submit_us;
+    };
+    struct worker {
+        worker():pid(-1),fd(-1),sent_us(),out(),in(){}
+        pid_t    pid;
+        int      fd;                    // socket: jobs out, results in
+        std::deque<uint64_t> sent_us;   // when each job whose result hasn't come back was submitted
+        std::string out;                // jobs not yet written to fd
+        std::string in;                 // a result read in part
+    };
+
+    const std::string name;             // for messages and the DFXML
+    const options opt;
+    const work_fn fn;
+    void *const arg;
+    bool     started;
+    std::deque<job> queue;
+    std::vector<worker> workers;
+
+    static uint64_t now_us();
+    void done(uint64_t submit_us);      // a job's result is in
+    void start();
+    void dispatch(bool flush);          // give queued jobs to the workers
+    void poll_workers(int timeout_ms);  // write what is pending, read what has arrived
+    void lost(worker &w);               // its process is gone
+    void run_worker(int fd);            // in the worker; does not return
+};
+
+#endif
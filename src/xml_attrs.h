@@ -0,0 +1,110 @@
+/*
+ * xml_attrs.h:
+ *
+ * Builds the attribute string of a DFXML element, such as the
+ * <tcpflow> element that tcpip::dump_xml() writes for every flow,
+ * without a std::stringstream. The buffer is reused from element to
+ * element, numbers are formatted by hand, and the date and time part of
+ * ISO 8601 timestamps is remembered from the previous one, since the
+ * flows written together mostly end within the same second.
+ *
+ * Each attribute is written as name='value' followed by a space.
+ * Values are not escaped; only use it for numbers, addresses and names
+ * that cannot contain XML metacharacters.
+ *
+ * This source code is under the GNU Public License (GPL).  See
+ * COPYING for details.
+ */
+
+#ifndef XML_ATTRS_H
+#define XML_ATTRS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+class xml_attrs {
+public:
+    xml_attrs():buf(),time_sec(-1),time_len(0){
+        time_str[0] = 0;
+    }
+
+    void clear() { buf.clear(); }
+    const std::string &str() const { return buf; }
+
+    void add(const char *name,const char *value) {
+        start(name);
+        buf += value;
+        end();
+    }
+    void add(const char *name,const std::string &value) {
+        start(name);
+        buf += value;
+        end();
+    }
+    void add(const char *name,uint64_t value) {
+        start(name);
+        put_dec(value,0);
+        end();
+    }
+    void add_signed(const char *name,int64_t value) {
+        start(name);
+        if(value<0){
+            buf += '-';
+            put_dec((uint64_t)0-(uint64_t)value,0);
+        } else {
+            put_dec((uint64_t)value,0);
+        }
+        end();
+    }
+    /* ISO 8601 in UTC, with 6 or 9 fraction digits if there is a fraction,
+     * as dfxml_writer::to8601() does for microseconds.
+     */
+    void add_time(const char *name,const struct timespec &ts,bool nsec) {
+        start(name);
+        if(ts.tv_sec!=time_sec){
+            struct tm tm;
+            time_t t = ts.tv_sec;
+            gmtime_r(&t,&tm);
+            time_len = strftime(time_str,sizeof(time_str),"%Y-%m-%dT%H:%M:%S",&tm);
+            time_sec = ts.tv_sec;
+        }
+        buf.append(time_str,time_len);
+        long frac = nsec ? ts.tv_nsec : ts.tv_nsec/1000;
+        if(frac>0){
+            buf += '.';
+            put_dec((uint64_t)frac,nsec ? 9 : 6);
+        }
+        buf += 'Z';
+        end();
+    }
+
+private:
+    std::string buf;
+    time_t      time_sec;               // date and time of the last timestamp
+    char        time_str[32];
+    size_t      time_len;
+
+    void start(const char *name) {
+        buf += name;
+        buf += "='";
+    }
+    void end() {
+        buf += "' ";
+    }
+    /* v as a decimal number, zero-padded to width */
+    void put_dec(uint64_t v,int width) {
+        char digits[24];
+        char *p = digits+sizeof(digits);
+        do {
+            *--p = (char)('0' + v%10);
+            v /= 10;
+            width--;
+        } while(v);
+        while(width-- > 0) *--p = '0';
+        buf.append(p,digits+sizeof(digits)-p);
+    }
+};
+
+#endif
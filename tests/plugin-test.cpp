@@ -0,0 +1,35 @@
+/**
+ * plugin-test.cpp:
+ *
+ * A scanner loaded with -P for test-plugin.sh: it records the size of
+ * each flow it is given, with a tag it gets from -S through tcpflow's own
+ * scanner_info::get_config, so the link must export tcpflow's symbols.
+ * Built with -DWRONG_ABI, it declares itself for another scanner_params
+ * version, and must be refused.
+ */
+
+#include "tcpflow.h"
+#include "scanner_plugin.h"
+
+static std::string plugin_test_tag = "plugin";
+
+extern "C"
+void scan_plugin_test(const class scanner_params &sp,const recursion_control_block &rcb)
+{
+    if(sp.phase==scanner_params::PHASE_STARTUP){
+        sp.info->name  = "plugin_test";
+        sp.info->get_config("plugin_test_tag",&plugin_test_tag,"Tag for each flow's size");
+        return;
+    }
+    if(sp.phase==scanner_params::PHASE_SCAN){
+        if(sp.sxml) (*sp.sxml) << "<plugin_test tag='" << plugin_test_tag << "' bytes='" << sp.sbuf.bufsize << "'/>";
+    }
+}
+
+#ifndef WRONG_ABI
+TCPFLOW_SCANNER_PLUGIN(scan_plugin_test)
+#else
+extern "C" const tcpflow_plugin tcpflow_plugin_info = {
+    TCPFLOW_PLUGIN_ABI, scanner_params::CURRENT_SP_VERSION+1,
+    scanner_info::CURRENT_SI_VERSION, sizeof(scanner_params), scan_plugin_test };
+#endif
@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# test -S checksum=ignore|count|drop on a capture with one corrupted segment
+#
+
+. $srcdir/test-subs.sh
+
+C2S=out/010.001.000.001.40000-010.002.000.002.00080
+S2C=out/010.002.000.002.00080-010.001.000.001.40000
+DMPFILE=$DMPDIR/bad-checksum.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+for mode in ignore count drop
+do
+  echo 
+  echo ========
+  echo check checksum=$mode
+  echo ========
+  /bin/rm -rf out
+
+  cmd "$TCPFLOW -o out -S checksum=$mode -X out/report.xml -r $DMPFILE"
+
+  checkmd5 $S2C "8700f1782833753f99e8e9c172ee50f3" "67"
+  case $mode in
+  ignore)
+  checkmd5 $C2S "593c0653af398452da0834efcd6da5a9" "47"
+  if grep bad_checksums out/report.xml >/dev/null ; then echo checksums were checked ; exit 1 ; fi
+;;
+  count)
+  checkmd5 $C2S "593c0653af398452da0834efcd6da5a9" "47"
+  if ! grep "bad_checksums='1'" out/report.xml >/dev/null ; then echo bad checksum not counted ; exit 1 ; fi
+;;
+  drop)
+  if [ -r $C2S ] ; then echo $C2S should not have been created ; exit 1 ; fi
+  if ! grep "bad_checksums='1'" out/report.xml >/dev/null ; then echo bad checksum not counted ; exit 1 ; fi
+;;
+  esac
+  echo checksum=$mode completed successfully
+done
+
+/bin/rm -rf out
+exit 0
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# test that the compiled filter (-S compiled_filter=1) selects the same
+# flows as libpcap's filter, and that it does not fold "src and dst"
+# clauses joined by "or"
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/test1.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+for compiled in 0 1
+do
+  for expr in "host 74.125.19.101" "tcp and (port 50956 or 9999) and not net 74.125.19.104/32"
+  do
+    echo 
+    echo ========
+    echo check compiled_filter=$compiled "$expr"
+    echo ========
+    /bin/rm -rf out
+    echo $TCPFLOW -o out -S compiled_filter=$compiled -r $DMPFILE "$expr"
+    if ! $TCPFLOW -o out -S compiled_filter=$compiled -r $DMPFILE "$expr" ; then echo failed; exit 1; fi
+
+    checkmd5 out/"074.125.019.101.00080-192.168.001.102.50956" "ae30a88136feb0655492bdb75e078643" "136"
+    checkmd5 out/"192.168.001.102.50956-074.125.019.101.00080" "78b8073093d107207327103e80fbdf43" "604"
+    if [ -r out/074.125.019.104.00080-192.168.001.102.50955 ] ; then
+      echo flow 50955 should have been filtered out
+      exit 1
+    fi
+  done
+done
+
+# Both ends must be the same host, so this matches none of the flows;
+# the two "src and dst" clauses must not be folded into one set
+for compiled in 0 1
+do
+  expr="src and dst host 192.168.1.102 or src and dst host 74.125.19.101"
+  echo check compiled_filter=$compiled "$expr"
+  /bin/rm -rf out
+  if ! $TCPFLOW -o out -S compiled_filter=$compiled -r $DMPFILE "$expr" ; then echo failed; exit 1; fi
+  if ls out | grep -v report.xml | grep . ; then
+    echo no flow should have been selected
+    exit 1
+  fi
+done
+
+/bin/rm -rf out
+exit 0
@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# test that flows get the next connection count when the output
+# directory already holds flows with the same 4-tuple
+#
+
+. $srcdir/test-subs.sh
+
+C2S=out/010.001.000.001.40000-010.002.000.002.00080
+S2C=out/010.002.000.002.00080-010.001.000.001.40000
+DMPFILE=$DMPDIR/nsec-be.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+/bin/rm -rf out
+cmd "$TCPFLOW -o out -r $DMPFILE"
+cmd "$TCPFLOW -o out -r $DMPFILE"
+cmd "$TCPFLOW -o out -r $DMPFILE"
+
+for c in "" c1 c2
+do
+  checkmd5 $C2S$c "e3956598633826eca0bf5c6374206439" "43"
+  checkmd5 $S2C$c "83d792c87f7c22b7d0f4ee9a91106725" "63"
+done
+if [ -r ${C2S}c3 ] ; then echo ${C2S}c3 should not have been created ; exit 1 ; fi
+
+/bin/rm -rf out
+exit 0
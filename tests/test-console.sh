@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# test that the buffered -c, -C and -D output is what tcpflow printed a
+# packet at a time, however it is collected
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/test1.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+for buffer in 1048576 0 100 ; do
+    /bin/rm -f console.out
+    echo $TCPFLOW -c -S console_buffer=$buffer -r $DMPFILE \> console.out
+    if ! $TCPFLOW -c -S console_buffer=$buffer -r $DMPFILE > console.out ; then echo failed ; exit 1 ; fi
+    checkmd5 console.out "35dceb6ca21661e12e502fcbfde40575" "4509"
+
+    /bin/rm -f console.out
+    echo $TCPFLOW -C -S console_buffer=$buffer -r $DMPFILE \> console.out
+    if ! $TCPFLOW -C -S console_buffer=$buffer -r $DMPFILE > console.out ; then echo failed ; exit 1 ; fi
+    checkmd5 console.out "8afebdcc8d61d915dc4d79db595d31ea" "4194"
+
+    /bin/rm -f console.out
+    echo $TCPFLOW -c -D -S console_buffer=$buffer -r $DMPFILE \> console.out
+    if ! $TCPFLOW -c -D -S console_buffer=$buffer -r $DMPFILE > console.out ; then echo failed ; exit 1 ; fi
+    checkmd5 console.out "c1cd90dca723595ab1cdfd291930ebcf" "16283"
+done
+
+/bin/rm -f console.out
+exit 0
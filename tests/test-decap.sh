@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# test that flows carried in VLAN stacks and tunnels are decapsulated
+# and that the outer tunnel id is recorded in the filename and the DFXML
+#
+
+. $srcdir/test-subs.sh
+
+C2S=010.001.000.001.40000-010.002.000.002.00080
+S2C=010.002.000.002.00080-010.001.000.001.40000
+
+for t in qinq mpls gre vxlan geneve erspan2 erspan3
+do
+  echo 
+  echo ========
+  echo check $t
+  echo ========
+  DMPFILE=$DMPDIR/decap-$t.pcap
+  echo checking $DMPFILE
+  if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+  /bin/rm -rf out
+
+  cmd "$TCPFLOW -o out -T %A.%a-%B.%b%U%u -X out/report.xml -r $DMPFILE"
+
+  case $t in
+  qinq)
+  checkmd5 out/$C2S "7526da43fc42848ecef2208c013d5d10" "43"
+  checkmd5 out/$S2C "8df67084f584005da829192a5d78e000" "63"
+  TUNNEL=""
+;;
+  mpls)
+  checkmd5 out/$C2S--1001 "b5fb0e3e123ae32e4f68f0e076cb5f62" "43"
+  checkmd5 out/$S2C--1001 "699cf3d44a9988134fa376ad432ea0a1" "63"
+  TUNNEL="tunnel='mpls' tunnel_id='1001'"
+;;
+  gre)
+  checkmd5 out/$C2S--4242 "a4e47e52140d45d977db2be8cc4a8ba1" "42"
+  checkmd5 out/$S2C--4242 "3f58d6ecccaa1ea596c001926f55f705" "62"
+  TUNNEL="tunnel='gre' tunnel_id='4242'"
+;;
+  vxlan)
+  checkmd5 out/$C2S--5001 "91b9c3bb6f6301cdaf3a0d6ffda2090a" "44"
+  checkmd5 out/$S2C--5001 "a3ab62e5ff277eda1e157674ad131439" "64"
+  TUNNEL="tunnel='vxlan' tunnel_id='5001'"
+;;
+  geneve)
+  checkmd5 out/$C2S--7001 "55b57f246abf64f252ef411414a4cf8a" "45"
+  checkmd5 out/$S2C--7001 "d036ab87b32d22247371c36f13ac2cbd" "65"
+  TUNNEL="tunnel='geneve' tunnel_id='7001'"
+;;
+  erspan2)
+  checkmd5 out/$C2S--100 "8f18aa5b7b32a969882ba5413ba206cc" "46"
+  checkmd5 out/$S2C--100 "c47214f10f14a4ceea4651536cd917c3" "66"
+  TUNNEL="tunnel='erspan' tunnel_id='100'"
+;;
+  erspan3)
+  checkmd5 out/$C2S--200 "bfe7e0868a1dd2ad9b4c9659c9981065" "46"
+  checkmd5 out/$S2C--200 "2848ed5fbcd1f6d1733ea29b8e91e7a6" "66"
+  TUNNEL="tunnel='erspan' tunnel_id='200'"
+;;
+  esac
+
+  if [ x"$TUNNEL" != x ] && ! grep "$TUNNEL" out/report.xml >/dev/null ;
+  then
+    echo "$TUNNEL" not recorded in out/report.xml
+    exit 1
+  fi
+  echo Packet file $t completed successfully
+done
+
+/bin/rm -rf out
+exit 0
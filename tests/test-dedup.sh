@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# test that -S dedup=1 replaces flows with the same content as an
+# earlier one by hard links, reports it in the DFXML, and that a later
+# run without dedup doesn't write into the linked files
+#
+
+. $srcdir/test-subs.sh
+
+C2S=out/010.001.000.001.40000-010.002.000.002.00080
+S2C=out/010.002.000.002.00080-010.001.000.001.40000
+DMPFILE=$DMPDIR/nsec-be.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+/bin/rm -rf out
+cmd "$TCPFLOW -S dedup=1 -o out -r $DMPFILE"
+if ! grep -q "<duplicate_files>0</duplicate_files>" out/report.xml ; then echo first run should have no duplicates ; exit 1 ; fi
+cmd "$TCPFLOW -S dedup=1 -o out -r $DMPFILE"
+if ! grep -q "<duplicate_files>2</duplicate_files>" out/report.xml ; then echo second run should have 2 duplicates ; exit 1 ; fi
+
+checkmd5 ${C2S}c1 "e3956598633826eca0bf5c6374206439" "43"
+checkmd5 ${S2C}c1 "83d792c87f7c22b7d0f4ee9a91106725" "63"
+if ! [ $C2S -ef ${C2S}c1 ] ; then echo ${C2S}c1 is not a link to $C2S ; exit 1 ; fi
+if ! [ $S2C -ef ${S2C}c1 ] ; then echo ${S2C}c1 is not a link to $S2C ; exit 1 ; fi
+
+# a run without dedup leaves the linked copies alone
+cmd "$TCPFLOW -o out -r $DMPFILE"
+checkmd5 ${C2S}c2 "e3956598633826eca0bf5c6374206439" "43"
+if [ $C2S -ef ${C2S}c2 ] ; then echo ${C2S}c2 should not be linked ; exit 1 ; fi
+for f in $C2S ${C2S}c1 ; do checkmd5 $f "e3956598633826eca0bf5c6374206439" "43" ; done
+for f in $S2C ${S2C}c1 ; do checkmd5 $f "83d792c87f7c22b7d0f4ee9a91106725" "63" ; done
+
+# and so does rewriting HTTP bodies that were linked
+C2S=out/010.001.000.001.40001-010.002.000.002.00080
+S2C=out/010.002.000.002.00080-010.001.000.001.40001
+DMPFILE=$DMPDIR/http-pairs.pcap
+/bin/rm -rf out
+cmd "$TCPFLOW -S dedup=1 -e http -o out -r $DMPFILE"
+cmd "$TCPFLOW -S dedup=1 -e http -o out -r $DMPFILE"
+if ! [ ${S2C}-HTTPBODY-004.html -ef ${S2C}c1-HTTPBODY-004.html ] ; then
+    echo the second run's body should be a link to the first ; exit 1
+fi
+cmd "$TCPFLOW -e http -o out -r $DMPFILE"
+for f in ${S2C} ${S2C}c1 ${S2C}c2 ; do
+    checkmd5 $f-HTTPBODY-004.html "5d41402abc4b2a76b9719d911017c592" "5"
+done
+for f in out/dedup/*/* ; do
+    if ! [ -s $f ] ; then echo dedup object $f was truncated ; exit 1 ; fi
+done
+
+/bin/rm -rf out
+exit 0
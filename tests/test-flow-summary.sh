@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# test that -S flow_summary writes an Arrow file with a row per flow,
+# and that it works with the DFXML report turned off
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/nsec-be.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+if ! python3 -c "import pyarrow" 2>/dev/null ; then echo pyarrow not installed ; exit 77 ; fi
+
+/bin/rm -rf out
+cmd "$TCPFLOW -S enable_report=NO -S flow_summary=flows.arrow -S flow_summary_batch=1 -o out -r $DMPFILE"
+if [ -r out/report.xml ] ; then echo out/report.xml should not have been created ; exit 1 ; fi
+
+python3 - <<'PYTHON' || exit 1
+import pyarrow as pa, pyarrow.ipc as ipc
+t = ipc.open_file('out/flows.arrow').read_all()
+t.validate(full=True)
+assert t.num_rows == 2, t.num_rows
+src  = t.column('src_ipn').to_pylist()
+port = t.column('srcport').to_pylist()
+start = t.column('startime').cast(pa.int64()).to_pylist()
+i = port.index(40000)
+assert src[i] == '10.1.0.1', src
+assert t.column('dst_ipn')[i].as_py() == '10.2.0.2'
+assert t.column('dstport')[i].as_py() == 80
+assert start[i] == 1500000000123456789, start
+assert t.column('filename')[i].as_py() == 'out/010.001.000.001.40000-010.002.000.002.00080'
+PYTHON
+
+/bin/rm -rf out
+exit 0
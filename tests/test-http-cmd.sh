@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+# test that -S http_cmd runs the command on every HTTP body, both by the
+# worker pool and as one command reading paths on its standard input,
+# and records the counts in the DFXML
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/http-pairs.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+HOOK=`pwd`/http-hook.sh
+LOG=`pwd`/http-hook.log
+printf '#!/bin/sh\nif [ $# -gt 0 ] ; then echo "$1" >> %s ; else cat >> %s ; fi\n' $LOG $LOG > $HOOK
+chmod +x $HOOK
+
+for mode in 0 1 ; do
+  /bin/rm -rf out $LOG
+  cmd "$TCPFLOW -e http -S http_cmd=$HOOK -S http_cmd_workers=2 -S http_cmd_stdin=$mode -o out -r $DMPFILE"
+  # the request body and two response bodies
+  if [ `grep -c HTTPBODY $LOG` != 3 ] ; then echo mode $mode: http_cmd should have been given 3 bodies ; cat $LOG ; exit 1 ; fi
+  if ! grep -q "<completed>3</completed><failed>0</failed><dropped>0</dropped>" out/report.xml ; then
+    echo mode $mode: the report should count 3 completed ; exit 1
+  fi
+done
+
+/bin/rm -rf out $LOG $HOOK
+exit 0
@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# test that -e http decodes gzip, br and zstd response bodies, each sent
+# in several segments, to the same text; br and zstd are only checked if
+# their libraries were compiled in, since otherwise the body is written
+# as it came, as .br or .zst. With -Z nothing is decoded.
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/http-encodings.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+S2C=out/010.002.000.002.00080-010.001.000.001.40002
+
+/bin/rm -rf out
+cmd "$TCPFLOW -e http -o out -r $DMPFILE"
+checkmd5 ${S2C}-HTTPBODY-001.txt "e86ec43e2f0bc360239ed8054da55b29" "21890"
+n=2
+for ext in br zst ; do
+  if [ -r ${S2C}-HTTPBODY-00$n.txt.$ext ] ; then
+    echo $ext is not compiled in
+  else
+    checkmd5 ${S2C}-HTTPBODY-00$n.txt "e86ec43e2f0bc360239ed8054da55b29" "21890"
+  fi
+  n=`expr $n + 1`
+done
+
+/bin/rm -rf out
+cmd "$TCPFLOW -e http -Z -o out -r $DMPFILE"
+checkmd5 ${S2C}-HTTPBODY-001.txt "8942430cd1795898dcdb56268fdd05bd" "9330"
+
+/bin/rm -rf out
+exit 0
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# test that -e http extracts request bodies as well as responses, pairs
+# each response with its request across the two flows, and uses the
+# pairing to parse the response to a pipelined HEAD. In http-pairs-fin.pcap
+# the client closes its side before any response arrives, so the pairs
+# are only all there if its flow waits for the server's to be written.
+# Last, that -S http_xml_headers=1 records the headers of every response.
+#
+
+. $srcdir/test-subs.sh
+
+C2S=out/010.001.000.001.40001-010.002.000.002.00080
+S2C=out/010.002.000.002.00080-010.001.000.001.40001
+for pcap in http-pairs.pcap http-pairs-fin.pcap ; do
+    DMPFILE=$DMPDIR/$pcap
+    if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+    /bin/rm -rf out
+    cmd "$TCPFLOW -e http -o out -r $DMPFILE"
+
+    # The POSTed body; then the responses: 100 Continue and 201 are messages 1
+    # and 2, the HEAD response is 3 and has no body, and the GET response is 4
+    checkmd5 ${C2S}-HTTPBODY-001.json "98b1bd7f951572bf4b1a8c93d7609c93" "13"
+    checkmd5 ${S2C}-HTTPBODY-002.txt  "444bcb3a3fcf8389296c49467f27e1d6" "2"
+    checkmd5 ${S2C}-HTTPBODY-004.html "5d41402abc4b2a76b9719d911017c592" "5"
+    if ls ${S2C}-HTTPBODY-003* >/dev/null 2>&1 ; then echo the HEAD response should have no body ; exit 1 ; fi
+
+    if [ `grep -c "<http_method>POST</http_method><http_url>/upload</http_url><http_status>201</http_status>" out/report.xml` != 2 ] ; then
+        echo the request and response bodies of the POST should both be paired ; exit 1
+    fi
+    if ! grep -q "<http_method>GET</http_method><http_url>/index.html</http_url><http_status>200</http_status>" out/report.xml ; then
+        echo the GET response should be paired with its request ; exit 1
+    fi
+done
+
+# -S http_xml_headers=1 records the headers of a response without a body too
+DMPFILE=$DMPDIR/http-pairs.pcap
+/bin/rm -rf out
+cmd "$TCPFLOW -e http -S http_xml_headers=1 -o out -r $DMPFILE"
+if ! grep -q "<fileobject><http_method>HEAD</http_method><http_url>/index.html</http_url><http_status>200</http_status><http_header name='content-type'>text/html</http_header><http_header name='content-length'>5</http_header></fileobject>" out/report.xml ; then
+    echo the headers of the HEAD response should be recorded ; exit 1
+fi
+if ! grep -q "<http_status>200</http_status><http_header name='content-type'>text/html</http_header><http_header name='content-length'>5</http_header><filesize>5</filesize>" out/report.xml ; then
+    echo the headers of the GET response should be recorded ; exit 1
+fi
+
+/bin/rm -rf out
+exit 0
@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# test that big-endian and nanosecond pcap files and pcapng files are read,
+# that nanosecond timestamps reach the DFXML and the packet index,
+# that -w writes unprocessed packets in the format of the input,
+# and that microsecond files are not reported with nanoseconds
+#
+
+. $srcdir/test-subs.sh
+
+C2S=010.001.000.001.40000-010.002.000.002.00080
+S2C=010.002.000.002.00080-010.001.000.001.40000
+
+for f in nsec-be.pcap nsec.pcapng
+do
+  echo 
+  echo ========
+  echo check $f
+  echo ========
+  DMPFILE=$DMPDIR/$f
+  echo checking $DMPFILE
+  if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+  /bin/rm -rf out
+
+  cmd "$TCPFLOW -o out -I -X out/report.xml -w out/unk -r $DMPFILE"
+
+  checkmd5 out/$C2S "e3956598633826eca0bf5c6374206439" "43"
+  checkmd5 out/$S2C "83d792c87f7c22b7d0f4ee9a91106725" "63"
+
+  for expect in "startime='2017-07-14T02:40:00.123456789Z'" \
+                "startime='2017-07-14T02:40:00.123457789Z'"
+  do
+    if ! grep "$expect" out/report.xml >/dev/null ; then
+      echo "$expect" not found in out/report.xml
+      exit 1
+    fi
+  done
+  if ! grep '^0|1500000000.123460789|43$' out/$C2S.findx >/dev/null ; then
+    echo nanosecond timestamp not found in out/$C2S.findx
+    cat out/$C2S.findx
+    exit 1
+  fi
+
+  # the ARP packet is written with the header of the input
+  case $f in
+  *.pcapng) MAGIC="0a0d0d0a" ;;
+  *)        MAGIC="a1b23c4d" ;;
+  esac
+  if ! od -An -tx4 -N4 out/unk | grep $MAGIC >/dev/null ; then
+    echo out/unk does not start with $MAGIC
+    od -An -tx4 -N4 out/unk
+    exit 1
+  fi
+  echo Packet file $f completed successfully
+done
+
+# a microsecond file keeps microseconds, though libpcap could give it nanoseconds
+echo
+echo ========
+echo check test1.pcap
+echo ========
+/bin/rm -rf out
+cmd "$TCPFLOW -o out -I -X out/report.xml -r $DMPDIR/test1.pcap"
+if ! grep -E "startime='[0-9T:-]+\.[0-9]{6}Z'" out/report.xml >/dev/null ; then
+  echo microsecond startime not found in out/report.xml
+  exit 1
+fi
+if grep -E "(startime|endtime)='[0-9T:-]+\.[0-9]{7,}Z'" out/report.xml ; then
+  echo test1.pcap has no nanoseconds to report
+  exit 1
+fi
+if cat out/*.findx | grep -v -E '^[0-9]+\|[0-9]+\.[0-9]{6}\|[0-9]+$' ; then
+  echo packet index times should have six digits
+  exit 1
+fi
+
+/bin/rm -rf out
+exit 0
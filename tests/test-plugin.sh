@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# test that -P loads a scanner built as a shared object against tcpflow's
+# headers and runs it on each flow, which needs tcpflow's symbols exported
+# since the plugin calls back into it for its option, and that a plugin
+# built for another version of the scanner interface is refused.
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/test1.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+CXX=${CXX:-c++}
+if ! command -v $CXX >/dev/null 2>&1 ; then echo no C++ compiler ; exit 77 ; fi
+
+# the source headers, and the build's config.h
+TESTSRC=${srcdir:-.}
+INCLUDES="-I$TESTSRC/../src -I$TESTSRC/../src/be13_api -I../src -I.."
+cmd "$CXX $CXXFLAGS -shared -fPIC $INCLUDES -o plugin-test.so $TESTSRC/plugin-test.cpp"
+cmd "$CXX $CXXFLAGS -shared -fPIC -DWRONG_ABI $INCLUDES -o plugin-test-abi.so $TESTSRC/plugin-test.cpp"
+
+/bin/rm -rf out
+if ! $TCPFLOW -P ./plugin-test.so -S plugin_test_tag=called_back -o out -r $DMPFILE > plugin-test.out 2>&1 ; then
+    if grep -q "built without dlopen" plugin-test.out ; then echo -P is not supported ; exit 77 ; fi
+    cat plugin-test.out ; echo failed ; exit 1
+fi
+if ! grep -q "<plugin_test tag='called_back' bytes='2792'/>" out/report.xml ; then
+    echo the plugin did not scan the flows ; exit 1
+fi
+
+/bin/rm -rf out
+if $TCPFLOW -P ./plugin-test-abi.so -o out -r $DMPFILE > plugin-test.out 2>&1 ; then
+    echo a plugin for another scanner interface was loaded ; exit 1
+fi
+if ! grep -q "built for plugin ABI" plugin-test.out ; then
+    cat plugin-test.out ; echo the plugin was not refused for its version ; exit 1
+fi
+
+/bin/rm -rf out plugin-test.so plugin-test-abi.so plugin-test.out
+exit 0
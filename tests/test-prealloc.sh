@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# test that -S flow_prealloc_rate, which reserves disk ahead of each
+# flow, leaves every file at the length of its flow when it is closed;
+# a rate of 1 byte/sec reserves for every flow
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/test1.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+checksize()
+{
+  size=`wc -c < $1 | tr -d ' '`
+  if [ x$size != x$2 ] ; then echo $1 is $size bytes, not $2 ; exit 1 ; fi
+}
+
+for max in 0 1000 ; do
+  /bin/rm -rf out
+  if [ $max = 0 ] ; then
+    cmd "$TCPFLOW -S flow_prealloc_rate=1 -o out -r $DMPFILE"
+    checkmd5 out/074.125.019.104.00080-192.168.001.102.50955 "61051e417d34e1354559e3a8901d19d3" "2792"
+    checksize out/074.125.019.104.00080-192.168.001.102.50955 2792
+  else
+    # the reservation stops at -b
+    cmd "$TCPFLOW -S flow_prealloc_rate=1 -b $max -o out -r $DMPFILE"
+    checksize out/074.125.019.104.00080-192.168.001.102.50955 $max
+  fi
+  checkmd5 out/074.125.019.101.00080-192.168.001.102.50956 "ae30a88136feb0655492bdb75e078643" "136"
+  checkmd5 out/192.168.001.102.50955-074.125.019.104.00080 "14e9c335bf54dc4652999e25d99fecfe" "655"
+  checkmd5 out/192.168.001.102.50956-074.125.019.101.00080 "78b8073093d107207327103e80fbdf43" "604"
+  checksize out/074.125.019.101.00080-192.168.001.102.50956 136
+  checksize out/192.168.001.102.50955-074.125.019.104.00080 655
+  checksize out/192.168.001.102.50956-074.125.019.101.00080 604
+done
+
+/bin/rm -rf out
+exit 0
@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# test that -e python calls a Python 3 function on every flow with all
+# of its data, NULs and all, and the flow's meta dict: one flow at a time,
+# in batches, and in worker processes
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/test1.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+if ! $TCPFLOW -H 2>&1 | grep -q python ; then echo scanner python not compiled in ; exit 77 ; fi
+
+cat > tcpflow_test_py.py <<'PYTHON'
+import os
+KEYS = {'path', 'src', 'dst', 'sport', 'dport', 'proto', 'family', 'start', 'end', 'packets', 'len', 'content'}
+
+def describe(data, meta):
+    if set(meta) != KEYS:
+        return 'bad meta: ' + ' '.join(sorted(meta))
+    if not isinstance(data, memoryview) or not data.readonly:
+        return 'not a read-only memoryview'
+    if meta['packets'] < 1 or meta['start'] > meta['end']:
+        return 'bad packets or times'
+    return '%s %d %d %d %d %d %s %d' % (os.path.basename(meta['path']), len(data), meta['len'],
+                                        bytes(data).count(0), meta['sport'], meta['dport'],
+                                        meta['proto'], os.path.getsize(meta['path']))
+
+def describe_batch(flows):
+    return [describe(data, meta) for data, meta in flows]
+PYTHON
+
+PY="-e python -S py_path=. -S py_module=tcpflow_test_py"
+/bin/rm -rf out
+if $TCPFLOW -d 2 $PY -S py_function=describe -o out -r $DMPFILE 2>&1 | grep -q "Python.h" ; then
+    echo tcpflow was built without Python 3 ; /bin/rm -rf out tcpflow_test_py.py ; exit 77
+fi
+
+for mode in "-S py_function=describe" \
+            "-S py_function=describe_batch -S py_batch=3" \
+            "-S py_function=describe -S py_workers=2" \
+            "-S py_function=describe_batch -S py_batch=2 -S py_workers=2" ; do
+    /bin/rm -rf out
+    cmd "$TCPFLOW $PY $mode -o out -r $DMPFILE"
+    # the server's 2792 bytes hold 16 NULs; none of the data may be lost at the first
+    for r in "074.125.019.104.00080-192.168.001.102.50955 2792 2792 16 80 50955 tcp 2792" \
+             "192.168.001.102.50955-074.125.019.104.00080 655 655 0 50955 80 tcp 655" \
+             "074.125.019.101.00080-192.168.001.102.50956 136 136 0 80 50956 tcp 136" \
+             "192.168.001.102.50956-074.125.019.101.00080 604 604 0 50956 80 tcp 604" ; do
+        if ! grep -q ">$r</tcpflow:result>" out/report.xml ; then
+            echo "$mode: no result '$r'" ; grep "tcpflow:result" out/report.xml ; exit 1
+        fi
+    done
+    if [ `grep -c "scan=\"python\"" out/report.xml` != 4 ] ; then
+        echo "$mode: there should be a result for each of the 4 flows" ; exit 1
+    fi
+done
+
+/bin/rm -rf out tcpflow_test_py.py tcpflow_test_py.pyc __pycache__
+exit 0
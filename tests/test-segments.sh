@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# test that -S segments=1 stores the flows in segment files and that
+# tcpflow-extract recreates the files tcpflow would have written
+#
+
+. $srcdir/test-subs.sh
+
+EXTRACT=`dirname $TCPFLOW`/tcpflow-extract
+C2S=010.001.000.001.40000-010.002.000.002.00080
+S2C=010.002.000.002.00080-010.001.000.001.40000
+DMPFILE=$DMPDIR/nsec-be.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+/bin/rm -rf out extracted
+cmd "$TCPFLOW -S segments=1 -o out -r $DMPFILE"
+if [ -r out/$C2S ] ; then echo out/$C2S should not have been created ; exit 1 ; fi
+if ! [ -r out/tcpflow.idx ] ; then echo out/tcpflow.idx was not created ; exit 1 ; fi
+if ! [ -r out/tcpflow-000000.seg ] ; then echo out/tcpflow-000000.seg was not created ; exit 1 ; fi
+
+cmd "$EXTRACT -o extracted out"
+checkmd5 extracted/$C2S "e3956598633826eca0bf5c6374206439" "43"
+checkmd5 extracted/$S2C "83d792c87f7c22b7d0f4ee9a91106725" "63"
+
+# one flow, by name
+/bin/rm -rf extracted
+cmd "$EXTRACT -o extracted out $S2C"
+checkmd5 extracted/$S2C "83d792c87f7c22b7d0f4ee9a91106725" "63"
+if [ -r extracted/$C2S ] ; then echo extracted/$C2S should not have been extracted ; exit 1 ; fi
+
+/bin/rm -rf out extracted
+exit 0
@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# test that flows and HTTP bodies are typed by their magic numbers, and
+# that a body without a Content-Type is named by what it holds
+#
+
+. $srcdir/test-subs.sh
+
+S2C=out/010.002.000.002.00080-010.001.000.001.40004
+DMPFILE=$DMPDIR/sniff.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+/bin/rm -rf out
+cmd "$TCPFLOW -e http -o out -r $DMPFILE"
+
+checkmd5 ${S2C}-HTTPBODY-001.png "08d760926035aef3cd94fb5bc4c36e95" "29"
+if ! grep -q "<content>png</content>" out/report.xml ; then
+    echo the PNG body should be recorded as png ; exit 1
+fi
+for t in tls-client-hello tls-server-hello ; do
+    if ! grep -q "content='$t'" out/report.xml ; then
+        echo a flow should be recorded as $t ; exit 1
+    fi
+done
+
+/bin/rm -rf out
+exit 0
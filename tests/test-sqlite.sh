@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# test that -S sqlite_db records one row per flow
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/nsec-be.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+if ! which sqlite3 >/dev/null 2>&1 ; then echo sqlite3 not installed ; exit 77 ; fi
+
+/bin/rm -rf out
+if ! $TCPFLOW -S sqlite_db=flows.db -o out -r $DMPFILE ; then
+  echo tcpflow was probably compiled without SQLite
+  /bin/rm -rf out
+  exit 77
+fi
+
+ROWS=`sqlite3 out/flows.db "SELECT count(*) FROM connections WHERE src_ipn='10.1.0.1' AND srcport=40000 AND dst_ipn='10.2.0.2' AND dstport=80"`
+if [ x$ROWS != x1 ] ; then echo expected one row for the 10.1.0.1 flow, got $ROWS ; exit 1 ; fi
+ROWS=`sqlite3 out/flows.db "SELECT count(*) FROM connections"`
+if [ x$ROWS != x2 ] ; then echo expected two rows, got $ROWS ; exit 1 ; fi
+START=`sqlite3 out/flows.db "SELECT starttime FROM connections WHERE srcport=40000"`
+if [ x$START != x2017-07-14T02:40:00.123456789Z ] ; then echo wrong starttime $START ; exit 1 ; fi
+
+/bin/rm -rf out
+exit 0
@@ -0,0 +1,123 @@
+#!/bin/sh
+#
+# test that -S stream=socket sends the flows to a consumer on a
+# Unix-domain socket, and that writing each DATA message at its offset
+# recreates the files tcpflow would have written; then, with a consumer
+# that doesn't read until the input has ended, that spill sends every
+# byte through the spill file and drop counts every byte it drops
+#
+
+. $srcdir/test-subs.sh
+
+C2S=010.001.000.001.40000-010.002.000.002.00080
+S2C=010.002.000.002.00080-010.001.000.001.40000
+DMPFILE=$DMPDIR/nsec-be.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+if ! python3 -c "import socket; socket.AF_UNIX" 2>/dev/null ; then echo python3 with Unix sockets not found ; exit 77 ; fi
+
+# The consumer: writes each flow to a file named as tcpflow would name it
+cat > stream-consumer.py <<'PYTHON'
+import os, socket, struct, sys, time
+sock, outdir = sys.argv[1], sys.argv[2]
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.bind(sock)
+s.listen(1)
+c, _ = s.accept()
+if len(sys.argv) > 3:
+    time.sleep(float(sys.argv[3]))      # fall behind
+f = c.makefile('rb')
+assert f.read(16)[:8] == b'TFSTRM1\0'
+names, files, received, opens, closes = {}, {}, {}, 0, 0
+while True:
+    h = f.read(16)
+    if not h:
+        break
+    mtype, mlen, fid = struct.unpack('=IIQ', h)
+    body = f.read(mlen - 16)
+    if mtype == 1:
+        sport, dport, ipv = struct.unpack('=HHB', body[12:17])
+        src, dst = body[24:28], body[40:44]
+        assert ipv == 4
+        names[fid] = '%03d.%03d.%03d.%03d.%05d-%03d.%03d.%03d.%03d.%05d' % (tuple(src) + (sport,) + tuple(dst) + (dport,))
+        opens += 1
+    elif mtype == 2:
+        offset, = struct.unpack('=Q', body[:8])
+        if fid not in files:
+            files[fid] = open(os.path.join(outdir, names[fid]), 'wb')
+        files[fid].seek(offset)
+        files[fid].write(body[8:])
+        received[fid] = received.get(fid, 0) + len(body) - 8
+    elif mtype == 3:
+        nbytes, packets, dropped = struct.unpack('=QQQ', body[16:40])
+        assert received.get(fid, 0) + dropped == nbytes, (names[fid], received.get(fid, 0), dropped, nbytes)
+        closes += 1
+        if fid in files:
+            files.pop(fid).close()
+assert opens == closes == 2, (opens, closes)
+PYTHON
+
+for policy in block spill ; do
+  /bin/rm -rf out streamed stream.sock
+  mkdir streamed
+  python3 stream-consumer.py stream.sock streamed &
+  CONSUMER=$!
+  for i in 1 2 3 4 5 6 7 8 9 10 ; do [ -S stream.sock ] && break ; sleep 1 ; done
+  cmd "$TCPFLOW -S stream=stream.sock -S stream_policy=$policy -S stream_queue=1 -o out -r $DMPFILE"
+  if ! wait $CONSUMER ; then echo stream consumer failed ; exit 1 ; fi
+  if [ -r out/$C2S ] ; then echo out/$C2S should not have been created ; exit 1 ; fi
+  checkmd5 streamed/$C2S "e3956598633826eca0bf5c6374206439" "43"
+  checkmd5 streamed/$S2C "83d792c87f7c22b7d0f4ee9a91106725" "63"
+done
+
+# A flow of 4 MB, much more than the socket holds
+cat > stream-big.py <<'PYTHON'
+import struct, sys
+def pkt(src, dst, sport, dport, seq, ack, flags, data=b''):
+    tcp = struct.pack('!HHIIBBHHH', sport, dport, seq, ack, 5 << 4, flags, 65535, 0, 0)
+    ip = struct.pack('!BBHHHBBH4s4s', 0x45, 0, 40 + len(data), 1, 0, 64, 6, 0, bytes(src), bytes(dst))
+    return b'\0\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\x08\x00' + ip + tcp + data
+C, S, cs, ss = [10, 1, 0, 1], [10, 2, 0, 2], 1000, 5000
+pk = [pkt(C, S, 40000, 80, cs, 0, 0x02), pkt(S, C, 80, 40000, ss, cs + 1, 0x12)]
+cs += 1; ss += 1
+for i in range(3000):
+    data = bytes((i * 7 + j) % 251 for j in range(1400))
+    pk.append(pkt(C, S, 40000, 80, cs, ss, 0x18, data)); cs += len(data)
+pk.append(pkt(S, C, 80, 40000, ss, cs, 0x18, b'ok')); ss += 2
+pk.append(pkt(C, S, 40000, 80, cs, ss, 0x11)); pk.append(pkt(S, C, 80, 40000, ss, cs + 1, 0x11))
+out = open(sys.argv[1], 'wb')
+out.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+for i, p in enumerate(pk):
+    out.write(struct.pack('<IIII', 1500000000, i, len(p), len(p)) + p)
+PYTHON
+python3 stream-big.py stream-big.pcap || exit 1
+/bin/rm -rf direct
+cmd "$TCPFLOW -o direct -r stream-big.pcap"
+
+for policy in spill drop ; do
+  /bin/rm -rf out streamed stream.sock
+  mkdir streamed
+  python3 stream-consumer.py stream.sock streamed 3 &
+  CONSUMER=$!
+  for i in 1 2 3 4 5 6 7 8 9 10 ; do [ -S stream.sock ] && break ; sleep 1 ; done
+  cmd "$TCPFLOW -S stream=stream.sock -S stream_policy=$policy -S stream_queue=65536 -o out -r stream-big.pcap"
+  if ! wait $CONSUMER ; then echo $policy: stream consumer failed ; exit 1 ; fi
+  if [ -r out/tcpflow-stream.spill ] ; then echo $policy: the spill file should have been removed ; exit 1 ; fi
+  case $policy in
+  spill)
+    # all of it arrives, most of it by way of the spill file, after the input has ended
+    if grep -q "<spilled_bytes>0</spilled_bytes>" out/report.xml ; then echo nothing was spilled ; exit 1 ; fi
+    if ! grep -q "<dropped_bytes>0</dropped_bytes>" out/report.xml ; then echo spill should drop nothing ; exit 1 ; fi
+    for f in $C2S $S2C ; do
+      if ! cmp -s direct/$f streamed/$f ; then echo spill: streamed/$f differs from direct/$f ; exit 1 ; fi
+    done
+    ;;
+  drop)
+    # the consumer checked that each CLOSE counts what was dropped
+    if grep -q "<dropped_bytes>0</dropped_bytes>" out/report.xml ; then echo nothing was dropped ; exit 1 ; fi
+    if ! grep -q "<spilled_bytes>0</spilled_bytes>" out/report.xml ; then echo drop should spill nothing ; exit 1 ; fi
+    ;;
+  esac
+done
+
+/bin/rm -rf out streamed direct stream.sock stream-consumer.py stream-big.py stream-big.pcap
+exit 0
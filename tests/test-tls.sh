@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# test that the TLS hellos and the server's certificates are recorded,
+# and that -S tls_truncate=1 stores each flow only up to the end of its
+# handshake
+#
+
+. $srcdir/test-subs.sh
+
+C2S=out/010.001.000.001.40005-010.002.000.002.00443
+S2C=out/010.002.000.002.00443-010.001.000.001.40005
+DMPFILE=$DMPDIR/tls.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+/bin/rm -rf out
+cmd "$TCPFLOW -e tls -o out -r $DMPFILE"
+checkmd5 ${S2C}-CERT-001.der "c6da5d7e41bf35883886172abfaafd0d" "554"
+for s in "<sni>www.example.com</sni>" "<alpn>h2</alpn>" \
+         "<ja3 md5='60b2156f8c04dd3d9c233259e8b7db76'>" \
+         "<ja3s md5='94d15fb85410d46db5a043124cf1b7ad'>" ; do
+    if ! grep -q "$s" out/report.xml ; then
+        echo report.xml should have $s ; exit 1
+    fi
+done
+
+/bin/rm -rf out
+cmd "$TCPFLOW -e tls -S tls_truncate=1 -o out -r $DMPFILE"
+checkmd5 $C2S "c299e3f8d1a9caad303df789051d01a2" "217"
+checkmd5 $S2C "b3bfa705967f1e14ab6900ff270fc471" "1206"
+checkmd5 ${S2C}-CERT-001.der "c6da5d7e41bf35883886172abfaafd0d" "554"
+
+/bin/rm -rf out
+exit 0
@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# test that -w splits unprocessed packets by protocol and rotates its output
+#
+
+. $srcdir/test-subs.sh
+
+DMPFILE=$DMPDIR/unk-packets.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+# checksize file bytes
+checksize()
+{
+  if [ ! -r $1 ] ; then echo file $1 was not created ; ls -l out ; exit 1 ; fi
+  size=`wc -c < $1 | tr -d ' '`
+  if [ x$2 != x$size ] ; then echo $1 has $size bytes, expected $2 ; exit 1 ; fi
+}
+
+echo ========
+echo check pcap_split
+echo ========
+/bin/rm -rf out
+cmd "$TCPFLOW -o out -S pcap_split=1 -w out/unk.pcap -r $DMPFILE"
+checksize out/unk-udp.pcap 420
+checksize out/unk-icmp.pcap 156
+checksize out/unk-other.pcap 82
+if [ -r out/unk.pcap ] ; then echo out/unk.pcap should not have been created ; exit 1 ; fi
+
+echo ========
+echo check pcap_rotate_seconds
+echo ========
+/bin/rm -rf out
+cmd "$TCPFLOW -o out -S pcap_rotate_seconds=3 -w out/unk.pcap -r $DMPFILE"
+checksize out/unk.pcap 222
+checksize out/unk.1.pcap 222
+checksize out/unk.2.pcap 214
+if [ -r out/unk.3.pcap ] ; then echo out/unk.3.pcap should not have been created ; exit 1 ; fi
+
+echo ========
+echo check pcap_rotate_size
+echo ========
+/bin/rm -rf out
+cmd "$TCPFLOW -o out -S pcap_rotate_size=200 -w out/unk.pcap -r $DMPFILE"
+checksize out/unk.pcap 156
+checksize out/unk.1.pcap 156
+checksize out/unk.2.pcap 156
+checksize out/unk.3.pcap 148
+checksize out/unk.4.pcap 90
+
+echo ========
+echo check pcap_prealloc
+echo ========
+# each file reserves 4 MB, and gives back what it didn't use on close
+/bin/rm -rf out
+cmd "$TCPFLOW -o out -S pcap_prealloc=4194304 -S pcap_rotate_size=200 -w out/unk.pcap -r $DMPFILE"
+checksize out/unk.pcap 156
+checksize out/unk.4.pcap 90
+if [ `du -sk out | awk '{print $1;}'` -ge 4096 ] ; then
+  du -k out ; echo the space reserved for the -w files was not freed ; exit 1
+fi
+
+/bin/rm -rf out
+exit 0
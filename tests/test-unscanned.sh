@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+# test that flows no enabled scanner can use are not post-processed, and
+# that a scanner which wants every flow still gets them all
+#
+
+. $srcdir/test-subs.sh
+
+S2C=out/010.002.000.002.00080-010.001.000.001.40004
+DMPFILE=$DMPDIR/sniff.pcap
+if ! [ -r $DMPFILE ] ; then echo $DMPFILE not found ; exit 1 ; fi
+
+# the two TLS flows are of no use to scan_http
+/bin/rm -rf out
+cmd "$TCPFLOW -e http -o out -r $DMPFILE"
+checkmd5 ${S2C}-HTTPBODY-001.png "08d760926035aef3cd94fb5bc4c36e95" "29"
+if ! grep -q "<unscanned_flows>2</unscanned_flows>" out/report.xml ; then
+    echo the TLS flows should not have been post-processed ; exit 1
+fi
+
+# md5 hashes every flow
+/bin/rm -rf out
+cmd "$TCPFLOW -e http -e md5 -o out -r $DMPFILE"
+if ! grep -q "<unscanned_flows>0</unscanned_flows>" out/report.xml ; then
+    echo every flow should have been post-processed for md5 ; exit 1
+fi
+
+/bin/rm -rf out
+exit 0